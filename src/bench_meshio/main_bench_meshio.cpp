@@ -0,0 +1,117 @@
+
+// The main for the bench_meshio program.
+// Benchmarks the memory-mapped FreeSurfer surf and curv readers and the PLY, OBJ and OFF readers against the libfs
+// readers. By default, it runs on the meshes and curv files in the demo_data directory, so run it from the repo root.
+// The text format files are generated from the last surf file and deleted afterwards.
+
+#include "libfs.h"
+#include "fs_mmap_io.h"
+#include "mesh_mmap_io.h"
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <cstdio>
+
+
+/// @brief Time `reps` calls of a loader function, return the mean time per call in milliseconds.
+template <typename F>
+double time_ms(F load, const int reps) {
+    std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+    for(int r=0; r<reps; r++) {
+        load();
+    }
+    std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / reps;
+}
+
+
+/// @brief Print one result line of the benchmark table.
+void report(const std::string& file, const size_t num_bytes, const double ms_libfs, const double ms_mmap) {
+    std::cout << std::left << std::setw(60) << file << std::right << std::setw(10) << (num_bytes / 1024) << " KiB"
+              << std::fixed << std::setprecision(3) << std::setw(12) << ms_libfs << " ms" << std::setw(12) << ms_mmap << " ms"
+              << std::setprecision(1) << std::setw(10) << (ms_libfs / ms_mmap) << "x\n";
+}
+
+
+int main(int argc, char** argv) {
+    int reps = 20;
+    std::vector<std::string> surf_files = {
+        "demo_data/subjects_dir/fsaverage3/surf/lh.white",
+        "demo_data/subjects_dir/fsaverage5/surf/lh.pial",
+        "demo_data/subjects_dir/fsaverage6/surf/lh.pial"
+    };
+    std::vector<std::string> curv_files = {
+        "demo_data/subjects_dir/fsaverage3/surf/lh.thickness",
+        "demo_data/subjects_dir/subject1/surf/lh.thickness"
+    };
+
+    if(argc > 1) {
+        std::istringstream iss(argv[1]);
+        if(!(iss >> reps) || reps < 1) {
+            std::cout << "Usage: " << argv[0] << " [<repetitions> [<surf_file> ...]]\n";
+            std::cout << "  <repetitions> : int, number of times each file is loaded with each reader. Defaults to 20.\n";
+            std::cout << "  <surf_file>   : str, FreeSurfer surf files to load instead of the demo data meshes. If given, no curv files are loaded.\n";
+            exit(1);
+        }
+    }
+    if(argc > 2) {
+        surf_files.clear();
+        curv_files.clear();
+        for(int i=2; i<argc; i++) {
+            surf_files.push_back(argv[i]);
+        }
+    }
+
+    std::cout << "=====[ bench_meshio ]=====. Mean load times over " << reps << " repetitions.\n";
+    std::cout << std::left << std::setw(60) << "file" << std::right << std::setw(14) << "size" << std::setw(15) << "libfs" << std::setw(15) << "mmap" << std::setw(11) << "speedup" << "\n";
+
+    for(size_t i=0; i<surf_files.size(); i++) {
+        const std::string& f = surf_files[i];
+        fs::Mesh a, b;
+        fs::read_surf(&a, f);
+        read_surf_mmap(&b, f);
+        if(a.vertices != b.vertices || a.faces != b.faces) {
+            throw std::runtime_error("Readers returned different meshes for file '" + f + "'.\n");
+        }
+        const double ms_libfs = time_ms([&]() { fs::Mesh m; fs::read_surf(&m, f); }, reps);
+        const double ms_mmap = time_ms([&]() { fs::Mesh m; read_surf_mmap(&m, f); }, reps);
+        report(f, MappedFile(f).size(), ms_libfs, ms_mmap);
+    }
+
+    for(size_t i=0; i<curv_files.size(); i++) {
+        const std::string& f = curv_files[i];
+        if(fs::read_curv_data(f) != read_curv_data_mmap(f)) {
+            throw std::runtime_error("Readers returned different data for file '" + f + "'.\n");
+        }
+        const double ms_libfs = time_ms([&]() { fs::read_curv_data(f); }, reps);
+        const double ms_mmap = time_ms([&]() { read_curv_data_mmap(f); }, reps);
+        report(f, MappedFile(f).size(), ms_libfs, ms_mmap);
+    }
+
+    if(! surf_files.empty()) {
+        fs::Mesh source;
+        read_surf_mmap(&source, surf_files.back());
+        const std::vector<std::string> text_files = { "bench_meshio_tmp.ply", "bench_meshio_tmp.obj", "bench_meshio_tmp.off" };
+        source.to_ply_file(text_files[0]);
+        source.to_obj_file(text_files[1]);
+        source.to_off_file(text_files[2]);
+        for(size_t i=0; i<text_files.size(); i++) {
+            const std::string& f = text_files[i];
+            fs::Mesh a, b;
+            fs::read_mesh(&a, f);
+            read_mesh_mmap(&b, f);
+            if(a.vertices != b.vertices || a.faces != b.faces) {
+                throw std::runtime_error("Readers returned different meshes for file '" + f + "'.\n");
+            }
+            const double ms_libfs = time_ms([&]() { fs::Mesh m; fs::read_mesh(&m, f); }, reps);
+            const double ms_mmap = time_ms([&]() { fs::Mesh m; read_mesh_mmap(&m, f); }, reps);
+            report(f, MappedFile(f).size(), ms_libfs, ms_mmap);
+            std::remove(f.c_str());
+        }
+    }
+    exit(0);
+}
@@ -0,0 +1,192 @@
+
+// The main for the bench_reorder program.
+// Benchmarks the cache-locality vertex reordering from mesh_reorder.h: for the original vertex order, Reverse
+// Cuthill-McKee and Morton order, it reports the mean index distance of mesh neighbors, the cache misses of bounded
+// Dijkstra searches in a simulated L1 data cache, and the run time of the geodesic neighborhood computation used by
+// meshneigh_geod. It also checks that the results mapped back to the original order are identical. By default, it runs
+// on meshes in the demo_data directory, so run it from the repo root.
+
+#include "libfs.h"
+#include "mesh_mmap_io.h"
+#include "mesh_view.h"
+#include "mesh_csr.h"
+#include "geod_engine.h"
+#include "mesh_reorder.h"
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+
+
+/// @brief Simulated set-associative data cache with LRU replacement, counting misses.
+struct CacheSim {
+  /// @brief Create a cache with `size_bytes` bytes, `ways` lines per set and `line_bytes` bytes per line.
+  CacheSim(const size_t size_bytes = 32768, const size_t ways = 8, const size_t line_bytes = 64) : ways(ways), line_bytes(line_bytes), num_sets(size_bytes / (ways * line_bytes)), tags(num_sets * ways, UINT64_MAX), accesses(0), misses(0) {}
+
+  size_t ways;
+  size_t line_bytes;
+  size_t num_sets;
+  std::vector<uint64_t> tags;  ///< Per set, the cached line addresses ordered from most to least recently used.
+  uint64_t accesses;
+  uint64_t misses;
+
+  /// @brief Simulate a read of the given address.
+  void touch(const void* addr) {
+    const uint64_t line = uint64_t(reinterpret_cast<uintptr_t>(addr)) / this->line_bytes;
+    uint64_t* set = this->tags.data() + (line % this->num_sets) * this->ways;
+    this->accesses++;
+    size_t pos = 0;
+    while(pos < this->ways && set[pos] != line) {
+      pos++;
+    }
+    if(pos == this->ways) {
+      this->misses++;
+      pos = this->ways - 1;  // Evict the least recently used line.
+    }
+    for(; pos>0; pos--) {
+      set[pos] = set[pos-1];
+    }
+    set[0] = line;
+  }
+};
+
+
+/// @brief Run a bounded Dijkstra search like `geod_dijkstra`, and simulate the reads of the graph and distance arrays in the cache.
+void dijkstra_simulated(const GeodGraph& g, const int32_t source, const float max_dist, GeodWorkspace& ws, CacheSim& cache) {
+  typedef std::pair<float, int32_t> HeapEntry;
+  ws.reset();
+  std::greater<HeapEntry> cmp;
+  ws.dist[source] = 0.0f;
+  ws.reached.push_back(source);
+  ws.heap.push_back(HeapEntry(0.0f, source));
+  while(! ws.heap.empty()) {
+    std::pop_heap(ws.heap.begin(), ws.heap.end(), cmp);
+    const HeapEntry top = ws.heap.back();
+    ws.heap.pop_back();
+    const int32_t cur = top.second;
+    cache.touch(&ws.dist[cur]);
+    if(top.first > ws.dist[cur]) {
+      continue;
+    }
+    cache.touch(&g.csr.offsets[cur]);
+    cache.touch(&g.csr.offsets[cur+1]);
+    for(int64_t k=g.csr.offsets[cur]; k<g.csr.offsets[cur+1]; k++) {
+      cache.touch(&g.csr.adj[k]);
+      cache.touch(&g.weights[k]);
+      const int32_t next = g.csr.adj[k];
+      cache.touch(&ws.dist[next]);
+      const float next_dist = top.first + g.weights[k];
+      if(next_dist < max_dist && next_dist < ws.dist[next]) {
+        if(ws.dist[next] == GEOD_UNREACHED) {
+          ws.reached.push_back(next);
+        }
+        ws.dist[next] = next_dist;
+        ws.heap.push_back(HeapEntry(next_dist, next));
+        std::push_heap(ws.heap.begin(), ws.heap.end(), cmp);
+      }
+    }
+  }
+}
+
+
+/// @brief Compute the mean index distance `|u - v|` over all mesh edges.
+double mean_edge_span(const MeshCSR& csr) {
+  double span = 0.0;
+  for(size_t v=0; v<csr.num_vertices(); v++) {
+    for(const int32_t* n = csr.neighbors_begin(v); n != csr.neighbors_end(v); ++n) {
+      span += std::abs(double(*n) - double(v));
+    }
+  }
+  return csr.adj.empty() ? 0.0 : span / double(csr.adj.size());
+}
+
+
+/// @brief Get milliseconds since `start`.
+double ms_since(const std::chrono::time_point<std::chrono::steady_clock>& start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+int main(int argc, char** argv) {
+  float max_dist = 5.0f;
+  std::vector<std::string> mesh_files = {
+      "demo_data/subjects_dir/fsaverage6/surf/lh.pial",
+      "demo_data/subjects_dir/subject1/surf/lh.pialsurface6"
+  };
+  const std::vector<std::string> methods = { "none", "rcm", "morton" };
+
+  if(argc > 1) {
+    std::istringstream iss(argv[1]);
+    if(!(iss >> max_dist) || max_dist <= 0.0f) {
+      std::cout << "Usage: " << argv[0] << " [<max_dist> [<mesh_file> ...]]\n";
+      std::cout << "  <max_dist>  : float, the radius of the geodesic neighborhoods. Defaults to 5.0.\n";
+      std::cout << "  <mesh_file> : str, mesh files to use instead of the demo data meshes, in any format supported by read_mesh_mmap.\n";
+      exit(1);
+    }
+  }
+  if(argc > 2) {
+    mesh_files.clear();
+    for(int i=2; i<argc; i++) {
+      mesh_files.push_back(argv[i]);
+    }
+  }
+
+  std::cout << "=====[ bench_reorder ]=====. Geodesic neighborhoods with max_dist " << max_dist << ", simulated 32 KiB 8-way L1 data cache.\n";
+  std::cout << std::left << std::setw(55) << "file" << std::setw(8) << "order" << std::right << std::setw(12) << "reorder" << std::setw(12) << "edge span"
+            << std::setw(14) << "misses/query" << std::setw(12) << "miss red." << std::setw(12) << "search" << std::setw(10) << "speedup" << "\n";
+
+  for(size_t i=0; i<mesh_files.size(); i++) {
+    fs::Mesh mesh;
+    read_mesh_mmap(&mesh, mesh_files[i]);
+    std::vector<std::vector<GeodNeighbor>> reference;
+    double base_misses = 0.0, base_ms = 0.0;
+
+    for(size_t j=0; j<methods.size(); j++) {
+      std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+      const VertexOrder order = vertex_order(mesh, methods[j]);
+      const fs::Mesh reordered = reorder_mesh(mesh, order);
+      const double reorder_ms = ms_since(start);
+
+      const MeshView<> mv = mesh_view(reordered);
+      const GeodGraph g = geod_graph(mv);
+      CacheSim cache;
+      GeodWorkspace ws(g.num_vertices());
+      for(size_t v=0; v<mv.num_vertices(); v++) {
+        dijkstra_simulated(g, int32_t(v), max_dist, ws, cache);  // In the same order as geod_neighborhood, so the reuse between consecutive queries counts.
+      }
+      const double misses = double(cache.misses) / double(mv.num_vertices());
+
+      start = std::chrono::steady_clock::now();
+      std::vector<std::vector<GeodNeighbor>> neigh = geod_neighborhood(mv, max_dist, true);
+      const double search_ms = ms_since(start);
+      neigh = geod_neighborhood_to_orig(neigh, order);
+
+      if(j == 0) {
+        reference = neigh;
+        base_misses = misses;
+        base_ms = search_ms;
+      } else {
+        for(size_t v=0; v<reference.size(); v++) {
+          bool same = reference[v].size() == neigh[v].size();
+          for(size_t k=0; same && k<neigh[v].size(); k++) {
+            same = reference[v][k].index == neigh[v][k].index && reference[v][k].distance == neigh[v][k].distance;
+          }
+          if(! same) {
+            throw std::runtime_error("Neighborhood of vertex " + std::to_string(v) + " differs for order '" + methods[j] + "' of mesh '" + mesh_files[i] + "'.\n");
+          }
+        }
+      }
+
+      std::cout << std::left << std::setw(55) << mesh_files[i] << std::setw(8) << methods[j] << std::right << std::fixed
+                << std::setprecision(2) << std::setw(9) << reorder_ms << " ms" << std::setprecision(1) << std::setw(12) << mean_edge_span(g.csr)
+                << std::setw(14) << misses << std::setw(11) << (100.0 * (1.0 - misses / base_misses)) << "%"
+                << std::setprecision(2) << std::setw(9) << search_ms << " ms" << std::setw(9) << (base_ms / search_ms) << "x\n";
+    }
+  }
+  exit(0);
+}
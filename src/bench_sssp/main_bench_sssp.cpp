@@ -0,0 +1,130 @@
+
+// The main for the bench_sssp program.
+// Benchmarks the parallel delta-stepping search from geod_delta.h against the sequential Dijkstra search from
+// geod_engine.h, for a single full distance field on synthetic meshes of increasing size: wavy grids, whose edge lengths
+// vary like the ones of a folded surface. It reports the strong scaling over thread counts and the effect of the bucket
+// width, and checks that all distances are identical to the Dijkstra ones.
+
+#include "libfs.h"
+#include "mesh_view.h"
+#include "geod_engine.h"
+#include "geod_delta.h"
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+
+/// @brief Create a synthetic mesh: a grid with `side x side` vertices and unit spacing, displaced along z by a few overlapping waves.
+fs::Mesh wavy_grid(const size_t side) {
+  fs::Mesh mesh = fs::Mesh::construct_grid(side, side);  // Only its faces are used, its y coordinates do not restart per row.
+  for(size_t v=0; v<mesh.num_vertices(); v++) {
+    const float x = float(v / side), y = float(v % side);
+    mesh.vertices[v*3] = x;
+    mesh.vertices[v*3+1] = y;
+    mesh.vertices[v*3+2] = 4.0f * std::sin(x / 9.0f) * std::cos(y / 13.0f) + 1.5f * std::sin((x + y) / 4.0f);
+  }
+  return mesh;
+}
+
+
+double ms_since(const std::chrono::time_point<std::chrono::steady_clock>& start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+/// @brief Get the fastest of `reps` runs of a delta-stepping search in ms, and check its distances against the reference.
+double time_delta(const GeodGraph& g, const int32_t source, const float delta, const size_t reps, const std::vector<float>& reference) {
+  GeodWorkspace ws(g.num_vertices());
+  double best = -1.0;
+  for(size_t r=0; r<reps; r++) {
+    const std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+    geod_delta_stepping(g, &source, 1, -1.0f, delta, ws);
+    const double ms = ms_since(start);
+    best = (best < 0.0 || ms < best) ? ms : best;
+  }
+  if(ws.dist != reference) {
+    throw std::runtime_error("Delta-stepping distances with delta " + std::to_string(delta) + " differ from the Dijkstra ones.\n");
+  }
+  return best;
+}
+
+
+int main(int argc, char** argv) {
+  size_t max_threads = 64;
+  std::vector<size_t> sides = { 500, 1000, 2000 };
+  const std::vector<float> delta_factors = { 0.5f, 1.0f, 2.0f, 4.0f, 8.0f, 16.0f };
+  const size_t reps = 3;
+
+  if(argc > 1) {
+    std::istringstream iss(argv[1]);
+    if(!(iss >> max_threads) || max_threads < 1) {
+      std::cout << "Usage: " << argv[0] << " [<max_threads> [<grid_side> ...]]\n";
+      std::cout << "  <max_threads> : int, the largest thread count to run with. The thread counts are the powers of 2 up to it. Defaults to 64.\n";
+      std::cout << "  <grid_side>   : int, the number of vertices per side of the synthetic grid meshes. Defaults to 500, 1000 and 2000, i.e., 0.25, 1 and 4 million vertices.\n";
+      exit(1);
+    }
+  }
+  if(argc > 2) {
+    sides.clear();
+    for(int i=2; i<argc; i++) {
+      size_t side;
+      std::istringstream iss(argv[i]);
+      if(!(iss >> side) || side < 2) {
+        throw std::runtime_error("Could not convert argument grid_side '" + std::string(argv[i]) + "' to an integer of at least 2.\n");
+      }
+      sides.push_back(side);
+    }
+  }
+#ifndef _OPENMP
+  std::cout << "Built without OpenMP, all runs use 1 thread.\n";
+#endif
+
+  std::cout << "=====[ bench_sssp ]=====. One full distance field from a corner vertex, fastest of " << reps << " runs.\n";
+  for(size_t i=0; i<sides.size(); i++) {
+    const fs::Mesh mesh = wavy_grid(sides[i]);
+    const GeodGraph g = geod_graph(mesh_view(mesh));
+    const int32_t source = 0;
+    const float default_delta = geod_delta_default(g);
+
+    GeodWorkspace ws(g.num_vertices());
+    double dijkstra_ms = -1.0;
+    for(size_t r=0; r<reps; r++) {
+      const std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+      geod_dijkstra(g, &source, 1, -1.0f, ws);
+      const double ms = ms_since(start);
+      dijkstra_ms = (dijkstra_ms < 0.0 || ms < dijkstra_ms) ? ms : dijkstra_ms;
+    }
+    const std::vector<float> reference = ws.dist;
+    std::cout << "Grid " << sides[i] << "x" << sides[i] << ": " << g.num_vertices() << " vertices, sequential Dijkstra " << std::fixed << std::setprecision(1) << dijkstra_ms << " ms, default delta " << std::setprecision(3) << default_delta << ".\n";
+
+    std::cout << std::right << std::setw(10) << "threads" << std::setw(14) << "delta-step" << std::setw(14) << "vs Dijkstra" << std::setw(14) << "vs 1 thread" << "\n";
+    double one_thread_ms = -1.0;
+    size_t last_threads = 1;
+    for(size_t t=1; t<=max_threads; t*=2) {
+      last_threads = t;
+#ifdef _OPENMP
+      omp_set_num_threads(int(t));
+#endif
+      const double ms = time_delta(g, source, default_delta, reps, reference);
+      if(t == 1) {
+        one_thread_ms = ms;
+      }
+      std::cout << std::setw(10) << t << std::setprecision(1) << std::setw(11) << ms << " ms" << std::setprecision(2) << std::setw(13) << (dijkstra_ms / ms) << "x" << std::setw(13) << (one_thread_ms / ms) << "x\n";
+    }
+
+    std::cout << std::setw(10) << "delta" << std::setw(14) << "delta-step" << std::setw(14) << "vs Dijkstra" << "   (" << last_threads << " threads)\n";
+    for(size_t d=0; d<delta_factors.size(); d++) {
+      const float delta = default_delta / 4.0f * delta_factors[d];
+      const double ms = time_delta(g, source, delta, reps, reference);
+      std::cout << std::setw(10) << std::setprecision(3) << delta << std::setprecision(1) << std::setw(11) << ms << " ms" << std::setprecision(2) << std::setw(13) << (dijkstra_ms / ms) << "x\n";
+    }
+  }
+  exit(0);
+}
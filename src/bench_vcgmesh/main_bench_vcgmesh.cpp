@@ -0,0 +1,150 @@
+
+// The main for the bench_vcgmesh program.
+// Benchmarks the lean VCGLIB mesh type `GeodMesh` against the full `MyMesh` type (see typedef_vcg.h) for the
+// geodesic and area functions templated on the mesh type: it reports the memory per vertex and face (including the
+// enabled optional components of `MyMesh`), and the run times of the conversion from `fs::Mesh`, the area and edge
+// length functions and full Dijkstra searches. It also checks that both types give identical results. By default, it
+// runs on meshes in the demo_data directory, so run it from the repo root.
+
+#include "libfs.h"
+#include "typedef_vcg.h"
+#include "fs_mesh_to_vcg.h"
+#include "mesh_area.h"
+#include "mesh_edges.h"
+#include "mesh_geodesic.h"
+#include "mesh_mmap_io.h"
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+
+
+/// @brief Get the milliseconds since `start`.
+double ms_since(const std::chrono::time_point<std::chrono::steady_clock>& start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+/// @brief Get the allocated bytes of a vector.
+template<typename X>
+size_t vec_bytes(const std::vector<X>& v) {
+  return v.capacity() * sizeof(X);
+}
+
+
+/// @brief Get the bytes allocated for the vertices and faces of a `MyMesh`, including its optional components.
+size_t mesh_bytes(MyMesh& m) {
+  size_t bytes = vec_bytes<MyVertex>(m.vert) + vec_bytes<MyFace>(m.face);
+  bytes += vec_bytes(m.vert.CV) + vec_bytes(m.vert.CuV) + vec_bytes(m.vert.CuDV) + vec_bytes(m.vert.MV) + vec_bytes(m.vert.NV)
+         + vec_bytes(m.vert.QV) + vec_bytes(m.vert.RadiusV) + vec_bytes(m.vert.TV) + vec_bytes(m.vert.AV);
+  bytes += vec_bytes(m.face.CV) + vec_bytes(m.face.CDV) + vec_bytes(m.face.MV) + vec_bytes(m.face.NV) + vec_bytes(m.face.QV)
+         + vec_bytes(m.face.WCV) + vec_bytes(m.face.WNV) + vec_bytes(m.face.WTV) + vec_bytes(m.face.AV) + vec_bytes(m.face.AF);
+  return bytes;
+}
+
+
+/// @brief Get the bytes allocated for the vertices and faces of a `GeodMesh`, which has no optional components.
+size_t mesh_bytes(GeodMesh& m) {
+  return vec_bytes<GeodVertex>(m.vert) + vec_bytes<GeodFace>(m.face);
+}
+
+
+/// @brief The results and timings of one mesh type.
+struct BenchResult {
+  size_t bytes;
+  double convert_ms;
+  double area_ms;
+  double edges_ms;
+  double geodist_ms;
+  double area;
+  std::vector<double> face_areas;
+  std::vector<double> edge_lengths;
+  std::vector<std::vector<float>> dists;
+};
+
+
+/// @brief Run the benchmark for one VCGLIB mesh type.
+template<class MeshT>
+BenchResult bench_mesh_type(const fs::Mesh& surface, const std::vector<int>& sources) {
+  BenchResult res;
+  std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+  MeshT m;
+  vcgmesh_from_fs_surface(&m, surface);
+  res.convert_ms = ms_since(start);
+
+  start = std::chrono::steady_clock::now();
+  res.area = mesh_area_total(m);
+  res.face_areas = mesh_area_per_face(m);
+  res.area_ms = ms_since(start);
+
+  start = std::chrono::steady_clock::now();
+  res.edge_lengths = mesh_edge_lengths(m);
+  res.edges_ms = ms_since(start);
+
+  start = std::chrono::steady_clock::now();
+  for(size_t i=0; i<sources.size(); i++) {
+    res.dists.push_back(geodist(m, std::vector<int>(1, sources[i]), -1.0f));
+  }
+  res.geodist_ms = ms_since(start);
+  res.bytes = mesh_bytes(m);  // After the searches, which enable the optional components they need.
+  return res;
+}
+
+
+int main(int argc, char** argv) {
+  size_t num_sources = 20;
+  std::vector<std::string> mesh_files = {
+      "demo_data/subjects_dir/fsaverage6/surf/lh.pial",
+      "demo_data/subjects_dir/subject1/surf/lh.pialsurface6"
+  };
+
+  if(argc > 1) {
+    std::istringstream iss(argv[1]);
+    if(!(iss >> num_sources) || num_sources < 1) {
+      std::cout << "Usage: " << argv[0] << " [<num_sources> [<mesh_file> ...]]\n";
+      std::cout << "  <num_sources> : int, the number of full single-source Dijkstra searches per mesh. Defaults to 20.\n";
+      std::cout << "  <mesh_file>   : str, mesh files to use instead of the demo data meshes, in any format supported by read_mesh_mmap.\n";
+      exit(1);
+    }
+  }
+  if(argc > 2) {
+    mesh_files.clear();
+    for(int i=2; i<argc; i++) {
+      mesh_files.push_back(argv[i]);
+    }
+  }
+
+  std::cout << "=====[ bench_vcgmesh ]=====. Element sizes: MyVertex " << sizeof(MyVertex) << " bytes, MyFace " << sizeof(MyFace)
+            << " bytes (plus optional components), GeodVertex " << sizeof(GeodVertex) << " bytes, GeodFace " << sizeof(GeodFace) << " bytes.\n";
+  std::cout << std::left << std::setw(55) << "file" << std::setw(10) << "type" << std::right << std::setw(12) << "memory" << std::setw(12) << "convert"
+            << std::setw(12) << "areas" << std::setw(12) << "edges" << std::setw(12) << "geodist" << std::setw(10) << "speedup" << "\n";
+
+  for(size_t i=0; i<mesh_files.size(); i++) {
+    fs::Mesh surface;
+    read_mesh_mmap(&surface, mesh_files[i]);
+    std::vector<int> sources(num_sources);
+    for(size_t j=0; j<num_sources; j++) {
+      sources[j] = int((j * surface.num_vertices()) / num_sources);
+    }
+
+    const BenchResult full = bench_mesh_type<MyMesh>(surface, sources);
+    const BenchResult lean = bench_mesh_type<GeodMesh>(surface, sources);
+    if(full.area != lean.area || full.face_areas != lean.face_areas || full.edge_lengths != lean.edge_lengths || full.dists != lean.dists) {
+      throw std::runtime_error("Results of MyMesh and GeodMesh differ for mesh '" + mesh_files[i] + "'.\n");
+    }
+
+    const std::string types[2] = { "MyMesh", "GeodMesh" };
+    const BenchResult* results[2] = { &full, &lean };
+    for(size_t j=0; j<2; j++) {
+      const BenchResult& r = *results[j];
+      std::cout << std::left << std::setw(55) << mesh_files[i] << std::setw(10) << types[j] << std::right << std::fixed
+                << std::setprecision(2) << std::setw(9) << (r.bytes / 1048576.0) << " MB" << std::setw(9) << r.convert_ms << " ms"
+                << std::setw(9) << r.area_ms << " ms" << std::setw(9) << r.edges_ms << " ms" << std::setw(9) << r.geodist_ms << " ms"
+                << std::setw(9) << (full.geodist_ms / r.geodist_ms) << "x\n";
+    }
+  }
+  exit(0);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "libfs.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <stdexcept>
+
+// Writing FreeSurfer annotation (parcellation) files, which libfs can read but not write, and building annotations
+// from per-vertex region indices.
+
+
+/// @brief Get the annot label code of an RGBA color, like computed by libfs when reading annots.
+inline int32_t annot_label_code(const int32_t r, const int32_t g, const int32_t b, const int32_t a = 0) {
+  return r + g * 256 + b * 65536 + a * 16777216;
+}
+
+
+/// @brief Write a FreeSurfer annotation to a file, in the annot format version 2 read by `fs::read_annot`.
+/// @param filename path of the output file, will be overwritten if it exists.
+/// @param annot the annotation. Its colortable must contain the label codes of all vertex labels.
+/// @throws std::runtime_error if the file cannot be written, std::invalid_argument if the annot is inconsistent.
+void write_annot(const std::string& filename, const fs::Annot& annot) {
+  const size_t nv = annot.num_vertices();
+  const fs::Colortable& ct = annot.colortable;
+  const size_t num_entries = ct.num_entries();
+  if(ct.name.size() != num_entries || ct.r.size() != num_entries || ct.g.size() != num_entries || ct.b.size() != num_entries || ct.a.size() != num_entries || ct.label.size() != num_entries) {
+    throw std::invalid_argument("Inconsistent colortable, vector sizes do not match.\n");
+  }
+  std::ofstream os(filename, std::ofstream::out | std::ofstream::binary);
+  if(! os.is_open()) {
+    throw std::runtime_error("Unable to open annot file '" + filename + "' for writing.\n");
+  }
+  fs::_fwritet<int32_t>(os, int32_t(nv));
+  for(size_t i=0; i<nv; i++) {
+    fs::_fwritet<int32_t>(os, annot.vertex_indices[i]);
+    fs::_fwritet<int32_t>(os, annot.vertex_labels[i]);
+  }
+  fs::_fwritet<int32_t>(os, 1);    // Has colortable.
+  fs::_fwritet<int32_t>(os, -2);   // Colortable format version 2, stored negated.
+  fs::_fwritet<int32_t>(os, int32_t(num_entries));  // The maximal structure ID plus 1.
+  const std::string orig_filename = "cpp_geodesics";  // The file the colortable was built from, unused metadata.
+  fs::_fwritet<int32_t>(os, int32_t(orig_filename.size()));
+  os.write(orig_filename.data(), orig_filename.size());
+  fs::_fwritet<int32_t>(os, int32_t(num_entries));
+  for(size_t i=0; i<num_entries; i++) {
+    fs::_fwritet<int32_t>(os, ct.id[i]);
+    fs::_fwritet<int32_t>(os, int32_t(ct.name[i].size() + 1));
+    os.write(ct.name[i].c_str(), ct.name[i].size() + 1);  // Including the terminating zero, like FreeSurfer.
+    fs::_fwritet<int32_t>(os, ct.r[i]);
+    fs::_fwritet<int32_t>(os, ct.g[i]);
+    fs::_fwritet<int32_t>(os, ct.b[i]);
+    fs::_fwritet<int32_t>(os, ct.a[i]);
+  }
+  if(! os.good()) {
+    throw std::runtime_error("Failed to write annot file '" + filename + "'.\n");
+  }
+}
+
+
+/// @brief Build an annotation from per-vertex region indices, with distinct generated colors.
+/// @param vertex_region for each vertex, the index of its region into `region_names`, or -1 for vertices without region, which are assigned to an extra first region named 'unknown' with color black.
+/// @param region_names the region names.
+/// @return the annotation, with `region_names.size() + 1` colortable entries.
+/// @throws std::invalid_argument if a region index is out of range.
+fs::Annot annot_from_regions(const std::vector<int32_t>& vertex_region, const std::vector<std::string>& region_names) {
+  fs::Annot annot;
+  fs::Colortable& ct = annot.colortable;
+  const size_t num_regions = region_names.size();
+  for(size_t i=0; i<=num_regions; i++) {
+    // Multiplication with an odd constant is a bijection modulo 2^24, so all regions get distinct, well spread colors, and no region gets the black of 'unknown'.
+    const uint32_t rgb = (i == 0) ? 0 : (uint32_t(i) * 2654435761u) & 0xffffff;
+    ct.id.push_back(int32_t(i));
+    ct.name.push_back(i == 0 ? std::string("unknown") : region_names[i-1]);
+    ct.r.push_back(int32_t(rgb & 0xff));
+    ct.g.push_back(int32_t((rgb >> 8) & 0xff));
+    ct.b.push_back(int32_t((rgb >> 16) & 0xff));
+    ct.a.push_back(0);
+    ct.label.push_back(annot_label_code(ct.r.back(), ct.g.back(), ct.b.back(), 0));
+  }
+  const size_t nv = vertex_region.size();
+  annot.vertex_indices.resize(nv);
+  annot.vertex_labels.resize(nv);
+  for(size_t v=0; v<nv; v++) {
+    const int32_t region = vertex_region[v];
+    if(region < -1 || region >= int32_t(num_regions)) {
+      throw std::invalid_argument("Region index " + std::to_string(region) + " of vertex " + std::to_string(v) + " is out of range for " + std::to_string(num_regions) + " regions.\n");
+    }
+    annot.vertex_indices[v] = int32_t(v);
+    annot.vertex_labels[v] = ct.label[region + 1];
+  }
+  return annot;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+// Byte order conversion for whole arrays. The FreeSurfer formats and our own binary formats are big endian, and
+// converting them one value at a time (like `fs::_freadt` does) is slow for large meshes. The loops in here are
+// simple enough for the compiler to vectorize them (e.g., into byte shuffles on x86).
+
+
+/// @brief Determine whether the host system is big endian.
+inline bool host_is_bigendian() {
+  const uint16_t number = 0x1;
+  unsigned char first_byte;
+  std::memcpy(&first_byte, &number, 1);
+  return first_byte != 1;
+}
+
+/// @brief Swap the bytes of a 16 bit value.
+/// @private
+inline uint16_t _bswap_u(uint16_t v) {
+  return uint16_t((v >> 8) | (v << 8));
+}
+
+/// @brief Swap the bytes of a 32 bit value.
+/// @private
+inline uint32_t _bswap_u(uint32_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_bswap32(v);
+#else
+  return ((v & 0x000000FFu) << 24) | ((v & 0x0000FF00u) << 8) | ((v & 0x00FF0000u) >> 8) | ((v & 0xFF000000u) >> 24);
+#endif
+}
+
+/// @brief Swap the bytes of a 64 bit value.
+/// @private
+inline uint64_t _bswap_u(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_bswap64(v);
+#else
+  return (uint64_t(_bswap_u(uint32_t(v & 0xFFFFFFFFu))) << 32) | uint64_t(_bswap_u(uint32_t(v >> 32)));
+#endif
+}
+
+/// @brief Unsigned integer type of the given size in bytes, used to reinterpret values for byte swapping.
+/// @private
+template <size_t N> struct _uint_of_size {};
+template <> struct _uint_of_size<2> { typedef uint16_t type; };
+template <> struct _uint_of_size<4> { typedef uint32_t type; };
+template <> struct _uint_of_size<8> { typedef uint64_t type; };
+
+/// @brief Swap the byte order of `n` consecutive values in place.
+/// @details Works for all trivially copyable types of size 2, 4 or 8, including float and double.
+template <typename T>
+void bswap_inplace(T* data, const size_t n) {
+  typedef typename _uint_of_size<sizeof(T)>::type U;
+  unsigned char* bytes = reinterpret_cast<unsigned char*>(data);
+  for(size_t i=0; i<n; i++) {
+    U u;
+    std::memcpy(&u, bytes + i * sizeof(T), sizeof(T));
+    u = _bswap_u(u);
+    std::memcpy(bytes + i * sizeof(T), &u, sizeof(T));
+  }
+}
+
+/// @brief Convert `n` big endian values to host byte order, in place.
+template <typename T>
+void big_endian_to_host(T* data, const size_t n) {
+  if(! host_is_bigendian()) {
+    bswap_inplace(data, n);
+  }
+}
+
+/// @brief Copy `n` big endian values from a raw byte buffer (e.g., a memory-mapped file) into `dst`, converting them to host byte order.
+/// @details The source does not need to be aligned for `T`.
+template <typename T>
+void copy_big_endian_to_host(T* dst, const char* src, const size_t n) {
+  std::memcpy(dst, src, n * sizeof(T));
+  big_endian_to_host(dst, n);
+}
+
+/// @brief Write `n` values to a stream in big endian byte order.
+/// @details The values are converted in blocks, so this needs only a small fixed amount of extra memory.
+template <typename T>
+void write_big_endian(std::ostream& os, const T* data, const size_t n) {
+  if(host_is_bigendian()) {
+    os.write(reinterpret_cast<const char*>(data), std::streamsize(n * sizeof(T)));
+    return;
+  }
+  const size_t block_size = 16384;
+  std::vector<T> block(block_size < n ? block_size : n);
+  for(size_t start=0; start<n; start+=block_size) {
+    const size_t len = (n - start) < block_size ? (n - start) : block_size;
+    std::memcpy(block.data(), data + start, len * sizeof(T));
+    bswap_inplace(block.data(), len);
+    os.write(reinterpret_cast<const char*>(block.data()), std::streamsize(len * sizeof(T)));
+  }
+}
+
+/// @brief Read `n` big endian values from a stream into `data`, converting them to host byte order.
+/// @throws std::runtime_error if the stream ends before `n` values could be read.
+template <typename T>
+void read_big_endian(std::istream& is, T* data, const size_t n) {
+  is.read(reinterpret_cast<char*>(data), std::streamsize(n * sizeof(T)));
+  if(size_t(is.gcount()) != n * sizeof(T)) {
+    throw std::runtime_error("Unexpected end of stream: expected " + std::to_string(n * sizeof(T)) + " bytes, got " + std::to_string(is.gcount()) + ".\n");
+  }
+  big_endian_to_host(data, n);
+}
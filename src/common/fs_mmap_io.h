@@ -0,0 +1,118 @@
+#pragma once
+
+#include "libfs.h"
+#include "bulk_endian.h"
+#include "mapped_file.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+// Fast readers for FreeSurfer binary surf and curv files.
+//
+// The libfs readers (`fs::read_surf`, `fs::read_curv`) read one value at a time through a stream and grow the target
+// vectors with push_back. The readers in here memory-map the file, size the target `fs::Mesh` / `fs::Curv` buffers
+// exactly once from the header, and copy and byte-swap the payload in bulk. Results are identical to the libfs readers.
+
+
+/// @brief Read a big endian int32 from a raw byte buffer.
+/// @private
+inline int32_t _mmap_read_int32(const char* src) {
+  int32_t v;
+  copy_big_endian_to_host(&v, src, 1);
+  return v;
+}
+
+
+/// @brief Read the 3 byte big endian integer used as magic number in FreeSurfer surf and curv files.
+/// @private
+inline int32_t _mmap_read_int3(const char* src) {
+  const unsigned char* b = reinterpret_cast<const unsigned char*>(src);
+  return (int32_t(b[0]) << 16) | (int32_t(b[1]) << 8) | int32_t(b[2]);
+}
+
+
+/// @brief Read a brain mesh from a file in binary FreeSurfer 'surf' format, using a memory mapping and bulk byte swapping.
+/// @details Drop-in replacement for `fs::read_surf`.
+/// @param surface the mesh to fill. Its vertex and face buffers are replaced.
+/// @param filename path to the surf file, e.g., `surf/lh.white`.
+/// @throws std::runtime_error if the file cannot be opened, std::domain_error if the magic number mismatches or the file is truncated.
+void read_surf_mmap(fs::Mesh* surface, const std::string& filename) {
+  const int32_t SURF_TRIS_MAGIC = 16777214;
+  MappedFile mf(filename);
+  const char* buf = mf.data();
+  const size_t size = mf.size();
+  if(size < 3 || _mmap_read_int3(buf) != SURF_TRIS_MAGIC) {
+    throw std::domain_error("Surf file '" + filename + "' magic code in header did not match: expected " + std::to_string(SURF_TRIS_MAGIC) + ".\n");
+  }
+
+  // Skip the 'created by' line and the comment line, each terminated by a newline.
+  size_t pos = 3;
+  for(int line=0; line<2; line++) {
+    const void* nl = (pos < size) ? std::memchr(buf + pos, '\n', size - pos) : NULL;
+    if(nl == NULL) {
+      throw std::domain_error("Surf file '" + filename + "' is truncated: header lines not terminated.\n");
+    }
+    pos = size_t(static_cast<const char*>(nl) - buf) + 1;
+  }
+
+  if(size < pos + 8) {
+    throw std::domain_error("Surf file '" + filename + "' is truncated: missing vertex and face counts.\n");
+  }
+  const int32_t num_verts = _mmap_read_int32(buf + pos);
+  const int32_t num_faces = _mmap_read_int32(buf + pos + 4);
+  pos += 8;
+  if(num_verts < 0 || num_faces < 0) {
+    throw std::domain_error("Surf file '" + filename + "' has negative vertex or face count.\n");
+  }
+  const size_t nv3 = size_t(num_verts) * 3;
+  const size_t nf3 = size_t(num_faces) * 3;
+  if(size < pos + nv3 * sizeof(float) + nf3 * sizeof(int32_t)) {
+    throw std::domain_error("Surf file '" + filename + "' is truncated: expected " + std::to_string(num_verts) + " vertices and " + std::to_string(num_faces) + " faces.\n");
+  }
+
+  surface->vertices.resize(nv3);
+  surface->faces.resize(nf3);
+  copy_big_endian_to_host(surface->vertices.data(), buf + pos, nv3);
+  pos += nv3 * sizeof(float);
+  copy_big_endian_to_host(surface->faces.data(), buf + pos, nf3);
+}
+
+
+/// @brief Read per-vertex data from a FreeSurfer curv format file, using a memory mapping and bulk byte swapping.
+/// @details Drop-in replacement for `fs::read_curv`.
+/// @param curv the Curv instance to fill.
+/// @param filename path to the curv file, e.g., `surf/lh.thickness`.
+/// @throws std::runtime_error if the file cannot be opened, std::domain_error if the magic number mismatches, the file contains more than 1 value per vertex, or the file is truncated.
+void read_curv_mmap(fs::Curv* curv, const std::string& filename) {
+  const int32_t CURV_MAGIC = 16777215;
+  MappedFile mf(filename);
+  const char* buf = mf.data();
+  const size_t size = mf.size();
+  if(size < 15 || _mmap_read_int3(buf) != CURV_MAGIC) {
+    throw std::domain_error("Curv file '" + filename + "' header magic did not match: expected " + std::to_string(CURV_MAGIC) + ".\n");
+  }
+  curv->num_vertices = _mmap_read_int32(buf + 3);
+  curv->num_faces = _mmap_read_int32(buf + 7);
+  curv->num_values_per_vertex = _mmap_read_int32(buf + 11);
+  if(curv->num_values_per_vertex != 1) {
+    throw std::domain_error("Curv file '" + filename + "' must contain exactly 1 value per vertex, found " + std::to_string(curv->num_values_per_vertex) + ".\n");
+  }
+  if(curv->num_vertices < 0 || size < 15 + size_t(curv->num_vertices) * sizeof(float)) {
+    throw std::domain_error("Curv file '" + filename + "' is truncated: expected " + std::to_string(curv->num_vertices) + " values.\n");
+  }
+  curv->data.resize(curv->num_vertices);
+  copy_big_endian_to_host(curv->data.data(), buf + 15, curv->data.size());
+}
+
+
+/// @brief Read per-vertex data from a FreeSurfer curv format file, using a memory mapping. Drop-in replacement for `fs::read_curv_data`.
+/// @throws see `read_curv_mmap`.
+std::vector<float> read_curv_data_mmap(const std::string& filename) {
+  fs::Curv curv;
+  read_curv_mmap(&curv, filename);
+  return curv.data;
+}
+
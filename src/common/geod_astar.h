@@ -0,0 +1,298 @@
+#pragma once
+
+#include "mesh_view.h"
+#include "geod_engine.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+// Point-to-point shortest paths on the mesh graph with A* and bidirectional A* searches.
+//
+// A single source-target distance does not need the distances of all vertices. A* orders the search by the distance
+// from the source plus the straight-line distance to the target, which never overestimates the remaining path length
+// on the edge graph, so the search heads for the target and settles a small fraction of the vertices Dijkstra's
+// algorithm would. The bidirectional variant searches from both ends with the average of both straight-line potentials
+// (Ikeda et al.) and stops once the two searches cannot improve the best connection any more.
+//
+// The heuristic is computed with the same float operations as the edge lengths, so it is consistent up to float
+// rounding. The searches correct labels which turn out too large, and keep going a relative 1e-4 past the stopping
+// criterion, so the rounding never makes them miss the shortest path. The A* distance is the Dijkstra one bit for
+// bit. The bidirectional length is summed along the path from the source, so it equals the Dijkstra one unless there
+// are several shortest paths with the same length in exact arithmetic.
+
+
+const float GEOD_ASTAR_SLACK = 1e-4f;  ///< The relative amount the searches continue past their stopping criterion, see the file comment.
+
+
+/// @brief A shortest path between two vertices, see `geod_shortest_path`.
+struct GeodPath {
+  float length = GEOD_UNREACHED;   ///< The path length, `GEOD_UNREACHED` if the vertices are not connected.
+  std::vector<int32_t> vertices;   ///< The path vertices from the source to the target, empty if the vertices are not connected.
+  size_t num_settled = 0;          ///< The number of vertices the search settled, counting vertices settled again after a label correction. For the bidirectional search, the sum of both directions.
+};
+
+
+/// @brief Per-thread work data for point-to-point searches, see `geod_shortest_path`.
+struct GeodPathWorkspace {
+  /// @brief Create a workspace for graphs with `num_vertices` vertices.
+  explicit GeodPathWorkspace(const size_t num_vertices = 0) : fwd(num_vertices), bwd(num_vertices), pred_fwd(num_vertices), pred_bwd(num_vertices) {}
+
+  GeodWorkspace fwd;              ///< The search from the source.
+  GeodWorkspace bwd;              ///< The search from the target, bidirectional search only.
+  std::vector<int32_t> pred_fwd;  ///< The predecessor of each vertex reached by the forward search. Only valid for reached vertices.
+  std::vector<int32_t> pred_bwd;  ///< The successor of each vertex reached by the backward search. Only valid for reached vertices.
+
+  /// @brief Resize for a graph with `num_vertices` vertices, if needed.
+  void fit(const size_t num_vertices) {
+    if(this->pred_fwd.size() != num_vertices) {
+      *this = GeodPathWorkspace(num_vertices);
+    }
+  }
+};
+
+
+/// @brief Get the length of the edge between two adjacent vertices.
+/// @throws std::invalid_argument if the vertices are not adjacent.
+/// @private
+inline float _geod_edge_weight(const GeodGraph& g, const int32_t u, const int32_t v) {
+  const int32_t* begin = g.csr.neighbors_begin(size_t(u));
+  const int32_t* end = g.csr.neighbors_end(size_t(u));
+  const int32_t* pos = std::lower_bound(begin, end, v);
+  if(pos == end || *pos != v) {
+    throw std::invalid_argument("Vertices " + std::to_string(u) + " and " + std::to_string(v) + " are not adjacent.\n");
+  }
+  return g.weights[size_t(g.csr.offsets[u] + (pos - begin))];
+}
+
+
+/// @brief Run one search direction of a point-to-point search: A* towards a goal, or Dijkstra's algorithm without potential.
+/// @details Both directions of the bidirectional search use this with a shared best connection. `potential(v)` gives the
+/// key offset of vertex v, the search settles vertices by distance plus potential. The search stops when the smallest key
+/// exceeds `stop_key()` by the relative slack.
+/// @private
+class _GeodPathSearch {
+  public:
+  typedef std::pair<float, int32_t> HeapEntry;
+
+  _GeodPathSearch(const GeodGraph& g, GeodWorkspace& ws, std::vector<int32_t>& pred) : g(g), ws(ws), pred(pred), num_settled(0) {}
+
+  const GeodGraph& g;
+  GeodWorkspace& ws;
+  std::vector<int32_t>& pred;
+  size_t num_settled;
+
+  /// @brief Start the search from a vertex.
+  void start(const int32_t source, const float key) {
+    if(this->ws.dist.size() != this->g.num_vertices()) {
+      this->ws = GeodWorkspace(this->g.num_vertices());
+    }
+    this->ws.reset();
+    this->ws.dist[source] = 0.0f;
+    this->pred[source] = -1;
+    this->ws.reached.push_back(source);
+    this->ws.heap.push_back(HeapEntry(key, source));
+  }
+
+  /// @brief Get the smallest key in the heap, `GEOD_UNREACHED` if it is empty. Outdated entries only make this smaller, so it is safe for stopping criteria.
+  float top_key() const {
+    return this->ws.heap.empty() ? GEOD_UNREACHED : this->ws.heap.front().first;
+  }
+
+  /// @brief Settle the vertex with the smallest key and relax its edges.
+  /// @param potential the potential of a vertex, see the class comment.
+  /// @param on_reach called with each vertex whose distance improved.
+  template<typename Potential, typename OnReach>
+  void step(const Potential& potential, const OnReach& on_reach) {
+    std::greater<HeapEntry> cmp;  // Turns the std max-heap functions into a min-heap.
+    std::pop_heap(this->ws.heap.begin(), this->ws.heap.end(), cmp);
+    const HeapEntry top = this->ws.heap.back();
+    this->ws.heap.pop_back();
+    const int32_t cur = top.second;
+    const float cur_dist = this->ws.dist[cur];
+    if(top.first > cur_dist + potential(cur)) {
+      return;  // Outdated entry, the vertex was reached on a shorter path since it was pushed.
+    }
+    this->num_settled++;
+    const MeshCSR& csr = this->g.csr;
+    for(int64_t k=csr.offsets[cur]; k<csr.offsets[cur+1]; k++) {
+      const int32_t next = csr.adj[k];
+      const float next_dist = cur_dist + this->g.weights[k];
+      if(next_dist < this->ws.dist[next]) {
+        if(this->ws.dist[next] == GEOD_UNREACHED) {
+          this->ws.reached.push_back(next);
+        }
+        this->ws.dist[next] = next_dist;
+        this->pred[next] = cur;
+        this->ws.heap.push_back(HeapEntry(next_dist + potential(next), next));
+        std::push_heap(this->ws.heap.begin(), this->ws.heap.end(), cmp);
+        on_reach(next);
+      }
+    }
+  }
+};
+
+
+/// @brief Check the vertices of a point-to-point query.
+/// @throws std::invalid_argument if a vertex is out of range.
+/// @private
+inline void _geod_path_check(const GeodGraph& g, const int32_t source, const int32_t target) {
+  const size_t nv = g.num_vertices();
+  if(source < 0 || size_t(source) >= nv || target < 0 || size_t(target) >= nv) {
+    throw std::invalid_argument("Vertex pair (" + std::to_string(source) + ", " + std::to_string(target) + ") is out of range for mesh with " + std::to_string(nv) + " vertices.\n");
+  }
+}
+
+
+/// @brief Compute a shortest path between two vertices with a unidirectional search, A* or Dijkstra's algorithm.
+/// @param m the mesh the graph was built from, for the straight-line distances. Ignored if `use_heuristic` is false.
+/// @param use_heuristic whether to use the straight-line distance to the target (A*) or nothing (Dijkstra).
+/// @private
+template<typename T, typename I>
+GeodPath _geod_path_unidirectional(const GeodGraph& g, const MeshView<T, I>& m, const int32_t source, const int32_t target, const bool use_heuristic, GeodPathWorkspace& ws) {
+  _GeodPathSearch search(g, ws.fwd, ws.pred_fwd);
+  const auto potential = [&](const int32_t v) { return use_heuristic ? _vertex_dist(m, size_t(v), size_t(target)) : 0.0f; };
+  const auto on_reach = [](const int32_t) {};
+  search.start(source, potential(source));
+  const float* dist = ws.fwd.dist.data();
+  while(! ws.fwd.heap.empty() && !(search.top_key() > dist[target] * (1.0f + GEOD_ASTAR_SLACK))) {
+    search.step(potential, on_reach);
+  }
+  GeodPath path;
+  path.num_settled = search.num_settled;
+  path.length = dist[target];
+  if(path.length != GEOD_UNREACHED) {
+    for(int32_t v=target; v != -1; v=ws.pred_fwd[v]) {
+      path.vertices.push_back(v);
+    }
+    std::reverse(path.vertices.begin(), path.vertices.end());
+  }
+  return path;
+}
+
+
+/// @brief Compute a shortest path between two vertices with a bidirectional A* search.
+/// @private
+template<typename T, typename I>
+GeodPath _geod_path_bidirectional(const GeodGraph& g, const MeshView<T, I>& m, const int32_t source, const int32_t target, GeodPathWorkspace& ws) {
+  _GeodPathSearch fwd(g, ws.fwd, ws.pred_fwd);
+  _GeodPathSearch bwd(g, ws.bwd, ws.pred_bwd);
+  // The average potentials of both directions add up to 0, which keeps the keys of both searches consistent.
+  const auto pot_fwd = [&](const int32_t v) { return 0.5f * (_vertex_dist(m, size_t(v), size_t(target)) - _vertex_dist(m, size_t(v), size_t(source))); };
+  const auto pot_bwd = [&](const int32_t v) { return -pot_fwd(v); };
+  float best = GEOD_UNREACHED;
+  int32_t meet = -1;
+  const auto meet_fwd = [&](const int32_t v) {
+    if(ws.bwd.dist[v] != GEOD_UNREACHED && ws.fwd.dist[v] + ws.bwd.dist[v] < best) {
+      best = ws.fwd.dist[v] + ws.bwd.dist[v];
+      meet = v;
+    }
+  };
+  const auto meet_bwd = [&](const int32_t v) {
+    if(ws.fwd.dist[v] != GEOD_UNREACHED && ws.fwd.dist[v] + ws.bwd.dist[v] < best) {
+      best = ws.fwd.dist[v] + ws.bwd.dist[v];
+      meet = v;
+    }
+  };
+  fwd.start(source, pot_fwd(source));
+  bwd.start(target, pot_bwd(target));
+  if(source == target) {
+    best = 0.0f;
+    meet = source;
+  }
+  while(! ws.fwd.heap.empty() && ! ws.bwd.heap.empty()) {
+    const float top_fwd = fwd.top_key(), top_bwd = bwd.top_key();
+    if(best != GEOD_UNREACHED && top_fwd + top_bwd > best * (1.0f + GEOD_ASTAR_SLACK)) {
+      break;
+    }
+    if(top_fwd <= top_bwd) {
+      fwd.step(pot_fwd, meet_fwd);
+    } else {
+      bwd.step(pot_bwd, meet_bwd);
+    }
+  }
+  GeodPath path;
+  path.num_settled = fwd.num_settled + bwd.num_settled;
+  if(meet < 0) {
+    return path;
+  }
+  for(int32_t v=meet; v != -1; v=ws.pred_fwd[v]) {
+    path.vertices.push_back(v);
+  }
+  std::reverse(path.vertices.begin(), path.vertices.end());
+  for(int32_t v=ws.pred_bwd[meet]; v != -1; v=ws.pred_bwd[v]) {
+    path.vertices.push_back(v);
+  }
+  path.length = 0.0f;
+  for(size_t i=1; i<path.vertices.size(); i++) {
+    path.length += _geod_edge_weight(g, path.vertices[i-1], path.vertices[i]);
+  }
+  return path;
+}
+
+
+/// @brief Compute a shortest path between two vertices along the mesh edges.
+/// @param g the mesh graph, see `geod_graph`.
+/// @param m the mesh the graph was built from, for the straight-line distances of the A* searches.
+/// @param source the source vertex.
+/// @param target the target vertex.
+/// @param method 'astar' for A*, 'bidir' for bidirectional A*, or 'dijkstra' for Dijkstra's algorithm stopped at the target. All give a shortest path with the length of `geodist`, see the file comment.
+/// @param ws optional workspace, for many queries on the same thread.
+/// @return the path and the number of settled vertices.
+/// @throws std::invalid_argument if the method is invalid or a vertex is out of range.
+template<typename T, typename I>
+GeodPath geod_shortest_path(const GeodGraph& g, const MeshView<T, I>& m, const int32_t source, const int32_t target, const std::string& method = "astar", GeodPathWorkspace* ws = NULL) {
+  _geod_path_check(g, source, target);
+  if(m.num_vertices() != g.num_vertices()) {
+    throw std::invalid_argument("Mesh with " + std::to_string(m.num_vertices()) + " vertices does not match graph with " + std::to_string(g.num_vertices()) + " vertices.\n");
+  }
+  GeodPathWorkspace local_ws;
+  if(! ws) {
+    ws = &local_ws;
+  }
+  ws->fit(g.num_vertices());
+  if(method == "astar" || method == "dijkstra") {
+    return _geod_path_unidirectional(g, m, source, target, method == "astar", *ws);
+  } else if(method == "bidir") {
+    return _geod_path_bidirectional(g, m, source, target, *ws);
+  }
+  throw std::invalid_argument("Invalid shortest path method '" + method + "', must be 'astar', 'bidir' or 'dijkstra'.\n");
+}
+
+
+/// @brief Compute the shortest path lengths of many vertex pairs with point-to-point searches, in parallel.
+/// @param u the first vertex of each pair.
+/// @param v the second vertex of each pair, same length as `u`.
+/// @param method the search method, see `geod_shortest_path`.
+/// @return the length for each pair, `GEOD_UNREACHED` for pairs in different connected components.
+/// @throws std::invalid_argument if the lengths differ, the mesh does not match the graph, the method is invalid or a vertex is out of range.
+template<typename T, typename I>
+std::vector<float> geod_pair_distances(const GeodGraph& g, const MeshView<T, I>& m, const std::vector<int32_t>& u, const std::vector<int32_t>& v, const std::string& method = "astar") {
+  if(u.size() != v.size()) {
+    throw std::invalid_argument("Got " + std::to_string(u.size()) + " first and " + std::to_string(v.size()) + " second vertices of vertex pairs.\n");
+  }
+  if(m.num_vertices() != g.num_vertices()) {
+    throw std::invalid_argument("Mesh with " + std::to_string(m.num_vertices()) + " vertices does not match graph with " + std::to_string(g.num_vertices()) + " vertices.\n");
+  }
+  for(size_t i=0; i<u.size(); i++) {
+    _geod_path_check(g, u[i], v[i]);  // Exceptions must not leave the parallel region below.
+  }
+  if(!(method == "astar" || method == "bidir" || method == "dijkstra")) {
+    throw std::invalid_argument("Invalid shortest path method '" + method + "', must be 'astar', 'bidir' or 'dijkstra'.\n");
+  }
+  std::vector<float> dist(u.size());
+  const int64_t num_pairs = int64_t(u.size());
+  # pragma omp parallel shared(dist)
+  {
+    GeodPathWorkspace ws(g.num_vertices());
+    # pragma omp for schedule(dynamic, 16)
+    for(int64_t i=0; i<num_pairs; i++) {
+      dist[i] = geod_shortest_path(g, m, u[i], v[i], method, &ws).length;
+    }
+  }
+  return dist;
+}
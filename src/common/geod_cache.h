@@ -0,0 +1,338 @@
+#pragma once
+
+#include "mesh_view.h"
+#include "geod_engine.h"
+#include "bulk_endian.h"
+#include "mapped_file.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <functional>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// Content-addressed on-disk cache for bounded geodesic neighborhoods.
+//
+// Computing the neighborhoods of all vertices is the expensive part of many runs, and re-running with other output
+// settings or a smaller radius would repeat it from scratch. The cache stores the neighborhoods of all vertices up to
+// a radius in a compact binary file, keyed by a hash of the mesh content (vertex coordinates and faces), the vertex
+// mask and the search backend, so renamed or copied surfaces hit the cache and changed ones miss it. The radius is
+// not part of the key: a file serves all queries with a radius not larger than its own by filtering, and a query with
+// a larger radius replaces it. A shortest path to a vertex within the radius only passes vertices within the radius,
+// so the distances of a bounded search are the final ones, and the filtered neighborhoods equal the ones of a search
+// with the smaller radius exactly.
+
+
+const int32_t GEOD_CACHE_MAGIC = 0x474e4331;  ///< Magic number at the start of neighborhood cache files, 'GNC1' in ASCII.
+
+
+/// @brief The bounded geodesic neighborhoods of all vertices of a mesh, in CSR format.
+/// @details Each neighborhood holds the vertex itself at distance 0 and all vertices at a distance in `(0, radius)`, sorted by vertex index. This is the format of the cache files and takes 8 bytes per neighbor.
+struct GeodNeighborhoods {
+  float radius = 0.0f;           ///< The neighborhood radius.
+  std::vector<int64_t> offsets;  ///< The neighbors of vertex v are at positions `[offsets[v], offsets[v+1])` of `index` and `dist`.
+  std::vector<int32_t> index;    ///< The neighbor vertices.
+  std::vector<float> dist;       ///< The geodesic distances of the neighbors.
+
+  /// @brief Get the number of vertices.
+  size_t num_vertices() const {
+    return this->offsets.empty() ? 0 : this->offsets.size() - 1;
+  }
+};
+
+
+/// @brief The key of a cache entry: what the neighborhoods were computed on and how.
+struct GeodCacheKey {
+  uint64_t mesh_hash = 0;  ///< Hash of the mesh content, see `mesh_content_hash`.
+  uint64_t mask_hash = 0;  ///< Hash of the vertex mask, see `mesh_mask_hash`. 0 for no mask.
+  std::string backend;     ///< The search backend, e.g., 'dijkstra'. Letters, digits and underscores only, it is part of the file name.
+};
+
+
+/// @brief Compute the 64 bit FNV-1a hash of a byte range.
+/// @param h the hash to continue, the FNV offset basis for a new hash.
+uint64_t geod_hash_bytes(const void* data, const size_t num_bytes, uint64_t h = 14695981039346656037ULL) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for(size_t i=0; i<num_bytes; i++) {
+    h ^= uint64_t(bytes[i]);
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+
+/// @brief Compute a hash of the vertex coordinates and faces of a mesh, for identifying its cache entries.
+/// @details Meshes with the same vertex and face arrays get the same hash, independent of their file names.
+template<typename T, typename I>
+uint64_t mesh_content_hash(const MeshView<T, I>& m) {
+  const uint64_t counts[2] = { uint64_t(m.num_vertices()), uint64_t(m.num_faces()) };
+  uint64_t h = geod_hash_bytes(counts, sizeof(counts));
+  h = geod_hash_bytes(m.vertices, m.num_vertices() * 3 * sizeof(T), h);
+  return geod_hash_bytes(m.faces, m.num_faces() * 3 * sizeof(I), h);
+}
+
+
+/// @brief Compute a hash of the included vertices of a mask, or 0 for no mask.
+uint64_t mesh_mask_hash(const MeshMask* mask) {
+  if(! mask) {
+    return 0;
+  }
+  const uint64_t h = geod_hash_bytes(mask->included.data(), mask->included.size());
+  return h == 0 ? 1 : h;
+}
+
+
+/// @brief Create the cache key for neighborhoods on a mesh, optionally restricted to the included vertices of a mask.
+template<typename T, typename I>
+GeodCacheKey geod_cache_key(const MeshView<T, I>& m, const MeshMask* mask = NULL, const std::string& backend = "dijkstra") {
+  GeodCacheKey key;
+  key.mesh_hash = mesh_content_hash(m);
+  key.mask_hash = mesh_mask_hash(mask);
+  key.backend = backend;
+  return key;
+}
+
+
+/// @brief Get the file name of the cache entry for a key in a cache directory.
+std::string geod_cache_filename(const std::string& cache_dir, const GeodCacheKey& key) {
+  char hex[40];
+  snprintf(hex, sizeof(hex), "%016llx_%016llx", (unsigned long long)key.mesh_hash, (unsigned long long)key.mask_hash);
+  return cache_dir + "/" + std::string(hex) + "_" + key.backend + ".geodneigh";
+}
+
+
+/// @brief Compute the bounded geodesic neighborhoods of all vertices, parallel using OpenMP.
+/// @details The neighborhoods are the ones of `geod_neighborhood` with `include_self` set, in CSR format.
+/// @param max_dist the neighborhood radius. Vertices at distance `>= max_dist` are not part of the neighborhood.
+GeodNeighborhoods geod_neighborhoods(const GeodGraph& g, const float max_dist) {
+  typedef std::pair<int32_t, float> Entry;
+  const int64_t nv = int64_t(g.num_vertices());
+  std::vector<std::vector<Entry>> found(nv);
+  # pragma omp parallel shared(g, found)
+  {
+    GeodWorkspace ws(g.num_vertices());
+    # pragma omp for schedule(dynamic, 64)
+    for(int64_t i=0; i<nv; i++) {
+      const int32_t source = int32_t(i);
+      geod_dijkstra(g, &source, 1, max_dist, ws);
+      std::vector<Entry>& neigh = found[i];
+      for(size_t j=0; j<ws.reached.size(); j++) {
+        const int32_t v = ws.reached[j];
+        // Vertices at distance 0 other than the source itself (duplicated coordinates) are excluded, like in `geod_neighborhood`.
+        if(v == source || ws.dist[v] > 0.0f) {
+          neigh.push_back(Entry(v, v == source ? 0.0f : ws.dist[v]));
+        }
+      }
+      std::sort(neigh.begin(), neigh.end());
+    }
+  }
+  GeodNeighborhoods nh;
+  nh.radius = max_dist;
+  nh.offsets.resize(nv + 1, 0);
+  for(int64_t v=0; v<nv; v++) {
+    nh.offsets[v+1] = nh.offsets[v] + int64_t(found[v].size());
+  }
+  nh.index.resize(nh.offsets[nv]);
+  nh.dist.resize(nh.offsets[nv]);
+  # pragma omp parallel for schedule(static)
+  for(int64_t v=0; v<nv; v++) {
+    for(size_t j=0; j<found[v].size(); j++) {
+      nh.index[nh.offsets[v] + j] = found[v][j].first;
+      nh.dist[nh.offsets[v] + j] = found[v][j].second;
+    }
+    std::vector<Entry>().swap(found[v]);
+  }
+  return nh;
+}
+
+
+/// @brief Convert neighborhoods computed by `geod_neighborhood` with `include_self` set to the CSR format, e.g., for storing them in the cache.
+/// @param max_dist the radius the neighborhoods were computed for.
+GeodNeighborhoods geod_neighborhoods_from_lists(const std::vector<std::vector<GeodNeighbor>>& neighborhoods, const float max_dist) {
+  const size_t nv = neighborhoods.size();
+  GeodNeighborhoods nh;
+  nh.radius = max_dist;
+  nh.offsets.resize(nv + 1, 0);
+  for(size_t v=0; v<nv; v++) {
+    nh.offsets[v+1] = nh.offsets[v] + int64_t(neighborhoods[v].size());
+  }
+  nh.index.reserve(nh.offsets[nv]);
+  nh.dist.reserve(nh.offsets[nv]);
+  for(size_t v=0; v<nv; v++) {
+    for(size_t j=0; j<neighborhoods[v].size(); j++) {
+      nh.index.push_back(int32_t(neighborhoods[v][j].index));
+      nh.dist.push_back(neighborhoods[v][j].distance);
+    }
+  }
+  return nh;
+}
+
+
+/// @brief Get the neighborhoods for a radius not larger than the one of the given neighborhoods, by filtering them.
+/// @param include_self whether to keep the vertex itself in its neighborhood.
+/// @return the neighborhoods in the format of `geod_neighborhood`, which equal its results for the same graph, radius and `include_self` setting.
+/// @throws std::invalid_argument if the radius is larger than the one of the neighborhoods.
+std::vector<std::vector<GeodNeighbor>> geod_neighborhoods_filter(const GeodNeighborhoods& nh, const float max_dist, const bool include_self) {
+  if(max_dist > nh.radius) {
+    throw std::invalid_argument("Cannot filter neighborhoods of radius " + std::to_string(nh.radius) + " for the larger radius " + std::to_string(max_dist) + ".\n");
+  }
+  const int64_t nv = int64_t(nh.num_vertices());
+  std::vector<std::vector<GeodNeighbor>> neighborhoods(nv);
+  # pragma omp parallel for schedule(dynamic, 256) shared(neighborhoods)
+  for(int64_t v=0; v<nv; v++) {
+    std::vector<GeodNeighbor>& neigh = neighborhoods[v];
+    for(int64_t k=nh.offsets[v]; k<nh.offsets[v+1]; k++) {
+      if(nh.index[k] == int32_t(v) ? include_self : nh.dist[k] < max_dist) {
+        neigh.push_back(GeodNeighbor(size_t(nh.index[k]), nh.dist[k]));
+      }
+    }
+  }
+  return neighborhoods;
+}
+
+
+/// @brief Get a temporary file name for writing a file, unique per process and thread.
+/// @details Files are written under this name and renamed to `filename` once complete. Runs that fill the same file concurrently each write their own temporary file, and the last rename wins with a complete file.
+std::string geod_tmp_filename(const std::string& filename) {
+#ifdef _WIN32
+  const long pid = long(_getpid());
+#else
+  const long pid = long(getpid());
+#endif
+  return filename + ".tmp." + std::to_string(pid) + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+}
+
+
+/// @brief Write neighborhoods to a cache file, in big endian byte order.
+/// @details Layout: int32 magic `GEOD_CACHE_MAGIC`, int32 number of vertices nv, uint64 mesh hash, uint64 mask hash, float
+/// radius, int32 length of the backend name B, B bytes backend name, (nv + 1) int64 offsets, then the int32 neighbor
+/// indices and the float distances. The file is written under a temporary name unique to the process and thread and
+/// renamed, see `geod_tmp_filename`, so concurrent runs never read or produce a partly written file.
+/// @throws std::runtime_error if the file cannot be written.
+void write_geod_neighborhoods(const std::string& filename, const GeodCacheKey& key, const GeodNeighborhoods& nh) {
+  const std::string tmp_filename = geod_tmp_filename(filename);
+  {
+    std::ofstream os(tmp_filename, std::ofstream::out | std::ofstream::binary);
+    if(! os.is_open()) {
+      throw std::runtime_error("Unable to open neighborhood cache file '" + tmp_filename + "' for writing.\n");
+    }
+    const int32_t num_vertices = int32_t(nh.num_vertices());
+    const int32_t backend_len = int32_t(key.backend.size());
+    write_big_endian(os, &GEOD_CACHE_MAGIC, 1);
+    write_big_endian(os, &num_vertices, 1);
+    write_big_endian(os, &key.mesh_hash, 1);
+    write_big_endian(os, &key.mask_hash, 1);
+    write_big_endian(os, &nh.radius, 1);
+    write_big_endian(os, &backend_len, 1);
+    os.write(key.backend.data(), backend_len);
+    write_big_endian(os, nh.offsets.data(), nh.offsets.size());
+    write_big_endian(os, nh.index.data(), nh.index.size());
+    write_big_endian(os, nh.dist.data(), nh.dist.size());
+    if(! os.good()) {
+      os.close();
+      std::remove(tmp_filename.c_str());
+      throw std::runtime_error("Failed to write neighborhood cache file '" + tmp_filename + "'.\n");
+    }
+  }
+  if(std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+    std::remove(tmp_filename.c_str());
+    throw std::runtime_error("Failed to rename neighborhood cache file '" + tmp_filename + "' to '" + filename + "'.\n");
+  }
+}
+
+
+/// @brief Read the neighborhoods of a cache file written by `write_geod_neighborhoods`, using a memory mapping.
+/// @param key the key the neighborhoods must have been computed for.
+/// @param min_radius the smallest acceptable neighborhood radius.
+/// @param nh set to the neighborhoods if they were read.
+/// @return whether the file exists, is valid, matches the key and has a radius of at least `min_radius`. Invalid files count as misses, so they are recomputed and replaced.
+bool read_geod_neighborhoods(const std::string& filename, const GeodCacheKey& key, const float min_radius, GeodNeighborhoods& nh) {
+  std::ifstream probe(filename);
+  if(! probe.good()) {
+    return false;
+  }
+  probe.close();
+  MappedFile mf(filename);
+  const char* buf = mf.data();
+  const size_t size = mf.size();
+  const size_t fixed_header_size = 32;
+  if(size < fixed_header_size) {
+    return false;
+  }
+  int32_t magic, num_vertices, backend_len;
+  uint64_t mesh_hash, mask_hash;
+  float radius;
+  copy_big_endian_to_host(&magic, buf, 1);
+  copy_big_endian_to_host(&num_vertices, buf + 4, 1);
+  copy_big_endian_to_host(&mesh_hash, buf + 8, 1);
+  copy_big_endian_to_host(&mask_hash, buf + 16, 1);
+  copy_big_endian_to_host(&radius, buf + 24, 1);
+  copy_big_endian_to_host(&backend_len, buf + 28, 1);
+  if(magic != GEOD_CACHE_MAGIC || num_vertices < 0 || backend_len < 0 || size < fixed_header_size + size_t(backend_len) + (size_t(num_vertices) + 1) * sizeof(int64_t)) {
+    return false;
+  }
+  if(mesh_hash != key.mesh_hash || mask_hash != key.mask_hash || std::string(buf + fixed_header_size, backend_len) != key.backend || radius < min_radius) {
+    return false;
+  }
+  const char* pos = buf + fixed_header_size + backend_len;
+  nh.radius = radius;
+  nh.offsets.resize(size_t(num_vertices) + 1);
+  copy_big_endian_to_host(nh.offsets.data(), pos, nh.offsets.size());
+  pos += nh.offsets.size() * sizeof(int64_t);
+  const int64_t num_entries = nh.offsets.back();
+  if(nh.offsets[0] != 0 || num_entries < 0 || size != size_t(pos - buf) + size_t(num_entries) * (sizeof(int32_t) + sizeof(float))) {
+    return false;
+  }
+  nh.index.resize(num_entries);
+  copy_big_endian_to_host(nh.index.data(), pos, nh.index.size());
+  pos += nh.index.size() * sizeof(int32_t);
+  nh.dist.resize(num_entries);
+  copy_big_endian_to_host(nh.dist.data(), pos, nh.dist.size());
+
+  // The neighborhood functions index with these without checks, so a damaged or foreign file must not get through.
+  for(size_t v=0; v<size_t(num_vertices); v++) {
+    if(nh.offsets[v+1] < nh.offsets[v]) {
+      return false;
+    }
+  }
+  for(int64_t k=0; k<num_entries; k++) {
+    if(nh.index[k] < 0 || nh.index[k] >= num_vertices) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/// @brief Get the neighborhoods of all vertices from the cache, or compute them and store them in the cache.
+/// @param cache_dir the cache directory, which must exist.
+/// @param key the cache key of the graph, see `geod_cache_key`.
+/// @param g the graph the key belongs to.
+/// @param max_dist the neighborhood radius.
+/// @param hit if not NULL, set to whether the neighborhoods were read from the cache.
+/// @return neighborhoods of at least radius `max_dist`. Use `geod_neighborhoods_filter` to get the ones for exactly that radius.
+/// @throws std::runtime_error if the cache file cannot be written.
+GeodNeighborhoods geod_neighborhoods_cached(const std::string& cache_dir, const GeodCacheKey& key, const GeodGraph& g, const float max_dist, bool* hit = NULL) {
+  const std::string filename = geod_cache_filename(cache_dir, key);
+  GeodNeighborhoods nh;
+  const bool found = read_geod_neighborhoods(filename, key, max_dist, nh) && nh.num_vertices() == g.num_vertices();
+  if(hit) {
+    *hit = found;
+  }
+  if(! found) {
+    nh = geod_neighborhoods(g, max_dist);
+    write_geod_neighborhoods(filename, key, nh);
+  }
+  return nh;
+}
@@ -0,0 +1,711 @@
+#pragma once
+
+#include "libfs.h"
+#include "spline.h"
+
+#include "mesh_view.h"
+#include "mesh_geometry.h"
+#include "geod_engine.h"
+#include "geod_cache.h"
+#include "vec_math.h"
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include <string>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <limits>
+#include <cassert>
+#include <stdexcept>
+
+// Geodesic circle stats (radius and perimeter of the geodesic circle that covers a given fraction of the mesh area)
+// on mesh views. See `geodesic_circles()`.
+
+
+/// Assumes the last value is in.
+template<typename T>
+int numsteps_for_stepsize(T start_in, T end_in, double stepsize) {
+  double start = static_cast<double>(start_in);
+  double end = static_cast<double>(end_in);
+  double delta = end - start;
+  int numsteps = (int)ceil(delta / stepsize);
+  return numsteps + 1;
+}
+
+/// A linspace or seq function for C++.
+template<typename T>
+std::vector<double> linspace(T start_in, T end_in, int num_in) {
+
+  std::vector<double> linspaced;
+
+  double start = static_cast<double>(start_in);
+  double end = static_cast<double>(end_in);
+  double num = static_cast<double>(num_in);
+
+  if (num == 0) { return linspaced; }
+  if (num == 1) {
+      linspaced.push_back(start);
+      return linspaced;
+  }
+
+  double delta = (end - start) / (num - 1);
+
+  for(int i=0; i < num-1; ++i) {
+      linspaced.push_back(start + delta * i);
+  }
+  linspaced.push_back(end); // Ensure that start and end are exactly the same as the input.
+  return linspaced;
+}
+
+
+/// @brief Compute the part of a face which is inside a geodesic circle, for a face that is partly in it.
+/// @param face the face, which must have 1 or 2 vertices with a geodesic distance below `radius`.
+/// @param face_area the area of the face.
+/// @param area the area of the face inside the circle is added to this.
+/// @param perimeter the length of the circle line through the face is added to this.
+/// @private
+template<typename T, typename I>
+void _add_partial_face_circle_stats(const MeshView<T, I>& m, const std::vector<float>& geodist, const int face, const double radius, const double face_area, double& area, double& perimeter) {
+  const I* face_verts_copy = m.face(face);
+  int num_verts_in_radius = 0;
+  for(int j=0; j<3; j++) {
+    if(geodist[face_verts_copy[j]] < radius) {
+      num_verts_in_radius++;
+    }
+  }
+  assert(num_verts_in_radius == 1 || num_verts_in_radius == 2);
+
+  int k = -1;
+  for(int j=0; j<3; j++) {
+    const bool in_radius = geodist[face_verts_copy[j]] < radius;
+    if(in_radius == (num_verts_in_radius == 1)) { // The single vertex in for 1 in, 2 out, the single vertex out for 2 in, 1 out.
+      k=j;
+    }
+  }
+  assert(k>=0);
+  // Reorder vertex indices of face, based on k. No re-ordering for k==0.
+  const I face_verts[3] = { face_verts_copy[k], face_verts_copy[(k+1) % 3], face_verts_copy[(k+2) % 3] };
+
+  std::vector<float> face_vertex_dists(3);  // Get distances for all vertices of this face.
+  face_vertex_dists[0] = geodist[face_verts[0]] - radius;
+  face_vertex_dists[1] = geodist[face_verts[1]] - radius;
+  face_vertex_dists[2] = geodist[face_verts[2]] - radius;
+
+  // If these asserts fail, the extra_dist added to the radius to create max_dist in the geodesic_circles() function is too small.
+  assert(geodist[face_verts[0]] < (std::numeric_limits<float>::max() - 0.01));
+  assert(geodist[face_verts[1]] < (std::numeric_limits<float>::max() - 0.01));
+  assert(geodist[face_verts[2]] < (std::numeric_limits<float>::max() - 0.01));
+
+  // The following 3 vectors represent 1 matrix together.
+  std::vector<float> coords_v0(m.vertex(face_verts[0]), m.vertex(face_verts[0]) + 3);
+  std::vector<float> coords_v1(m.vertex(face_verts[1]), m.vertex(face_verts[1]) + 3);
+  std::vector<float> coords_v2(m.vertex(face_verts[2]), m.vertex(face_verts[2]) + 3);
+
+  // These computations use vector math with overloaded operators from vec_math.h
+  float alpha1 = face_vertex_dists[1]/(face_vertex_dists[1]-face_vertex_dists[0]);
+  std::vector<float> v1 = alpha1 * coords_v0 + (1.0f-alpha1) * coords_v1;
+  float alpha2 = face_vertex_dists[2]/(face_vertex_dists[2]-face_vertex_dists[0]);
+  std::vector<float> v2 = alpha2 * coords_v0 + (1.0f-alpha2) * coords_v2;
+
+  float b = vnorm(cross(coords_v0 - v1, coords_v0 - v2)) / 2.0;
+  if(num_verts_in_radius == 2) { // 2 in, 1 out
+    area += face_area - b;
+  } else { // 1 in, 2 out
+    area += b;
+  }
+  perimeter += vnorm(v1 - v2);
+}
+
+
+///  Compute geodesic circle area and perimeter at location defined by geodists for all radii.
+///  The location at which it will be computed is the vertex for which the geodesic distances were computed.
+///
+/// This function is internal, it is called by geodesic_circles(). It sweeps over the given faces once and evaluates all
+/// radii per face from the range of its vertex distances: a face is fully inside all radii above its maximal vertex
+/// distance, and partly inside the radii between its minimal and maximal vertex distance.
+/// @param sample_at_radii the radii, in ascending order.
+/// @param per_face_area the area of each face of the mesh, see `mesh_area_per_face`.
+/// @param face_indices the faces to consider. All other faces must have no vertex with a geodesic distance below the largest radius, e.g., the faces incident to the vertices reached by the distance computation.
+template<typename T, typename I>
+std::vector<std::vector<double>> _compute_geodesic_circle_stats(const MeshView<T, I>& m, const std::vector<float>& geodist, const std::vector<double>& sample_at_radii, const std::vector<double>& per_face_area, const std::vector<int32_t>& face_indices) {
+
+  const int nr = int(sample_at_radii.size());
+  assert(std::is_sorted(sample_at_radii.begin(), sample_at_radii.end()));
+
+  std::vector<double> full_areas_by_radius(nr + 1, 0.0); // Area of the full faces, by the index of the smallest radius they are fully in.
+  std::vector<double> areas_by_radius(nr, 0.0);
+  std::vector<double> perimeters_by_radius(nr, 0.0);
+
+  for(size_t fi=0; fi<face_indices.size(); fi++) {
+    const int32_t i = face_indices[fi];
+    const I* fv = m.face(i);
+    const double dmin = std::min(geodist[fv[0]], std::min(geodist[fv[1]], geodist[fv[2]]));
+    const double dmax = std::max(geodist[fv[0]], std::max(geodist[fv[1]], geodist[fv[2]]));
+    // A vertex is in radius if its geodesic distance value is < radius. The face is partly in the radii in [first_partial, first_full).
+    const int first_partial = int(std::upper_bound(sample_at_radii.begin(), sample_at_radii.end(), dmin) - sample_at_radii.begin());
+    const int first_full = int(std::upper_bound(sample_at_radii.begin() + first_partial, sample_at_radii.end(), dmax) - sample_at_radii.begin());
+    full_areas_by_radius[first_full] += per_face_area[i];
+    for(int radius_idx=first_partial; radius_idx<first_full; radius_idx++) {
+      _add_partial_face_circle_stats(m, geodist, i, sample_at_radii[radius_idx], per_face_area[i], areas_by_radius[radius_idx], perimeters_by_radius[radius_idx]);
+    }
+  }
+  // A face which is fully in a radius is fully in all larger ones as well.
+  double full_area = 0.0;
+  for(int radius_idx=0; radius_idx<nr; radius_idx++) {
+    full_area += full_areas_by_radius[radius_idx];
+    areas_by_radius[radius_idx] += full_area;
+  }
+
+  std::vector<std::vector<double>> res;
+  res.push_back(areas_by_radius);
+  res.push_back(perimeters_by_radius);
+  return res;
+}
+
+
+/// @brief A face of a geodesic circle root search with the range of its vertex distances.
+/// @private
+struct _CircleFace {
+  int32_t face;
+  double dmin;
+  double dmax;
+};
+
+
+/// @brief Compute the area and perimeter of a geodesic circle of the given radius over some faces.
+/// @param faces the faces which are partly inside the circle or may be. Faces with `dmax < radius` are fully inside.
+/// @param base_area the area of all faces which are known to be fully inside, and are not part of `faces`.
+/// @param perimeter set to the perimeter of the circle.
+/// @return the area of the circle.
+/// @private
+template<typename T, typename I>
+double _geodesic_circle_area(const MeshView<T, I>& m, const std::vector<float>& geodist, const std::vector<double>& per_face_area, const std::vector<_CircleFace>& faces, const double base_area, const double radius, double& perimeter) {
+  double area = base_area;
+  perimeter = 0.0;
+  for(size_t fi=0; fi<faces.size(); fi++) {
+    const _CircleFace& cf = faces[fi];
+    if(cf.dmax < radius) {
+      area += per_face_area[cf.face];
+    } else if(cf.dmin < radius) {
+      _add_partial_face_circle_stats(m, geodist, cf.face, radius, per_face_area[cf.face], area, perimeter);
+    }
+  }
+  return area;
+}
+
+
+/// @brief Find the radius of the geodesic circle with the given area by root finding on the exact area function.
+/// @details The area of the circle is a continuous, non-decreasing function of the radius, which is evaluated exactly
+/// from the distance field like in `_compute_geodesic_circle_stats`. The root is bracketed in `[0, max_radius]` and found
+/// with the Illinois variant of regula falsi, falling back to bisection. After each step, the faces fully inside the
+/// lower end of the bracket are added to a base area, and the faces fully outside its upper end are dropped, so later
+/// evaluations only visit the faces crossed by the remaining bracket.
+/// @param face_indices the faces to consider, see `_compute_geodesic_circle_stats`.
+/// @param target_area the area of the circle.
+/// @param max_radius the upper end of the bracket. The distances of all vertices of faces that are partly inside a circle of this radius must be known.
+/// @param tolerance the relative tolerance of the circle area.
+/// @param radius set to the radius of the circle.
+/// @param perimeter set to the perimeter of the circle.
+/// @return whether the circle of radius `max_radius` has at least the target area. If not, `radius` and `perimeter` are the ones for `max_radius`.
+/// @private
+template<typename T, typename I>
+bool _geodesic_circle_radius_root(const MeshView<T, I>& m, const std::vector<float>& geodist, const std::vector<double>& per_face_area, const std::vector<int32_t>& face_indices, const double target_area, const double max_radius, const double tolerance, double& radius, double& perimeter) {
+  std::vector<_CircleFace> faces;
+  faces.reserve(face_indices.size());
+  for(size_t fi=0; fi<face_indices.size(); fi++) {
+    const I* fv = m.face(face_indices[fi]);
+    _CircleFace cf;
+    cf.face = face_indices[fi];
+    cf.dmin = std::min(geodist[fv[0]], std::min(geodist[fv[1]], geodist[fv[2]]));
+    cf.dmax = std::max(geodist[fv[0]], std::max(geodist[fv[1]], geodist[fv[2]]));
+    if(cf.dmin < max_radius) {
+      faces.push_back(cf);
+    }
+  }
+  double base_area = 0.0;
+
+  double lo = 0.0, hi = max_radius;
+  double f_lo = -target_area;  // No vertex is in radius 0.
+  double f_hi = _geodesic_circle_area(m, geodist, per_face_area, faces, base_area, hi, perimeter) - target_area;
+  radius = hi;
+  if(f_hi <= 0.0) {
+    return f_hi == 0.0;
+  }
+
+  int retained = 0;  // The bracket end kept by the last step, -1 for lo and 1 for hi.
+  for(int iter=0; iter<100; iter++) {
+    double r = (lo * f_hi - hi * f_lo) / (f_hi - f_lo);
+    if(!(r > lo && r < hi)) {
+      r = 0.5 * (lo + hi);
+    }
+    const double f = _geodesic_circle_area(m, geodist, per_face_area, faces, base_area, r, perimeter) - target_area;
+    radius = r;
+    if(std::fabs(f) <= tolerance * target_area || hi - lo <= 1e-12 * max_radius) {
+      break;
+    }
+    if(f < 0.0) {
+      lo = r; f_lo = f;
+      if(retained == 1) { f_hi *= 0.5; }
+      retained = 1;
+    } else {
+      hi = r; f_hi = f;
+      if(retained == -1) { f_lo *= 0.5; }
+      retained = -1;
+    }
+    // Settle the faces which are fully inside or outside of all radii in the remaining bracket.
+    size_t num_kept = 0;
+    for(size_t fi=0; fi<faces.size(); fi++) {
+      if(faces[fi].dmax < lo) {
+        base_area += per_face_area[faces[fi].face];
+      } else if(faces[fi].dmin < hi) {
+        faces[num_kept++] = faces[fi];
+      }
+    }
+    faces.resize(num_kept);
+  }
+  return true;
+}
+
+
+/// @brief Collect the faces incident to some vertices, each face once.
+/// @param vertex_faces the vertex-face incidence, see `mesh_vertex_faces`.
+/// @param face_mark per face, the stamp of the last collection which included it.
+/// @param stamp the stamp of this collection, must differ from all entries of `face_mark` which are not from it.
+/// @param faces cleared and set to the faces.
+/// @private
+inline void _collect_vertex_faces(const MeshCSR& vertex_faces, const std::vector<int32_t>& vertices, std::vector<int32_t>& face_mark, const int32_t stamp, std::vector<int32_t>& faces) {
+  faces.clear();
+  for(size_t j=0; j<vertices.size(); j++) {
+    const int32_t v = vertices[j];
+    for(const int32_t* f = vertex_faces.neighbors_begin(v); f != vertex_faces.neighbors_end(v); f++) {
+      if(face_mark[*f] != stamp) {
+        face_mark[*f] = stamp;
+        faces.push_back(*f);
+      }
+    }
+  }
+}
+
+
+/// @brief Find the radius of the geodesic circle with the given area by cubic spline interpolation of the circle areas at 10 radii.
+/// @details The radii are sampled in a window of +/- 10 around `r_cycle`, and the closest of 91 interpolated samples is picked.
+/// @param face_indices the faces to consider, see `_compute_geodesic_circle_stats`.
+/// @param target_area the area of the circle.
+/// @param r_cycle the radius of a flat disk with the target area, the center of the sampling window.
+/// @param radius set to the radius of the circle.
+/// @param perimeter set to the perimeter of the circle.
+/// @private
+template<typename T, typename I>
+void _geodesic_circle_radius_spline(const MeshView<T, I>& m, const std::vector<float>& geodist, const std::vector<double>& per_face_area, const std::vector<int32_t>& face_indices, const double target_area, const double r_cycle, double& radius, double& perimeter) {
+  double sampling = 10.0;
+  std::vector<double> sample_at_radii = linspace<double>(r_cycle-10.0, r_cycle+10.0, sampling);
+  std::vector<std::vector<double>> circle_stats = _compute_geodesic_circle_stats(m, geodist, sample_at_radii, per_face_area, face_indices);
+  std::vector<double> circle_areas = circle_stats[0];
+  std::vector<double> circle_perimeters = circle_stats[1];
+
+  assert(sample_at_radii.size() == circle_areas.size());
+  assert(sample_at_radii.size() == circle_perimeters.size());
+
+  std::vector<double> x = linspace<double>(1.0, sampling, numsteps_for_stepsize(1.0, sampling, 1.0)); // spline x values
+  std::vector<double> xx = linspace<double>(1.0, sampling, numsteps_for_stepsize(1.0, sampling, 0.1));  // where to sample
+  int num_samples = xx.size();
+
+  assert(x.size() == circle_areas.size()); // If this fails, there is a bug in the numsteps_for_stepsize() function.
+
+  // Create cubic splines interpolation.
+  tk::spline spl_areas(x, circle_areas);
+  tk::spline spl_radius(x, sample_at_radii);
+  tk::spline spl_perimeters(x, circle_perimeters);
+  // Get interpolated values.
+  std::vector<double> sampled_areas(num_samples);
+  for(int i=0; i<num_samples; i++) { sampled_areas[i] = spl_areas(xx[i]); }
+  std::vector<double> sampled_radii(num_samples);
+  for(int i=0; i<num_samples; i++) { sampled_radii[i] = spl_radius(xx[i]); }
+  std::vector<double> sampled_perimeters(num_samples);
+  for(int i=0; i<num_samples; i++) { sampled_perimeters[i] = spl_perimeters(xx[i]); }
+
+  // Determine index of min
+  for(int i=0; i<num_samples; i++) {
+    sampled_areas[i] = fabs(target_area - sampled_areas[i]);
+  }
+  int min_index = std::distance(sampled_areas.begin(),std::min_element(sampled_areas.begin(),sampled_areas.end()));
+  // Collect results.
+  radius = sampled_radii[min_index];
+  perimeter = sampled_perimeters[min_index];
+}
+
+
+/// @brief Get the radius up to which the distances are needed for the geodesic circles of several scales.
+/// @details The spline method needs the top of its sampling window. The root finding needs no window around r_cycle, it
+/// starts with a tighter radius and doubles it for the circles beyond.
+/// @private
+template<typename T, typename I>
+double _geodesic_circles_needed_radius(const MeshGeometry<T, I>& geom, const std::vector<float>& scales, const bool use_root) {
+  double max_r_cycle = 0.0;
+  for(size_t k=0; k<scales.size(); k++) {
+    max_r_cycle = std::max(max_r_cycle, sqrt(((scales[k] * geom.area_total()) / 100.0) / M_PI));
+  }
+  return use_root ? 1.25 * max_r_cycle : max_r_cycle + 10.0;
+}
+
+
+/// @brief Get the float search radius for a needed radius, rounded up so that all faces with a vertex closer than the radius in double precision are covered.
+/// @private
+inline float _geodesic_circles_search_radius(const double radius) {
+  return std::nextafter(float(radius), GEOD_UNREACHED);
+}
+
+
+/// @brief Compute geodesic circles at the query vertices for several scales, see `geodesic_circles_scales`.
+/// @param geom the geometry of the mesh.
+/// @param g the graph of the mesh.
+/// @param query_vertices the query vertices, must not be empty.
+/// @param scales the scales, must not be empty.
+/// @param num_included the number of vertices the mean distance is computed over, i.e., the vertices of the mesh which are not masked.
+/// @param radius_method how the radius is determined from the circle areas, 'spline' or 'root'. See `geodesic_circles`.
+/// @param radius_tolerance the relative tolerance of the circle area for radius method 'root'.
+/// @param neighborhoods optional neighborhoods of all vertices to take the distances from instead of searching, see `geodesic_circles_scales`.
+/// @throws std::invalid_argument if the radius method is invalid.
+/// @private
+template<typename T, typename I>
+std::vector<std::vector<float>> _geodesic_circles(const MeshGeometry<T, I>& geom, const GeodGraph& g, const std::vector<int>& query_vertices, const std::vector<float>& scales, const bool do_meandist, const size_t num_included, const std::string& radius_method, const double radius_tolerance, const GeodNeighborhoods* neighborhoods) {
+
+  if(radius_method != "spline" && radius_method != "root") {
+    throw std::invalid_argument("Invalid radius method '" + radius_method + "', must be 'spline' or 'root'.\n");
+  }
+  const bool use_root = radius_method == "root";
+  const MeshView<T, I>& m = geom.mesh;
+
+  const size_t ns = scales.size();
+  double mesh_area = geom.area_total();
+  std::vector<double> area_scale(ns), r_cycle(ns);
+  for(size_t k=0; k<ns; k++) {
+    area_scale[k] = (scales[k] * mesh_area) / 100.0;
+    r_cycle[k] = sqrt(area_scale[k] / M_PI);
+  }
+  float max_possible_float = std::numeric_limits<float>::max();
+  const int nv = int(m.num_vertices());
+
+  const std::vector<double>& edge_lengths = geom.edge_lengths();
+  double mean_len = std::accumulate(edge_lengths.begin(), edge_lengths.end(), 0.0) / (double)edge_lengths.size();
+  double max_edge_len = *std::max_element(edge_lengths.begin(), edge_lengths.end());
+  std::cout  << "     o Mesh has " << edge_lengths.size() << " edges with average length " << mean_len << " and maximal length " << max_edge_len << ".\n";
+  // Circles which reach an open edge, e.g., at the border of a cortex mask, cover less area than they would on a closed surface.
+  const std::vector<int32_t>& face_adj = geom.face_adjacency();
+  const size_t num_open_edges = size_t(std::count(face_adj.begin(), face_adj.end(), -1));
+  if(num_open_edges > 0) {
+    std::cout  << "     o Mesh has " << num_open_edges << " open edges, geodesic circles which reach them are cut off at the mesh boundary.\n";
+  }
+
+  // A single search per query vertex up to the radius needed by the largest scale serves all scales. The search stops
+  // once the faces crossing that radius have final vertex distances, see `geod_dijkstra_faces`, for dramatic speed-up.
+  double needed_radius = _geodesic_circles_needed_radius(geom, scales, use_root);
+  if(do_meandist) {
+    needed_radius = -1.0; // Compute full pairwise geodesic distances if meandist computation was requested.
+    neighborhoods = NULL;
+  } else {
+    std::cout  << "     o Using " << (use_root ? "initial " : "") << "search radius " << needed_radius << ", plus the vertices of the faces crossing it.\n";
+    if(neighborhoods) {
+      std::cout  << "     o Taking the distances from the given neighborhoods of radius " << neighborhoods->radius << " where they hold all vertices of the faces crossing the search radius.\n";
+    }
+  }
+
+  int nqv = int(query_vertices.size());
+  std::vector<std::vector<float>> radius(ns, std::vector<float>(nqv)), perimeter(ns, std::vector<float>(nqv));
+  std::vector<float> meandist(nqv);
+  size_t num_reached = 0, num_beyond = 0;  // Over all searches, the vertices reached and the ones settled beyond the needed radius.
+  size_t num_from_neighborhoods = 0;       // The query vertices whose distances were taken from their neighborhood.
+
+  // Shared by all threads, the mesh view, its geometry and the graph are read-only.
+  const std::vector<double>& per_face_area = geom.face_areas();
+  const MeshCSR vertex_faces = mesh_vertex_faces(m);
+  std::vector<int32_t> all_faces;  // Unreached vertices are in all radii for the mean distance, so all faces are needed then.
+  if(do_meandist) {
+    all_faces.resize(m.num_faces());
+    std::iota(all_faces.begin(), all_faces.end(), 0);
+  }
+
+  // Unreached vertices get distance 0 for the mean distance, and the maximal float for the circle stats. The latter
+  // also holds for reached vertices in distance 0, other than the query vertex itself.
+  const float unreached_value = do_meandist ? 0.0f : max_possible_float;
+
+  # pragma omp parallel shared(g, per_face_area, vertex_faces, all_faces, radius, perimeter, meandist) reduction(+:num_reached, num_beyond, num_from_neighborhoods)
+  {
+  GeodWorkspace ws(g.num_vertices());
+  std::vector<float> v_geodist(nv, unreached_value);  // Per thread, only the entries of the filled vertices are reset after each query.
+  std::vector<int32_t> filled;                         // The vertices with a distance in v_geodist.
+  bool complete = false;                               // Whether the distances of all vertices reachable from the query vertex are known.
+  std::vector<int32_t> face_mark(m.num_faces(), -1);   // Per thread, the last collection of the faces of reached vertices that included each face.
+  int32_t face_stamp = 0;
+  std::vector<int32_t> local_faces;
+  std::vector<int32_t> vertex_mark(neighborhoods ? nv : 0, -1);  // Per thread, the last neighborhood that included each vertex.
+  int32_t vertex_stamp = 0;
+
+  auto clear_distances = [&]() {
+    for(size_t j=0; j<filled.size(); j++) {
+      v_geodist[filled[j]] = unreached_value;
+    }
+  };
+
+  // The faces are swept in ascending order, so the circles do not depend on the order the distances were found in.
+  auto collect_faces = [&]() {
+    _collect_vertex_faces(vertex_faces, filled, face_mark, face_stamp++, local_faces);
+    std::sort(local_faces.begin(), local_faces.end());
+  };
+
+  // Run the distance computation for the current query vertex up to the given radius, or over the full mesh for a
+  // negative one, and fill in the distances of the reached vertices. Returns the largest distance reached.
+  int qv = -1;
+  auto search = [&](const double search_radius) {
+    clear_distances();
+    const int32_t query_vertex = qv;
+    if(search_radius < 0.0) {
+      geod_dijkstra(g, &query_vertex, 1, -1.0f, ws);
+    } else {
+      num_beyond += geod_dijkstra_faces(g, &query_vertex, 1, _geodesic_circles_search_radius(search_radius), ws);
+    }
+    num_reached += ws.reached.size();
+    filled.assign(ws.reached.begin(), ws.reached.end());
+    complete = ws.heap.empty();
+    double max_reached_dist = 0.0;
+    for(size_t j=0; j<ws.reached.size(); j++) {
+      const int32_t v = ws.reached[j];
+      if(do_meandist || v == qv || ws.dist[v] > 0.000000001) {
+        v_geodist[v] = ws.dist[v];
+      }
+      max_reached_dist = std::max(max_reached_dist, double(ws.dist[v]));
+    }
+    if(! do_meandist) {
+      collect_faces();  // Only the faces incident to reached vertices can be in any radius.
+    }
+    return max_reached_dist;
+  };
+
+  // Fill in the distances of the current query vertex from its neighborhood instead of searching, if the neighborhood
+  // holds all vertices of the faces crossing the given radius. Returns whether it does. The distances in the
+  // neighborhood are the final ones, so the circles equal the ones computed with a search.
+  auto from_neighborhood = [&](const double search_radius) {
+    const float radius_f = _geodesic_circles_search_radius(search_radius);
+    const int64_t begin = neighborhoods->offsets[qv], end = neighborhoods->offsets[qv+1];
+    const int32_t* index = neighborhoods->index.data();
+    const float* dist = neighborhoods->dist.data();
+    const int32_t stamp = vertex_stamp++;
+    for(int64_t k=begin; k<end; k++) {
+      vertex_mark[index[k]] = stamp;
+    }
+    for(int64_t k=begin; k<end; k++) {
+      if(dist[k] < radius_f) {
+        for(const int32_t* n = g.csr.neighbors_begin(index[k]); n != g.csr.neighbors_end(index[k]); ++n) {
+          if(vertex_mark[*n] != stamp) {
+            return false;
+          }
+        }
+      }
+    }
+    clear_distances();
+    for(int64_t k=begin; k<end; k++) {
+      if(index[k] == qv || dist[k] > 0.000000001) {
+        v_geodist[index[k]] = dist[k];
+      }
+    }
+    filled.assign(index + begin, index + end);
+    complete = false;
+    collect_faces();
+    return true;
+  };
+
+  # pragma omp for
+  for(int i=0; i<nqv; i++) {
+    qv = query_vertices[i];
+    double search_radius = needed_radius;
+    double max_reached_dist = 0.0;  // Only used if the distances are complete.
+    if(neighborhoods && from_neighborhood(search_radius)) {
+      num_from_neighborhoods++;
+    } else {
+      max_reached_dist = search(search_radius);
+    }
+
+    if(do_meandist) {
+      meandist[i] = std::accumulate(v_geodist.begin(), v_geodist.end(), 0.0) / (float)num_included;
+    }
+
+    for(size_t k=0; k<ns; k++) {
+      double r, p;
+      if(! use_root) {
+        _geodesic_circle_radius_spline(m, v_geodist, per_face_area, do_meandist ? all_faces : local_faces, area_scale[k], r_cycle[k], r, p);
+      } else {
+        while(true) {
+          // If the search settled all vertices it could reach, all distances are known. Otherwise, the faces partly
+          // inside the search radius have final vertex distances.
+          const double max_radius = complete ? std::nextafter(max_reached_dist, std::numeric_limits<double>::max()) : search_radius;
+          if(_geodesic_circle_radius_root(m, v_geodist, per_face_area, do_meandist ? all_faces : local_faces, area_scale[k], max_radius, radius_tolerance, r, p) || complete) {
+            break;
+          }
+          // The circle is larger than the search radius, redo the search with twice the radius.
+          search_radius *= 2.0;
+          max_reached_dist = search(search_radius);
+        }
+      }
+      radius[k][i] = float(r);
+      perimeter[k][i] = float(p);
+    }
+  }
+  }
+
+  if(neighborhoods) {
+    std::cout  << "     o Took the distances of " << num_from_neighborhoods << " of " << nqv << " query vertices from their neighborhoods.\n";
+  }
+  if(! do_meandist && size_t(nqv) > num_from_neighborhoods) {
+    const size_t num_searched = nqv - num_from_neighborhoods;
+    std::cout  << "     o Reached " << (num_reached / num_searched) << " vertices per searched query vertex on average, " << (num_beyond / num_searched) << " of them settled beyond the needed radius to complete the faces crossing it.\n";
+  }
+
+  // Prepare and return results.
+  std::vector<std::vector<float>> res;
+  for(size_t k=0; k<ns; k++) {
+    res.push_back(radius[k]);
+    res.push_back(perimeter[k]);
+  }
+  if(do_meandist) {
+    res.push_back(meandist);
+  }
+  return res;
+}
+
+
+/// Compute geodesic circles at each query vertex and return their radius and perimeter (and mean geodesic distance if requested).
+/// If 'query_vertices' is empty, this function will work on ALL vertices.
+/// If 'do_meandist' is true, this function will compute the mean geodesic distances to all other vertices for each vertex and
+/// return those as well. This is only partially needed for the function (it only needs to know for each vertex the geodesic
+/// distances in a certain radius, not to ALL vertices), but it is faster to do it here instead of separately computing the mean
+/// distances with another function call to mean_geodist_p()/mean_geodist() IF you need them anyways. If in doubt, leave this
+/// disabled for a dramatic speedup (how much depends on the 'scale' parameter).
+/// The 'radius_method' determines how the radius of the circle with the requested area is found. The default 'spline' samples
+/// the circle area at 10 radii in a window of +/- 10 around the radius of a flat disk with that area, interpolates it with
+/// cubic splines, and picks the closest of 91 interpolated values. The method 'root' finds the radius by root finding on the
+/// exact area function to the relative area tolerance 'radius_tolerance', without any window, and computes the perimeter
+/// at that radius. It is faster and more accurate, but its results differ slightly from the ones of 'spline'.
+/// @throws std::invalid_argument if the radius method is invalid.
+template<typename T, typename I>
+std::vector<std::vector<float>> geodesic_circles(const MeshView<T, I>& m, std::vector<int> query_vertices, float scale=5.0, bool do_meandist=false, const std::string& radius_method="spline", const double radius_tolerance=1e-6) {
+  // Use all vertices if query_vertices is empty.
+  if(query_vertices.empty()) {
+    query_vertices.resize(m.num_vertices());
+    for(size_t i=0; i<m.num_vertices(); i++) {
+      query_vertices[i] = int(i);
+    }
+  }
+  return _geodesic_circles(MeshGeometry<T, I>(m), geod_graph(m), query_vertices, std::vector<float>(1, scale), do_meandist, m.num_vertices(), radius_method, radius_tolerance, NULL);
+}
+
+
+/// @brief Compute geodesic circles for several scales with a prebuilt graph and mesh geometry, optionally on the included part of a mask only, see `geodesic_circles`.
+/// @details A single distance computation per query vertex, up to the bound required by the largest scale, serves the
+/// circles of all scales. With a mask, the distances run over the faces of the mask only, and the circle areas and the
+/// mean distances only cover the included vertices, so the results equal the ones for a submesh of the included vertices.
+/// Reuse the geometry for several computations on the same mesh, so its face areas and edge lengths are computed only once.
+/// @param geom the geometry of the mesh, or of the masked view of the mesh if a mask is given.
+/// @param g the graph of the mesh, or of the masked view of the mesh if a mask is given. See `geod_graph_cached` for reusing the adjacency for several meshes with the same faces.
+/// @param query_vertices the query vertices, all (included) vertices if empty.
+/// @param scales the scales, i.e., the fractions of the mesh area that the circles should have, in percent.
+/// @param mask the mask, or NULL for the full mesh.
+/// @param radius_method 'spline' or 'root', see `geodesic_circles`.
+/// @param radius_tolerance the relative tolerance of the circle area for radius method 'root'.
+/// @param neighborhoods optional neighborhoods of all vertices on the graph, e.g., from the neighborhood cache, see `geod_neighborhoods_cached` and `geodesic_circles_neighborhood_radius`. The distances of query vertices whose neighborhood holds all vertices of the faces crossing the needed radius are taken from it instead of a search, with identical results. Ignored if the mean distances are computed.
+/// @return vector of `2 * scales.size()` vectors, the radii and perimeters for each scale in turn, followed by the mean distances if requested. One value per query vertex each. For the default query vertices with a mask, this is the order of `mask.vertices`, see `mask_scatter`.
+/// @throws std::invalid_argument if there are no scales, if the graph, the mask or the neighborhoods do not match the mesh, if a query vertex is out of range or masked, or if the radius method is invalid.
+template<typename T>
+std::vector<std::vector<float>> geodesic_circles_scales(const MeshGeometry<T, int32_t>& geom, const GeodGraph& g, std::vector<int> query_vertices, const std::vector<float>& scales, bool do_meandist=false, const MeshMask* mask=NULL, const std::string& radius_method="spline", const double radius_tolerance=1e-6, const GeodNeighborhoods* neighborhoods=NULL) {
+  const MeshView<T, int32_t>& m = geom.mesh;
+  if(scales.empty()) {
+    throw std::invalid_argument("Need at least one scale for the geodesic circles.\n");
+  }
+  if(g.num_vertices() != m.num_vertices()) {
+    throw std::invalid_argument("Graph with " + std::to_string(g.num_vertices()) + " vertices does not match mesh with " + std::to_string(m.num_vertices()) + " vertices.\n");
+  }
+  if(neighborhoods && neighborhoods->num_vertices() != m.num_vertices()) {
+    throw std::invalid_argument("Neighborhoods of " + std::to_string(neighborhoods->num_vertices()) + " vertices do not match mesh with " + std::to_string(m.num_vertices()) + " vertices.\n");
+  }
+  if(! mask) {
+    if(query_vertices.empty()) {
+      query_vertices.resize(m.num_vertices());
+      for(size_t i=0; i<m.num_vertices(); i++) {
+        query_vertices[i] = int(i);
+      }
+    }
+    return _geodesic_circles(geom, g, query_vertices, scales, do_meandist, m.num_vertices(), radius_method, radius_tolerance, neighborhoods);
+  }
+  if(mask->included.size() != m.num_vertices() || mask->num_faces() != m.num_faces()) {
+    throw std::invalid_argument("Mask does not match the mesh geometry, which must be the one of the masked view.\n");
+  }
+  if(query_vertices.empty()) {
+    query_vertices.assign(mask->vertices.begin(), mask->vertices.end());
+  }
+  for(size_t i=0; i<query_vertices.size(); i++) {
+    if(query_vertices[i] < 0 || size_t(query_vertices[i]) >= m.num_vertices() || ! mask->included[query_vertices[i]]) {
+      throw std::invalid_argument("Query vertex " + std::to_string(query_vertices[i]) + " is not an included vertex of the mask.\n");
+    }
+  }
+  return _geodesic_circles(geom, g, query_vertices, scales, do_meandist, mask->num_vertices(), radius_method, radius_tolerance, neighborhoods);
+}
+
+
+/// @brief Get the radius of neighborhoods which can serve the distances of `geodesic_circles_scales` for all query vertices.
+/// @details Neighborhoods of this radius hold all vertices of the faces crossing the radius needed by the circles, as no
+/// edge is longer than the longest one of the mesh.
+/// @param geom the geometry of the mesh, or of the masked view of the mesh if a mask is used.
+/// @throws std::invalid_argument if the radius method is invalid.
+template<typename T>
+float geodesic_circles_neighborhood_radius(const MeshGeometry<T, int32_t>& geom, const std::vector<float>& scales, const std::string& radius_method="spline") {
+  if(radius_method != "spline" && radius_method != "root") {
+    throw std::invalid_argument("Invalid radius method '" + radius_method + "', must be 'spline' or 'root'.\n");
+  }
+  const std::vector<double>& edge_lengths = geom.edge_lengths();
+  const double max_edge_len = edge_lengths.empty() ? 0.0 : *std::max_element(edge_lengths.begin(), edge_lengths.end());
+  return _geodesic_circles_search_radius(_geodesic_circles_needed_radius(geom, scales, radius_method == "root") + max_edge_len);
+}
+
+
+/// @brief Compute geodesic circles with a prebuilt graph and mesh geometry, optionally on the included part of a mask only, see `geodesic_circles`.
+/// @details This is `geodesic_circles_scales` for a single scale.
+/// @param geom the geometry of the mesh, or of the masked view of the mesh if a mask is given.
+/// @param g the graph of the mesh, or of the masked view of the mesh if a mask is given.
+/// @param query_vertices the query vertices, all (included) vertices if empty.
+/// @param mask the mask, or NULL for the full mesh.
+/// @param radius_method 'spline' or 'root', see `geodesic_circles`.
+/// @param radius_tolerance the relative tolerance of the circle area for radius method 'root'.
+/// @return like `geodesic_circles`, one value per query vertex. For the default query vertices with a mask, this is the order of `mask.vertices`, see `mask_scatter`.
+/// @throws std::invalid_argument if the graph or the mask do not match the mesh, if a query vertex is out of range or masked, or if the radius method is invalid.
+template<typename T>
+std::vector<std::vector<float>> geodesic_circles(const MeshGeometry<T, int32_t>& geom, const GeodGraph& g, std::vector<int> query_vertices, float scale=5.0, bool do_meandist=false, const MeshMask* mask=NULL, const std::string& radius_method="spline", const double radius_tolerance=1e-6) {
+  return geodesic_circles_scales(geom, g, query_vertices, std::vector<float>(1, scale), do_meandist, mask, radius_method, radius_tolerance);
+}
+
+
+/// @brief Compute geodesic circles on a mesh with a prebuilt graph, optionally on the included part of a mask only, see `geodesic_circles`.
+/// @details This computes the geometry of the mesh or of its masked view, see the overload for a `MeshGeometry`, which this calls.
+/// @param m the mesh.
+/// @param g the graph of the mesh, or of the masked view of the mesh if a mask is given.
+/// @param query_vertices the query vertices, all (included) vertices if empty.
+/// @param mask the mask, or NULL for the full mesh.
+/// @throws std::invalid_argument if the graph does not match the mesh, if a query vertex is out of range or masked, or if the radius method is invalid.
+template<typename T>
+std::vector<std::vector<float>> geodesic_circles(const MeshView<T, int32_t>& m, const GeodGraph& g, std::vector<int> query_vertices, float scale=5.0, bool do_meandist=false, const MeshMask* mask=NULL, const std::string& radius_method="spline", const double radius_tolerance=1e-6) {
+  return geodesic_circles(MeshGeometry<T, int32_t>(mask ? masked_view(m, *mask) : m), g, query_vertices, scale, do_meandist, mask, radius_method, radius_tolerance);
+}
+
+
+/// @brief Compute geodesic circles on the included part of a masked mesh, see `geodesic_circles`.
+/// @details The distances run over the faces of the mask only, and the circle areas and the mean distances only cover the
+/// included vertices, so the results equal the ones for a submesh of the included vertices.
+/// @param query_vertices the query vertices, all included vertices of the mask if empty.
+/// @return like `geodesic_circles`, one value per query vertex. For the default query vertices, this is the order of `mask.vertices`, see `mask_scatter`.
+/// @throws std::invalid_argument if a query vertex is out of range or masked.
+template<typename T>
+std::vector<std::vector<float>> geodesic_circles(const MeshView<T, int32_t>& m, const MeshMask& mask, std::vector<int> query_vertices, float scale=5.0, bool do_meandist=false, const std::string& radius_method="spline", const double radius_tolerance=1e-6) {
+  return geodesic_circles(m, geod_graph(masked_view(m, mask)), query_vertices, scale, do_meandist, &mask, radius_method, radius_tolerance);
+}
@@ -0,0 +1,258 @@
+#pragma once
+
+#include "geod_engine.h"
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Delta-stepping single-source search, for using all threads on one search over a large mesh.
+//
+// Most computations run many independent searches, one per thread. A single full distance field, or a few of them
+// like the landmark fields of a distance oracle, leave all but a few threads idle on a sequential Dijkstra search. The
+// delta-stepping algorithm of Meyer and Sanders groups the tentative distances into buckets of width delta and relaxes
+// all vertices of the lowest non-empty bucket in parallel, repeating until the bucket stays empty. Each thread keeps
+// its own buckets, and the distances are updated with an atomic minimum, so no locks are needed. Small deltas do less
+// redundant work, large deltas need fewer synchronized rounds.
+//
+// The distances are the ones of `geod_dijkstra`, bit for bit: floating point addition of non-negative values is
+// monotone, so both compute the minimum over all paths of the path lengths summed along the path, whatever the
+// order of the relaxations.
+
+
+/// @brief Get the number of threads an OpenMP parallel region would use, 1 without OpenMP.
+inline size_t geod_num_threads() {
+#ifdef _OPENMP
+  return size_t(omp_get_max_threads());
+#else
+  return 1;
+#endif
+}
+
+
+/// @brief Get the default bucket width for delta-stepping on a graph: a few mean edge lengths.
+/// @details Mesh edges have similar lengths, so a bucket holds a band a few edges wide around the sources. This balances the rounds and the redundant relaxations on brain meshes and synthetic grids, see the `bench_sssp` app. The mean is taken over at most 4096 evenly spaced edges, so small bounded searches do not pay for a pass over the whole graph.
+float geod_delta_default(const GeodGraph& g) {
+  const size_t num_weights = g.weights.size();
+  const size_t step = num_weights / 4096 + 1;
+  double sum = 0.0;
+  size_t num_sampled = 0;
+  for(size_t k=0; k<num_weights; k+=step) {
+    sum += g.weights[k];
+    num_sampled++;
+  }
+  const float mean = num_sampled == 0 ? 1.0f : float(sum / double(num_sampled));
+  return mean > 0.0f ? 4.0f * mean : 1.0f;
+}
+
+
+/// @brief Get the bits of a non-negative float as an unsigned integer, which orders like the float.
+/// @private
+inline uint32_t _geod_float_bits(const float f) {
+  uint32_t u;
+  std::memcpy(&u, &f, sizeof(u));
+  return u;
+}
+
+
+/// @brief Get the float of bits from `_geod_float_bits`.
+/// @private
+inline float _geod_bits_float(const uint32_t u) {
+  float f;
+  std::memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+
+/// @brief Compute geodesic distances from the source vertices with parallel delta-stepping, into a workspace.
+/// @details This is a drop-in replacement for `geod_dijkstra` which uses all OpenMP threads for one search. Worth it for full or large bounded searches only, the rounds are synchronized with barriers.
+/// @param g the mesh graph, see `geod_graph`.
+/// @param sources the source vertices, at distance 0.
+/// @param num_sources the number of source vertices.
+/// @param max_dist the search stops at this distance, vertices at distance `>= max_dist` are not reached. Pass a negative value for no limit.
+/// @param delta the bucket width. Pass a value `<= 0` for `geod_delta_default(g)`.
+/// @param ws the workspace, see `GeodWorkspace`. It is reset before the search, and holds the results afterwards. Unlike for `geod_dijkstra`, `reached` is sorted by vertex index. The atomic distances are kept in the workspace, so repeated bounded searches cost time proportional to the vertices they reach, not to `nv`.
+/// @throws std::invalid_argument if a source vertex is out of range.
+inline void geod_delta_stepping(const GeodGraph& g, const int32_t* sources, const size_t num_sources, float max_dist, float delta, GeodWorkspace& ws) {
+  const size_t nv = g.num_vertices();
+  const size_t no_bin = size_t(-1);
+  if(ws.dist.size() != nv) {
+    ws = GeodWorkspace(nv);
+  }
+  ws.reset();
+  if(max_dist < 0.0f) {
+    max_dist = GEOD_UNREACHED;
+  }
+  if(delta <= 0.0f) {
+    delta = geod_delta_default(g);
+  }
+  const uint32_t unreached_bits = _geod_float_bits(GEOD_UNREACHED);
+  if(ws.dist_bits.size() != nv) {
+    std::vector<std::atomic<uint32_t>> bits(nv);
+    const int64_t nv_signed = int64_t(nv);
+    # pragma omp parallel for schedule(static)
+    for(int64_t v=0; v<nv_signed; v++) {
+      bits[v].store(unreached_bits, std::memory_order_relaxed);
+    }
+    ws.dist_bits.swap(bits);
+  }
+  // All entries are unreached here: `reset` restored the ones changed by the last search, which are all in `reached`.
+  std::vector<std::atomic<uint32_t>>& dist = ws.dist_bits;
+  std::vector<int32_t> frontier;
+  for(size_t i=0; i<num_sources; i++) {
+    const int32_t s = sources[i];
+    if(s < 0 || size_t(s) >= nv) {
+      throw std::invalid_argument("Source vertex " + std::to_string(s) + " is out of range for mesh with " + std::to_string(nv) + " vertices.\n");
+    }
+    if(dist[s].load(std::memory_order_relaxed) != 0) {
+      dist[s].store(0, std::memory_order_relaxed);
+      frontier.push_back(s);
+      ws.reached.push_back(s);
+    }
+  }
+
+  // The bucket of the frontier, the lowest non-empty bucket of any thread after a round, and the frontier sizes.
+  size_t curr_bin = frontier.empty() ? no_bin : 0;
+  size_t next_bin = no_bin;
+  int64_t frontier_size = int64_t(frontier.size());
+  std::atomic<int64_t> next_frontier_size(0);
+  const int64_t* offsets = g.csr.offsets.data();
+  const int32_t* adj = g.csr.adj.data();
+  const float* weights = g.weights.data();
+
+  # pragma omp parallel shared(dist, frontier, curr_bin, next_bin, frontier_size, next_frontier_size)
+  {
+    std::vector<std::vector<int32_t>> bins;  // Per thread, the vertices whose distance fell into each bucket.
+    std::vector<int32_t> my_reached;         // Per thread, the vertices it reached first.
+    while(curr_bin != no_bin) {
+      const size_t bin = curr_bin;
+      # pragma omp for schedule(dynamic, 64)
+      for(int64_t i=0; i<frontier_size; i++) {
+        const int32_t cur = frontier[i];
+        const float cur_dist = _geod_bits_float(dist[cur].load(std::memory_order_relaxed));
+        if(size_t(cur_dist / delta) < bin) {
+          continue;  // Outdated entry, the vertex got a shorter distance in an earlier bucket and was relaxed there.
+        }
+        for(int64_t k=offsets[cur]; k<offsets[cur+1]; k++) {
+          const float next_dist = cur_dist + weights[k];
+          if(!(next_dist < max_dist)) {
+            continue;
+          }
+          const uint32_t next_bits = _geod_float_bits(next_dist);
+          std::atomic<uint32_t>& target = dist[adj[k]];
+          uint32_t old_bits = target.load(std::memory_order_relaxed);
+          bool improved = false;
+          while(next_bits < old_bits && !(improved = target.compare_exchange_weak(old_bits, next_bits, std::memory_order_relaxed))) {}
+          if(improved) {
+            if(old_bits == unreached_bits) {
+              my_reached.push_back(adj[k]);  // Only one thread swaps out the unreached value, so each vertex is listed once.
+            }
+            const size_t next_bin_idx = size_t(next_dist / delta);
+            if(next_bin_idx >= bins.size()) {
+              bins.resize(next_bin_idx + 1);
+            }
+            bins[next_bin_idx].push_back(adj[k]);
+          }
+        }
+      }
+      // The implicit barrier of the loop ends the round. Vertices improved to the current bucket are relaxed again in the next one.
+      size_t my_next_bin = no_bin;
+      for(size_t b=bin; b<bins.size(); b++) {
+        if(! bins[b].empty()) {
+          my_next_bin = b;
+          break;
+        }
+      }
+      # pragma omp critical
+      {
+        next_bin = std::min(next_bin, my_next_bin);
+      }
+      # pragma omp barrier
+      const size_t new_bin = next_bin;
+      const bool contributes = new_bin != no_bin && new_bin < bins.size();
+      const int64_t my_offset = contributes ? next_frontier_size.fetch_add(int64_t(bins[new_bin].size())) : 0;
+      # pragma omp barrier
+      # pragma omp single
+      {
+        frontier_size = next_frontier_size.load();
+        if(size_t(frontier_size) > frontier.size()) {
+          frontier.resize(size_t(frontier_size));
+        }
+        next_frontier_size.store(0);
+        curr_bin = new_bin;
+        next_bin = no_bin;
+      }
+      if(contributes) {
+        std::copy(bins[new_bin].begin(), bins[new_bin].end(), frontier.begin() + my_offset);
+        bins[new_bin].clear();
+      }
+      # pragma omp barrier
+    }
+    # pragma omp critical
+    {
+      ws.reached.insert(ws.reached.end(), my_reached.begin(), my_reached.end());
+    }
+  }
+
+  // Sort the reached vertices. For searches which reach a large part of the mesh, a scan in index order is faster.
+  if(ws.reached.size() >= nv / 8) {
+    ws.reached.clear();
+    for(size_t v=0; v<nv; v++) {
+      if(dist[v].load(std::memory_order_relaxed) != unreached_bits) {
+        ws.reached.push_back(int32_t(v));
+      }
+    }
+  } else {
+    std::sort(ws.reached.begin(), ws.reached.end());
+  }
+  const int64_t num_reached = int64_t(ws.reached.size());
+  # pragma omp parallel for schedule(static)
+  for(int64_t i=0; i<num_reached; i++) {
+    const int32_t v = ws.reached[i];
+    ws.dist[v] = _geod_bits_float(dist[v].load(std::memory_order_relaxed));
+  }
+}
+
+
+/// @brief Pick the search backend for a number of independent searches: 'delta' if there are fewer searches than threads, 'dijkstra' otherwise.
+/// @details With at least one search per thread, the searches run in parallel, one Dijkstra search per thread, which does no redundant work. With fewer searches, the searches run one after the other and each uses all threads with delta-stepping.
+std::string geod_search_backend(const size_t num_searches) {
+  return num_searches < geod_num_threads() ? "delta" : "dijkstra";
+}
+
+
+/// @brief Compute geodesic distances from the source vertices with the given backend, into a workspace.
+/// @param backend 'dijkstra' for `geod_dijkstra` or 'delta' for `geod_delta_stepping` with the default delta. The results are identical.
+/// @throws std::invalid_argument if the backend is invalid or a source vertex is out of range.
+inline void geod_search(const GeodGraph& g, const int32_t* sources, const size_t num_sources, const float max_dist, GeodWorkspace& ws, const std::string& backend = "dijkstra") {
+  if(backend == "dijkstra") {
+    geod_dijkstra(g, sources, num_sources, max_dist, ws);
+  } else if(backend == "delta") {
+    geod_delta_stepping(g, sources, num_sources, max_dist, -1.0f, ws);
+  } else {
+    throw std::invalid_argument("Invalid search backend '" + backend + "', must be 'dijkstra' or 'delta'.\n");
+  }
+}
+
+
+/// @brief Compute geodesic distances from the source vertices to all vertices with parallel delta-stepping.
+/// @details Like `geodist`, with the same results, but using all OpenMP threads for the single search.
+/// @param delta the bucket width. Pass a value `<= 0` for `geod_delta_default(g)`.
+/// @return vector of length `nv`, the distance of each vertex. Vertices which were not reached get distance 0.
+std::vector<float> geodist_delta(const GeodGraph& g, const std::vector<int32_t>& source_verts, const float max_dist, const float delta = -1.0f) {
+  GeodWorkspace ws(g.num_vertices());
+  geod_delta_stepping(g, source_verts.data(), source_verts.size(), max_dist, delta, ws);
+  std::vector<float> geodists(g.num_vertices(), 0.0f);
+  for(size_t i=0; i<ws.reached.size(); i++) {
+    geodists[ws.reached[i]] = ws.dist[ws.reached[i]];
+  }
+  return geodists;
+}
@@ -0,0 +1,449 @@
+#pragma once
+
+#include "libfs.h"
+#include "mesh_view.h"
+#include "mesh_csr.h"
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+// Graph-based (pseudo-)geodesic distances on mesh views, without VCGLIB.
+//
+// The distances are shortest path lengths along the mesh edges, the same as computed by the VCGLIB function
+// `tri::Geodesic<MyMesh>::PerVertexDijkstraCompute` with the `EuclideanDistance` functor that the `geodist()`
+// function in `mesh_geodesic.h` uses, and the results are identical. The graph (CSR adjacency plus edge lengths) is
+// built once per mesh and is read-only, so one instance is shared by all threads. Each thread owns a `GeodWorkspace`,
+// which is reset in time proportional to the number of vertices the previous search reached, so many bounded searches
+// on a large mesh do not pay for the full mesh each time.
+
+
+/// Distance value used for vertices which were not reached by a search.
+const float GEOD_UNREACHED = std::numeric_limits<float>::max();
+
+
+/// @brief The edge graph of a mesh: vertex adjacency in CSR format plus the Euclidean length of each edge.
+struct GeodGraph {
+  MeshCSR csr;                 ///< The vertex adjacency.
+  std::vector<float> weights;  ///< The length of each edge, in the same order as `csr.adj`.
+
+  /// @brief Get the number of vertices.
+  size_t num_vertices() const {
+    return this->csr.num_vertices();
+  }
+};
+
+
+/// @brief Compute the edge lengths of a graph for the vertex coordinates of a mesh with the adjacency of the graph.
+/// @details This swaps in new coordinates for a mesh with the same faces, e.g., the pial instead of the white surface of a subject, without rebuilding the adjacency.
+/// @throws std::invalid_argument if the vertex count of the mesh and the graph differ.
+template<typename T, typename I>
+void geod_graph_set_coords(GeodGraph& g, const MeshView<T, I>& m) {
+  if(m.num_vertices() != g.num_vertices()) {
+    throw std::invalid_argument("Mesh with " + std::to_string(m.num_vertices()) + " vertices does not match graph with " + std::to_string(g.num_vertices()) + " vertices.\n");
+  }
+  g.weights.resize(g.csr.adj.size());
+  const int64_t nv_signed = int64_t(m.num_vertices());
+  # pragma omp parallel for schedule(static)
+  for(int64_t v=0; v<nv_signed; v++) {
+    for(int64_t k=g.csr.offsets[v]; k<g.csr.offsets[v+1]; k++) {
+      g.weights[k] = _vertex_dist(m, size_t(v), size_t(g.csr.adj[k]));
+    }
+  }
+}
+
+
+/// @brief Build the edge graph of a mesh, with edge lengths computed like the VCGLIB `EuclideanDistance` functor.
+template<typename T, typename I>
+GeodGraph geod_graph(const MeshView<T, I>& m) {
+  GeodGraph g;
+  g.csr = mesh_csr(m);
+  geod_graph_set_coords(g, m);
+  return g;
+}
+
+
+/// @brief Cache for the edge graph of meshes which share their faces, like the white, pial and inflated surfaces of a subject, or subjects resampled to a template.
+/// @details See `geod_graph_cached`. The cache holds a copy of the faces, so the meshes it was used with need not outlive it.
+struct GeodGraphCache {
+  GeodGraphCache() : num_builds(0), num_reuses(0) {}
+
+  std::vector<int32_t> faces;  ///< The faces of the mesh the adjacency of the graph was built for.
+  GeodGraph graph;             ///< The graph, with the edge lengths of the last mesh.
+  size_t num_builds;           ///< The number of meshes for which the adjacency was built.
+  size_t num_reuses;           ///< The number of meshes for which the adjacency was reused.
+};
+
+
+/// @brief Get the edge graph of a mesh, reusing the adjacency of the last mesh if both have the same faces.
+/// @details Comparing the faces takes one pass over the face array, much less than building the adjacency. Only the edge lengths are recomputed for a mesh with the same faces as the last one.
+/// @return the graph in the cache, valid until the next call.
+template<typename T>
+const GeodGraph& geod_graph_cached(GeodGraphCache& cache, const MeshView<T, int32_t>& m) {
+  const size_t num_indices = m.num_faces() * 3;
+  if(cache.num_builds > 0 && cache.graph.num_vertices() == m.num_vertices() && cache.faces.size() == num_indices && std::equal(cache.faces.begin(), cache.faces.end(), m.faces)) {
+    cache.num_reuses++;
+  } else {
+    cache.faces.assign(m.faces, m.faces + num_indices);
+    cache.graph.csr = mesh_csr(m);
+    cache.num_builds++;
+  }
+  geod_graph_set_coords(cache.graph, m);
+  return cache.graph;
+}
+
+
+/// @brief Get the lengths of all unique edges of a graph.
+/// @return vector of edge lengths, one per undirected edge, ordered by the lower and then the higher vertex index of the edge.
+std::vector<double> mesh_edge_lengths(const GeodGraph& g) {
+  std::vector<double> edgelength;
+  edgelength.reserve(g.csr.num_edges());
+  for(size_t v=0; v<g.num_vertices(); v++) {
+    for(int64_t k=g.csr.offsets[v]; k<g.csr.offsets[v+1]; k++) {
+      if(size_t(g.csr.adj[k]) > v) {
+        edgelength.push_back(g.weights[k]);
+      }
+    }
+  }
+  return edgelength;
+}
+
+
+/// @brief Compute the lengths of all unique edges of a mesh.
+/// @return vector of edge lengths, one per undirected edge, ordered by the lower and then the higher vertex index of the edge.
+template<typename T, typename I>
+std::vector<double> mesh_edge_lengths(const MeshView<T, I>& m) {
+  const MeshCSR csr = mesh_csr(m);
+  std::vector<double> edgelength;
+  edgelength.reserve(csr.num_edges());
+  for(size_t v=0; v<csr.num_vertices(); v++) {
+    for(const int32_t* n = csr.neighbors_begin(v); n != csr.neighbors_end(v); ++n) {
+      if(size_t(*n) > v) {
+        edgelength.push_back(_vertex_dist(m, v, size_t(*n)));
+      }
+    }
+  }
+  return edgelength;
+}
+
+
+/// @brief Per-thread work data for geodesic searches on a graph with a fixed vertex count.
+/// @details After a search, `dist` holds the distances of all reached vertices and `GEOD_UNREACHED` for all others, and `reached` lists the reached vertices in the order they were first reached.
+struct GeodWorkspace {
+  /// @brief Create a workspace for graphs with `num_vertices` vertices.
+  explicit GeodWorkspace(const size_t num_vertices = 0) : dist(num_vertices, GEOD_UNREACHED) {}
+
+  std::vector<float> dist;                        ///< Distance of each vertex from the sources of the last search.
+  std::vector<int32_t> reached;                   ///< The vertices reached by the last search.
+  std::vector<std::pair<float, int32_t>> heap;    ///< The priority queue, as a binary min-heap on the distance.
+  std::vector<uint8_t> state;                     ///< Per vertex, whether it is settled or needed, see `geod_dijkstra_faces`. Empty unless that function was used.
+  std::vector<std::atomic<uint32_t>> dist_bits;  ///< Per vertex, the bits of the distance for atomic updates, see `geod_delta_stepping`. Empty unless that function was used.
+
+  /// @brief Reset the distances of the vertices reached by the last search, in time proportional to their number.
+  void reset() {
+    const bool has_state = ! this->state.empty();
+    const bool has_dist_bits = ! this->dist_bits.empty();
+    const float unreached = GEOD_UNREACHED;
+    uint32_t unreached_bits;
+    std::memcpy(&unreached_bits, &unreached, sizeof(unreached_bits));
+    for(size_t i=0; i<this->reached.size(); i++) {
+      this->dist[this->reached[i]] = GEOD_UNREACHED;
+      if(has_state) {
+        this->state[this->reached[i]] = 0;
+      }
+      if(has_dist_bits) {
+        this->dist_bits[this->reached[i]].store(unreached_bits, std::memory_order_relaxed);
+      }
+    }
+    this->reached.clear();
+    this->heap.clear();
+  }
+};
+
+
+/// @brief Compute geodesic distances from the source vertices with Dijkstra's algorithm, into a workspace.
+/// @param g the mesh graph, see `geod_graph`.
+/// @param sources the source vertices, at distance 0.
+/// @param num_sources the number of source vertices.
+/// @param max_dist the search stops at this distance, vertices at distance `>= max_dist` are not reached. Pass a negative value for no limit.
+/// @param ws the workspace, see `GeodWorkspace`. It is reset before the search, and holds the results afterwards.
+/// @throws std::invalid_argument if a source vertex is out of range.
+inline void geod_dijkstra(const GeodGraph& g, const int32_t* sources, const size_t num_sources, float max_dist, GeodWorkspace& ws) {
+  typedef std::pair<float, int32_t> HeapEntry;
+  const size_t nv = g.num_vertices();
+  if(ws.dist.size() != nv) {
+    ws = GeodWorkspace(nv);
+  }
+  ws.reset();
+  if(max_dist < 0.0f) {
+    max_dist = GEOD_UNREACHED;
+  }
+  for(size_t i=0; i<num_sources; i++) {
+    const int32_t s = sources[i];
+    if(s < 0 || size_t(s) >= nv) {
+      throw std::invalid_argument("Source vertex " + std::to_string(s) + " is out of range for mesh with " + std::to_string(nv) + " vertices.\n");
+    }
+    if(ws.dist[s] != 0.0f) {
+      ws.dist[s] = 0.0f;
+      ws.reached.push_back(s);
+      ws.heap.push_back(HeapEntry(0.0f, s));
+    }
+  }
+  std::greater<HeapEntry> cmp;  // Turns the std max-heap functions into a min-heap.
+  std::make_heap(ws.heap.begin(), ws.heap.end(), cmp);
+  const int64_t* offsets = g.csr.offsets.data();
+  const int32_t* adj = g.csr.adj.data();
+  const float* weights = g.weights.data();
+  float* dist = ws.dist.data();
+  while(! ws.heap.empty()) {
+    std::pop_heap(ws.heap.begin(), ws.heap.end(), cmp);
+    const HeapEntry top = ws.heap.back();
+    ws.heap.pop_back();
+    const int32_t cur = top.second;
+    if(top.first > dist[cur]) {
+      continue;  // Outdated entry, the vertex was reached on a shorter path since it was pushed.
+    }
+    for(int64_t k=offsets[cur]; k<offsets[cur+1]; k++) {
+      const int32_t next = adj[k];
+      const float next_dist = top.first + weights[k];
+      if(next_dist < max_dist && next_dist < dist[next]) {
+        if(dist[next] == GEOD_UNREACHED) {
+          ws.reached.push_back(next);
+        }
+        dist[next] = next_dist;
+        ws.heap.push_back(HeapEntry(next_dist, next));
+        std::push_heap(ws.heap.begin(), ws.heap.end(), cmp);
+      }
+    }
+  }
+}
+
+
+/// @brief Compute geodesic distances with Dijkstra's algorithm until all faces crossing a radius have final vertex distances, into a workspace.
+/// @details Instead of a fixed bound with some slack for the faces at the radius, the search stops once all vertices at
+/// distance `< radius` and all of their neighbors are settled. In a triangle mesh, the neighbors of a vertex are the
+/// vertices of its faces, so every face with a vertex closer than the radius then has final distances at all of its
+/// vertices, and the results for such faces are bit-identical to the ones of an unbounded search. The search itself is
+/// the one of an unbounded search up to the point where it stops, so `reached` is a prefix of its `reached`. Vertices
+/// which were reached but not settled hold an upper bound of their distance, which is at least `radius`.
+/// @param g the mesh graph, see `geod_graph`.
+/// @param sources the source vertices, at distance 0.
+/// @param num_sources the number of source vertices.
+/// @param radius all faces with a vertex at distance `< radius` get final vertex distances.
+/// @param ws the workspace, see `GeodWorkspace`. It is reset before the search, and holds the results afterwards. If the heap is empty afterwards, the search settled all vertices it could reach.
+/// @return the number of vertices which were settled at distances `>= radius`, to complete the faces crossing the radius.
+/// @throws std::invalid_argument if a source vertex is out of range.
+inline size_t geod_dijkstra_faces(const GeodGraph& g, const int32_t* sources, const size_t num_sources, const float radius, GeodWorkspace& ws) {
+  typedef std::pair<float, int32_t> HeapEntry;
+  const uint8_t NEEDED = 1, SETTLED = 2;
+  const size_t nv = g.num_vertices();
+  if(ws.dist.size() != nv) {
+    ws = GeodWorkspace(nv);
+  }
+  if(ws.state.empty()) {
+    ws.state.assign(nv, 0);
+  }
+  ws.reset();
+  for(size_t i=0; i<num_sources; i++) {
+    const int32_t s = sources[i];
+    if(s < 0 || size_t(s) >= nv) {
+      throw std::invalid_argument("Source vertex " + std::to_string(s) + " is out of range for mesh with " + std::to_string(nv) + " vertices.\n");
+    }
+    if(ws.dist[s] != 0.0f) {
+      ws.dist[s] = 0.0f;
+      ws.reached.push_back(s);
+      ws.heap.push_back(HeapEntry(0.0f, s));
+    }
+  }
+  std::greater<HeapEntry> cmp;  // Turns the std max-heap functions into a min-heap.
+  std::make_heap(ws.heap.begin(), ws.heap.end(), cmp);
+  const int64_t* offsets = g.csr.offsets.data();
+  const int32_t* adj = g.csr.adj.data();
+  const float* weights = g.weights.data();
+  float* dist = ws.dist.data();
+  uint8_t* state = ws.state.data();
+  size_t num_pending = 0;  // The number of needed vertices which are not settled yet.
+  size_t num_beyond = 0;
+  while(! ws.heap.empty()) {
+    // All vertices closer than the radius are settled once the closest remaining entry is not.
+    if(num_pending == 0 && ws.heap.front().first >= radius) {
+      break;
+    }
+    std::pop_heap(ws.heap.begin(), ws.heap.end(), cmp);
+    const HeapEntry top = ws.heap.back();
+    ws.heap.pop_back();
+    const int32_t cur = top.second;
+    if(top.first > dist[cur]) {
+      continue;  // Outdated entry, the vertex was reached on a shorter path since it was pushed.
+    }
+    if(state[cur] == NEEDED) {
+      num_pending--;
+    }
+    state[cur] = SETTLED;
+    const bool inside = top.first < radius;
+    if(! inside) {
+      num_beyond++;
+    }
+    for(int64_t k=offsets[cur]; k<offsets[cur+1]; k++) {
+      const int32_t next = adj[k];
+      if(inside && state[next] == 0) {
+        state[next] = NEEDED;
+        num_pending++;
+      }
+      const float next_dist = top.first + weights[k];
+      if(next_dist < dist[next]) {
+        if(dist[next] == GEOD_UNREACHED) {
+          ws.reached.push_back(next);
+        }
+        dist[next] = next_dist;
+        ws.heap.push_back(HeapEntry(next_dist, next));
+        std::push_heap(ws.heap.begin(), ws.heap.end(), cmp);
+      }
+    }
+  }
+  return num_beyond;
+}
+
+
+/// @brief Compute geodesic distances from the source vertices to all vertices.
+/// @param g the mesh graph, see `geod_graph`.
+/// @param source_verts the source vertices.
+/// @param max_dist the search stops at this distance. Pass a negative value for no limit.
+/// @return vector of length `nv`, the distance of each vertex. Like the VCGLIB based `geodist()`, vertices which were not reached get distance 0.
+std::vector<float> geodist(const GeodGraph& g, const std::vector<int32_t>& source_verts, const float max_dist) {
+  GeodWorkspace ws(g.num_vertices());
+  geod_dijkstra(g, source_verts.data(), source_verts.size(), max_dist, ws);
+  std::vector<float> geodists(g.num_vertices(), 0.0f);
+  for(size_t i=0; i<ws.reached.size(); i++) {
+    geodists[ws.reached[i]] = ws.dist[ws.reached[i]];
+  }
+  return geodists;
+}
+
+
+/// @brief Compute geodesic distances from the source vertices to all vertices of a mesh view.
+/// @details This builds the mesh graph first. Use the overload for `GeodGraph` for more than one search on the same mesh.
+template<typename T, typename I>
+std::vector<float> geodist(const MeshView<T, I>& m, const std::vector<int32_t>& source_verts, const float max_dist) {
+  return geodist(geod_graph(m), source_verts, max_dist);
+}
+
+
+/// @brief Model a geodesic neighbor, i.e., vertex withing geodesic threshold distance.
+/// @details This currently does not hold any information on the source vertex, i.e., you will need to keep track of the vertex this neighbor belongs to.
+struct GeodNeighbor {
+  GeodNeighbor() : index(0), distance(0.0) {}
+  GeodNeighbor(size_t index, float distance) : index(index), distance(distance) {}
+  size_t index; ///< The index of the neighbor vertex.
+  float distance; ///< The geodesic distance to that neighbor.
+  std::vector<float> normals; // TODO: use this, compute with vcglib.
+};
+
+
+/// @brief Compute for each mesh vertex all vertices in a given distance (and that distance), parallel using OpenMP.
+/// @param m the mesh.
+/// @param max_dist the neighborhood radius. Vertices at distance `>= max_dist` are not part of the neighborhood.
+/// @param include_self whether to include the vertex itself, at distance 0.
+/// @return for each vertex, its neighbors sorted by vertex index.
+std::vector<std::vector<GeodNeighbor>> geod_neighborhood(const GeodGraph& g, const float max_dist = 5.0, const bool include_self = true) {
+  const int64_t nv = int64_t(g.num_vertices());
+  std::vector<std::vector<GeodNeighbor>> neighborhoods(nv);
+
+  # pragma omp parallel shared(g, neighborhoods)
+  {
+    GeodWorkspace ws(g.num_vertices());
+    std::vector<int32_t> found;
+    # pragma omp for schedule(dynamic, 64)
+    for(int64_t i=0; i<nv; i++) {
+      const int32_t source = int32_t(i);
+      geod_dijkstra(g, &source, 1, max_dist, ws);
+      found.clear();
+      for(size_t j=0; j<ws.reached.size(); j++) {
+        const int32_t v = ws.reached[j];
+        // Vertices at distance 0 other than the source itself (duplicated coordinates) are excluded, like unreached ones.
+        if((v == source && include_self) || (v != source && ws.dist[v] > 0.0f && ws.dist[v] <= max_dist)) {
+          found.push_back(v);
+        }
+      }
+      std::sort(found.begin(), found.end());
+      std::vector<GeodNeighbor>& neigh = neighborhoods[i];
+      neigh.reserve(found.size());
+      for(size_t j=0; j<found.size(); j++) {
+        neigh.push_back(GeodNeighbor(size_t(found[j]), found[j] == source ? 0.0f : ws.dist[found[j]]));
+      }
+    }
+  }
+  return neighborhoods;
+}
+
+
+/// @brief Compute for each mesh vertex all vertices in a given distance (and that distance), parallel using OpenMP.
+/// @details This builds the mesh graph first, see the overload for `GeodGraph`.
+template<typename T, typename I>
+std::vector<std::vector<GeodNeighbor>> geod_neighborhood(const MeshView<T, I>& m, const float max_dist = 5.0, const bool include_self = true) {
+  return geod_neighborhood(geod_graph(m), max_dist, include_self);
+}
+
+
+/// @brief Compute the mean geodesic distance of the source vertices to all vertices of the graph, parallel using OpenMP.
+/// @param sources the source vertices, or NULL to use all vertices.
+/// @param num_sources the number of source vertices.
+/// @param num_included the number of vertices to average over: the masked vertices are unreached and add nothing to the sum.
+/// @private
+std::vector<float> _mean_geodist_p(const GeodGraph& g, const int32_t* sources, const size_t num_sources, const size_t num_included) {
+  const int64_t ns = int64_t(num_sources);
+  const int64_t nv = int64_t(g.num_vertices());
+  std::vector<float> meandists(ns);
+
+  # pragma omp parallel shared(g, meandists)
+  {
+    GeodWorkspace ws(g.num_vertices());
+    # pragma omp for schedule(dynamic, 16)
+    for(int64_t i=0; i<ns; i++) {
+      const int32_t source = sources ? sources[i] : int32_t(i);
+      geod_dijkstra(g, &source, 1, -1.0f, ws);
+      double dist_sum = 0.0;
+      for(int64_t j=0; j<nv; j++) {
+        dist_sum += (ws.dist[j] == GEOD_UNREACHED) ? 0.0f : ws.dist[j];
+      }
+      meandists[i] = (float)(dist_sum / num_included);
+    }
+  }
+  return meandists;
+}
+
+
+/// @brief Compute for each mesh vertex the mean geodesic distance to all others, parallel using OpenMP.
+/// @details Vertices which cannot be reached from a vertex (other connected components) count with distance 0.
+template<typename T, typename I>
+std::vector<float> mean_geodist_p(const MeshView<T, I>& m) {
+  return _mean_geodist_p(geod_graph(m), NULL, m.num_vertices(), m.num_vertices());
+}
+
+
+/// @brief Compute mean geodesic distances on a graph, optionally for the included vertices of a mask only, parallel using OpenMP.
+/// @param g the graph of the mesh, or of the masked view of the mesh if a mask is given, see `geod_graph_cached` for reusing the adjacency for several meshes.
+/// @param mask the mask, or NULL for all vertices.
+/// @return vector with one value per vertex, or per included vertex in the order of `mask.vertices` if a mask is given.
+std::vector<float> mean_geodist_p(const GeodGraph& g, const MeshMask* mask = NULL) {
+  if(mask) {
+    return _mean_geodist_p(g, mask->vertices.data(), mask->num_vertices(), mask->num_vertices());
+  }
+  return _mean_geodist_p(g, NULL, g.num_vertices(), g.num_vertices());
+}
+
+
+/// @brief Compute for each included vertex of a mask the mean geodesic distance to all other included vertices, parallel using OpenMP.
+/// @details The paths run over the faces of the mask only, and the mean is over the included vertices, so the result equals the one for a submesh of the included vertices.
+/// @return vector with one value per included vertex, in the order of `mask.vertices`. See `mask_scatter` to map it to all mesh vertices.
+template<typename T>
+std::vector<float> mean_geodist_p(const MeshView<T, int32_t>& m, const MeshMask& mask) {
+  return mean_geodist_p(geod_graph(masked_view(m, mask)), &mask);
+}
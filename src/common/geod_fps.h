@@ -0,0 +1,132 @@
+#pragma once
+
+#include "mesh_view.h"
+#include "geod_engine.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+// Geodesic farthest-point sampling (FPS) of mesh vertices, for evenly spaced landmarks or patch centers.
+//
+// FPS repeatedly picks the vertex farthest away (along the mesh) from all points picked so far. Instead of recomputing
+// the distances to all points after each pick, the functions in here keep the field of distances to the nearest point,
+// and run a Dijkstra search from each new point directly on that field: the search only expands into vertices for which
+// it improves the field, so later searches get smaller and smaller. A lazy max-heap over the field gives the next point.
+// The field is identical to the one computed from scratch (minimum over the single-source distances of all points).
+
+
+/// @brief The result of a farthest-point sampling.
+struct GeodFPS {
+  std::vector<int32_t> points;  ///< The picked vertices, in the order they were picked.
+  std::vector<float> radius;    ///< For each step, the coverage radius after picking the point of that step: the maximal distance of any vertex to its nearest picked point. It is `GEOD_UNREACHED` while some connected components of the mesh contain no picked point.
+  std::vector<float> dist;      ///< For each vertex, the distance to its nearest picked point.
+};
+
+
+/// @brief Order for the max-heap over the distance field: larger distances first, then lower vertex indices.
+/// @private
+struct _FPSHeapLess {
+  bool operator()(const std::pair<float, int32_t>& a, const std::pair<float, int32_t>& b) const {
+    return a.first < b.first || (a.first == b.first && a.second > b.second);
+  }
+};
+
+
+/// @brief Compute a geodesic farthest-point sampling of the mesh vertices.
+/// @param g the mesh graph, see `geod_graph`.
+/// @param num_points the maximal number of points to pick. At most all vertices are picked.
+/// @param first_vertex the first point.
+/// @param min_radius stop as soon as the coverage radius is at or below this value, even if less than `num_points` points were picked. Pass 0 to always pick `num_points` points.
+/// @return the picked points, the coverage radius after each step, and the final distance field.
+/// @throws std::invalid_argument if `first_vertex` is out of range.
+GeodFPS geod_farthest_point_sampling(const GeodGraph& g, const size_t num_points, const int32_t first_vertex = 0, const float min_radius = 0.0f) {
+  typedef std::pair<float, int32_t> HeapEntry;
+  const size_t nv = g.num_vertices();
+  if(first_vertex < 0 || size_t(first_vertex) >= nv) {
+    throw std::invalid_argument("First vertex " + std::to_string(first_vertex) + " is out of range for mesh with " + std::to_string(nv) + " vertices.\n");
+  }
+  GeodFPS res;
+  res.dist.assign(nv, GEOD_UNREACHED);
+  float* field = res.dist.data();
+  const int64_t* offsets = g.csr.offsets.data();
+  const int32_t* adj = g.csr.adj.data();
+  const float* weights = g.weights.data();
+
+  // The max-heap holds an entry for each improvement of the field. Entries whose distance no longer matches the field are outdated and skipped.
+  _FPSHeapLess max_cmp;
+  std::vector<HeapEntry> max_heap;
+  max_heap.reserve(nv);
+  for(size_t v=0; v<nv; v++) {
+    max_heap.push_back(HeapEntry(GEOD_UNREACHED, int32_t(v)));
+  }
+  std::make_heap(max_heap.begin(), max_heap.end(), max_cmp);
+  std::greater<HeapEntry> min_cmp;
+  std::vector<HeapEntry> min_heap;  // The priority queue of the Dijkstra searches.
+
+  int32_t next_point = first_vertex;
+  const size_t max_points = std::min(num_points, nv);
+  while(res.points.size() < max_points) {
+    const int32_t p = next_point;
+    res.points.push_back(p);
+
+    // Dijkstra search from p on the field: only vertices which get closer to p than to all earlier points are updated and expanded.
+    field[p] = 0.0f;
+    max_heap.push_back(HeapEntry(0.0f, p));
+    std::push_heap(max_heap.begin(), max_heap.end(), max_cmp);
+    min_heap.clear();
+    min_heap.push_back(HeapEntry(0.0f, p));
+    while(! min_heap.empty()) {
+      std::pop_heap(min_heap.begin(), min_heap.end(), min_cmp);
+      const HeapEntry top = min_heap.back();
+      min_heap.pop_back();
+      const int32_t cur = top.second;
+      if(top.first > field[cur]) {
+        continue;
+      }
+      for(int64_t k=offsets[cur]; k<offsets[cur+1]; k++) {
+        const int32_t next = adj[k];
+        const float next_dist = top.first + weights[k];
+        if(next_dist < field[next]) {
+          field[next] = next_dist;
+          min_heap.push_back(HeapEntry(next_dist, next));
+          std::push_heap(min_heap.begin(), min_heap.end(), min_cmp);
+          max_heap.push_back(HeapEntry(next_dist, next));
+          std::push_heap(max_heap.begin(), max_heap.end(), max_cmp);
+        }
+      }
+    }
+
+    // Drop outdated entries from the top of the max-heap. Rebuild it from the field if it has grown too large.
+    if(max_heap.size() > 4 * nv) {
+      max_heap.clear();
+      for(size_t v=0; v<nv; v++) {
+        max_heap.push_back(HeapEntry(field[v], int32_t(v)));
+      }
+      std::make_heap(max_heap.begin(), max_heap.end(), max_cmp);
+    }
+    while(max_heap.front().first != field[max_heap.front().second]) {
+      std::pop_heap(max_heap.begin(), max_heap.end(), max_cmp);
+      max_heap.pop_back();
+    }
+    const float radius = max_heap.front().first;
+    res.radius.push_back(radius);
+    if(radius <= min_radius) {
+      break;
+    }
+    next_point = max_heap.front().second;
+  }
+  return res;
+}
+
+
+/// @brief Compute a geodesic farthest-point sampling of the vertices of a mesh view.
+/// @see The overload for `GeodGraph`, which this calls after building the graph.
+template<typename T, typename I>
+GeodFPS geod_farthest_point_sampling(const MeshView<T, I>& m, const size_t num_points, const int32_t first_vertex = 0, const float min_radius = 0.0f) {
+  return geod_farthest_point_sampling(geod_graph(m), num_points, first_vertex, min_radius);
+}
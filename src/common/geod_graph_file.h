@@ -0,0 +1,198 @@
+#pragma once
+
+#include "mesh_view.h"
+#include "mesh_csr.h"
+#include "geod_engine.h"
+#include "geod_cache.h"
+#include "bulk_endian.h"
+#include "mapped_file.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <utility>
+#include <stdexcept>
+
+// Persisted mesh graphs in `.geodgraph` sidecar files, so apps skip building the topology of a surface at startup.
+//
+// Building the vertex adjacency, the edge lengths, the face adjacency and the face areas of a surface costs the same
+// every time an app loads it. A sidecar file next to the mesh file, `<mesh_file>.geodgraph`, stores all of them
+// together with the content hash of the mesh they were built for (see `mesh_content_hash`). Apps load the sidecar if
+// it exists and its hash matches the mesh they read, and build the graph as before otherwise, so a stale sidecar of an
+// edited surface is never used. The `geodgraph` app pre-generates the sidecars for all subjects of a subjects dir.
+
+
+const int32_t GEOD_GRAPH_MAGIC = 0x47475231;  ///< Magic number at the start of graph sidecar files, 'GGR1' in ASCII.
+
+
+/// @brief The mesh graph and face topology stored in a graph sidecar file, see `geod_graph_sidecar`.
+struct GeodGraphSidecar {
+  uint64_t mesh_hash = 0;           ///< The content hash of the mesh, see `mesh_content_hash`.
+  GeodGraph graph;                  ///< The edge graph, see `geod_graph`.
+  std::vector<int32_t> face_adj;    ///< The face adjacency, see `mesh_face_adjacency`.
+  std::vector<double> face_areas;   ///< The area of each face, see `mesh_area_per_face`.
+
+  /// @brief Get the number of faces.
+  size_t num_faces() const {
+    return this->face_areas.size();
+  }
+};
+
+
+/// @brief Get the file name of the graph sidecar of a mesh file.
+std::string geod_graph_sidecar_filename(const std::string& mesh_file) {
+  return mesh_file + ".geodgraph";
+}
+
+
+/// @brief Compute the graph, face adjacency and face areas of a mesh for a sidecar file.
+template<typename T, typename I>
+GeodGraphSidecar geod_graph_sidecar(const MeshView<T, I>& m) {
+  GeodGraphSidecar sc;
+  sc.mesh_hash = mesh_content_hash(m);
+  sc.graph = geod_graph(m);
+  sc.face_adj = mesh_face_adjacency(m);
+  sc.face_areas = mesh_area_per_face(m);
+  return sc;
+}
+
+
+/// @brief Write a graph sidecar file, in big endian byte order.
+/// @details Layout: int32 magic `GEOD_GRAPH_MAGIC`, int32 number of vertices nv, int32 number of faces nf, int64 number
+/// of adjacency entries na, uint64 mesh hash, (nv + 1) int64 CSR offsets, na int32 CSR neighbors, na float edge
+/// lengths, 3 * nf int32 face adjacency, nf double face areas. The file is written under a unique temporary name and
+/// renamed, so concurrent runs never read a partly written file.
+/// @throws std::runtime_error if the file cannot be written.
+void write_geod_graph_sidecar(const std::string& filename, const GeodGraphSidecar& sc) {
+  const std::string tmp_filename = geod_tmp_filename(filename);
+  {
+    std::ofstream os(tmp_filename, std::ofstream::out | std::ofstream::binary);
+    if(! os.is_open()) {
+      throw std::runtime_error("Unable to open graph sidecar file '" + tmp_filename + "' for writing.\n");
+    }
+    const int32_t num_vertices = int32_t(sc.graph.num_vertices());
+    const int32_t num_faces = int32_t(sc.num_faces());
+    const int64_t num_adj = int64_t(sc.graph.csr.adj.size());
+    write_big_endian(os, &GEOD_GRAPH_MAGIC, 1);
+    write_big_endian(os, &num_vertices, 1);
+    write_big_endian(os, &num_faces, 1);
+    write_big_endian(os, &num_adj, 1);
+    write_big_endian(os, &sc.mesh_hash, 1);
+    write_big_endian(os, sc.graph.csr.offsets.data(), sc.graph.csr.offsets.size());
+    write_big_endian(os, sc.graph.csr.adj.data(), sc.graph.csr.adj.size());
+    write_big_endian(os, sc.graph.weights.data(), sc.graph.weights.size());
+    write_big_endian(os, sc.face_adj.data(), sc.face_adj.size());
+    write_big_endian(os, sc.face_areas.data(), sc.face_areas.size());
+    if(! os.good()) {
+      throw std::runtime_error("Failed to write graph sidecar file '" + tmp_filename + "'.\n");
+    }
+  }
+  if(std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+    throw std::runtime_error("Failed to rename graph sidecar file '" + tmp_filename + "' to '" + filename + "'.\n");
+  }
+}
+
+
+/// @brief Read a graph sidecar file written by `write_geod_graph_sidecar`, using a memory mapping.
+/// @param mesh_hash the content hash of the mesh the sidecar must have been built for, see `mesh_content_hash`.
+/// @param sc set to the sidecar contents if they were read.
+/// @return whether the file exists, is valid and matches the hash. Invalid files count as stale, so apps build the graph instead.
+bool read_geod_graph_sidecar(const std::string& filename, const uint64_t mesh_hash, GeodGraphSidecar& sc) {
+  std::ifstream probe(filename);
+  if(! probe.good()) {
+    return false;
+  }
+  probe.close();
+  MappedFile mf(filename);
+  const char* buf = mf.data();
+  const size_t size = mf.size();
+  const size_t header_size = 28;
+  if(size < header_size) {
+    return false;
+  }
+  int32_t magic, num_vertices, num_faces;
+  int64_t num_adj;
+  uint64_t file_hash;
+  copy_big_endian_to_host(&magic, buf, 1);
+  copy_big_endian_to_host(&num_vertices, buf + 4, 1);
+  copy_big_endian_to_host(&num_faces, buf + 8, 1);
+  copy_big_endian_to_host(&num_adj, buf + 12, 1);
+  copy_big_endian_to_host(&file_hash, buf + 20, 1);
+  if(magic != GEOD_GRAPH_MAGIC || file_hash != mesh_hash || num_vertices < 0 || num_faces < 0 || num_adj < 0) {
+    return false;
+  }
+  const size_t nv = size_t(num_vertices), nf = size_t(num_faces), na = size_t(num_adj);
+  if(size != header_size + (nv + 1) * sizeof(int64_t) + na * (sizeof(int32_t) + sizeof(float)) + nf * (3 * sizeof(int32_t) + sizeof(double))) {
+    return false;
+  }
+  const char* pos = buf + header_size;
+  sc.mesh_hash = file_hash;
+  MeshCSR& csr = sc.graph.csr;
+  csr.offsets.resize(nv + 1);
+  copy_big_endian_to_host(csr.offsets.data(), pos, csr.offsets.size());
+  pos += csr.offsets.size() * sizeof(int64_t);
+  csr.adj.resize(na);
+  copy_big_endian_to_host(csr.adj.data(), pos, csr.adj.size());
+  pos += csr.adj.size() * sizeof(int32_t);
+  sc.graph.weights.resize(na);
+  copy_big_endian_to_host(sc.graph.weights.data(), pos, sc.graph.weights.size());
+  pos += sc.graph.weights.size() * sizeof(float);
+  sc.face_adj.resize(nf * 3);
+  copy_big_endian_to_host(sc.face_adj.data(), pos, sc.face_adj.size());
+  pos += sc.face_adj.size() * sizeof(int32_t);
+  sc.face_areas.resize(nf);
+  copy_big_endian_to_host(sc.face_areas.data(), pos, sc.face_areas.size());
+
+  // The searches index with these without checks, so a damaged file must not get through.
+  if(csr.offsets[0] != 0 || csr.offsets[nv] != num_adj) {
+    return false;
+  }
+  for(size_t v=0; v<nv; v++) {
+    if(csr.offsets[v+1] < csr.offsets[v]) {
+      return false;
+    }
+  }
+  for(size_t k=0; k<na; k++) {
+    if(csr.adj[k] < 0 || size_t(csr.adj[k]) >= nv) {
+      return false;
+    }
+  }
+  for(size_t k=0; k<nf * 3; k++) {
+    if(sc.face_adj[k] < -1 || sc.face_adj[k] >= num_faces) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/// @brief Read the graph sidecar of a mesh file, if it matches the mesh.
+/// @param mesh_file the file the mesh was read from. Its sidecar is `geod_graph_sidecar_filename(mesh_file)`.
+/// @param m the mesh read from the file.
+/// @param sc set to the sidecar contents if they were read.
+/// @return whether the sidecar exists, is valid and was built for the mesh.
+template<typename T, typename I>
+bool read_geod_graph_sidecar_for(const std::string& mesh_file, const MeshView<T, I>& m, GeodGraphSidecar& sc) {
+  return read_geod_graph_sidecar(geod_graph_sidecar_filename(mesh_file), mesh_content_hash(m), sc) && sc.graph.num_vertices() == m.num_vertices() && sc.num_faces() == m.num_faces();
+}
+
+
+/// @brief Get the edge graph of a mesh read from a file, from its graph sidecar if that matches the mesh.
+/// @param mesh_file the file the mesh was read from. Its sidecar is `geod_graph_sidecar_filename(mesh_file)`.
+/// @param m the mesh read from the file.
+/// @param hit if not NULL, set to whether the graph was read from the sidecar.
+/// @return the graph, identical to `geod_graph(m)`.
+template<typename T, typename I>
+GeodGraph geod_graph_from_sidecar(const std::string& mesh_file, const MeshView<T, I>& m, bool* hit = NULL) {
+  GeodGraphSidecar sc;
+  const bool found = read_geod_graph_sidecar_for(mesh_file, m, sc);
+  if(hit) {
+    *hit = found;
+  }
+  if(! found) {
+    return geod_graph(m);
+  }
+  return std::move(sc.graph);
+}
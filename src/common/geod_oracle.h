@@ -0,0 +1,349 @@
+#pragma once
+
+#include "mesh_view.h"
+#include "geod_engine.h"
+#include "geod_fps.h"
+#include "geod_delta.h"
+#include "geod_astar.h"
+#include "bulk_endian.h"
+#include "mapped_file.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cmath>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+// Landmark-based geodesic distance oracle, for answering many vertex-pair distance queries without a search per pair.
+//
+// The oracle stores the full distance fields of a few landmark vertices, quantized to 16 bit. For any two vertices u
+// and v, the triangle inequality gives max_l |d(u,l) - d(v,l)| <= d(u,v) <= min_l (d(u,l) + d(v,l)), which takes
+// O(L) operations for L landmarks. The fields are stored per vertex, so a query reads two contiguous rows, and the
+// bound loop works on integers only, which compilers vectorize. Pairs with too loose bounds can be refined with an
+// exact search bounded by the upper bound. Landmarks picked by farthest-point sampling give tight bounds everywhere.
+
+
+const uint16_t GEOD_ORACLE_UNREACHED = 65535;  ///< Quantized distance of vertices not reached from a landmark.
+const int32_t GEOD_ORACLE_MAX_CODE = 32767;    ///< Largest quantized distance of reached vertices. Keeping it below half of `GEOD_ORACLE_UNREACHED` lets the bound loop detect unreached vertices without branches.
+const int32_t GEOD_ORACLE_MAGIC = 0x474f5231;  ///< Magic number at the start of oracle files, 'GOR1' in ASCII.
+
+
+/// @brief A landmark distance oracle, see `geod_oracle_build`.
+struct GeodOracle {
+  int32_t num_vertices = 0;        ///< The number of mesh vertices.
+  int64_t num_edges = 0;           ///< The number of directed edges of the mesh graph, used to detect oracles built for another mesh.
+  float scale = 1.0f;              ///< The distance represented by one unit of the quantized distances.
+  std::vector<int32_t> landmarks;  ///< The landmark vertices.
+  std::vector<uint16_t> qdist;     ///< The quantized distances, vertex-major: `qdist[v * num_landmarks() + l]` is the distance of vertex v to landmark l divided by `scale` and rounded, or `GEOD_ORACLE_UNREACHED`.
+
+  /// @brief Get the number of landmarks.
+  size_t num_landmarks() const {
+    return this->landmarks.size();
+  }
+};
+
+
+/// @brief Lower and upper bound for a geodesic distance. Both are `GEOD_UNREACHED` for vertices in different connected components, and the upper bound is `GEOD_UNREACHED` if no landmark reaches both vertices.
+struct GeodBounds {
+  float lower;
+  float upper;
+};
+
+
+/// @brief Build a landmark distance oracle from the given landmarks, with one full Dijkstra search per landmark.
+/// @param g the mesh graph, see `geod_graph`.
+/// @param landmarks the landmark vertices, must not be empty.
+/// @return the oracle. The searches run in parallel with OpenMP, the result does not depend on the number of threads.
+/// @throws std::invalid_argument if there are no landmarks or a landmark is out of range.
+GeodOracle geod_oracle_build(const GeodGraph& g, const std::vector<int32_t>& landmarks) {
+  const size_t nv = g.num_vertices();
+  const size_t nl = landmarks.size();
+  if(nl == 0) {
+    throw std::invalid_argument("Need at least one landmark to build a distance oracle.\n");
+  }
+  for(size_t l=0; l<nl; l++) {
+    if(landmarks[l] < 0 || size_t(landmarks[l]) >= nv) {
+      throw std::invalid_argument("Landmark vertex " + std::to_string(landmarks[l]) + " is out of range for mesh with " + std::to_string(nv) + " vertices.\n");
+    }
+  }
+  GeodOracle oracle;
+  oracle.num_vertices = int32_t(nv);
+  oracle.num_edges = int64_t(g.csr.adj.size());
+  oracle.landmarks = landmarks;
+
+  // Compute the full fields first, the quantization step depends on the largest distance over all of them.
+  // With fewer landmarks than threads, the searches run one after the other with all threads each, see `geod_search_backend`.
+  std::vector<float> fields(nv * nl);
+  std::vector<float> max_dists(nl, 0.0f);
+  const int64_t nl_signed = int64_t(nl);
+  const bool parallel_searches = geod_search_backend(nl) == "dijkstra";
+  # pragma omp parallel shared(fields, max_dists) if(parallel_searches)
+  {
+    GeodWorkspace ws(nv);
+    # pragma omp for schedule(dynamic, 1)
+    for(int64_t l=0; l<nl_signed; l++) {
+      geod_search(g, &landmarks[l], 1, -1.0f, ws, parallel_searches ? "dijkstra" : "delta");
+      for(size_t v=0; v<nv; v++) {
+        const float d = ws.dist[v];
+        fields[v * nl + size_t(l)] = d;
+        if(d != GEOD_UNREACHED && d > max_dists[l]) {
+          max_dists[l] = d;
+        }
+      }
+    }
+  }
+  const float max_dist = *std::max_element(max_dists.begin(), max_dists.end());
+  oracle.scale = max_dist > 0.0f ? max_dist / float(GEOD_ORACLE_MAX_CODE) : 1.0f;
+  oracle.qdist.resize(nv * nl);
+  for(size_t i=0; i<fields.size(); i++) {
+    const float d = fields[i];
+    oracle.qdist[i] = (d == GEOD_UNREACHED) ? GEOD_ORACLE_UNREACHED : uint16_t(std::min(int32_t(std::lround(d / oracle.scale)), GEOD_ORACLE_MAX_CODE));
+  }
+  return oracle;
+}
+
+
+/// @brief Build a landmark distance oracle with landmarks picked by geodesic farthest-point sampling.
+/// @param num_landmarks the number of landmarks. A few dozen give tight bounds on brain meshes.
+/// @param first_vertex the first landmark, see `geod_farthest_point_sampling`.
+/// @see The overload with explicit landmarks.
+GeodOracle geod_oracle_build(const GeodGraph& g, const size_t num_landmarks, const int32_t first_vertex = 0) {
+  return geod_oracle_build(g, geod_farthest_point_sampling(g, num_landmarks, first_vertex).points);
+}
+
+
+/// @brief Check that an oracle was built for a mesh graph with the same vertex and edge count.
+/// @throws std::invalid_argument if it was not.
+void geod_oracle_check(const GeodOracle& oracle, const GeodGraph& g) {
+  if(size_t(oracle.num_vertices) != g.num_vertices() || oracle.num_edges != int64_t(g.csr.adj.size())) {
+    throw std::invalid_argument("Distance oracle was built for a mesh with " + std::to_string(oracle.num_vertices) + " vertices and " + std::to_string(oracle.num_edges) + " edges, but the mesh has " + std::to_string(g.num_vertices()) + " vertices and " + std::to_string(g.csr.adj.size()) + " edges.\n");
+  }
+}
+
+
+/// @brief Compute the quantized triangle inequality bounds from two rows of the oracle.
+/// @details Branch-free integer loop, vectorized by the compiler. A difference above `GEOD_ORACLE_MAX_CODE` means that a landmark reaches one vertex but not the other, and a sum of at least `GEOD_ORACLE_UNREACHED` that a landmark does not reach both.
+/// @private
+inline void _geod_oracle_bounds_q(const uint16_t* a, const uint16_t* b, const size_t nl, int32_t& lo, int32_t& hi) {
+  int32_t max_diff = 0;
+  int32_t min_sum = 2 * int32_t(GEOD_ORACLE_UNREACHED);
+  for(size_t l=0; l<nl; l++) {
+    const int32_t x = a[l];
+    const int32_t y = b[l];
+    const int32_t diff = x > y ? x - y : y - x;
+    const int32_t sum = x + y;
+    max_diff = diff > max_diff ? diff : max_diff;
+    min_sum = sum < min_sum ? sum : min_sum;
+  }
+  lo = max_diff;
+  hi = min_sum;
+}
+
+
+/// @brief Check that the vertices of a pair are valid for the oracle.
+/// @throws std::invalid_argument if a vertex is out of range.
+/// @private
+inline void _geod_oracle_check_pair(const GeodOracle& oracle, const int32_t u, const int32_t v) {
+  if(u < 0 || u >= oracle.num_vertices || v < 0 || v >= oracle.num_vertices) {
+    throw std::invalid_argument("Vertex pair (" + std::to_string(u) + ", " + std::to_string(v) + ") is out of range for oracle with " + std::to_string(oracle.num_vertices) + " vertices.\n");
+  }
+}
+
+
+/// @brief Get lower and upper bounds for the geodesic distance between two vertices from the oracle, in O(L) for L landmarks.
+/// @details The bounds include the quantization error, up to the float rounding of the landmark searches. They are 0 for `u == v`.
+/// @throws std::invalid_argument if a vertex is out of range.
+GeodBounds geod_oracle_bounds(const GeodOracle& oracle, const int32_t u, const int32_t v) {
+  _geod_oracle_check_pair(oracle, u, v);
+  GeodBounds b;
+  if(u == v) {
+    b.lower = b.upper = 0.0f;
+    return b;
+  }
+  const size_t nl = oracle.num_landmarks();
+  int32_t lo, hi;
+  _geod_oracle_bounds_q(&oracle.qdist[size_t(u) * nl], &oracle.qdist[size_t(v) * nl], nl, lo, hi);
+  if(lo > GEOD_ORACLE_MAX_CODE) {
+    b.lower = b.upper = GEOD_UNREACHED;
+    return b;
+  }
+  // Each stored distance is off by at most half a unit, so differences and sums by at most one unit.
+  b.lower = float(std::max(lo - 1, 0)) * oracle.scale;
+  b.upper = (hi >= int32_t(GEOD_ORACLE_UNREACHED)) ? GEOD_UNREACHED : float(hi + 1) * oracle.scale;
+  return b;
+}
+
+
+/// @brief Get distance bounds for many vertex pairs, see the single pair version.
+/// @param u the first vertex of each pair.
+/// @param v the second vertex of each pair, same length as `u`.
+/// @return the bounds for each pair. The pairs are processed in parallel with OpenMP.
+/// @throws std::invalid_argument if the lengths differ or a vertex is out of range.
+std::vector<GeodBounds> geod_oracle_bounds(const GeodOracle& oracle, const std::vector<int32_t>& u, const std::vector<int32_t>& v) {
+  if(u.size() != v.size()) {
+    throw std::invalid_argument("Need the same number of first and second vertices, got " + std::to_string(u.size()) + " and " + std::to_string(v.size()) + ".\n");
+  }
+  for(size_t i=0; i<u.size(); i++) {
+    _geod_oracle_check_pair(oracle, u[i], v[i]);  // Exceptions must not leave the parallel region below.
+  }
+  std::vector<GeodBounds> bounds(u.size());
+  const int64_t num_pairs = int64_t(u.size());
+  # pragma omp parallel for schedule(static) shared(bounds)
+  for(int64_t i=0; i<num_pairs; i++) {
+    bounds[i] = geod_oracle_bounds(oracle, u[i], v[i]);
+  }
+  return bounds;
+}
+
+
+/// @brief Answer the vertex pairs with tight enough bounds from the oracle, and list the pairs to refine by exact searches.
+/// @param bounds set to the bounds of each pair.
+/// @param dist set to the distance of each pair answered from the oracle.
+/// @return the first vertex and the index of all pairs to refine, see `geod_oracle_distances`.
+/// @private
+std::vector<std::pair<int32_t, size_t>> _geod_oracle_triage(const GeodOracle& oracle, const GeodGraph& g, const std::vector<int32_t>& u, const std::vector<int32_t>& v, const float max_gap, std::vector<GeodBounds>& bounds, std::vector<float>& dist) {
+  geod_oracle_check(oracle, g);
+  bounds = geod_oracle_bounds(oracle, u, v);
+  const size_t num_pairs = bounds.size();
+  dist.resize(num_pairs);
+  std::vector<std::pair<int32_t, size_t>> refine;
+  for(size_t i=0; i<num_pairs; i++) {
+    const GeodBounds& b = bounds[i];
+    if(b.lower == GEOD_UNREACHED) {
+      dist[i] = GEOD_UNREACHED;
+    } else if(max_gap >= 0.0f && b.upper - b.lower > max_gap) {
+      refine.push_back(std::pair<int32_t, size_t>(u[i], i));
+    } else {
+      dist[i] = (b.upper == GEOD_UNREACHED) ? GEOD_UNREACHED : 0.5f * (b.lower + b.upper);
+    }
+  }
+  return refine;
+}
+
+
+/// @brief Get geodesic distances for many vertex pairs from the oracle, refining pairs with loose bounds by exact searches.
+/// @param oracle the oracle, built for `g`.
+/// @param g the mesh graph, see `geod_graph`.
+/// @param u the first vertex of each pair.
+/// @param v the second vertex of each pair, same length as `u`.
+/// @param max_gap pairs whose bounds differ by at most this are answered from the oracle with the mean of the bounds, which is off by at most `max_gap / 2`. Other pairs get the exact distance from a Dijkstra search bounded by the upper bound, with one search per distinct first vertex. Pass 0 to get exact distances for all pairs, and a negative value to never search, in which case pairs without upper bound get `GEOD_UNREACHED`.
+/// @return the distance for each pair, `GEOD_UNREACHED` for pairs in different connected components.
+/// @throws std::invalid_argument if the oracle does not match the graph, the lengths differ or a vertex is out of range.
+std::vector<float> geod_oracle_distances(const GeodOracle& oracle, const GeodGraph& g, const std::vector<int32_t>& u, const std::vector<int32_t>& v, const float max_gap) {
+  std::vector<GeodBounds> bounds;
+  std::vector<float> dist;
+  std::vector<std::pair<int32_t, size_t>> refine = _geod_oracle_triage(oracle, g, u, v, max_gap, bounds, dist);
+  if(refine.empty()) {
+    return dist;
+  }
+
+  // Group the pairs to refine by their first vertex, and answer each group from a single bounded search.
+  std::sort(refine.begin(), refine.end());
+  std::vector<size_t> group_start;
+  for(size_t j=0; j<refine.size(); j++) {
+    if(j == 0 || refine[j].first != refine[j-1].first) {
+      group_start.push_back(j);
+    }
+  }
+  group_start.push_back(refine.size());
+  const int64_t num_groups = int64_t(group_start.size()) - 1;
+  # pragma omp parallel shared(dist)
+  {
+    GeodWorkspace ws(g.num_vertices());
+    # pragma omp for schedule(dynamic, 1)
+    for(int64_t k=0; k<num_groups; k++) {
+      float bound = 0.0f;
+      for(size_t j=group_start[k]; j<group_start[k+1]; j++) {
+        bound = std::max(bound, bounds[refine[j].second].upper);
+      }
+      // The upper bounds hold up to float rounding, so search a little farther. Unbounded if a pair has no upper bound.
+      const float search_dist = (bound == GEOD_UNREACHED) ? -1.0f : bound * 1.001f + oracle.scale;
+      const int32_t source = refine[group_start[k]].first;
+      geod_dijkstra(g, &source, 1, search_dist, ws);
+      for(size_t j=group_start[k]; j<group_start[k+1]; j++) {
+        const size_t i = refine[j].second;
+        dist[i] = ws.dist[v[i]];
+      }
+    }
+  }
+  return dist;
+}
+
+
+/// @brief Get geodesic distances for many vertex pairs from the oracle, refining pairs with loose bounds by point-to-point searches.
+/// @details Like the overload without mesh, but each pair to refine gets its own A* or bidirectional A* search, see `geod_shortest_path`. These settle a small fraction of the vertices a Dijkstra search bounded by the upper bound settles, so this is faster unless many pairs share their first vertex.
+/// @param m the mesh `g` was built from, for the straight-line distances of the searches.
+/// @param method the point-to-point search method: 'astar', 'bidir' or 'dijkstra'.
+/// @throws std::invalid_argument if the oracle does not match the graph, the lengths differ, a vertex is out of range or the method is invalid.
+template<typename T, typename I>
+std::vector<float> geod_oracle_distances(const GeodOracle& oracle, const GeodGraph& g, const MeshView<T, I>& m, const std::vector<int32_t>& u, const std::vector<int32_t>& v, const float max_gap, const std::string& method) {
+  std::vector<GeodBounds> bounds;
+  std::vector<float> dist;
+  const std::vector<std::pair<int32_t, size_t>> refine = _geod_oracle_triage(oracle, g, u, v, max_gap, bounds, dist);
+  std::vector<int32_t> refine_u(refine.size()), refine_v(refine.size());
+  for(size_t j=0; j<refine.size(); j++) {
+    refine_u[j] = refine[j].first;
+    refine_v[j] = v[refine[j].second];
+  }
+  const std::vector<float> refined = geod_pair_distances(g, m, refine_u, refine_v, method);
+  for(size_t j=0; j<refine.size(); j++) {
+    dist[refine[j].second] = refined[j];
+  }
+  return dist;
+}
+
+
+/// @brief Write a distance oracle to a sidecar file, in big endian byte order.
+/// @details Layout: int32 magic `GEOD_ORACLE_MAGIC`, int32 number of vertices, int64 number of edges, float scale, int32 number of landmarks L, L int32 landmark vertices, then the uint16 quantized distances, vertex-major.
+/// @throws std::runtime_error if the file cannot be written.
+void write_geod_oracle(const std::string& filename, const GeodOracle& oracle) {
+  std::ofstream os(filename, std::ofstream::out | std::ofstream::binary);
+  if(! os.is_open()) {
+    throw std::runtime_error("Unable to open distance oracle file '" + filename + "' for writing.\n");
+  }
+  const int32_t num_landmarks = int32_t(oracle.num_landmarks());
+  write_big_endian(os, &GEOD_ORACLE_MAGIC, 1);
+  write_big_endian(os, &oracle.num_vertices, 1);
+  write_big_endian(os, &oracle.num_edges, 1);
+  write_big_endian(os, &oracle.scale, 1);
+  write_big_endian(os, &num_landmarks, 1);
+  write_big_endian(os, oracle.landmarks.data(), oracle.landmarks.size());
+  write_big_endian(os, oracle.qdist.data(), oracle.qdist.size());
+  if(! os.good()) {
+    throw std::runtime_error("Failed to write distance oracle file '" + filename + "'.\n");
+  }
+}
+
+
+/// @brief Read a distance oracle from a sidecar file written by `write_geod_oracle`, using a memory mapping.
+/// @throws std::runtime_error if the file cannot be opened, std::domain_error if the magic number mismatches or the file is truncated.
+GeodOracle read_geod_oracle(const std::string& filename) {
+  MappedFile mf(filename);
+  const char* buf = mf.data();
+  const size_t size = mf.size();
+  const size_t header_size = 24;
+  int32_t magic = 0;
+  if(size >= header_size) {
+    copy_big_endian_to_host(&magic, buf, 1);
+  }
+  if(magic != GEOD_ORACLE_MAGIC) {
+    throw std::domain_error("Distance oracle file '" + filename + "' magic code in header did not match: expected " + std::to_string(GEOD_ORACLE_MAGIC) + ".\n");
+  }
+  GeodOracle oracle;
+  int32_t num_landmarks;
+  copy_big_endian_to_host(&oracle.num_vertices, buf + 4, 1);
+  copy_big_endian_to_host(&oracle.num_edges, buf + 8, 1);
+  copy_big_endian_to_host(&oracle.scale, buf + 16, 1);
+  copy_big_endian_to_host(&num_landmarks, buf + 20, 1);
+  if(oracle.num_vertices < 0 || num_landmarks < 0 || size != header_size + size_t(num_landmarks) * sizeof(int32_t) + size_t(oracle.num_vertices) * size_t(num_landmarks) * sizeof(uint16_t)) {
+    throw std::domain_error("Distance oracle file '" + filename + "' is truncated or has an invalid header.\n");
+  }
+  oracle.landmarks.resize(num_landmarks);
+  copy_big_endian_to_host(oracle.landmarks.data(), buf + header_size, oracle.landmarks.size());
+  oracle.qdist.resize(size_t(oracle.num_vertices) * size_t(num_landmarks));
+  copy_big_endian_to_host(oracle.qdist.data(), buf + header_size + size_t(num_landmarks) * sizeof(int32_t), oracle.qdist.size());
+  return oracle;
+}
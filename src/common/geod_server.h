@@ -0,0 +1,563 @@
+#pragma once
+
+#include "libfs.h"
+#include "mesh_view.h"
+#include "mesh_csr.h"
+#include "geod_engine.h"
+#include "geod_astar.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <poll.h>
+#endif
+
+// A geodesic query server, which keeps meshes, their graphs and per-thread search workspaces in memory and answers
+// distance field, neighborhood, k-ring and path requests over a Unix domain socket.
+//
+// Protocol: each message, in both directions, is a uint32 payload length followed by the payload. All values are in
+// host byte order, as the socket is local. A request payload starts with the uint32 operation (`GeodServerOp`) and the
+// uint32 mesh index (ignored by INFO, STATS and SHUTDOWN), followed by the operation arguments:
+//   DIST     : float max_dist (negative for no limit), uint32 n, n x int32 source vertices.
+//   NEIGH    : int32 vertex, float max_dist.
+//   KRING    : int32 vertex, uint32 k.
+//   PATH     : int32 source, int32 target.
+// A response payload starts with an int32 status, 0 for success. On errors, a uint32 length and the error message
+// follow. On success, the results follow:
+//   INFO     : uint32 number of meshes, then per mesh uint32 num_vertices, uint32 num_faces, uint32 name length, name.
+//   DIST     : uint32 nv, nv x float distance (`GEOD_UNREACHED` for unreached vertices).
+//   NEIGH    : uint32 n, n x int32 vertices within max_dist (ascending, including the vertex itself), n x float distance.
+//   KRING    : uint32 n, n x int32 vertices in edge distance 1 to k, ordered by ring.
+//   PATH     : float length (`GEOD_UNREACHED` if not connected), uint32 n, n x int32 path vertices from source to target.
+//   STATS    : uint32 number of operations, uint32 number of buckets, then the uint64 request counts of the latency
+//              histogram of each operation. Bucket b counts requests served in [2^b, 2^(b+1)) microseconds (b=0: < 2).
+//   SHUTDOWN : nothing. The server stops accepting connections and exits once all open requests are answered.
+
+
+/// @brief The operations supported by the geodesic query server.
+enum GeodServerOp {
+  GEOD_OP_INFO = 0,
+  GEOD_OP_DIST = 1,
+  GEOD_OP_NEIGH = 2,
+  GEOD_OP_KRING = 3,
+  GEOD_OP_PATH = 4,
+  GEOD_OP_STATS = 5,
+  GEOD_OP_SHUTDOWN = 6,
+  GEOD_OP_COUNT = 7
+};
+
+const size_t GEOD_LATENCY_BUCKETS = 32;               ///< The number of buckets of the latency histograms.
+const uint32_t GEOD_SERVER_MAX_MESSAGE = 256u << 20;  ///< Longer messages are rejected, so a broken client cannot make the server allocate arbitrary memory.
+
+
+/// @brief Appends values to a binary message buffer, in host byte order.
+struct GeodMessageWriter {
+  std::vector<char> buf;  ///< The message payload.
+
+  /// @brief Append a single value.
+  template<typename T>
+  void put(const T& value) {
+    this->put_array(&value, 1);
+  }
+
+  /// @brief Append `n` values.
+  template<typename T>
+  void put_array(const T* values, const size_t n) {
+    const size_t pos = this->buf.size();
+    this->buf.resize(pos + n * sizeof(T));
+    if(n > 0) {
+      std::memcpy(this->buf.data() + pos, values, n * sizeof(T));
+    }
+  }
+};
+
+
+/// @brief Reads values from a binary message buffer, in host byte order.
+struct GeodMessageReader {
+  /// @brief Read from the `size` bytes at `data`, which must stay valid while reading.
+  GeodMessageReader(const char* data, const size_t size) : data(data), size(size), pos(0) {}
+
+  const char* data;
+  size_t size;
+  size_t pos;  ///< The number of bytes read so far.
+
+  /// @brief Read a single value.
+  /// @throws std::invalid_argument if the message is too short.
+  template<typename T>
+  T get() {
+    T value;
+    this->get_array(&value, 1);
+    return value;
+  }
+
+  /// @brief Read `n` values into `values`.
+  /// @throws std::invalid_argument if the message is too short.
+  template<typename T>
+  void get_array(T* values, const size_t n) {
+    if(n > (this->size - this->pos) / sizeof(T)) {
+      throw std::invalid_argument("Message is truncated: expected " + std::to_string(n * sizeof(T)) + " more bytes at position " + std::to_string(this->pos) + ", message has " + std::to_string(this->size) + ".\n");
+    }
+    if(n > 0) {
+      std::memcpy(values, this->data + this->pos, n * sizeof(T));
+    }
+    this->pos += n * sizeof(T);
+  }
+
+  /// @brief Read `n` values into a new vector, checking the length before allocating it.
+  /// @throws std::invalid_argument if the message is too short.
+  template<typename T>
+  std::vector<T> get_vector(const size_t n) {
+    if(n > (this->size - this->pos) / sizeof(T)) {
+      throw std::invalid_argument("Message is truncated: expected " + std::to_string(n) + " values at position " + std::to_string(this->pos) + ", message has " + std::to_string(this->size) + " bytes.\n");
+    }
+    std::vector<T> values(n);
+    this->get_array(values.data(), n);
+    return values;
+  }
+};
+
+
+/// @brief A mesh served by the geodesic query server.
+struct GeodServerMesh {
+  std::string name;             ///< The name of the mesh, typically the file it was loaded from.
+  size_t num_faces;             ///< The number of faces of the mesh.
+  GeodGraph graph;              ///< The edge graph, which also holds the adjacency used for k-rings.
+  std::vector<float> vertices;  ///< The vertex coordinates, for the straight-line distances of the A* path searches.
+
+  /// @brief Get a view of the vertex coordinates, without faces, see `geod_shortest_path`.
+  MeshView<float, int32_t> vertex_view() const {
+    return MeshView<float, int32_t>(this->vertices.data(), this->vertices.size() / 3, NULL, 0);
+  }
+};
+
+
+/// @brief State of the geodesic query server shared by all worker threads: the meshes and the latency statistics.
+struct GeodServer {
+  GeodServer() : stop_requested(false) {
+    for(size_t op=0; op<GEOD_OP_COUNT; op++) {
+      for(size_t b=0; b<GEOD_LATENCY_BUCKETS; b++) {
+        this->latency_counts[op][b] = 0;
+      }
+    }
+  }
+
+  std::vector<GeodServerMesh> meshes;                                        ///< The served meshes. Must not be changed while serving.
+  std::atomic<uint64_t> latency_counts[GEOD_OP_COUNT][GEOD_LATENCY_BUCKETS];  ///< The latency histogram of each operation, see the protocol description.
+  std::atomic<bool> stop_requested;                                          ///< Set by a SHUTDOWN request.
+
+  /// @brief Load a mesh for serving. Its index is the number of meshes added before it.
+  void add_mesh(const std::string& name, const fs::Mesh& mesh) {
+    this->add_mesh(name, mesh, geod_graph(mesh_view(mesh)));
+  }
+
+  /// @brief Load a mesh with its prebuilt graph for serving, e.g., one read from a graph sidecar file.
+  void add_mesh(const std::string& name, const fs::Mesh& mesh, const GeodGraph& graph) {
+    GeodServerMesh sm;
+    sm.name = name;
+    sm.num_faces = mesh.num_faces();
+    sm.graph = graph;
+    sm.vertices = mesh.vertices;
+    this->meshes.push_back(sm);
+  }
+};
+
+
+/// @brief Per-thread work data of the geodesic query server, kept between requests.
+struct GeodServerSession {
+  std::vector<GeodWorkspace> ws;                 ///< One search workspace per mesh.
+  std::vector<GeodPathWorkspace> path_ws;        ///< One point-to-point search workspace per mesh, see `geod_shortest_path`.
+  std::vector<std::vector<int32_t>> kring_mark;  ///< One k-ring work array per mesh, see `_csr_kring_single`.
+  std::vector<int32_t> kring_stamp;              ///< The stamp of the last k-ring search, per mesh.
+};
+
+
+/// @brief Check that a vertex index is valid for the mesh.
+/// @private
+inline void _geod_server_check_vertex(const GeodServerMesh& m, const int32_t v) {
+  if(v < 0 || size_t(v) >= m.graph.num_vertices()) {
+    throw std::invalid_argument("Vertex " + std::to_string(v) + " is out of range for mesh '" + m.name + "' with " + std::to_string(m.graph.num_vertices()) + " vertices.\n");
+  }
+}
+
+
+/// @brief Answer a single request of the geodesic query server.
+/// @param server the server state.
+/// @param session the work data of the calling thread.
+/// @param request the request payload, see the protocol description.
+/// @param request_size the length of the request payload in bytes.
+/// @return the response payload. Errors in the request are reported in the response, this does not throw for them.
+std::vector<char> geod_server_handle(GeodServer& server, GeodServerSession& session, const char* request, const size_t request_size) {
+  std::chrono::time_point<std::chrono::steady_clock> t_start = std::chrono::steady_clock::now();
+  GeodMessageWriter out;
+  out.put<int32_t>(0);
+  uint32_t op = GEOD_OP_COUNT;
+  try {
+    GeodMessageReader in(request, request_size);
+    op = in.get<uint32_t>();
+    const uint32_t mesh_idx = in.get<uint32_t>();
+    if(op >= GEOD_OP_COUNT) {
+      throw std::invalid_argument("Unknown operation " + std::to_string(op) + ".\n");
+    }
+    const bool needs_mesh = (op == GEOD_OP_DIST || op == GEOD_OP_NEIGH || op == GEOD_OP_KRING || op == GEOD_OP_PATH);
+    if(needs_mesh && mesh_idx >= server.meshes.size()) {
+      throw std::invalid_argument("Mesh index " + std::to_string(mesh_idx) + " is out of range, serving " + std::to_string(server.meshes.size()) + " meshes.\n");
+    }
+    if(session.ws.size() != server.meshes.size()) {
+      session.ws.resize(server.meshes.size());
+      session.path_ws.resize(server.meshes.size());
+      session.kring_mark.resize(server.meshes.size());
+      session.kring_stamp.resize(server.meshes.size());
+    }
+
+    if(op == GEOD_OP_INFO) {
+      out.put<uint32_t>(uint32_t(server.meshes.size()));
+      for(size_t i=0; i<server.meshes.size(); i++) {
+        const GeodServerMesh& m = server.meshes[i];
+        out.put<uint32_t>(uint32_t(m.graph.num_vertices()));
+        out.put<uint32_t>(uint32_t(m.num_faces));
+        out.put<uint32_t>(uint32_t(m.name.size()));
+        out.put_array(m.name.data(), m.name.size());
+      }
+    } else if(op == GEOD_OP_DIST) {
+      const GeodServerMesh& m = server.meshes[mesh_idx];
+      const float max_dist = in.get<float>();
+      const std::vector<int32_t> sources = in.get_vector<int32_t>(in.get<uint32_t>());
+      GeodWorkspace& ws = session.ws[mesh_idx];
+      geod_dijkstra(m.graph, sources.data(), sources.size(), max_dist, ws);
+      out.put<uint32_t>(uint32_t(ws.dist.size()));
+      out.put_array(ws.dist.data(), ws.dist.size());
+    } else if(op == GEOD_OP_NEIGH) {
+      const GeodServerMesh& m = server.meshes[mesh_idx];
+      const int32_t v = in.get<int32_t>();
+      const float max_dist = in.get<float>();
+      _geod_server_check_vertex(m, v);
+      GeodWorkspace& ws = session.ws[mesh_idx];
+      geod_dijkstra(m.graph, &v, 1, max_dist, ws);
+      std::vector<int32_t> neigh = ws.reached;
+      std::sort(neigh.begin(), neigh.end());
+      std::vector<float> neigh_dist(neigh.size());
+      for(size_t i=0; i<neigh.size(); i++) {
+        neigh_dist[i] = ws.dist[neigh[i]];
+      }
+      out.put<uint32_t>(uint32_t(neigh.size()));
+      out.put_array(neigh.data(), neigh.size());
+      out.put_array(neigh_dist.data(), neigh_dist.size());
+    } else if(op == GEOD_OP_KRING) {
+      const GeodServerMesh& m = server.meshes[mesh_idx];
+      const int32_t v = in.get<int32_t>();
+      const uint32_t k = in.get<uint32_t>();
+      _geod_server_check_vertex(m, v);
+      if(k < 1) {
+        throw std::invalid_argument("The k of k-ring requests must be at least 1.\n");
+      }
+      std::vector<int32_t>& mark = session.kring_mark[mesh_idx];
+      int32_t& stamp = session.kring_stamp[mesh_idx];
+      if(mark.size() != m.graph.num_vertices() || stamp == INT32_MAX) {
+        mark.assign(m.graph.num_vertices(), -1);
+        stamp = 0;
+      }
+      std::vector<int32_t> neigh;
+      _csr_kring_single(m.graph.csr, v, k, mark, ++stamp, neigh);
+      out.put<uint32_t>(uint32_t(neigh.size()));
+      out.put_array(neigh.data(), neigh.size());
+    } else if(op == GEOD_OP_PATH) {
+      const GeodServerMesh& m = server.meshes[mesh_idx];
+      const int32_t source = in.get<int32_t>();
+      const int32_t target = in.get<int32_t>();
+      _geod_server_check_vertex(m, source);
+      _geod_server_check_vertex(m, target);
+      // An A* search towards the target settles a fraction of the vertices a full search would.
+      const GeodPath path = geod_shortest_path(m.graph, m.vertex_view(), source, target, "astar", &session.path_ws[mesh_idx]);
+      out.put<float>(path.length);
+      out.put<uint32_t>(uint32_t(path.vertices.size()));
+      out.put_array(path.vertices.data(), path.vertices.size());
+    } else if(op == GEOD_OP_STATS) {
+      out.put<uint32_t>(uint32_t(GEOD_OP_COUNT));
+      out.put<uint32_t>(uint32_t(GEOD_LATENCY_BUCKETS));
+      for(size_t o=0; o<GEOD_OP_COUNT; o++) {
+        for(size_t b=0; b<GEOD_LATENCY_BUCKETS; b++) {
+          out.put<uint64_t>(server.latency_counts[o][b].load());
+        }
+      }
+    } else if(op == GEOD_OP_SHUTDOWN) {
+      server.stop_requested = true;
+    }
+  } catch(const std::exception& e) {
+    const std::string msg = e.what();
+    out.buf.clear();
+    out.put<int32_t>(1);
+    out.put<uint32_t>(uint32_t(msg.size()));
+    out.put_array(msg.data(), msg.size());
+  }
+  if(op < GEOD_OP_COUNT) {
+    const int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t_start).count();
+    size_t bucket = 0;
+    while(bucket + 1 < GEOD_LATENCY_BUCKETS && (int64_t(2) << bucket) <= us) {
+      bucket++;
+    }
+    server.latency_counts[op][bucket]++;
+  }
+  return out.buf;
+}
+
+
+#ifndef _WIN32
+
+/// @brief Read exactly `n` bytes from a socket.
+/// @return false if the peer closed the connection before all bytes were read.
+/// @private
+inline bool _geod_socket_read(const int fd, char* dst, const size_t n) {
+  size_t done = 0;
+  while(done < n) {
+    const ssize_t r = read(fd, dst + done, n - done);
+    if(r <= 0) {
+      return false;
+    }
+    done += size_t(r);
+  }
+  return true;
+}
+
+
+/// @brief Write exactly `n` bytes to a socket.
+/// @return false if the connection failed.
+/// @private
+inline bool _geod_socket_write(const int fd, const char* src, const size_t n) {
+  size_t done = 0;
+  while(done < n) {
+    const ssize_t w = write(fd, src + done, n - done);
+    if(w <= 0) {
+      return false;
+    }
+    done += size_t(w);
+  }
+  return true;
+}
+
+
+/// @brief Send a message, prefixed with its length.
+/// @return false if the connection failed.
+/// @private
+inline bool _geod_socket_send_message(const int fd, const std::vector<char>& payload) {
+  const uint32_t len = uint32_t(payload.size());
+  return _geod_socket_write(fd, reinterpret_cast<const char*>(&len), sizeof(len)) && _geod_socket_write(fd, payload.data(), payload.size());
+}
+
+
+/// @brief Answer the next request on a client connection, which has data to read.
+/// @param request work buffer for the request payload.
+/// @return whether the connection is still open. It is not if the client closed it or does not speak our protocol.
+/// @private
+inline bool _geod_server_request(GeodServer& server, GeodServerSession& session, const int fd, std::vector<char>& request) {
+  uint32_t len;
+  if(! _geod_socket_read(fd, reinterpret_cast<char*>(&len), sizeof(len)) || len > GEOD_SERVER_MAX_MESSAGE) {
+    return false;
+  }
+  request.resize(len);
+  if(! _geod_socket_read(fd, request.data(), len)) {
+    return false;
+  }
+  return _geod_socket_send_message(fd, geod_server_handle(server, session, request.data(), request.size()));
+}
+
+
+/// @brief Serve requests on a Unix domain socket until a SHUTDOWN request arrives.
+/// @details A fixed pool of worker threads answers the requests, each with its own warm `GeodServerSession`. The
+/// calling thread accepts the connections and watches all open ones, and queues a connection for the workers whenever
+/// a request arrives on it. A worker answers that single request and hands the connection back, so clients may stay
+/// connected between requests without holding a worker, and any request, e.g., STATS or SHUTDOWN, waits for a free
+/// worker only.
+/// @param server the server state, with all meshes added.
+/// @param socket_path the path of the socket file. An existing file at that path is replaced.
+/// @param num_threads the number of worker threads.
+/// @throws std::runtime_error if the socket cannot be created.
+void geod_server_run(GeodServer& server, const std::string& socket_path, const size_t num_threads) {
+  struct sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if(socket_path.size() >= sizeof(addr.sun_path)) {
+    throw std::runtime_error("Socket path '" + socket_path + "' is too long.\n");
+  }
+  std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+  const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(listen_fd < 0) {
+    throw std::runtime_error("Could not create socket.\n");
+  }
+  unlink(socket_path.c_str());
+  if(bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listen_fd, 64) != 0) {
+    close(listen_fd);
+    throw std::runtime_error("Could not bind or listen on socket '" + socket_path + "'.\n");
+  }
+  int wake_pipe[2];  // The workers write to it when they hand back a connection, to wake up the accepting thread.
+  if(pipe(wake_pipe) != 0) {
+    close(listen_fd);
+    unlink(socket_path.c_str());
+    throw std::runtime_error("Could not create the wake-up pipe of the server.\n");
+  }
+
+  std::mutex queue_mutex;
+  std::condition_variable queue_cv;
+  std::deque<int> queue;      // Connections with a request waiting for a worker. -1 tells a worker to exit.
+  std::vector<int> returned;  // Connections whose request was answered, to be watched again.
+  std::vector<std::thread> workers;
+  for(size_t t=0; t<std::max(num_threads, size_t(1)); t++) {
+    workers.push_back(std::thread([&server, &queue_mutex, &queue_cv, &queue, &returned, &wake_pipe]() {
+      GeodServerSession session;
+      std::vector<char> request;
+      while(true) {
+        int fd;
+        {
+          std::unique_lock<std::mutex> lock(queue_mutex);
+          queue_cv.wait(lock, [&queue]() { return ! queue.empty(); });
+          fd = queue.front();
+          queue.pop_front();
+        }
+        if(fd < 0) {
+          return;
+        }
+        if(! _geod_server_request(server, session, fd, request)) {
+          close(fd);
+          continue;
+        }
+        {
+          std::lock_guard<std::mutex> lock(queue_mutex);
+          returned.push_back(fd);
+        }
+        const char wake = 0;
+        const ssize_t w = write(wake_pipe[1], &wake, 1);  // If this fails, the connection is picked up after the poll timeout.
+        (void)w;
+      }
+    }));
+  }
+
+  std::vector<int> idle;  // Open connections without a pending request.
+  std::vector<struct pollfd> pfds;
+  while(! server.stop_requested.load()) {
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex);
+      idle.insert(idle.end(), returned.begin(), returned.end());
+      returned.clear();
+    }
+    pfds.resize(2 + idle.size());
+    pfds[0].fd = listen_fd;
+    pfds[1].fd = wake_pipe[0];
+    for(size_t i=0; i<idle.size(); i++) {
+      pfds[2 + i].fd = idle[i];
+    }
+    for(size_t i=0; i<pfds.size(); i++) {
+      pfds[i].events = POLLIN;
+      pfds[i].revents = 0;
+    }
+    if(poll(pfds.data(), pfds.size(), 100) <= 0) {
+      continue;
+    }
+    if(pfds[1].revents != 0) {
+      char drain[256];
+      const ssize_t r = read(wake_pipe[0], drain, sizeof(drain));
+      (void)r;
+    }
+    // A connection with a request, or one the client closed, goes to a worker, which answers or closes it.
+    size_t num_idle = 0, num_queued = 0;
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex);
+      for(size_t i=0; i<idle.size(); i++) {
+        if(pfds[2 + i].revents != 0) {
+          queue.push_back(idle[i]);
+          num_queued++;
+        } else {
+          idle[num_idle++] = idle[i];
+        }
+      }
+    }
+    idle.resize(num_idle);
+    if(num_queued > 0) {
+      queue_cv.notify_all();
+    }
+    if(pfds[0].revents != 0) {
+      const int fd = accept(listen_fd, NULL, NULL);
+      if(fd >= 0) {
+        idle.push_back(fd);
+      }
+    }
+  }
+
+  close(listen_fd);
+  unlink(socket_path.c_str());
+  for(size_t i=0; i<idle.size(); i++) {
+    close(idle[i]);
+  }
+  {
+    // The queued requests are answered before the workers exit.
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    for(size_t t=0; t<workers.size(); t++) {
+      queue.push_back(-1);
+    }
+    queue_cv.notify_all();
+  }
+  for(size_t t=0; t<workers.size(); t++) {
+    workers[t].join();
+  }
+  for(size_t i=0; i<returned.size(); i++) {
+    close(returned[i]);
+  }
+  close(wake_pipe[0]);
+  close(wake_pipe[1]);
+}
+
+
+/// @brief Connect to a geodesic query server.
+/// @return the socket file descriptor, to be used with `geod_client_call` and closed with `close`.
+/// @throws std::runtime_error if the connection fails.
+int geod_client_connect(const std::string& socket_path) {
+  struct sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if(socket_path.size() >= sizeof(addr.sun_path)) {
+    throw std::runtime_error("Socket path '" + socket_path + "' is too long.\n");
+  }
+  std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd < 0 || connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+    if(fd >= 0) {
+      close(fd);
+    }
+    throw std::runtime_error("Could not connect to socket '" + socket_path + "'.\n");
+  }
+  return fd;
+}
+
+
+/// @brief Send a request to a geodesic query server and wait for the response.
+/// @param fd the connection, see `geod_client_connect`.
+/// @param request the request payload, see the protocol description.
+/// @return the response payload, starting with the status.
+/// @throws std::runtime_error if the connection fails.
+std::vector<char> geod_client_call(const int fd, const std::vector<char>& request) {
+  uint32_t len;
+  if(! _geod_socket_send_message(fd, request) || ! _geod_socket_read(fd, reinterpret_cast<char*>(&len), sizeof(len))) {
+    throw std::runtime_error("Connection to geodesic query server failed.\n");
+  }
+  std::vector<char> response(len);
+  if(! _geod_socket_read(fd, response.data(), len)) {
+    throw std::runtime_error("Connection to geodesic query server failed.\n");
+  }
+  return response;
+}
+
+#endif
@@ -0,0 +1,325 @@
+#pragma once
+
+#include "geod_engine.h"
+#include "bulk_endian.h"
+#include "mapped_file.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+// Shortest-path trees from a single propagation, for the paths from one source to many targets.
+//
+// A search from a source implicitly computes the shortest paths to all vertices it reaches: each vertex got its final
+// distance from one neighbor, its parent. Storing the parent of each vertex next to its distance, 8 bytes per vertex,
+// keeps all of these paths, and the path to any target is read by following the parents back to the source, without
+// another search. `geod_tree` builds the tree with the graph engine, `geod_tree` in `mesh_geodesic.h` converts the
+// parent output of the VCGLIB `PerVertexDijkstraCompute`, and the geodpath app exports the trees of the
+// third_party/geodesic algorithms. `geod_tree_paths` reconstructs the paths to a whole target set at once.
+
+
+const int32_t GEOD_TREE_MAGIC = 0x47545231;  ///< Magic number at the start of shortest-path tree files, 'GTR1' in ASCII.
+
+
+/// @brief A shortest-path tree: the distance and the parent of each vertex, see `geod_tree`.
+struct GeodTree {
+  std::vector<float> dist;      ///< The distance of each vertex from the sources, `GEOD_UNREACHED` for vertices which were not reached.
+  std::vector<int32_t> parent;  ///< The vertex before each vertex on its shortest path, -1 for the sources and the vertices which were not reached.
+
+  /// @brief Get the number of vertices.
+  size_t num_vertices() const {
+    return this->dist.size();
+  }
+
+  /// @brief Whether vertex v was reached by the search.
+  bool reached(const size_t v) const {
+    return this->dist[v] != GEOD_UNREACHED;
+  }
+};
+
+
+/// @brief Shortest paths to many targets in CSR format, see `geod_tree_paths`.
+struct GeodTreePaths {
+  std::vector<int64_t> offsets;   ///< Length `num_paths + 1`, the path to target i is `vertices[offsets[i]]` to `vertices[offsets[i+1]-1]`.
+  std::vector<int32_t> vertices;  ///< The vertices of all paths, each from its source to its target, concatenated. Paths to vertices which were not reached are empty.
+
+  /// @brief Get the number of paths.
+  size_t num_paths() const {
+    return this->offsets.empty() ? 0 : this->offsets.size() - 1;
+  }
+
+  /// @brief Get the path to target i, from its source to the target.
+  std::vector<int32_t> path(const size_t i) const {
+    return std::vector<int32_t>(this->vertices.begin() + this->offsets[i], this->vertices.begin() + this->offsets[i+1]);
+  }
+};
+
+
+/// @brief Compute geodesic distances and the shortest-path tree from the source vertices with Dijkstra's algorithm, into a workspace.
+/// @details This is `geod_dijkstra`, which also records the parent of each vertex. The distances are identical.
+/// @param parent pointer to `nv` entries. Set to the parent of each reached vertex, and to -1 for the sources. The entries of other vertices are not changed.
+/// @throws std::invalid_argument if a source vertex is out of range.
+inline void geod_dijkstra_tree(const GeodGraph& g, const int32_t* sources, const size_t num_sources, float max_dist, GeodWorkspace& ws, int32_t* parent) {
+  typedef std::pair<float, int32_t> HeapEntry;
+  const size_t nv = g.num_vertices();
+  if(ws.dist.size() != nv) {
+    ws = GeodWorkspace(nv);
+  }
+  ws.reset();
+  if(max_dist < 0.0f) {
+    max_dist = GEOD_UNREACHED;
+  }
+  for(size_t i=0; i<num_sources; i++) {
+    const int32_t s = sources[i];
+    if(s < 0 || size_t(s) >= nv) {
+      throw std::invalid_argument("Source vertex " + std::to_string(s) + " is out of range for mesh with " + std::to_string(nv) + " vertices.\n");
+    }
+    if(ws.dist[s] != 0.0f) {
+      ws.dist[s] = 0.0f;
+      parent[s] = -1;
+      ws.reached.push_back(s);
+      ws.heap.push_back(HeapEntry(0.0f, s));
+    }
+  }
+  std::greater<HeapEntry> cmp;  // Turns the std max-heap functions into a min-heap.
+  std::make_heap(ws.heap.begin(), ws.heap.end(), cmp);
+  const int64_t* offsets = g.csr.offsets.data();
+  const int32_t* adj = g.csr.adj.data();
+  const float* weights = g.weights.data();
+  float* dist = ws.dist.data();
+  while(! ws.heap.empty()) {
+    std::pop_heap(ws.heap.begin(), ws.heap.end(), cmp);
+    const HeapEntry top = ws.heap.back();
+    ws.heap.pop_back();
+    const int32_t cur = top.second;
+    if(top.first > dist[cur]) {
+      continue;  // Outdated entry, the vertex was reached on a shorter path since it was pushed.
+    }
+    for(int64_t k=offsets[cur]; k<offsets[cur+1]; k++) {
+      const int32_t next = adj[k];
+      const float next_dist = top.first + weights[k];
+      if(next_dist < max_dist && next_dist < dist[next]) {
+        if(dist[next] == GEOD_UNREACHED) {
+          ws.reached.push_back(next);
+        }
+        dist[next] = next_dist;
+        parent[next] = cur;
+        ws.heap.push_back(HeapEntry(next_dist, next));
+        std::push_heap(ws.heap.begin(), ws.heap.end(), cmp);
+      }
+    }
+  }
+}
+
+
+/// @brief Compute the shortest-path tree from the source vertices.
+/// @param g the mesh graph, see `geod_graph`.
+/// @param source_verts the source vertices.
+/// @param max_dist the search stops at this distance, so the tree only covers the region closer than it. Pass a negative value for no limit.
+/// @return the tree. Its distances are the ones of `geodist`, except that vertices which were not reached get `GEOD_UNREACHED`.
+/// @throws std::invalid_argument if a source vertex is out of range.
+GeodTree geod_tree(const GeodGraph& g, const std::vector<int32_t>& source_verts, const float max_dist) {
+  GeodWorkspace ws(g.num_vertices());
+  GeodTree tree;
+  tree.parent.assign(g.num_vertices(), -1);
+  geod_dijkstra_tree(g, source_verts.data(), source_verts.size(), max_dist, ws, tree.parent.data());
+  tree.dist.swap(ws.dist);
+  return tree;
+}
+
+
+/// @brief Check that a tree is valid: matching lengths, parents in range and only for reached vertices.
+/// @throws std::domain_error if the tree is invalid.
+/// @private
+inline void _geod_tree_check(const GeodTree& tree) {
+  const size_t nv = tree.num_vertices();
+  if(tree.parent.size() != nv) {
+    throw std::domain_error("Shortest-path tree has " + std::to_string(tree.parent.size()) + " parents for " + std::to_string(nv) + " vertices.\n");
+  }
+  for(size_t v=0; v<nv; v++) {
+    const int32_t p = tree.parent[v];
+    if(p != -1 && (p < 0 || size_t(p) >= nv || ! tree.reached(v) || ! tree.reached(size_t(p)))) {
+      throw std::domain_error("Shortest-path tree has invalid parent " + std::to_string(p) + " for vertex " + std::to_string(v) + ".\n");
+    }
+  }
+}
+
+
+/// @brief Mark the vertices whose parents do not lead to a source as not reached.
+/// @details Trees from algorithms which could not trace back the paths of some vertices, e.g., the exact algorithm of
+/// `geodpath` on degenerate meshes, hold such vertices: their paths run through a vertex which was not reached. After
+/// pruning, all paths of the tree end at a source, so `geod_tree_paths` and `read_geod_tree` accept it. Each vertex is
+/// visited once.
+/// @param tree the tree. Reached vertices whose parent chain hits a vertex which was not reached, an invalid vertex index,
+/// a cycle or a root with a distance other than 0 get distance `GEOD_UNREACHED` and parent -1.
+/// @return the number of vertices marked as not reached.
+/// @throws std::domain_error if the number of parents does not match the number of vertices.
+size_t geod_tree_prune(GeodTree& tree) {
+  const size_t nv = tree.num_vertices();
+  if(tree.parent.size() != nv) {
+    throw std::domain_error("Shortest-path tree has " + std::to_string(tree.parent.size()) + " parents for " + std::to_string(nv) + " vertices.\n");
+  }
+  enum { UNKNOWN = 0, VALID = 1, INVALID = 2, ON_CHAIN = 3 };
+  std::vector<uint8_t> state(nv, UNKNOWN);
+  std::vector<int32_t> chain;
+  size_t num_pruned = 0;
+  for(size_t start=0; start<nv; start++) {
+    // Walk up from the vertex until a vertex with known state or the end of the chain, then settle the whole chain.
+    chain.clear();
+    int32_t v = int32_t(start);
+    uint8_t result = INVALID;
+    while(true) {
+      if(v < 0 || size_t(v) >= nv || state[v] == ON_CHAIN || ! tree.reached(size_t(v))) {
+        result = INVALID;
+        break;
+      }
+      if(state[v] != UNKNOWN) {
+        result = state[v];
+        break;
+      }
+      state[v] = ON_CHAIN;
+      chain.push_back(v);
+      if(tree.parent[v] == -1) {
+        result = (tree.dist[v] == 0.0f) ? VALID : INVALID;
+        break;
+      }
+      v = tree.parent[v];
+    }
+    for(size_t i=0; i<chain.size(); i++) {
+      state[chain[i]] = result;
+      if(result == INVALID) {
+        tree.dist[chain[i]] = GEOD_UNREACHED;
+        tree.parent[chain[i]] = -1;
+        num_pruned++;
+      }
+    }
+  }
+  return num_pruned;
+}
+
+
+/// @brief Reconstruct the shortest paths to many targets from a shortest-path tree, in parallel.
+/// @details Each path costs time proportional to its number of vertices, which are written once, to their final position. Nothing else depends on the mesh size, so small target sets are cheap on large trees.
+/// @param tree the tree, see `geod_tree`.
+/// @param targets the target vertices.
+/// @return the path to each target, from its source to the target. Paths to vertices which were not reached are empty.
+/// @throws std::invalid_argument if a target is out of range, std::domain_error if the parents on a path are out of range, form a cycle or end at a vertex with a distance other than 0, which is not a source.
+GeodTreePaths geod_tree_paths(const GeodTree& tree, const std::vector<int32_t>& targets) {
+  const size_t nv = tree.num_vertices();
+  for(size_t i=0; i<targets.size(); i++) {
+    if(targets[i] < 0 || size_t(targets[i]) >= nv) {
+      throw std::invalid_argument("Target vertex " + std::to_string(targets[i]) + " is out of range for tree with " + std::to_string(nv) + " vertices.\n");
+    }
+  }
+  if(tree.parent.size() != nv) {
+    throw std::domain_error("Shortest-path tree has " + std::to_string(tree.parent.size()) + " parents for " + std::to_string(nv) + " vertices.\n");
+  }
+  // Count the path lengths first, so each path is filled from its target backwards into its final place.
+  const int64_t num_targets = int64_t(targets.size());
+  std::vector<int64_t> lengths(targets.size(), 0);
+  bool invalid = false;
+  # pragma omp parallel for schedule(dynamic, 64) shared(lengths) reduction(||:invalid)
+  for(int64_t i=0; i<num_targets; i++) {
+    if(! tree.reached(size_t(targets[i]))) {
+      continue;
+    }
+    int64_t len = 0;
+    int32_t root = targets[i];
+    for(int32_t v=targets[i]; v != -1; v=tree.parent[v]) {
+      if(v < 0 || size_t(v) >= nv || len >= int64_t(nv)) {
+        invalid = true;  // Exceptions must not leave the parallel region.
+        len = 0;
+        break;
+      }
+      root = v;
+      len++;
+    }
+    if(len > 0 && tree.dist[root] != 0.0f) {
+      invalid = true;
+      len = 0;
+    }
+    lengths[i] = len;
+  }
+  if(invalid) {
+    throw std::domain_error("The parents of the shortest-path tree are out of range, form a cycle or lead to a vertex which is not a source.\n");
+  }
+  GeodTreePaths paths;
+  paths.offsets.resize(targets.size() + 1);
+  paths.offsets[0] = 0;
+  for(size_t i=0; i<targets.size(); i++) {
+    paths.offsets[i+1] = paths.offsets[i] + lengths[i];
+  }
+  paths.vertices.resize(size_t(paths.offsets[targets.size()]));
+  # pragma omp parallel for schedule(dynamic, 64) shared(paths)
+  for(int64_t i=0; i<num_targets; i++) {
+    int32_t v = targets[i];
+    for(int64_t pos=paths.offsets[i+1]-1; pos>=paths.offsets[i]; pos--) {
+      paths.vertices[pos] = v;
+      v = tree.parent[v];
+    }
+  }
+  return paths;
+}
+
+
+/// @brief Write a shortest-path tree to a file, in big endian byte order.
+/// @details Layout: int32 magic `GEOD_TREE_MAGIC`, int32 number of vertices nv, nv int32 parents, nv float distances. Vertices which were not reached have parent -1 and distance -1.
+/// @throws std::runtime_error if the file cannot be written.
+void write_geod_tree(const std::string& filename, const GeodTree& tree) {
+  std::ofstream os(filename, std::ofstream::out | std::ofstream::binary);
+  if(! os.is_open()) {
+    throw std::runtime_error("Unable to open shortest-path tree file '" + filename + "' for writing.\n");
+  }
+  const int32_t num_vertices = int32_t(tree.num_vertices());
+  std::vector<float> dist(tree.dist);
+  for(size_t v=0; v<dist.size(); v++) {
+    if(dist[v] == GEOD_UNREACHED) {
+      dist[v] = -1.0f;
+    }
+  }
+  write_big_endian(os, &GEOD_TREE_MAGIC, 1);
+  write_big_endian(os, &num_vertices, 1);
+  write_big_endian(os, tree.parent.data(), tree.parent.size());
+  write_big_endian(os, dist.data(), dist.size());
+  if(! os.good()) {
+    throw std::runtime_error("Failed to write shortest-path tree file '" + filename + "'.\n");
+  }
+}
+
+
+/// @brief Read a shortest-path tree from a file written by `write_geod_tree`, using a memory mapping.
+/// @throws std::runtime_error if the file cannot be opened, std::domain_error if the magic number mismatches, the file is truncated or the tree is invalid.
+GeodTree read_geod_tree(const std::string& filename) {
+  MappedFile mf(filename);
+  const char* buf = mf.data();
+  const size_t header_size = 8;
+  if(mf.size() < header_size) {
+    throw std::domain_error("Shortest-path tree file '" + filename + "' is truncated.\n");
+  }
+  int32_t magic, num_vertices;
+  copy_big_endian_to_host(&magic, buf, 1);
+  copy_big_endian_to_host(&num_vertices, buf + 4, 1);
+  if(magic != GEOD_TREE_MAGIC) {
+    throw std::domain_error("File '" + filename + "' is not a shortest-path tree file, magic number mismatch.\n");
+  }
+  if(num_vertices < 0 || mf.size() != header_size + size_t(num_vertices) * (sizeof(int32_t) + sizeof(float))) {
+    throw std::domain_error("Shortest-path tree file '" + filename + "' is truncated.\n");
+  }
+  GeodTree tree;
+  tree.parent.resize(size_t(num_vertices));
+  tree.dist.resize(size_t(num_vertices));
+  copy_big_endian_to_host(tree.parent.data(), buf + header_size, tree.parent.size());
+  copy_big_endian_to_host(tree.dist.data(), buf + header_size + tree.parent.size() * sizeof(int32_t), tree.dist.size());
+  for(size_t v=0; v<tree.dist.size(); v++) {
+    if(tree.dist[v] < 0.0f) {
+      tree.dist[v] = GEOD_UNREACHED;
+    }
+  }
+  _geod_tree_check(tree);
+  return tree;
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "mesh_view.h"
+#include "geod_engine.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+// Geodesic Voronoi parcellation of a mesh from many seed vertices.
+//
+// A single multi-source Dijkstra search from all seeds computes the distance of each vertex to its nearest seed. The
+// search also propagates along the shortest paths which seed a vertex was reached from, so one search labels all
+// vertices, instead of one search per seed. Ties in distance go to the seed with the lower index in the seed list.
+
+
+/// @brief The result of a geodesic Voronoi parcellation.
+struct GeodVoronoi {
+  std::vector<int32_t> seed;  ///< For each vertex, the index into the seed list of its nearest seed, or -1 if no seed reached it.
+  std::vector<float> dist;    ///< For each vertex, the geodesic distance to its nearest seed, or `GEOD_UNREACHED` if no seed reached it.
+
+  /// @brief Get the number of vertices.
+  size_t num_vertices() const {
+    return this->seed.size();
+  }
+};
+
+
+/// @brief Multi-source Dijkstra search like `geod_dijkstra`, which also records for each reached vertex the index of its nearest seed.
+/// @param seeds the seed vertices. Their index in this array is the seed index.
+/// @param seed_offset added to the seed indices written to `nearest`, used when searching from a part of a larger seed list.
+/// @param nearest work array of length `nv`. After the search, holds the nearest seed index for all vertices in `ws.reached`, other entries are undefined.
+/// @private
+inline void _geod_voronoi_search(const GeodGraph& g, const int32_t* seeds, const size_t num_seeds, const int32_t seed_offset, float max_dist, GeodWorkspace& ws, std::vector<int32_t>& nearest) {
+  typedef std::pair<float, int32_t> HeapEntry;
+  const size_t nv = g.num_vertices();
+  if(ws.dist.size() != nv) {
+    ws = GeodWorkspace(nv);
+  }
+  nearest.resize(nv);
+  ws.reset();
+  if(max_dist < 0.0f) {
+    max_dist = GEOD_UNREACHED;
+  }
+  for(size_t i=0; i<num_seeds; i++) {
+    const int32_t s = seeds[i];
+    if(s < 0 || size_t(s) >= nv) {
+      throw std::invalid_argument("Seed vertex " + std::to_string(s) + " is out of range for mesh with " + std::to_string(nv) + " vertices.\n");
+    }
+    if(ws.dist[s] != 0.0f) {  // A vertex listed as seed more than once belongs to the first of them.
+      ws.dist[s] = 0.0f;
+      nearest[s] = seed_offset + int32_t(i);
+      ws.reached.push_back(s);
+      ws.heap.push_back(HeapEntry(0.0f, s));
+    }
+  }
+  std::greater<HeapEntry> cmp;
+  std::make_heap(ws.heap.begin(), ws.heap.end(), cmp);
+  const int64_t* offsets = g.csr.offsets.data();
+  const int32_t* adj = g.csr.adj.data();
+  const float* weights = g.weights.data();
+  float* dist = ws.dist.data();
+  while(! ws.heap.empty()) {
+    std::pop_heap(ws.heap.begin(), ws.heap.end(), cmp);
+    const HeapEntry top = ws.heap.back();
+    ws.heap.pop_back();
+    const int32_t cur = top.second;
+    if(top.first > dist[cur]) {
+      continue;
+    }
+    const int32_t cur_seed = nearest[cur];
+    for(int64_t k=offsets[cur]; k<offsets[cur+1]; k++) {
+      const int32_t next = adj[k];
+      const float next_dist = top.first + weights[k];
+      if(next_dist < max_dist && next_dist < dist[next]) {
+        if(dist[next] == GEOD_UNREACHED) {
+          ws.reached.push_back(next);
+        }
+        dist[next] = next_dist;
+        nearest[next] = cur_seed;
+        ws.heap.push_back(HeapEntry(next_dist, next));
+        std::push_heap(ws.heap.begin(), ws.heap.end(), cmp);
+      } else if(next_dist < max_dist && next_dist == dist[next] && cur_seed < nearest[next]) {
+        nearest[next] = cur_seed;  // The vertex is not settled yet, as its distance is larger than the current one.
+      }
+    }
+  }
+}
+
+
+/// @brief Compute the geodesic Voronoi parcellation of a mesh: the nearest seed of each vertex and the distance to it.
+/// @param g the mesh graph, see `geod_graph`.
+/// @param seeds the seed vertices.
+/// @param max_dist vertices at distance `>= max_dist` from all seeds are not reached and not assigned to any seed. Pass a negative value for no limit.
+/// @param num_partitions split the seed list into this many contiguous parts, search from the parts in parallel with OpenMP, and merge the results. With 1, all seeds are searched in a single pass. Partitioning pays off for bounded searches, where each part only covers the regions around its own seeds. Without a bound, each part covers the whole mesh and a single pass is faster.
+/// @return the parcellation. The result does not depend on the number of threads.
+/// @throws std::invalid_argument if a seed vertex is out of range or `num_partitions` is 0.
+GeodVoronoi geod_voronoi(const GeodGraph& g, const std::vector<int32_t>& seeds, const float max_dist = -1.0f, const size_t num_partitions = 1) {
+  if(num_partitions == 0) {
+    throw std::invalid_argument("Number of partitions must be at least 1.\n");
+  }
+  const size_t nv = g.num_vertices();
+  GeodVoronoi res;
+  res.seed.assign(nv, -1);
+  res.dist.assign(nv, GEOD_UNREACHED);
+  const size_t num_parts = std::max(size_t(1), std::min(num_partitions, seeds.size()));
+
+  if(num_parts == 1) {
+    GeodWorkspace ws(nv);
+    std::vector<int32_t> nearest;
+    _geod_voronoi_search(g, seeds.data(), seeds.size(), 0, max_dist, ws, nearest);
+    for(size_t j=0; j<ws.reached.size(); j++) {
+      const int32_t v = ws.reached[j];
+      res.seed[v] = nearest[v];
+      res.dist[v] = ws.dist[v];
+    }
+    return res;
+  }
+
+  // Search from each part of the seed list, keeping only the reached vertices, then merge in part order.
+  std::vector<std::vector<int32_t>> part_vertices(num_parts), part_seed(num_parts);
+  std::vector<std::vector<float>> part_dist(num_parts);
+  const int64_t num_parts_signed = int64_t(num_parts);
+  std::vector<std::string> errors(num_parts);
+  # pragma omp parallel shared(part_vertices, part_seed, part_dist, errors)
+  {
+    GeodWorkspace ws(nv);
+    std::vector<int32_t> nearest;
+    # pragma omp for schedule(dynamic, 1)
+    for(int64_t p=0; p<num_parts_signed; p++) {
+      const size_t start = seeds.size() * size_t(p) / num_parts;
+      const size_t end = seeds.size() * size_t(p + 1) / num_parts;
+      try {
+        _geod_voronoi_search(g, seeds.data() + start, end - start, int32_t(start), max_dist, ws, nearest);
+      } catch(const std::exception& e) {
+        errors[p] = e.what();  // Exceptions must not leave the parallel region.
+        continue;
+      }
+      part_vertices[p] = ws.reached;
+      part_seed[p].resize(ws.reached.size());
+      part_dist[p].resize(ws.reached.size());
+      for(size_t j=0; j<ws.reached.size(); j++) {
+        part_seed[p][j] = nearest[ws.reached[j]];
+        part_dist[p][j] = ws.dist[ws.reached[j]];
+      }
+    }
+  }
+  for(size_t p=0; p<num_parts; p++) {
+    if(! errors[p].empty()) {
+      throw std::invalid_argument(errors[p]);
+    }
+  }
+  for(size_t p=0; p<num_parts; p++) {
+    for(size_t j=0; j<part_vertices[p].size(); j++) {
+      const int32_t v = part_vertices[p][j];
+      if(part_dist[p][j] < res.dist[v]) {  // On ties, the earlier part has the lower seed indices and wins.
+        res.dist[v] = part_dist[p][j];
+        res.seed[v] = part_seed[p][j];
+      }
+    }
+  }
+  return res;
+}
+
+
+/// @brief Compute the geodesic Voronoi parcellation of a mesh view.
+/// @details This builds the mesh graph first. Use the overload for `GeodGraph` for more than one parcellation of the same mesh.
+template<typename T, typename I>
+GeodVoronoi geod_voronoi(const MeshView<T, I>& m, const std::vector<int32_t>& seeds, const float max_dist = -1.0f, const size_t num_partitions = 1) {
+  return geod_voronoi(geod_graph(m), seeds, max_dist, num_partitions);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdio>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file. On POSIX systems this uses mmap, so the file contents are paged in
+// directly from the page cache without going through stream buffers. On Windows, the file is read into memory
+// with a single bulk read instead, which keeps the interface identical.
+
+
+/// @brief Read-only view of the contents of a file, memory-mapped where supported.
+/// @details The mapping is released when the instance is destroyed. Instances cannot be copied.
+class MappedFile {
+  public:
+    /// @brief Map the given file into memory.
+    /// @throws std::runtime_error if the file cannot be opened or mapped.
+    explicit MappedFile(const std::string& filename) : filename_(filename), data_(NULL), size_(0) {
+#ifndef _WIN32
+      int fd = open(filename.c_str(), O_RDONLY);
+      if(fd < 0) {
+        throw std::runtime_error("Unable to open file '" + filename + "' for reading.\n");
+      }
+      struct stat st;
+      if(fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Unable to determine size of file '" + filename + "'.\n");
+      }
+      size_ = size_t(st.st_size);
+      if(size_ > 0) {
+        void* addr = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(addr == MAP_FAILED) {
+          close(fd);
+          throw std::runtime_error("Unable to memory-map file '" + filename + "'.\n");
+        }
+        madvise(addr, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(addr);
+      }
+      close(fd); // The mapping stays valid after closing the descriptor.
+#else
+      FILE* fp = fopen(filename.c_str(), "rb");
+      if(fp == NULL) {
+        throw std::runtime_error("Unable to open file '" + filename + "' for reading.\n");
+      }
+      fseek(fp, 0, SEEK_END);
+      long len = ftell(fp);
+      fseek(fp, 0, SEEK_SET);
+      buffer_.resize(len > 0 ? size_t(len) : 0);
+      size_ = buffer_.size();
+      if(size_ > 0 && fread(buffer_.data(), 1, size_, fp) != size_) {
+        fclose(fp);
+        throw std::runtime_error("Unable to read file '" + filename + "'.\n");
+      }
+      fclose(fp);
+      data_ = buffer_.data();
+#endif
+    }
+
+    ~MappedFile() {
+#ifndef _WIN32
+      if(data_ != NULL) {
+        munmap(const_cast<char*>(data_), size_);
+      }
+#endif
+    }
+
+    /// @brief Get pointer to the first byte of the file. NULL for empty files.
+    const char* data() const { return data_; }
+
+    /// @brief Get the file size in bytes.
+    size_t size() const { return size_; }
+
+    /// @brief Get the name of the mapped file.
+    const std::string& filename() const { return filename_; }
+
+  private:
+    MappedFile(const MappedFile&);             // Not copyable.
+    MappedFile& operator=(const MappedFile&);  // Not copyable.
+
+    std::string filename_;
+    const char* data_;
+    size_t size_;
+#ifdef _WIN32
+    std::vector<char> buffer_;
+#endif
+};
@@ -0,0 +1,349 @@
+#pragma once
+
+#include "libfs.h"
+#include "mesh_view.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+// Vertex adjacency of triangular meshes in compressed sparse row (CSR) format.
+//
+// The libfs functions `fs::Mesh::as_adjlist()` (which goes through a dense V x V matrix by default) and
+// `fs::Mesh::extend_adj()` (linear duplicate checks) do not scale to large meshes. The functions in here build the
+// adjacency with a counting sort over the face list followed by a per-vertex sort-and-unique, which needs O(F) memory
+// and runs in parallel with OpenMP if available. Use them whenever you need vertex adjacency.
+
+
+/// @brief Vertex adjacency of a mesh in compressed sparse row (CSR) format.
+/// @details The neighbors of vertex `v` are stored in `adj[offsets[v]]` to `adj[offsets[v+1]-1]`, sorted in ascending order. The vertex itself is never part of its neighbors. Each undirected mesh edge occurs twice, once for each of its vertices.
+struct MeshCSR {
+  std::vector<int64_t> offsets;  ///< Length `nv + 1`, start index into `adj` for each vertex. The last entry is the total number of entries in `adj`.
+  std::vector<int32_t> adj;      ///< The neighbor vertex indices of all vertices, concatenated.
+
+  /// @brief Get the number of vertices.
+  size_t num_vertices() const {
+    return this->offsets.empty() ? 0 : this->offsets.size() - 1;
+  }
+
+  /// @brief Get the number of undirected edges, i.e., half the number of entries in `adj`.
+  size_t num_edges() const {
+    return this->adj.size() / 2;
+  }
+
+  /// @brief Get the number of neighbors of vertex `v`.
+  size_t degree(const size_t v) const {
+    return size_t(this->offsets[v+1] - this->offsets[v]);
+  }
+
+  /// @brief Get pointer to the first neighbor of vertex `v`.
+  const int32_t* neighbors_begin(const size_t v) const {
+    return this->adj.data() + this->offsets[v];
+  }
+
+  /// @brief Get pointer one past the last neighbor of vertex `v`.
+  const int32_t* neighbors_end(const size_t v) const {
+    return this->adj.data() + this->offsets[v+1];
+  }
+
+  /// @brief Get the neighbors of vertex `v` as a vector.
+  std::vector<int32_t> neighbors(const size_t v) const {
+    return std::vector<int32_t>(this->neighbors_begin(v), this->neighbors_end(v));
+  }
+
+  /// @brief Get adjacency list representation, in the format used by libfs (e.g., by `fs::Mesh::smooth_pvd_nn`).
+  std::vector<std::vector<size_t>> to_adjlist() const {
+    size_t nv = this->num_vertices();
+    std::vector<std::vector<size_t>> adjlist(nv);
+    for(size_t v=0; v<nv; v++) {
+      adjlist[v].assign(this->neighbors_begin(v), this->neighbors_end(v));
+    }
+    return adjlist;
+  }
+};
+
+
+/// @brief Exclusive prefix sum of `counts` into `offsets`, which gets length `counts.size() + 1`.
+/// @private
+inline void _csr_prefix_sum(const std::vector<int64_t>& counts, std::vector<int64_t>& offsets) {
+  offsets.resize(counts.size() + 1);
+  offsets[0] = 0;
+  for(size_t i=0; i<counts.size(); i++) {
+    offsets[i+1] = offsets[i] + counts[i];
+  }
+}
+
+
+/// @brief Compute vertex adjacency in CSR format from a face array.
+/// @param faces pointer to `3 * num_faces` vertex indices, the 3 vertex indices of each triangle.
+/// @param num_faces the number of faces.
+/// @param num_vertices the number of vertices of the mesh. Vertices which are not part of any face get no neighbors.
+/// @return the adjacency in CSR format, with sorted neighbor lists.
+/// @throws std::domain_error if a face references a vertex index outside of `[0, num_vertices)`.
+template<typename I>
+MeshCSR mesh_csr_from_faces(const I* faces, const size_t num_faces, const size_t num_vertices) {
+  const size_t nf = num_faces;
+  for(size_t i=0; i<nf * 3; i++) {
+    if(faces[i] < 0 || size_t(faces[i]) >= num_vertices) {
+      throw std::domain_error("Face " + std::to_string(i / 3) + " references invalid vertex index " + std::to_string(faces[i]) + " for mesh with " + std::to_string(num_vertices) + " vertices.\n");
+    }
+  }
+
+  // Counting sort of the directed half-edges by their source vertex. Every face contributes 2 half-edges per vertex.
+  std::vector<int64_t> counts(num_vertices, 0);
+  for(size_t i=0; i<nf * 3; i++) {
+    counts[faces[i]] += 2;
+  }
+  std::vector<int64_t> bucket_offsets;
+  _csr_prefix_sum(counts, bucket_offsets);
+
+  std::vector<int32_t> buckets(bucket_offsets[num_vertices]);
+  std::vector<int64_t> fill_pos(bucket_offsets.begin(), bucket_offsets.end() - 1);
+  for(size_t f=0; f<nf; f++) {
+    const int32_t a = int32_t(faces[f*3]), b = int32_t(faces[f*3+1]), c = int32_t(faces[f*3+2]);
+    buckets[fill_pos[a]++] = b; buckets[fill_pos[a]++] = c;
+    buckets[fill_pos[b]++] = a; buckets[fill_pos[b]++] = c;
+    buckets[fill_pos[c]++] = a; buckets[fill_pos[c]++] = b;
+  }
+
+  // Sort and deduplicate each bucket in place. Edges shared by two faces occur twice in the buckets of their vertices.
+  const int64_t nv_signed = int64_t(num_vertices);
+  # pragma omp parallel for schedule(static)
+  for(int64_t v=0; v<nv_signed; v++) {
+    int32_t* begin = buckets.data() + bucket_offsets[v];
+    int32_t* end = buckets.data() + bucket_offsets[v+1];
+    std::sort(begin, end);
+    int32_t* last = std::unique(begin, end);
+    last = std::remove(begin, last, int32_t(v)); // Degenerate faces could make a vertex its own neighbor.
+    counts[v] = last - begin;
+  }
+
+  // Compact the unique entries into the final CSR arrays.
+  MeshCSR csr;
+  _csr_prefix_sum(counts, csr.offsets);
+  csr.adj.resize(csr.offsets[num_vertices]);
+  # pragma omp parallel for schedule(static)
+  for(int64_t v=0; v<nv_signed; v++) {
+    std::copy(buckets.data() + bucket_offsets[v], buckets.data() + bucket_offsets[v] + counts[v], csr.adj.data() + csr.offsets[v]);
+  }
+  return csr;
+}
+
+
+/// @brief Compute vertex adjacency in CSR format from a face list.
+/// @param faces vector of length `3 * nf`, the 3 vertex indices of each triangle, like `fs::Mesh.faces`.
+/// @param num_vertices the number of vertices of the mesh. Vertices which are not part of any face get no neighbors.
+/// @see The overload for face arrays, which this calls.
+MeshCSR mesh_csr_from_faces(const std::vector<int32_t>& faces, const size_t num_vertices) {
+  return mesh_csr_from_faces(faces.data(), faces.size() / 3, num_vertices);
+}
+
+
+/// @brief Compute vertex adjacency in CSR format for an fs::Mesh.
+MeshCSR mesh_csr(const fs::Mesh& mesh) {
+  return mesh_csr_from_faces(mesh.faces, mesh.num_vertices());
+}
+
+
+/// @brief Compute vertex adjacency in CSR format for a mesh view.
+template<typename T, typename I>
+MeshCSR mesh_csr(const MeshView<T, I>& m) {
+  return mesh_csr_from_faces(m.faces, m.num_faces(), m.num_vertices());
+}
+
+
+/// @brief Compute the k-ring neighborhood of a single vertex by breadth-first search.
+/// @param csr the 1-ring adjacency of the mesh.
+/// @param source the query vertex.
+/// @param k the maximal edge distance.
+/// @param mark work array of length `nv`, must contain no entry equal to `stamp`. Entries reached by this search are set to `stamp`, so reusing it with a new stamp per call avoids clearing.
+/// @param stamp the value used to mark visited vertices in `mark`.
+/// @param out vector to which the neighbors are appended, ordered by ring (all vertices in edge distance 1 first, then 2, and so on). The query vertex itself is not added.
+/// @private
+inline void _csr_kring_single(const MeshCSR& csr, const int32_t source, const size_t k, std::vector<int32_t>& mark, const int32_t stamp, std::vector<int32_t>& out) {
+  mark[source] = stamp;
+  size_t ring_start = out.size();
+  // The seed ring is the source itself. We cannot put it into `out`, so the first ring is handled separately.
+  for(const int32_t* n = csr.neighbors_begin(source); n != csr.neighbors_end(source); ++n) {
+    if(mark[*n] != stamp) {
+      mark[*n] = stamp;
+      out.push_back(*n);
+    }
+  }
+  for(size_t ring=1; ring<k; ring++) {
+    const size_t ring_end = out.size();
+    if(ring_start == ring_end) {
+      break;  // No new vertices in last ring, the connected component is exhausted.
+    }
+    for(size_t i=ring_start; i<ring_end; i++) {
+      const int32_t cur = out[i];
+      for(const int32_t* n = csr.neighbors_begin(cur); n != csr.neighbors_end(cur); ++n) {
+        if(mark[*n] != stamp) {
+          mark[*n] = stamp;
+          out.push_back(*n);
+        }
+      }
+    }
+    ring_start = ring_end;
+  }
+}
+
+
+/// @brief Compute the k-ring neighborhoods (all vertices in edge distance up to `k`) for the query vertices, in parallel.
+/// @param csr the 1-ring adjacency of the mesh, see `mesh_csr`.
+/// @param query_vertices the vertices for which to compute the neighborhoods. If empty, all vertices are used.
+/// @param k the maximal edge distance. Use 1 for direct edge neighbors.
+/// @param include_self whether to include the query vertex itself, as the first entry of its neighborhood.
+/// @return one neighborhood per query vertex, each ordered by ring and ascending vertex index within the first ring.
+std::vector<std::vector<int32_t>> mesh_kring(const MeshCSR& csr, std::vector<int32_t> query_vertices, const size_t k=1, const bool include_self=false) {
+  const size_t nv = csr.num_vertices();
+  if(query_vertices.empty()) {
+    query_vertices.resize(nv);
+    for(size_t i=0; i<nv; i++) {
+      query_vertices[i] = int32_t(i);
+    }
+  }
+  const int64_t nq = int64_t(query_vertices.size());
+  std::vector<std::vector<int32_t>> neighborhoods(query_vertices.size());
+
+  # pragma omp parallel shared(csr, query_vertices, neighborhoods)
+  {
+    std::vector<int32_t> mark(nv, -1);  // Per thread, stamped with the query index to avoid clearing.
+    # pragma omp for schedule(dynamic, 256)
+    for(int64_t i=0; i<nq; i++) {
+      const int32_t qv = query_vertices[i];
+      if(qv < 0 || size_t(qv) >= nv) {
+        continue; // Invalid query vertex, leave neighborhood empty.
+      }
+      std::vector<int32_t>& neigh = neighborhoods[i];
+      if(include_self) {
+        neigh.push_back(qv);
+      }
+      _csr_kring_single(csr, qv, k, mark, int32_t(i), neigh);
+    }
+  }
+  return neighborhoods;
+}
+
+
+/// @brief Extend 1-ring adjacency to the k-ring adjacency of all vertices, in CSR format.
+/// @details This replaces `fs::Mesh::extend_adj`. Neighbor lists in the result are sorted in ascending order and never contain the vertex itself.
+/// @param csr the 1-ring adjacency of the mesh, see `mesh_csr`.
+/// @param k the maximal edge distance.
+/// @return the k-ring adjacency in CSR format.
+MeshCSR mesh_csr_extend(const MeshCSR& csr, const size_t k) {
+  if(k <= 1) {
+    return csr;
+  }
+  std::vector<std::vector<int32_t>> rings = mesh_kring(csr, std::vector<int32_t>(), k, false);
+  const size_t nv = rings.size();
+  std::vector<int64_t> counts(nv);
+  for(size_t v=0; v<nv; v++) {
+    counts[v] = int64_t(rings[v].size());
+  }
+  MeshCSR ext;
+  _csr_prefix_sum(counts, ext.offsets);
+  ext.adj.resize(ext.offsets[nv]);
+  const int64_t nv_signed = int64_t(nv);
+  # pragma omp parallel for schedule(static)
+  for(int64_t v=0; v<nv_signed; v++) {
+    std::sort(rings[v].begin(), rings[v].end());
+    std::copy(rings[v].begin(), rings[v].end(), ext.adj.data() + ext.offsets[v]);
+  }
+  return ext;
+}
+
+
+/// @brief Compute the vertex-face incidence of a mesh in CSR format.
+/// @details This uses the CSR layout of `MeshCSR`, but the entries of vertex `v` are the indices of the faces that contain `v`, in ascending order, instead of its neighbor vertices. A degenerate face which contains a vertex several times is listed once for it.
+/// @param faces pointer to `3 * num_faces` vertex indices, the 3 vertex indices of each triangle.
+/// @param num_faces the number of faces.
+/// @param num_vertices the number of vertices of the mesh. Vertices which are not part of any face get no faces.
+/// @return the incident faces of all vertices in CSR format. Note that `num_edges()` is meaningless for it.
+/// @throws std::domain_error if a face references a vertex index outside of `[0, num_vertices)`.
+template<typename I>
+MeshCSR mesh_vertex_faces_from_faces(const I* faces, const size_t num_faces, const size_t num_vertices) {
+  const size_t nf = num_faces;
+  for(size_t i=0; i<nf * 3; i++) {
+    if(faces[i] < 0 || size_t(faces[i]) >= num_vertices) {
+      throw std::domain_error("Face " + std::to_string(i / 3) + " references invalid vertex index " + std::to_string(faces[i]) + " for mesh with " + std::to_string(num_vertices) + " vertices.\n");
+    }
+  }
+
+  // Counting sort of the faces by their vertices. Filling in face order keeps the face lists sorted.
+  std::vector<int64_t> counts(num_vertices, 0);
+  for(size_t f=0; f<nf; f++) {
+    const I* fv = faces + f * 3;
+    counts[fv[0]]++;
+    if(fv[1] != fv[0]) { counts[fv[1]]++; }
+    if(fv[2] != fv[0] && fv[2] != fv[1]) { counts[fv[2]]++; }
+  }
+  MeshCSR csr;
+  _csr_prefix_sum(counts, csr.offsets);
+  csr.adj.resize(csr.offsets[num_vertices]);
+  std::vector<int64_t> fill_pos(csr.offsets.begin(), csr.offsets.end() - 1);
+  for(size_t f=0; f<nf; f++) {
+    const I* fv = faces + f * 3;
+    csr.adj[fill_pos[fv[0]]++] = int32_t(f);
+    if(fv[1] != fv[0]) { csr.adj[fill_pos[fv[1]]++] = int32_t(f); }
+    if(fv[2] != fv[0] && fv[2] != fv[1]) { csr.adj[fill_pos[fv[2]]++] = int32_t(f); }
+  }
+  return csr;
+}
+
+
+/// @brief Compute the vertex-face incidence of a mesh view in CSR format, see `mesh_vertex_faces_from_faces`.
+template<typename T, typename I>
+MeshCSR mesh_vertex_faces(const MeshView<T, I>& m) {
+  return mesh_vertex_faces_from_faces(m.faces, m.num_faces(), m.num_vertices());
+}
+
+
+/// @brief Compute the face adjacency of a mesh from a face array: for each edge of each face, the face on the other side of the edge.
+/// @param faces pointer to `3 * num_faces` vertex indices, the 3 vertex indices of each triangle.
+/// @param num_faces the number of faces.
+/// @param num_vertices the number of vertices of the mesh.
+/// @return vector of length `3 * num_faces`. Entry `f * 3 + k` is the face across the edge from vertex k to vertex `(k + 1) % 3` of face f, or -1 for boundary edges and degenerate edges. For non-manifold edges, it is the lowest other face index.
+/// @throws std::domain_error if a face references a vertex index outside of `[0, num_vertices)`.
+template<typename I>
+std::vector<int32_t> mesh_face_adjacency_from_faces(const I* faces, const size_t num_faces, const size_t num_vertices) {
+  const MeshCSR vf = mesh_vertex_faces_from_faces(faces, num_faces, num_vertices);
+  std::vector<int32_t> face_adj(num_faces * 3, -1);
+  const int64_t nf_signed = int64_t(num_faces);
+  # pragma omp parallel for schedule(static)
+  for(int64_t f=0; f<nf_signed; f++) {
+    for(size_t k=0; k<3; k++) {
+      const I a = faces[f*3 + k], b = faces[f*3 + (k + 1) % 3];
+      if(a == b) {
+        continue;
+      }
+      // The faces of both edge vertices are sorted, so the faces sharing the edge are their intersection.
+      const int32_t* pa = vf.neighbors_begin(a);
+      const int32_t* pb = vf.neighbors_begin(b);
+      while(pa != vf.neighbors_end(a) && pb != vf.neighbors_end(b)) {
+        if(*pa < *pb) {
+          ++pa;
+        } else if(*pb < *pa) {
+          ++pb;
+        } else {
+          if(*pa != f) {
+            face_adj[f*3 + k] = *pa;
+            break;
+          }
+          ++pa;
+          ++pb;
+        }
+      }
+    }
+  }
+  return face_adj;
+}
+
+
+/// @brief Compute the face adjacency of a mesh view, see `mesh_face_adjacency_from_faces`.
+template<typename T, typename I>
+std::vector<int32_t> mesh_face_adjacency(const MeshView<T, I>& m) {
+  return mesh_face_adjacency_from_faces(m.faces, m.num_faces(), m.num_vertices());
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "mesh_view.h"
+#include "mesh_csr.h"
+
+#include <vector>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <stdexcept>
+
+// Lazily computed, shared geometry of a mesh view: face areas, face adjacency, unique edges and their lengths, vertex
+// normals and vertex coordinates.
+//
+// Several computations on the same mesh need the same derived quantities, e.g., the geodesic circles need the face
+// areas and edge lengths, and the neighborhood builders need the vertex normals and coordinates. A `MeshGeometry`
+// computes each quantity on first use and keeps it, so it is computed once per mesh no matter how many functions or
+// threads ask for it. The quantities are immutable once computed, and the lazy initialization is thread-safe, so a
+// const geometry can be shared by all threads. The face areas and the face adjacency may also be passed in when the
+// geometry is created, e.g., from the graph sidecar file of the mesh (see `geod_graph_file.h`).
+//
+// The free functions `mesh_area_per_face`, `mesh_face_adjacency`, `mesh_area_total`, `mesh_edge_lengths`,
+// `mesh_vnormals` and `mesh_vertex_coords` have overloads for a geometry which return the cached quantities, so
+// templates that call them on a mesh accept a geometry as well. Like the view, the geometry must not outlive the mesh
+// arrays.
+
+
+/// @brief Lazily computed, immutable geometry of a mesh view, see the file comment.
+/// @details Not copyable. The values are identical to the ones of the respective functions for mesh views in `mesh_view.h`.
+template<typename T = float, typename I = int32_t>
+class MeshGeometry {
+  public:
+  /// @brief Create the geometry of a mesh view. Nothing is computed yet.
+  explicit MeshGeometry(const MeshView<T, I>& m) : mesh(m), _area_total(0.0) {}
+
+  /// @brief Create the geometry of a mesh view with precomputed face areas and face adjacency.
+  /// @param face_areas the area of each face, see `mesh_area_per_face`. If empty, computed on first use.
+  /// @param face_adj the face adjacency, see `mesh_face_adjacency`. If empty, computed on first use.
+  /// @throws std::invalid_argument if a non-empty vector does not match the number of faces of the mesh.
+  MeshGeometry(const MeshView<T, I>& m, std::vector<double> face_areas, std::vector<int32_t> face_adj) : mesh(m), _area_total(0.0) {
+    if(! face_areas.empty()) {
+      if(face_areas.size() != m.num_faces()) {
+        throw std::invalid_argument("Expected " + std::to_string(m.num_faces()) + " face areas, got " + std::to_string(face_areas.size()) + ".\n");
+      }
+      std::call_once(this->_face_areas_once, [&]() { this->_set_face_areas(std::move(face_areas)); });
+    }
+    if(! face_adj.empty()) {
+      if(face_adj.size() != m.num_faces() * 3) {
+        throw std::invalid_argument("Expected " + std::to_string(m.num_faces() * 3) + " face adjacency entries, got " + std::to_string(face_adj.size()) + ".\n");
+      }
+      std::call_once(this->_face_adj_once, [&]() { this->_face_adj = std::move(face_adj); });
+    }
+  }
+
+  const MeshView<T, I> mesh;  ///< The view this is the geometry of.
+
+  /// @brief Get the area of each face, see `mesh_area_per_face`.
+  const std::vector<double>& face_areas() const {
+    std::call_once(this->_face_areas_once, [this]() { this->_set_face_areas(mesh_area_per_face(this->mesh)); });
+    return this->_face_areas;
+  }
+
+  /// @brief Get the total area of the mesh, see `mesh_area_total`.
+  double area_total() const {
+    this->face_areas();
+    return this->_area_total;
+  }
+
+  /// @brief Get the face adjacency, see `mesh_face_adjacency`.
+  const std::vector<int32_t>& face_adjacency() const {
+    std::call_once(this->_face_adj_once, [this]() { this->_face_adj = mesh_face_adjacency(this->mesh); });
+    return this->_face_adj;
+  }
+
+  /// @brief Get the unique edges, as 2 consecutive vertex indices per edge.
+  /// @return vector of length `2 * ne`. Each edge is stored as its lower and then its higher vertex index, and the edges are sorted in that order.
+  const std::vector<int32_t>& edges() const {
+    std::call_once(this->_edges_once, [this]() {
+      const MeshCSR csr = mesh_csr(this->mesh);
+      this->_edges.reserve(csr.num_edges() * 2);
+      this->_edge_lengths.reserve(csr.num_edges());
+      for(size_t v=0; v<csr.num_vertices(); v++) {
+        for(const int32_t* n = csr.neighbors_begin(v); n != csr.neighbors_end(v); ++n) {
+          if(size_t(*n) > v) {
+            this->_edges.push_back(int32_t(v));
+            this->_edges.push_back(*n);
+            this->_edge_lengths.push_back(_vertex_dist(this->mesh, v, size_t(*n)));
+          }
+        }
+      }
+    });
+    return this->_edges;
+  }
+
+  /// @brief Get the lengths of the unique edges, in the order of `edges`. See `mesh_edge_lengths`.
+  const std::vector<double>& edge_lengths() const {
+    this->edges();
+    return this->_edge_lengths;
+  }
+
+  /// @brief Get the area weighted vertex normals, see `mesh_vnormals`.
+  const std::vector<std::vector<float>>& vnormals() const {
+    std::call_once(this->_vnormals_once, [this]() { this->_vnormals = mesh_vnormals(this->mesh, false); });
+    return this->_vnormals;
+  }
+
+  /// @brief Get the vertex coordinates as `nv x 3` 2D vector, see `mesh_vertex_coords`.
+  const std::vector<std::vector<float>>& vertex_coords() const {
+    std::call_once(this->_vertex_coords_once, [this]() { this->_vertex_coords = mesh_vertex_coords(this->mesh); });
+    return this->_vertex_coords;
+  }
+
+  private:
+  /// @brief Set the face areas and their total.
+  void _set_face_areas(std::vector<double> face_areas) const {
+    this->_face_areas = std::move(face_areas);
+    for(size_t f=0; f<this->_face_areas.size(); f++) {
+      this->_area_total += this->_face_areas[f];
+    }
+  }
+
+  mutable std::once_flag _face_areas_once, _face_adj_once, _edges_once, _vnormals_once, _vertex_coords_once;
+  mutable std::vector<double> _face_areas;
+  mutable double _area_total;
+  mutable std::vector<int32_t> _face_adj;
+  mutable std::vector<int32_t> _edges;
+  mutable std::vector<double> _edge_lengths;
+  mutable std::vector<std::vector<float>> _vnormals;
+  mutable std::vector<std::vector<float>> _vertex_coords;
+};
+
+
+/// @brief Get the cached area of each face of a mesh geometry.
+template<typename T, typename I>
+const std::vector<double>& mesh_area_per_face(const MeshGeometry<T, I>& geom) {
+  return geom.face_areas();
+}
+
+
+/// @brief Get the cached face adjacency of a mesh geometry.
+template<typename T, typename I>
+const std::vector<int32_t>& mesh_face_adjacency(const MeshGeometry<T, I>& geom) {
+  return geom.face_adjacency();
+}
+
+
+/// @brief Get the cached total area of a mesh geometry.
+template<typename T, typename I>
+double mesh_area_total(const MeshGeometry<T, I>& geom) {
+  return geom.area_total();
+}
+
+
+/// @brief Get the cached lengths of the unique edges of a mesh geometry.
+template<typename T, typename I>
+const std::vector<double>& mesh_edge_lengths(const MeshGeometry<T, I>& geom) {
+  return geom.edge_lengths();
+}
+
+
+/// @brief Get the cached area weighted vertex normals of a mesh geometry.
+template<typename T, typename I>
+const std::vector<std::vector<float>>& mesh_vnormals(const MeshGeometry<T, I>& geom) {
+  return geom.vnormals();
+}
+
+
+/// @brief Get the cached vertex coordinates of a mesh geometry.
+template<typename T, typename I>
+const std::vector<std::vector<float>>& mesh_vertex_coords(const MeshGeometry<T, I>& geom) {
+  return geom.vertex_coords();
+}
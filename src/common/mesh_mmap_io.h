@@ -0,0 +1,851 @@
+#pragma once
+
+#include "libfs.h"
+#include "bulk_endian.h"
+#include "mapped_file.h"
+#include "fs_mmap_io.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+// Fast readers for the standard mesh formats PLY (ASCII and binary, both byte orders), Wavefront OBJ and OFF.
+//
+// The libfs readers (`fs::Mesh::from_ply` etc.) parse line by line with getline and stringstream, and `from_ply` only
+// supports ASCII PLY. The readers in here memory-map the file. Binary PLY payloads are copied and byte-swapped in
+// bulk. The data section of text formats is split into chunks at line boundaries, the lines of each chunk are counted
+// in parallel to determine where each chunk starts in the vertex and face arrays, and then all chunks are parsed in
+// parallel with strtof/strtol directly into the preallocated `fs::Mesh` buffers.
+
+
+/// @brief Target size of the chunks the data section of text files is split into for parallel parsing.
+/// @private
+const size_t _TEXT_CHUNK_BYTES = 1 << 20;
+
+
+/// @brief A range `[begin, end)` of a text buffer that starts at a line start and ends after a newline (or at the end of the buffer).
+/// @private
+struct _TextChunk {
+  size_t begin;
+  size_t end;
+};
+
+
+/// @brief Split the text range `[begin, end)` of `buf` into chunks of about `_TEXT_CHUNK_BYTES` bytes at line boundaries.
+/// @private
+std::vector<_TextChunk> _split_text_chunks(const char* buf, const size_t begin, const size_t end) {
+  std::vector<_TextChunk> chunks;
+  size_t pos = begin;
+  while(pos < end) {
+    size_t split = pos + _TEXT_CHUNK_BYTES;
+    if(split >= end) {
+      split = end;
+    } else {
+      const void* nl = std::memchr(buf + split, '\n', end - split);
+      split = (nl == NULL) ? end : size_t(static_cast<const char*>(nl) - buf) + 1;
+    }
+    _TextChunk c;
+    c.begin = pos;
+    c.end = split;
+    chunks.push_back(c);
+    pos = split;
+  }
+  return chunks;
+}
+
+
+/// @brief Get the end of the line starting at `p`, i.e., the position of the next newline or `end`.
+/// @private
+inline const char* _line_end(const char* p, const char* end) {
+  const void* nl = std::memchr(p, '\n', size_t(end - p));
+  return (nl == NULL) ? end : static_cast<const char*>(nl);
+}
+
+
+/// @brief Skip spaces, tabs and carriage returns, but not newlines.
+/// @private
+inline const char* _skip_blanks(const char* p, const char* line_end) {
+  while(p < line_end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+    p++;
+  }
+  return p;
+}
+
+
+/// @brief Parse a float token at `*p`, advance `*p` past it. Returns false if there is no valid number before `line_end`.
+/// @details The buffer must be terminated by whitespace or NUL, see `_TextBuffer`.
+/// @private
+inline bool _parse_float(const char** p, const char* line_end, float* value) {
+  const char* s = _skip_blanks(*p, line_end);
+  if(s >= line_end) {
+    return false;
+  }
+  char* tok_end;
+  *value = std::strtof(s, &tok_end);
+  if(tok_end == s || tok_end > line_end) {
+    return false;
+  }
+  *p = tok_end;
+  return true;
+}
+
+
+/// @brief Parse an integer token at `*p`, advance `*p` past it. Returns false if there is no valid number before `line_end`.
+/// @details Parsing stops at the first non-digit, so for OBJ face tokens like '3/1/2' only the leading '3' is consumed.
+/// @private
+inline bool _parse_long(const char** p, const char* line_end, long* value) {
+  const char* s = _skip_blanks(*p, line_end);
+  if(s >= line_end) {
+    return false;
+  }
+  char* tok_end;
+  *value = std::strtol(s, &tok_end, 10);
+  if(tok_end == s || tok_end > line_end) {
+    return false;
+  }
+  *p = tok_end;
+  return true;
+}
+
+
+/// @brief Skip the next whitespace-separated token. Returns false if there is no token before `line_end`.
+/// @private
+inline bool _skip_token(const char** p, const char* line_end) {
+  const char* s = _skip_blanks(*p, line_end);
+  if(s >= line_end) {
+    return false;
+  }
+  while(s < line_end && *s != ' ' && *s != '\t' && *s != '\r') {
+    s++;
+  }
+  *p = s;
+  return true;
+}
+
+
+/// @brief Skip the remainder of a token, e.g., the '/1/2' part of an OBJ face token '3/1/2'.
+/// @private
+inline void _skip_token_rest(const char** p, const char* line_end) {
+  const char* s = *p;
+  while(s < line_end && *s != ' ' && *s != '\t' && *s != '\r') {
+    s++;
+  }
+  *p = s;
+}
+
+
+/// @brief Memory-mapped file that can be made safe to parse with strtof/strtol.
+/// @details The number parsers stop at whitespace, but would read past the end of the mapping if the file ends in the middle of a number. Call `make_parse_safe()` before parsing text: if the file does not end with whitespace, the contents are copied into a NUL-terminated buffer.
+/// @private
+class _TextBuffer {
+  public:
+    explicit _TextBuffer(const std::string& filename) : mf_(filename), data_(mf_.data()), size_(mf_.size()) {}
+
+    void make_parse_safe() {
+      if(size_ > 0 && data_ == mf_.data()) {
+        const char last = data_[size_ - 1];
+        if(!(last == '\n' || last == ' ' || last == '\t' || last == '\r')) {
+          copy_.assign(data_, size_);
+          data_ = copy_.c_str();
+        }
+      }
+    }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+  private:
+    MappedFile mf_;
+    std::string copy_;
+    const char* data_;
+    size_t size_;
+};
+
+
+/// @brief Throw the first non-empty error message collected by parallel workers, if any.
+/// @private
+inline void _throw_first_error(const std::vector<std::string>& errors) {
+  for(size_t i=0; i<errors.size(); i++) {
+    if(! errors[i].empty()) {
+      throw std::domain_error(errors[i]);
+    }
+  }
+}
+
+
+/// @brief Scalar data types supported in PLY files.
+/// @private
+enum _PlyType { PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64 };
+
+
+/// @brief Parse a PLY type name like 'uchar' or 'float32'.
+/// @throws std::domain_error for unknown type names.
+/// @private
+inline _PlyType _ply_type(const std::string& name) {
+  if(name == "char" || name == "int8") return PLY_INT8;
+  if(name == "uchar" || name == "uint8") return PLY_UINT8;
+  if(name == "short" || name == "int16") return PLY_INT16;
+  if(name == "ushort" || name == "uint16") return PLY_UINT16;
+  if(name == "int" || name == "int32") return PLY_INT32;
+  if(name == "uint" || name == "uint32") return PLY_UINT32;
+  if(name == "float" || name == "float32") return PLY_FLOAT32;
+  if(name == "double" || name == "float64") return PLY_FLOAT64;
+  throw std::domain_error("Unsupported PLY property type '" + name + "'.\n");
+}
+
+
+/// @brief Get the size in bytes of a PLY scalar type.
+/// @private
+inline size_t _ply_type_size(const _PlyType t) {
+  switch(t) {
+    case PLY_INT8: case PLY_UINT8: return 1;
+    case PLY_INT16: case PLY_UINT16: return 2;
+    case PLY_INT32: case PLY_UINT32: case PLY_FLOAT32: return 4;
+    default: return 8;
+  }
+}
+
+
+/// @brief Read a binary PLY scalar of the given type from `p`, swapping bytes if `swap` is set.
+/// @private
+template <typename T>
+inline T _ply_value_as(const char* p, const _PlyType t, const bool swap) {
+  switch(t) {
+    case PLY_INT8: { int8_t v; std::memcpy(&v, p, 1); return T(v); }
+    case PLY_UINT8: { uint8_t v; std::memcpy(&v, p, 1); return T(v); }
+    case PLY_INT16: { int16_t v; std::memcpy(&v, p, 2); if(swap) bswap_inplace(&v, 1); return T(v); }
+    case PLY_UINT16: { uint16_t v; std::memcpy(&v, p, 2); if(swap) bswap_inplace(&v, 1); return T(v); }
+    case PLY_INT32: { int32_t v; std::memcpy(&v, p, 4); if(swap) bswap_inplace(&v, 1); return T(v); }
+    case PLY_UINT32: { uint32_t v; std::memcpy(&v, p, 4); if(swap) bswap_inplace(&v, 1); return T(v); }
+    case PLY_FLOAT32: { float v; std::memcpy(&v, p, 4); if(swap) bswap_inplace(&v, 1); return T(v); }
+    default: { double v; std::memcpy(&v, p, 8); if(swap) bswap_inplace(&v, 1); return T(v); }
+  }
+}
+
+
+/// @brief A property of a PLY element, either a scalar or a list.
+/// @private
+struct _PlyProperty {
+  std::string name;
+  bool is_list;
+  _PlyType count_type;  ///< Type of the list length, only used for lists.
+  _PlyType type;        ///< Type of the scalar, or of the list items.
+};
+
+
+/// @brief A PLY element, like 'vertex' or 'face', with its number of rows and its properties.
+/// @private
+struct _PlyElement {
+  std::string name;
+  size_t count;
+  std::vector<_PlyProperty> props;
+
+  /// @brief Get the index of the property with the given name, or -1 if there is none.
+  int prop_index(const std::string& prop_name) const {
+    for(size_t i=0; i<props.size(); i++) {
+      if(props[i].name == prop_name) {
+        return int(i);
+      }
+    }
+    return -1;
+  }
+
+  /// @brief Whether all properties are scalars, so that all rows have the same size in binary files.
+  bool is_fixed_size() const {
+    for(size_t i=0; i<props.size(); i++) {
+      if(props[i].is_list) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /// @brief Get the byte offset of each property within a binary row. Only valid if `is_fixed_size()`.
+  std::vector<size_t> scalar_offsets(size_t* row_size) const {
+    std::vector<size_t> offsets(props.size());
+    size_t off = 0;
+    for(size_t i=0; i<props.size(); i++) {
+      offsets[i] = off;
+      off += _ply_type_size(props[i].type);
+    }
+    *row_size = off;
+    return offsets;
+  }
+};
+
+
+/// @brief The parsed header of a PLY file.
+/// @private
+struct _PlyHeader {
+  enum Format { ASCII, BINARY_LE, BINARY_BE } format;
+  std::vector<_PlyElement> elements;
+  size_t data_start;  ///< Byte offset of the first data byte after the header.
+};
+
+
+/// @brief Parse the header of a PLY file.
+/// @throws std::domain_error if the header is invalid or uses unsupported features.
+/// @private
+_PlyHeader _parse_ply_header(const char* buf, const size_t size, const std::string& filename) {
+  _PlyHeader header;
+  header.format = _PlyHeader::ASCII;
+  bool have_format = false;
+  size_t pos = 0;
+  size_t line_idx = 0;
+  while(true) {
+    if(pos >= size) {
+      throw std::domain_error("Invalid PLY file '" + filename + "': header not terminated by 'end_header'.\n");
+    }
+    const char* lend = _line_end(buf + pos, buf + size);
+    std::string line(buf + pos, lend);
+    pos = size_t(lend - buf) + 1;
+    if(! line.empty() && line[line.size() - 1] == '\r') {
+      line.erase(line.size() - 1);
+    }
+    if(line_idx++ == 0) {
+      if(line != "ply") {
+        throw std::domain_error("Invalid PLY file '" + filename + "': missing 'ply' magic line.\n");
+      }
+      continue;
+    }
+    std::istringstream iss(line);
+    std::string keyword;
+    iss >> keyword;
+    if(keyword == "end_header") {
+      break;
+    } else if(keyword == "format") {
+      std::string fmt, version;
+      iss >> fmt >> version;
+      if(fmt == "ascii") {
+        header.format = _PlyHeader::ASCII;
+      } else if(fmt == "binary_little_endian") {
+        header.format = _PlyHeader::BINARY_LE;
+      } else if(fmt == "binary_big_endian") {
+        header.format = _PlyHeader::BINARY_BE;
+      } else {
+        throw std::domain_error("Unsupported PLY format '" + fmt + "' in file '" + filename + "'.\n");
+      }
+      have_format = true;
+    } else if(keyword == "element") {
+      _PlyElement elem;
+      long long count;
+      if(!(iss >> elem.name >> count) || count < 0) {
+        throw std::domain_error("Could not parse element line '" + line + "' of PLY header in file '" + filename + "'.\n");
+      }
+      elem.count = size_t(count);
+      header.elements.push_back(elem);
+    } else if(keyword == "property") {
+      if(header.elements.empty()) {
+        throw std::domain_error("PLY header of file '" + filename + "' contains a property before the first element.\n");
+      }
+      _PlyProperty prop;
+      std::string t1;
+      iss >> t1;
+      if(t1 == "list") {
+        std::string tc, ti;
+        iss >> tc >> ti >> prop.name;
+        prop.is_list = true;
+        prop.count_type = _ply_type(tc);
+        prop.type = _ply_type(ti);
+      } else {
+        iss >> prop.name;
+        prop.is_list = false;
+        prop.count_type = PLY_UINT8;
+        prop.type = _ply_type(t1);
+      }
+      header.elements.back().props.push_back(prop);
+    } // Other lines, like 'comment' and 'obj_info', are ignored.
+  }
+  if(! have_format) {
+    throw std::domain_error("Invalid PLY file '" + filename + "': missing format line.\n");
+  }
+  header.data_start = pos;
+  return header;
+}
+
+
+/// @brief Get the index of the face vertex list property of a PLY face element.
+/// @throws std::domain_error if there is none.
+/// @private
+inline int _ply_face_list_index(const _PlyElement& elem, const std::string& filename) {
+  int idx = elem.prop_index("vertex_indices");
+  if(idx < 0) {
+    idx = elem.prop_index("vertex_index");
+  }
+  if(idx < 0 || ! elem.props[idx].is_list) {
+    throw std::domain_error("PLY face element in file '" + filename + "' has no 'vertex_indices' list property.\n");
+  }
+  return idx;
+}
+
+
+/// @brief Read the binary data section of a PLY file into the mesh.
+/// @private
+void _read_ply_binary(fs::Mesh* mesh, const char* buf, const size_t size, const _PlyHeader& header, const std::string& filename) {
+  const bool swap = (header.format == _PlyHeader::BINARY_BE) != host_is_bigendian();
+  const std::string truncated_msg = "PLY file '" + filename + "' is truncated.\n";
+  size_t pos = header.data_start;
+
+  for(size_t e=0; e<header.elements.size(); e++) {
+    const _PlyElement& elem = header.elements[e];
+    const size_t n = elem.count;
+
+    if(elem.name == "vertex" && elem.is_fixed_size()) {
+      const int ix = elem.prop_index("x"), iy = elem.prop_index("y"), iz = elem.prop_index("z");
+      if(ix < 0 || iy < 0 || iz < 0) {
+        throw std::domain_error("PLY vertex element in file '" + filename + "' must have x, y and z properties.\n");
+      }
+      size_t stride;
+      const std::vector<size_t> offsets = elem.scalar_offsets(&stride);
+      if(size - pos < n * stride) {
+        throw std::domain_error(truncated_msg);
+      }
+      mesh->vertices.resize(n * 3);
+      float* out = mesh->vertices.data();
+      const char* src = buf + pos;
+      if(stride == 12 && offsets[ix] == 0 && offsets[iy] == 4 && offsets[iz] == 8 && elem.props[ix].type == PLY_FLOAT32 && elem.props[iy].type == PLY_FLOAT32 && elem.props[iz].type == PLY_FLOAT32) {
+        std::memcpy(out, src, n * 12); // Packed float xyz: bulk copy and swap.
+        if(swap) {
+          bswap_inplace(out, n * 3);
+        }
+      } else {
+        const size_t ox = offsets[ix], oy = offsets[iy], oz = offsets[iz];
+        const _PlyType tx = elem.props[ix].type, ty = elem.props[iy].type, tz = elem.props[iz].type;
+        const int64_t n_signed = int64_t(n);
+        # pragma omp parallel for schedule(static)
+        for(int64_t i=0; i<n_signed; i++) {
+          const char* row = src + size_t(i) * stride;
+          out[i*3] = _ply_value_as<float>(row + ox, tx, swap);
+          out[i*3+1] = _ply_value_as<float>(row + oy, ty, swap);
+          out[i*3+2] = _ply_value_as<float>(row + oz, tz, swap);
+        }
+      }
+      pos += n * stride;
+      continue;
+    }
+
+    const bool is_vertex = elem.name == "vertex";
+    const bool is_face = elem.name == "face";
+    const int fl = is_face ? _ply_face_list_index(elem, filename) : -1;
+    if(is_vertex) {
+      // Vertex element with list properties, rows have variable size.
+      if(elem.prop_index("x") < 0 || elem.prop_index("y") < 0 || elem.prop_index("z") < 0) {
+        throw std::domain_error("PLY vertex element in file '" + filename + "' must have x, y and z properties.\n");
+      }
+      mesh->vertices.resize(n * 3);
+    }
+    if(is_face) {
+      mesh->faces.resize(n * 3);
+      if(elem.props.size() == 1) {
+        // Only the vertex index list: fixed row size if all faces are triangles, which we require anyways.
+        const _PlyProperty& p = elem.props[0];
+        const size_t csz = _ply_type_size(p.count_type), isz = _ply_type_size(p.type);
+        const size_t stride = csz + 3 * isz;
+        if(size - pos < n * stride) {
+          throw std::domain_error(truncated_msg);
+        }
+        const char* src = buf + pos;
+        int32_t* out = mesh->faces.data();
+        const int64_t n_signed = int64_t(n);
+        int64_t bad_face = -1;
+        # pragma omp parallel for schedule(static)
+        for(int64_t i=0; i<n_signed; i++) {
+          const char* row = src + size_t(i) * stride;
+          if(_ply_value_as<int64_t>(row, p.count_type, swap) != 3) {
+            # pragma omp critical
+            bad_face = i;
+            continue;
+          }
+          for(size_t k=0; k<3; k++) {
+            out[i*3+k] = _ply_value_as<int32_t>(row + csz + k * isz, p.type, swap);
+          }
+        }
+        if(bad_face >= 0) {
+          throw std::domain_error("Only triangular meshes are supported: face " + std::to_string(bad_face) + " in PLY file '" + filename + "' does not have exactly 3 vertices.\n");
+        }
+        pos += n * stride;
+        continue;
+      }
+    }
+
+    // Generic row-by-row walk, for faces with extra properties and for other elements, which are skipped.
+    for(size_t i=0; i<n; i++) {
+      for(size_t k=0; k<elem.props.size(); k++) {
+        const _PlyProperty& p = elem.props[k];
+        if(p.is_list) {
+          const size_t csz = _ply_type_size(p.count_type), isz = _ply_type_size(p.type);
+          if(size - pos < csz) {
+            throw std::domain_error(truncated_msg);
+          }
+          const int64_t cnt = _ply_value_as<int64_t>(buf + pos, p.count_type, swap);
+          pos += csz;
+          if(cnt < 0 || size - pos < size_t(cnt) * isz) {
+            throw std::domain_error(truncated_msg);
+          }
+          if(is_face && int(k) == fl) {
+            if(cnt != 3) {
+              throw std::domain_error("Only triangular meshes are supported: face " + std::to_string(i) + " in PLY file '" + filename + "' does not have exactly 3 vertices.\n");
+            }
+            for(size_t j=0; j<3; j++) {
+              mesh->faces[i*3+j] = _ply_value_as<int32_t>(buf + pos + j * isz, p.type, swap);
+            }
+          }
+          pos += size_t(cnt) * isz;
+        } else {
+          const size_t sz = _ply_type_size(p.type);
+          if(size - pos < sz) {
+            throw std::domain_error(truncated_msg);
+          }
+          if(is_vertex && (p.name == "x" || p.name == "y" || p.name == "z")) {
+            mesh->vertices[i*3 + size_t(p.name[0] - 'x')] = _ply_value_as<float>(buf + pos, p.type, swap);
+          }
+          pos += sz;
+        }
+      }
+    }
+  }
+}
+
+
+/// @brief Read the ASCII data section of a PLY file into the mesh, in parallel.
+/// @private
+void _read_ply_ascii(fs::Mesh* mesh, const char* buf, const size_t size, const _PlyHeader& header, const std::string& filename) {
+  // Each element row is one line. Compute the first line of each element.
+  const size_t ne = header.elements.size();
+  std::vector<size_t> elem_first_line(ne + 1, 0);
+  int vertex_elem = -1, face_elem = -1;
+  for(size_t e=0; e<ne; e++) {
+    elem_first_line[e+1] = elem_first_line[e] + header.elements[e].count;
+    if(header.elements[e].name == "vertex") {
+      vertex_elem = int(e);
+    } else if(header.elements[e].name == "face") {
+      face_elem = int(e);
+    }
+  }
+  const size_t total_lines = elem_first_line[ne];
+  int vx = -1, vy = -1, vz = -1, fl = -1;
+  if(vertex_elem >= 0) {
+    const _PlyElement& ve = header.elements[vertex_elem];
+    vx = ve.prop_index("x"); vy = ve.prop_index("y"); vz = ve.prop_index("z");
+    if(vx < 0 || vy < 0 || vz < 0) {
+      throw std::domain_error("PLY vertex element in file '" + filename + "' must have x, y and z properties.\n");
+    }
+    mesh->vertices.resize(ve.count * 3);
+  } else {
+    mesh->vertices.clear();
+  }
+  if(face_elem >= 0) {
+    fl = _ply_face_list_index(header.elements[face_elem], filename);
+    mesh->faces.resize(header.elements[face_elem].count * 3);
+  } else {
+    mesh->faces.clear();
+  }
+
+  // Pass 1: count lines per chunk, to know the global line index at which each chunk starts.
+  const std::vector<_TextChunk> chunks = _split_text_chunks(buf, header.data_start, size);
+  const int64_t nc = int64_t(chunks.size());
+  std::vector<size_t> chunk_first_line(chunks.size() + 1, 0);
+  # pragma omp parallel for schedule(dynamic, 1)
+  for(int64_t c=0; c<nc; c++) {
+    size_t num_lines = 0;
+    const char* p = buf + chunks[c].begin;
+    const char* end = buf + chunks[c].end;
+    while(p < end) {
+      p = _line_end(p, end) + 1;
+      num_lines++;
+    }
+    chunk_first_line[c+1] = num_lines;
+  }
+  for(size_t c=0; c<chunks.size(); c++) {
+    chunk_first_line[c+1] += chunk_first_line[c];
+  }
+  if(chunk_first_line[chunks.size()] < total_lines) {
+    throw std::domain_error("PLY file '" + filename + "' is truncated: expected " + std::to_string(total_lines) + " data lines, found " + std::to_string(chunk_first_line[chunks.size()]) + ".\n");
+  }
+
+  // Pass 2: parse all lines of all chunks.
+  std::vector<std::string> errors(chunks.size());
+  float* vout = mesh->vertices.data();
+  int32_t* fout = mesh->faces.data();
+  # pragma omp parallel for schedule(dynamic, 1)
+  for(int64_t c=0; c<nc; c++) {
+    size_t line = chunk_first_line[c];
+    size_t e = 0;
+    while(e < ne && elem_first_line[e+1] <= line) {
+      e++;
+    }
+    const char* p = buf + chunks[c].begin;
+    const char* end = buf + chunks[c].end;
+    for(; p < end && line < total_lines; line++) {
+      const char* lend = _line_end(p, end);
+      while(elem_first_line[e+1] <= line) {
+        e++;
+      }
+      if(int(e) == vertex_elem || int(e) == face_elem) {
+        const _PlyElement& elem = header.elements[e];
+        const size_t row = line - elem_first_line[e];
+        const char* q = p;
+        bool ok = true;
+        for(size_t k=0; k<elem.props.size() && ok; k++) {
+          const _PlyProperty& prop = elem.props[k];
+          if(prop.is_list) {
+            long cnt = 0;
+            ok = _parse_long(&q, lend, &cnt);
+            if(ok && int(e) == face_elem && int(k) == fl) {
+              if(cnt != 3) {
+                errors[c] = "Only triangular meshes are supported: PLY face lines in file '" + filename + "' must contain exactly 3 vertex indices.\n";
+                ok = false;
+                break;
+              }
+              for(size_t j=0; j<3 && ok; j++) {
+                long idx = 0;
+                ok = _parse_long(&q, lend, &idx);
+                fout[row*3+j] = int32_t(idx);
+              }
+            } else {
+              for(long j=0; j<cnt && ok; j++) {
+                ok = _skip_token(&q, lend);
+              }
+            }
+          } else if(int(e) == vertex_elem && (int(k) == vx || int(k) == vy || int(k) == vz)) {
+            ok = _parse_float(&q, lend, &vout[row*3 + size_t(prop.name[0] - 'x')]);
+          } else {
+            ok = _skip_token(&q, lend);
+          }
+        }
+        if(! ok) {
+          if(errors[c].empty()) {
+            errors[c] = "Could not parse " + elem.name + " line " + std::to_string(row) + " of PLY data in file '" + filename + "', invalid format.\n";
+          }
+          break;
+        }
+      }
+      p = lend + 1;
+    }
+  }
+  _throw_first_error(errors);
+}
+
+
+/// @brief Read a mesh from a Stanford PLY file in ASCII or binary (little or big endian) format.
+/// @details Vertex coordinates are taken from the x, y and z properties of the 'vertex' element, faces from the 'vertex_indices' list of the 'face' element. Other elements and properties (like colors or normals) are ignored.
+/// @param mesh the mesh to fill. Its vertex and face buffers are replaced.
+/// @param filename path to the PLY file.
+/// @throws std::runtime_error if the file cannot be opened, std::domain_error if the file is invalid, truncated, or contains non-triangular faces.
+void read_ply_mmap(fs::Mesh* mesh, const std::string& filename) {
+  _TextBuffer tb(filename);
+  const _PlyHeader header = _parse_ply_header(tb.data(), tb.size(), filename);
+  if(header.format == _PlyHeader::ASCII) {
+    tb.make_parse_safe();
+    _read_ply_ascii(mesh, tb.data(), tb.size(), header, filename);
+  } else {
+    _read_ply_binary(mesh, tb.data(), tb.size(), header, filename);
+  }
+}
+
+
+/// @brief Read a mesh from a Wavefront OBJ file, in parallel.
+/// @details Only the geometry is read: lines starting with 'v ' and 'f '. Face tokens like '3/1/2' are supported, as are negative (relative) vertex indices. Like libfs, only the first 3 vertices of each face are used.
+/// @param mesh the mesh to fill. Its vertex and face buffers are replaced.
+/// @param filename path to the OBJ file.
+/// @throws std::runtime_error if the file cannot be opened, std::domain_error if the file is invalid.
+void read_obj_mmap(fs::Mesh* mesh, const std::string& filename) {
+  _TextBuffer tb(filename);
+  tb.make_parse_safe();
+  const char* buf = tb.data();
+  const std::vector<_TextChunk> chunks = _split_text_chunks(buf, 0, tb.size());
+  const int64_t nc = int64_t(chunks.size());
+
+  // Pass 1: count vertex and face lines per chunk.
+  std::vector<size_t> chunk_first_vert(chunks.size() + 1, 0), chunk_first_face(chunks.size() + 1, 0);
+  # pragma omp parallel for schedule(dynamic, 1)
+  for(int64_t c=0; c<nc; c++) {
+    size_t nv = 0, nf = 0;
+    const char* p = buf + chunks[c].begin;
+    const char* end = buf + chunks[c].end;
+    while(p < end) {
+      const char* lend = _line_end(p, end);
+      if(lend - p >= 2 && p[1] == ' ') {
+        if(p[0] == 'v') nv++;
+        else if(p[0] == 'f') nf++;
+      }
+      p = lend + 1;
+    }
+    chunk_first_vert[c+1] = nv;
+    chunk_first_face[c+1] = nf;
+  }
+  for(size_t c=0; c<chunks.size(); c++) {
+    chunk_first_vert[c+1] += chunk_first_vert[c];
+    chunk_first_face[c+1] += chunk_first_face[c];
+  }
+  mesh->vertices.resize(chunk_first_vert[chunks.size()] * 3);
+  mesh->faces.resize(chunk_first_face[chunks.size()] * 3);
+
+  // Pass 2: parse.
+  std::vector<std::string> errors(chunks.size());
+  float* vout = mesh->vertices.data();
+  int32_t* fout = mesh->faces.data();
+  # pragma omp parallel for schedule(dynamic, 1)
+  for(int64_t c=0; c<nc; c++) {
+    size_t vi = chunk_first_vert[c], fi = chunk_first_face[c];
+    const char* p = buf + chunks[c].begin;
+    const char* end = buf + chunks[c].end;
+    while(p < end) {
+      const char* lend = _line_end(p, end);
+      if(lend - p >= 2 && p[1] == ' ') {
+        const char* q = p + 2;
+        if(p[0] == 'v') {
+          if(!(_parse_float(&q, lend, &vout[vi*3]) && _parse_float(&q, lend, &vout[vi*3+1]) && _parse_float(&q, lend, &vout[vi*3+2]))) {
+            errors[c] = "Could not parse vertex " + std::to_string(vi) + " of OBJ file '" + filename + "', invalid format.\n";
+            break;
+          }
+          vi++;
+        } else if(p[0] == 'f') {
+          for(size_t j=0; j<3; j++) {
+            long idx = 0;
+            if(! _parse_long(&q, lend, &idx) || idx == 0) {
+              errors[c] = "Could not parse face " + std::to_string(fi) + " of OBJ file '" + filename + "', invalid format.\n";
+              break;
+            }
+            _skip_token_rest(&q, lend);
+            // OBJ indices are 1-based, negative ones are relative to the last vertex defined so far.
+            fout[fi*3+j] = int32_t(idx > 0 ? idx - 1 : long(vi) + idx);
+          }
+          if(! errors[c].empty()) {
+            break;
+          }
+          fi++;
+        }
+      }
+      p = lend + 1;
+    }
+  }
+  _throw_first_error(errors);
+}
+
+
+/// @brief Read a mesh from an Object File Format (OFF) file, in parallel.
+/// @details Supports 'OFF' and 'COFF' files. Lines starting with '#' are ignored. Vertex colors are ignored.
+/// @param mesh the mesh to fill. Its vertex and face buffers are replaced.
+/// @param filename path to the OFF file.
+/// @throws std::runtime_error if the file cannot be opened, std::domain_error if the file is invalid, truncated, or contains non-triangular faces.
+void read_off_mmap(fs::Mesh* mesh, const std::string& filename) {
+  _TextBuffer tb(filename);
+  tb.make_parse_safe();
+  const char* buf = tb.data();
+  const size_t size = tb.size();
+
+  // Header: the magic line and the element count line, skipping comments.
+  size_t pos = 0;
+  size_t num_header_lines = 0;
+  long long num_vertices = 0, num_faces = 0;
+  while(num_header_lines < 2) {
+    if(pos >= size) {
+      throw std::domain_error("Invalid OFF file '" + filename + "': incomplete header.\n");
+    }
+    const char* lend = _line_end(buf + pos, buf + size);
+    std::string line(buf + pos, lend);
+    pos = size_t(lend - buf) + 1;
+    if(fs::util::starts_with(line, "#")) {
+      continue;
+    }
+    std::istringstream iss(line);
+    if(num_header_lines == 0) {
+      std::string magic;
+      iss >> magic;
+      if(!(magic == "OFF" || magic == "COFF")) {
+        throw std::domain_error("OFF magic string invalid, file '" + filename + "' not in OFF format.\n");
+      }
+    } else {
+      if(!(iss >> num_vertices >> num_faces) || num_vertices < 0 || num_faces < 0) {
+        throw std::domain_error("Could not parse element count header line of OFF file '" + filename + "', invalid format.\n");
+      }
+    }
+    num_header_lines++;
+  }
+  const size_t nv = size_t(num_vertices), nf = size_t(num_faces);
+  const size_t total_lines = nv + nf;
+  mesh->vertices.resize(nv * 3);
+  mesh->faces.resize(nf * 3);
+
+  // Pass 1: count non-comment lines per chunk.
+  const std::vector<_TextChunk> chunks = _split_text_chunks(buf, std::min(pos, size), size);
+  const int64_t nc = int64_t(chunks.size());
+  std::vector<size_t> chunk_first_line(chunks.size() + 1, 0);
+  # pragma omp parallel for schedule(dynamic, 1)
+  for(int64_t c=0; c<nc; c++) {
+    size_t num_lines = 0;
+    const char* p = buf + chunks[c].begin;
+    const char* end = buf + chunks[c].end;
+    while(p < end) {
+      if(*p != '#') num_lines++;
+      p = _line_end(p, end) + 1;
+    }
+    chunk_first_line[c+1] = num_lines;
+  }
+  for(size_t c=0; c<chunks.size(); c++) {
+    chunk_first_line[c+1] += chunk_first_line[c];
+  }
+  if(chunk_first_line[chunks.size()] < total_lines) {
+    throw std::domain_error("Vertex or face count mismatch between OFF file '" + filename + "' header and data: expected " + std::to_string(total_lines) + " data lines, found " + std::to_string(chunk_first_line[chunks.size()]) + ".\n");
+  }
+
+  // Pass 2: parse.
+  std::vector<std::string> errors(chunks.size());
+  float* vout = mesh->vertices.data();
+  int32_t* fout = mesh->faces.data();
+  # pragma omp parallel for schedule(dynamic, 1)
+  for(int64_t c=0; c<nc; c++) {
+    size_t line = chunk_first_line[c];
+    const char* p = buf + chunks[c].begin;
+    const char* end = buf + chunks[c].end;
+    while(p < end && line < total_lines) {
+      const char* lend = _line_end(p, end);
+      if(*p != '#') {
+        const char* q = p;
+        if(line < nv) {
+          if(!(_parse_float(&q, lend, &vout[line*3]) && _parse_float(&q, lend, &vout[line*3+1]) && _parse_float(&q, lend, &vout[line*3+2]))) {
+            errors[c] = "Could not parse vertex " + std::to_string(line) + " of OFF file '" + filename + "', invalid format.\n";
+            break;
+          }
+        } else {
+          const size_t fi = line - nv;
+          long cnt, v0, v1, v2;
+          if(!(_parse_long(&q, lend, &cnt) && _parse_long(&q, lend, &v0) && _parse_long(&q, lend, &v1) && _parse_long(&q, lend, &v2))) {
+            errors[c] = "Could not parse face " + std::to_string(fi) + " of OFF file '" + filename + "', invalid format.\n";
+            break;
+          }
+          if(cnt != 3) {
+            errors[c] = "At OFF file '" + filename + "' face " + std::to_string(fi) + ": only triangular meshes supported.\n";
+            break;
+          }
+          fout[fi*3] = int32_t(v0); fout[fi*3+1] = int32_t(v1); fout[fi*3+2] = int32_t(v2);
+        }
+        line++;
+      }
+      p = lend + 1;
+    }
+  }
+  _throw_first_error(errors);
+}
+
+
+/// @brief Read a triangular mesh from a file with the fast memory-mapped readers. Drop-in replacement for `fs::read_mesh`.
+/// @details The format is determined from the file extension like in libfs: files ending with '.obj', '.ply' or '.off' are read as Wavefront OBJ, Stanford PLY (ASCII or binary) or OFF files, all others as FreeSurfer surf files.
+/// @throws std::runtime_error if the file cannot be opened, std::domain_error if the file is invalid.
+void read_mesh_mmap(fs::Mesh* surface, const std::string& filename) {
+  if(fs::util::ends_with(filename, ".obj")) {
+    read_obj_mmap(surface, filename);
+  } else if(fs::util::ends_with(filename, ".ply")) {
+    read_ply_mmap(surface, filename);
+  } else if(fs::util::ends_with(filename, ".off")) {
+    read_off_mmap(surface, filename);
+  } else {
+    read_surf_mmap(surface, filename);
+  }
+}
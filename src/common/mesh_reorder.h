@@ -0,0 +1,331 @@
+#pragma once
+
+#include "libfs.h"
+#include "mesh_view.h"
+#include "mesh_csr.h"
+#include "geod_engine.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+// Vertex reordering of meshes for better cache locality.
+//
+// The vertex order of FreeSurfer meshes comes from the tessellation (or icosahedron subdivision), so the neighbors
+// of a vertex are often far apart in the vertex arrays, and graph searches like the Dijkstra in `geod_engine.h` spend
+// much of their time waiting for cache misses on the distance and adjacency arrays. The functions in here compute a
+// vertex order in which mesh neighbors get close indices, either Reverse Cuthill-McKee (RCM) on the mesh graph or a
+// Morton (Z-order) curve over the vertex coordinates, and apply it to a mesh. Run the computation on the reordered mesh,
+// then map the per-vertex results and neighbor indices back to the original order with the `*_to_orig` functions.
+// See the `bench_reorder` app for the effect on cache misses and run time.
+
+
+/// @brief A vertex permutation of a mesh, stored in both directions.
+struct VertexOrder {
+  std::vector<int32_t> new_to_old;  ///< For each vertex of the reordered mesh, its index in the original mesh.
+  std::vector<int32_t> old_to_new;  ///< For each vertex of the original mesh, its index in the reordered mesh.
+
+  /// @brief Get the number of vertices.
+  size_t size() const {
+    return this->new_to_old.size();
+  }
+};
+
+
+/// @brief Create a vertex order from the original vertex index of each new vertex.
+/// @param new_to_old for each vertex of the reordered mesh, its index in the original mesh.
+/// @throws std::invalid_argument if `new_to_old` is not a permutation of `0` to `n-1`.
+VertexOrder vertex_order_from_permutation(const std::vector<int32_t>& new_to_old) {
+  const size_t nv = new_to_old.size();
+  VertexOrder order;
+  order.new_to_old = new_to_old;
+  order.old_to_new.assign(nv, -1);
+  for(size_t i=0; i<nv; i++) {
+    const int32_t old = new_to_old[i];
+    if(old < 0 || size_t(old) >= nv || order.old_to_new[old] != -1) {
+      throw std::invalid_argument("Vertex order is not a permutation: invalid or duplicate index " + std::to_string(old) + " at position " + std::to_string(i) + ".\n");
+    }
+    order.old_to_new[old] = int32_t(i);
+  }
+  return order;
+}
+
+
+/// @brief Get the identity order for `num_vertices` vertices.
+VertexOrder vertex_order_identity(const size_t num_vertices) {
+  std::vector<int32_t> new_to_old(num_vertices);
+  for(size_t i=0; i<num_vertices; i++) {
+    new_to_old[i] = int32_t(i);
+  }
+  VertexOrder order;
+  order.new_to_old = new_to_old;
+  order.old_to_new = new_to_old;
+  return order;
+}
+
+
+/// @brief Breadth-first search from `root` that records the levels, used to find a pseudo-peripheral vertex.
+/// @param mark work array of length `nv`, entries reached by this search are set to `stamp`.
+/// @param queue output, the reached vertices in BFS order.
+/// @param last_level_start output, index into `queue` of the first vertex of the last level.
+/// @return the number of levels, i.e., the eccentricity of `root` plus 1.
+/// @private
+inline size_t _rcm_bfs_levels(const MeshCSR& csr, const int32_t root, std::vector<int32_t>& mark, const int32_t stamp, std::vector<int32_t>& queue, size_t& last_level_start) {
+  queue.clear();
+  queue.push_back(root);
+  mark[root] = stamp;
+  size_t level_start = 0, num_levels = 0;
+  while(level_start < queue.size()) {
+    const size_t level_end = queue.size();
+    last_level_start = level_start;
+    num_levels++;
+    for(size_t i=level_start; i<level_end; i++) {
+      for(const int32_t* n = csr.neighbors_begin(queue[i]); n != csr.neighbors_end(queue[i]); ++n) {
+        if(mark[*n] != stamp) {
+          mark[*n] = stamp;
+          queue.push_back(*n);
+        }
+      }
+    }
+    level_start = level_end;
+  }
+  return num_levels;
+}
+
+
+/// @brief Compute the Reverse Cuthill-McKee (RCM) vertex order of a mesh graph.
+/// @details Each connected component is numbered by a breadth-first search from a pseudo-peripheral vertex (found with the George-Liu heuristic), visiting the new neighbors of each vertex in order of increasing degree. The resulting order is reversed. This minimizes the bandwidth of the adjacency matrix, i.e., the index distance between mesh neighbors.
+/// @param csr the adjacency of the mesh, see `mesh_csr`.
+VertexOrder vertex_order_rcm(const MeshCSR& csr) {
+  const size_t nv = csr.num_vertices();
+  std::vector<int32_t> new_to_old;
+  new_to_old.reserve(nv);
+  std::vector<char> numbered(nv, 0);
+  std::vector<int32_t> mark(nv, -1);
+  std::vector<int32_t> queue, next;
+  int32_t stamp = 0;
+  const size_t max_root_iterations = 8;  // George-Liu usually converges after 2 or 3.
+
+  for(size_t s=0; s<nv; s++) {
+    if(numbered[s]) {
+      continue;
+    }
+    // Find a pseudo-peripheral vertex of the component of s: move to a vertex of minimal degree in the last BFS level as long as the eccentricity grows.
+    int32_t root = int32_t(s);
+    size_t last_level_start = 0;
+    size_t num_levels = _rcm_bfs_levels(csr, root, mark, stamp++, queue, last_level_start);
+    for(size_t it=0; it<max_root_iterations; it++) {
+      int32_t candidate = queue[last_level_start];
+      for(size_t i=last_level_start; i<queue.size(); i++) {
+        if(csr.degree(queue[i]) < csr.degree(candidate)) {
+          candidate = queue[i];
+        }
+      }
+      size_t cand_last_level_start = 0;
+      const size_t cand_num_levels = _rcm_bfs_levels(csr, candidate, mark, stamp++, queue, cand_last_level_start);
+      if(cand_num_levels <= num_levels) {
+        break;
+      }
+      root = candidate;
+      num_levels = cand_num_levels;
+      last_level_start = cand_last_level_start;
+    }
+
+    // Cuthill-McKee numbering of the component, new neighbors are numbered by increasing degree.
+    size_t head = new_to_old.size();
+    new_to_old.push_back(root);
+    numbered[root] = 1;
+    while(head < new_to_old.size()) {
+      const int32_t cur = new_to_old[head++];
+      next.clear();
+      for(const int32_t* n = csr.neighbors_begin(cur); n != csr.neighbors_end(cur); ++n) {
+        if(! numbered[*n]) {
+          numbered[*n] = 1;
+          next.push_back(*n);
+        }
+      }
+      std::stable_sort(next.begin(), next.end(), [&csr](const int32_t a, const int32_t b) { return csr.degree(a) < csr.degree(b); });
+      new_to_old.insert(new_to_old.end(), next.begin(), next.end());
+    }
+  }
+  std::reverse(new_to_old.begin(), new_to_old.end());
+  return vertex_order_from_permutation(new_to_old);
+}
+
+
+/// @brief Spread the lower 21 bits of `x` so that there are 2 zero bits between each of them, for 3D Morton codes.
+/// @private
+inline uint64_t _morton_spread_bits(uint64_t x) {
+  x &= 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffffULL;
+  x = (x | x << 16) & 0x1f0000ff0000ffULL;
+  x = (x | x << 8) & 0x100f00f00f00f00fULL;
+  x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+  x = (x | x << 2) & 0x1249249249249249ULL;
+  return x;
+}
+
+
+/// @brief Compute the Morton (Z-order) vertex order of a mesh, from its vertex coordinates.
+/// @details The coordinates are quantized to 21 bits per axis over the bounding box of the mesh, and the vertices are sorted by the interleaved bits. Vertices with identical codes keep their relative order. Unlike RCM, this does not need the adjacency, but it does not follow the surface, so it is usually a bit less local for folded surfaces.
+template<typename T, typename I>
+VertexOrder vertex_order_morton(const MeshView<T, I>& m) {
+  const size_t nv = m.num_vertices();
+  double min_c[3] = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+  double max_c[3] = { std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest() };
+  for(size_t v=0; v<nv; v++) {
+    for(int j=0; j<3; j++) {
+      min_c[j] = std::min(min_c[j], double(m.vm_at(v, j)));
+      max_c[j] = std::max(max_c[j], double(m.vm_at(v, j)));
+    }
+  }
+  const double max_cell = double((1 << 21) - 1);
+  double scale[3];
+  for(int j=0; j<3; j++) {
+    scale[j] = (max_c[j] > min_c[j]) ? max_cell / (max_c[j] - min_c[j]) : 0.0;
+  }
+
+  std::vector<std::pair<uint64_t, int32_t>> codes(nv);
+  for(size_t v=0; v<nv; v++) {
+    uint64_t code = 0;
+    for(int j=0; j<3; j++) {
+      const uint64_t cell = uint64_t((double(m.vm_at(v, j)) - min_c[j]) * scale[j]);
+      code |= _morton_spread_bits(cell) << j;
+    }
+    codes[v] = std::make_pair(code, int32_t(v));
+  }
+  std::sort(codes.begin(), codes.end());  // Ties are broken by the original index.
+  std::vector<int32_t> new_to_old(nv);
+  for(size_t i=0; i<nv; i++) {
+    new_to_old[i] = codes[i].second;
+  }
+  return vertex_order_from_permutation(new_to_old);
+}
+
+
+/// @brief Compute a vertex order of a mesh by method name.
+/// @param method one of 'none' (the identity), 'rcm' (see `vertex_order_rcm`) or 'morton' (see `vertex_order_morton`).
+/// @throws std::invalid_argument if the method is not supported.
+VertexOrder vertex_order(const fs::Mesh& mesh, const std::string& method) {
+  if(method == "none") {
+    return vertex_order_identity(mesh.num_vertices());
+  } else if(method == "rcm") {
+    return vertex_order_rcm(mesh_csr(mesh));
+  } else if(method == "morton") {
+    return vertex_order_morton(mesh_view(mesh));
+  }
+  throw std::invalid_argument("Invalid vertex reordering method '" + method + "'. Must be 'none', 'rcm' or 'morton'.\n");
+}
+
+
+/// @brief Apply a vertex order to a mesh.
+/// @details The vertices are permuted, and the faces get the new vertex indices. The faces are also sorted by their lowest new vertex index (keeping the relative order of faces with the same lowest vertex), so that loops over the faces access the vertex data in order as well.
+/// @param mesh the original mesh.
+/// @param order the vertex order, e.g., from `vertex_order`.
+/// @return the reordered mesh.
+/// @throws std::invalid_argument if the order does not match the vertex count of the mesh.
+fs::Mesh reorder_mesh(const fs::Mesh& mesh, const VertexOrder& order) {
+  const size_t nv = mesh.num_vertices();
+  const size_t nf = mesh.num_faces();
+  if(order.size() != nv) {
+    throw std::invalid_argument("Vertex order for " + std::to_string(order.size()) + " vertices does not match mesh with " + std::to_string(nv) + " vertices.\n");
+  }
+  fs::Mesh out;
+  out.vertices.resize(nv * 3);
+  for(size_t i=0; i<nv; i++) {
+    const size_t old = size_t(order.new_to_old[i]);
+    out.vertices[i*3] = mesh.vertices[old*3];
+    out.vertices[i*3+1] = mesh.vertices[old*3+1];
+    out.vertices[i*3+2] = mesh.vertices[old*3+2];
+  }
+
+  // Counting sort of the faces by their lowest new vertex index.
+  std::vector<int32_t> face_min(nf);
+  std::vector<int64_t> counts(nv, 0);
+  for(size_t f=0; f<nf; f++) {
+    const int32_t a = order.old_to_new[mesh.faces[f*3]], b = order.old_to_new[mesh.faces[f*3+1]], c = order.old_to_new[mesh.faces[f*3+2]];
+    face_min[f] = std::min(a, std::min(b, c));
+    counts[face_min[f]]++;
+  }
+  std::vector<int64_t> fill_pos;
+  _csr_prefix_sum(counts, fill_pos);
+  out.faces.resize(nf * 3);
+  for(size_t f=0; f<nf; f++) {
+    const int64_t pos = fill_pos[face_min[f]]++;
+    for(int j=0; j<3; j++) {
+      out.faces[pos*3+j] = order.old_to_new[mesh.faces[f*3+j]];
+    }
+  }
+  return out;
+}
+
+
+/// @brief Apply a vertex order to CSR adjacency, keeping the order of the neighbors of each vertex.
+/// @details The neighbor lists of the result are in general not sorted by the new indices. They are in the order of the original indices, so that searches which visit the neighbors in list order, like `mesh_kring`, give the same results as on the original adjacency once mapped back with `index_lists_to_orig`.
+MeshCSR mesh_csr_permute(const MeshCSR& csr, const VertexOrder& order) {
+  const size_t nv = csr.num_vertices();
+  if(order.size() != nv) {
+    throw std::invalid_argument("Vertex order for " + std::to_string(order.size()) + " vertices does not match adjacency with " + std::to_string(nv) + " vertices.\n");
+  }
+  std::vector<int64_t> counts(nv);
+  for(size_t i=0; i<nv; i++) {
+    counts[i] = int64_t(csr.degree(size_t(order.new_to_old[i])));
+  }
+  MeshCSR out;
+  _csr_prefix_sum(counts, out.offsets);
+  out.adj.resize(csr.adj.size());
+  for(size_t i=0; i<nv; i++) {
+    const size_t old = size_t(order.new_to_old[i]);
+    int32_t* dst = out.adj.data() + out.offsets[i];
+    for(const int32_t* n = csr.neighbors_begin(old); n != csr.neighbors_end(old); ++n) {
+      *dst++ = order.old_to_new[*n];
+    }
+  }
+  return out;
+}
+
+
+/// @brief Map per-vertex data computed on a reordered mesh back to the original vertex order.
+template<typename T>
+std::vector<T> data_to_orig(const std::vector<T>& data, const VertexOrder& order) {
+  std::vector<T> out(data.size());
+  for(size_t i=0; i<data.size(); i++) {
+    out[order.new_to_old[i]] = data[i];
+  }
+  return out;
+}
+
+
+/// @brief Map per-vertex index lists (like k-ring neighborhoods) computed on a reordered mesh back to the original vertex order.
+/// @details Both the list positions and the vertex indices in the lists are mapped. The order within each list is kept.
+template<typename I>
+std::vector<std::vector<I>> index_lists_to_orig(const std::vector<std::vector<I>>& lists, const VertexOrder& order) {
+  std::vector<std::vector<I>> out(lists.size());
+  for(size_t i=0; i<lists.size(); i++) {
+    std::vector<I>& dst = out[order.new_to_old[i]];
+    dst.resize(lists[i].size());
+    for(size_t j=0; j<lists[i].size(); j++) {
+      dst[j] = I(order.new_to_old[lists[i][j]]);
+    }
+  }
+  return out;
+}
+
+
+/// @brief Map geodesic neighborhoods computed on a reordered mesh back to the original vertex order.
+/// @details Like the result of `geod_neighborhood`, the neighbors of each vertex are sorted by (original) vertex index.
+std::vector<std::vector<GeodNeighbor>> geod_neighborhood_to_orig(const std::vector<std::vector<GeodNeighbor>>& neigh, const VertexOrder& order) {
+  std::vector<std::vector<GeodNeighbor>> out(neigh.size());
+  for(size_t i=0; i<neigh.size(); i++) {
+    std::vector<GeodNeighbor>& dst = out[order.new_to_old[i]];
+    dst.reserve(neigh[i].size());
+    for(size_t j=0; j<neigh[i].size(); j++) {
+      dst.push_back(GeodNeighbor(size_t(order.new_to_old[neigh[i][j].index]), neigh[i][j].distance));
+    }
+    std::sort(dst.begin(), dst.end(), [](const GeodNeighbor& a, const GeodNeighbor& b) { return a.index < b.index; });
+  }
+  return out;
+}
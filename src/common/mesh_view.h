@@ -0,0 +1,279 @@
+#pragma once
+
+#include "libfs.h"
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <stdexcept>
+
+// A lightweight, read-only view of a triangular mesh stored in contiguous vertex and face arrays.
+//
+// The VCGLIB based functions need a `MyMesh`, which has to be built from the `fs::Mesh` (and often copied back), and
+// which cannot be shared between threads because geodesic computations store their results in it. A `MeshView` only
+// holds pointers to the coordinate and index arrays of an existing mesh, so creating one is free and it can be shared by
+// all threads. The geometry functions in here, and the geodesic functions in `geod_engine.h` and `geod_circles.h`, are
+// templates on the view and work directly on the arrays.
+//
+// The arrays must outlive the view, and must not be resized while it is used.
+
+
+/// @brief Read-only view of a triangular mesh stored in contiguous arrays, like the ones of `fs::Mesh`.
+/// @details The vertex coordinates are stored as 3 consecutive values (x, y, z) per vertex, the faces as 3 consecutive vertex indices per face.
+/// @tparam T the coordinate type, typically float.
+/// @tparam I the vertex index type, typically int32_t.
+template<typename T = float, typename I = int32_t>
+struct MeshView {
+  /// @brief Create a view of raw vertex and face arrays.
+  /// @param vertices pointer to `3 * num_vertices` coordinates.
+  /// @param num_vertices the number of vertices.
+  /// @param faces pointer to `3 * num_faces` vertex indices.
+  /// @param num_faces the number of faces.
+  MeshView(const T* vertices, const size_t num_vertices, const I* faces, const size_t num_faces) : vertices(vertices), faces(faces), nv(num_vertices), nf(num_faces) {}
+
+  const T* vertices;  ///< The vertex coordinates, 3 consecutive values per vertex.
+  const I* faces;     ///< The vertex indices of the faces, 3 consecutive values per face.
+  size_t nv;          ///< The number of vertices.
+  size_t nf;          ///< The number of faces.
+
+  /// @brief Get the number of vertices.
+  size_t num_vertices() const {
+    return this->nv;
+  }
+
+  /// @brief Get the number of faces.
+  size_t num_faces() const {
+    return this->nf;
+  }
+
+  /// @brief Get a pointer to the 3 coordinates of vertex `v`.
+  const T* vertex(const size_t v) const {
+    return this->vertices + v * 3;
+  }
+
+  /// @brief Get a pointer to the 3 vertex indices of face `f`.
+  const I* face(const size_t f) const {
+    return this->faces + f * 3;
+  }
+
+  /// @brief Get coordinate `j` (0 for x, 1 for y, 2 for z) of vertex `v`, like `fs::Mesh::vm_at`.
+  T vm_at(const size_t v, const size_t j) const {
+    return this->vertices[v * 3 + j];
+  }
+
+  /// @brief Get vertex index `j` (0, 1 or 2) of face `f`, like `fs::Mesh::fm_at`.
+  I fm_at(const size_t f, const size_t j) const {
+    return this->faces[f * 3 + j];
+  }
+
+  /// @brief Get the coordinates of vertex `v` as a vector, like `fs::Mesh::vertex_coords`.
+  std::vector<T> vertex_coords(const size_t v) const {
+    return std::vector<T>(this->vertex(v), this->vertex(v) + 3);
+  }
+
+  /// @brief Get the vertex indices of face `f` as a vector, like `fs::Mesh::face_vertices`.
+  std::vector<I> face_vertices(const size_t f) const {
+    return std::vector<I>(this->face(f), this->face(f) + 3);
+  }
+};
+
+
+/// @brief Create a view of an fs::Mesh. The mesh must outlive the view, and must not be changed while it is used.
+MeshView<float, int32_t> mesh_view(const fs::Mesh& mesh) {
+  return MeshView<float, int32_t>(mesh.vertices.data(), mesh.num_vertices(), mesh.faces.data(), mesh.num_faces());
+}
+
+
+/// @brief Compute twice the area of face `f` in single precision, like the VCGLIB function `DoubleArea`.
+/// @private
+template<typename T, typename I>
+inline float _face_double_area(const MeshView<T, I>& m, const size_t f) {
+  const T* p0 = m.vertex(m.fm_at(f, 0));
+  const T* p1 = m.vertex(m.fm_at(f, 1));
+  const T* p2 = m.vertex(m.fm_at(f, 2));
+  const float a[3] = { float(p1[0] - p0[0]), float(p1[1] - p0[1]), float(p1[2] - p0[2]) };
+  const float b[3] = { float(p2[0] - p0[0]), float(p2[1] - p0[1]), float(p2[2] - p0[2]) };
+  const float c[3] = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+  return std::sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+}
+
+
+/// @brief Compute the Euclidean distance between vertices `u` and `v` in single precision, like the VCGLIB `EuclideanDistance` functor.
+/// @private
+template<typename T, typename I>
+inline float _vertex_dist(const MeshView<T, I>& m, const size_t u, const size_t v) {
+  const T* a = m.vertex(u);
+  const T* b = m.vertex(v);
+  const float d[3] = { float(a[0] - b[0]), float(a[1] - b[1]), float(a[2] - b[2]) };
+  return std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+}
+
+
+/// @brief Compute the area of each face of the mesh.
+/// @return vector of length `nf`, the area of each face.
+template<typename T, typename I>
+std::vector<double> mesh_area_per_face(const MeshView<T, I>& m) {
+  std::vector<double> faceareas(m.num_faces());
+  for(size_t f=0; f<m.num_faces(); f++) {
+    faceareas[f] = _face_double_area(m, f) / 2.0;
+  }
+  return faceareas;
+}
+
+
+/// @brief Compute the total area of the mesh.
+template<typename T, typename I>
+double mesh_area_total(const MeshView<T, I>& m) {
+  double area = 0.0;
+  for(size_t f=0; f<m.num_faces(); f++) {
+    area += _face_double_area(m, f);
+  }
+  return area / 2.0;
+}
+
+
+/// @brief Compute the vertex normals of the mesh.
+/// @details The normals are not normalized, like the ones computed by VCGLIB.
+/// @param face_angle_weighted the vertex normals type, angle weighted (true) or area weighted (false) sum of the normals of the surrounding faces.
+/// @return `nv x 3` vector of vertex normals. Vertices which are not part of any face get the zero vector.
+template<typename T, typename I>
+std::vector<std::vector<float>> mesh_vnormals(const MeshView<T, I>& m, const bool face_angle_weighted=false) {
+  std::vector<float> acc(m.num_vertices() * 3, 0.0f);
+  for(size_t f=0; f<m.num_faces(); f++) {
+    const I* fv = m.face(f);
+    const T* p[3] = { m.vertex(fv[0]), m.vertex(fv[1]), m.vertex(fv[2]) };
+    float e[3][3];  // The edge vectors p[j+1] - p[j].
+    for(int j=0; j<3; j++) {
+      for(int k=0; k<3; k++) {
+        e[j][k] = float(p[(j+1) % 3][k] - p[j][k]);
+      }
+    }
+    const float b[3] = { float(p[2][0] - p[0][0]), float(p[2][1] - p[0][1]), float(p[2][2] - p[0][2]) };
+    float n[3] = { e[0][1] * b[2] - e[0][2] * b[1], e[0][2] * b[0] - e[0][0] * b[2], e[0][0] * b[1] - e[0][1] * b[0] };
+    if(! face_angle_weighted) {
+      for(int j=0; j<3; j++) {
+        for(int k=0; k<3; k++) {
+          acc[size_t(fv[j]) * 3 + k] += n[k];
+        }
+      }
+      continue;
+    }
+    const float nlen = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if(nlen > 0.0f) {
+      for(int k=0; k<3; k++) { n[k] /= nlen; }
+    }
+    for(int j=0; j<3; j++) {
+      const float elen = std::sqrt(e[j][0] * e[j][0] + e[j][1] * e[j][1] + e[j][2] * e[j][2]);
+      if(elen > 0.0f) {
+        for(int k=0; k<3; k++) { e[j][k] /= elen; }
+      }
+    }
+    for(int j=0; j<3; j++) {
+      // The angle at vertex j is between the outgoing edge j and the reversed incoming edge j-1.
+      const float* out = e[j];
+      const float* in = e[(j+2) % 3];
+      float w = -(out[0] * in[0] + out[1] * in[1] + out[2] * in[2]);
+      w = w > 1.0f ? 1.0f : (w < -1.0f ? -1.0f : w);
+      const float angle = std::acos(w);
+      for(int k=0; k<3; k++) {
+        acc[size_t(fv[j]) * 3 + k] += n[k] * angle;
+      }
+    }
+  }
+  std::vector<std::vector<float>> vnormals(m.num_vertices(), std::vector<float>(3));
+  for(size_t v=0; v<m.num_vertices(); v++) {
+    vnormals[v][0] = acc[v * 3];
+    vnormals[v][1] = acc[v * 3 + 1];
+    vnormals[v][2] = acc[v * 3 + 2];
+  }
+  return vnormals;
+}
+
+
+/// @brief Get mesh vertex coords as `nv x 3` 2D vector of floats.
+template<typename T, typename I>
+std::vector<std::vector<float>> mesh_vertex_coords(const MeshView<T, I>& m) {
+  std::vector<std::vector<float>> vertex_coords(m.num_vertices(), std::vector<float>(3));
+  for(size_t v=0; v<m.num_vertices(); v++) {
+    vertex_coords[v][0] = float(m.vm_at(v, 0));
+    vertex_coords[v][1] = float(m.vm_at(v, 1));
+    vertex_coords[v][2] = float(m.vm_at(v, 2));
+  }
+  return vertex_coords;
+}
+
+
+/// @brief A vertex mask of a mesh, e.g., the cortex of a brain surface mesh without the medial wall.
+/// @details Computations on a masked mesh use the vertex array of the full mesh and the faces of the mask, so no submesh
+/// with its own vertex indices is built, and results map back to the full mesh through the dense `vertices` array.
+struct MeshMask {
+  std::vector<uint8_t> included;  ///< For each mesh vertex, whether it is included (1) or masked (0).
+  std::vector<int32_t> vertices;  ///< The included vertices in ascending order. Maps the index of a result of a masked computation to the mesh vertex.
+  std::vector<int32_t> faces;     ///< The vertex indices of the faces with all 3 vertices included, 3 consecutive values per face, in mesh order.
+
+  /// @brief Get the number of included vertices.
+  size_t num_vertices() const {
+    return this->vertices.size();
+  }
+
+  /// @brief Get the number of faces with all 3 vertices included.
+  size_t num_faces() const {
+    return this->faces.size() / 3;
+  }
+};
+
+
+/// @brief Create a vertex mask of a mesh which includes the given vertices, e.g., the vertices of a cortex label.
+/// @param vertex_indices the vertices to include, in any order. Duplicates are allowed.
+/// @throws std::invalid_argument if a vertex index is out of range.
+template<typename T, typename I>
+MeshMask mesh_mask(const MeshView<T, I>& m, const std::vector<int32_t>& vertex_indices) {
+  MeshMask mask;
+  mask.included.assign(m.num_vertices(), 0);
+  for(size_t i=0; i<vertex_indices.size(); i++) {
+    if(vertex_indices[i] < 0 || size_t(vertex_indices[i]) >= m.num_vertices()) {
+      throw std::invalid_argument("Mask vertex index " + std::to_string(vertex_indices[i]) + " out of range for mesh with " + std::to_string(m.num_vertices()) + " vertices.\n");
+    }
+    mask.included[vertex_indices[i]] = 1;
+  }
+  for(size_t v=0; v<m.num_vertices(); v++) {
+    if(mask.included[v]) {
+      mask.vertices.push_back(int32_t(v));
+    }
+  }
+  for(size_t f=0; f<m.num_faces(); f++) {
+    const I* fv = m.face(f);
+    if(mask.included[fv[0]] && mask.included[fv[1]] && mask.included[fv[2]]) {
+      mask.faces.push_back(int32_t(fv[0]));
+      mask.faces.push_back(int32_t(fv[1]));
+      mask.faces.push_back(int32_t(fv[2]));
+    }
+  }
+  return mask;
+}
+
+
+/// @brief Create a view of the masked part of a mesh: all vertices of the mesh, but only the faces of the mask.
+/// @details Masked vertices are not part of any face of the view, so the geodesic functions never reach them. The mask must outlive the view.
+template<typename T>
+MeshView<T, int32_t> masked_view(const MeshView<T, int32_t>& m, const MeshMask& mask) {
+  return MeshView<T, int32_t>(m.vertices, m.num_vertices(), mask.faces.data(), mask.num_faces());
+}
+
+
+/// @brief Scatter the per-vertex results of a masked computation to all mesh vertices.
+/// @param values one value per included vertex, in the order of `mask.vertices`.
+/// @param fill_value the value for the masked vertices.
+/// @return vector with one value per mesh vertex.
+template<typename T>
+std::vector<T> mask_scatter(const std::vector<T>& values, const MeshMask& mask, const T fill_value) {
+  if(values.size() != mask.num_vertices()) {
+    throw std::invalid_argument("Expected " + std::to_string(mask.num_vertices()) + " values for the included vertices of the mask, got " + std::to_string(values.size()) + ".\n");
+  }
+  std::vector<T> full(mask.included.size(), fill_value);
+  for(size_t i=0; i<values.size(); i++) {
+    full[mask.vertices[i]] = values[i];
+  }
+  return full;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "bulk_endian.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <stdexcept>
+
+// A minimal sparse matrix in compressed sparse row (CSR) format, with parallel matrix-vector products and
+// a binary file format. Used to store precomputed per-mesh operators like smoothing kernels.
+
+
+/// @brief Sparse float matrix in compressed sparse row (CSR) format.
+/// @details The non-zero entries of row `i` are `values[row_ptr[i]]` to `values[row_ptr[i+1]-1]`, in the columns given at the same positions in `col_idx`.
+struct SparseMatrix {
+  SparseMatrix() : num_rows(0), num_cols(0), fingerprint(0), row_ptr(1, 0) {}
+
+  int32_t num_rows;  ///< Number of rows.
+  int32_t num_cols;  ///< Number of columns.
+  uint64_t fingerprint;  ///< Identifies what the matrix was computed for, e.g., a hash of the mesh and the kernel parameters, so stored matrices are not reused for something else. 0 if unknown.
+  std::vector<int64_t> row_ptr;  ///< Length `num_rows + 1`, start of each row in `col_idx` and `values`.
+  std::vector<int32_t> col_idx;  ///< Column index of each non-zero entry.
+  std::vector<float> values;     ///< Value of each non-zero entry.
+
+  /// @brief Get the number of stored (non-zero) entries.
+  size_t nnz() const {
+    return this->values.size();
+  }
+};
+
+
+/// @brief Compute the product `A * x` of a sparse matrix and a dense vector, in parallel.
+/// @throws std::invalid_argument if the length of `x` does not match the number of columns of `A`.
+std::vector<float> spmv(const SparseMatrix& A, const std::vector<float>& x) {
+  if(x.size() != size_t(A.num_cols)) {
+    throw std::invalid_argument("Vector length " + std::to_string(x.size()) + " does not match number of matrix columns " + std::to_string(A.num_cols) + ".\n");
+  }
+  std::vector<float> y(A.num_rows);
+  const int64_t nr = A.num_rows;
+  # pragma omp parallel for schedule(static) shared(A, x, y)
+  for(int64_t i=0; i<nr; i++) {
+    double sum = 0.0;
+    for(int64_t k=A.row_ptr[i]; k<A.row_ptr[i+1]; k++) {
+      sum += double(A.values[k]) * x[A.col_idx[k]];
+    }
+    y[i] = float(sum);
+  }
+  return y;
+}
+
+
+/// @brief Compute `A * x` for several dense vectors `x` in a single pass over the matrix, in parallel.
+/// @details Each matrix row is loaded once and applied to all vectors, which is faster than separate `spmv` calls when the matrix is larger than the caches.
+/// @throws std::invalid_argument if the length of any vector does not match the number of columns of `A`.
+std::vector<std::vector<float>> spmv_batch(const SparseMatrix& A, const std::vector<std::vector<float>>& xs) {
+  const size_t nx = xs.size();
+  for(size_t j=0; j<nx; j++) {
+    if(xs[j].size() != size_t(A.num_cols)) {
+      throw std::invalid_argument("Length " + std::to_string(xs[j].size()) + " of vector #" + std::to_string(j) + " does not match number of matrix columns " + std::to_string(A.num_cols) + ".\n");
+    }
+  }
+  std::vector<std::vector<float>> ys(nx, std::vector<float>(A.num_rows));
+  const int64_t nr = A.num_rows;
+  # pragma omp parallel shared(A, xs, ys)
+  {
+    std::vector<double> sums(nx);
+    # pragma omp for schedule(static)
+    for(int64_t i=0; i<nr; i++) {
+      std::fill(sums.begin(), sums.end(), 0.0);
+      for(int64_t k=A.row_ptr[i]; k<A.row_ptr[i+1]; k++) {
+        const double w = A.values[k];
+        const int32_t col = A.col_idx[k];
+        for(size_t j=0; j<nx; j++) {
+          sums[j] += w * xs[j][col];
+        }
+      }
+      for(size_t j=0; j<nx; j++) {
+        ys[j][i] = float(sums[j]);
+      }
+    }
+  }
+  return ys;
+}
+
+
+/// @brief Write a sparse matrix to a file in our binary sparse matrix format.
+/// @details The file is big endian. Fields: int32 magic number 43, int32 format version 2, int32 number of rows R, int32 number of columns, int64 number of non-zero entries NNZ, uint64 fingerprint, then (R+1) x int64 row pointers, NNZ x int32 column indices, NNZ x float32 values. Format version 1 has no fingerprint.
+/// @throws std::runtime_error if the file cannot be opened.
+void write_sparse_matrix(const std::string& filename, const SparseMatrix& A) {
+  std::ofstream ofs;
+  ofs.open(filename, std::ofstream::out | std::ofstream::binary);
+  if(! ofs.is_open()) {
+    throw std::runtime_error("Unable to open sparse matrix file '" + filename + "' for writing.\n");
+  }
+  const int32_t header[4] = { 43, 2, A.num_rows, A.num_cols };
+  write_big_endian(ofs, header, 4);
+  const int64_t nnz = int64_t(A.nnz());
+  write_big_endian(ofs, &nnz, 1);
+  write_big_endian(ofs, &A.fingerprint, 1);
+  write_big_endian(ofs, A.row_ptr.data(), A.row_ptr.size());
+  write_big_endian(ofs, A.col_idx.data(), A.col_idx.size());
+  write_big_endian(ofs, A.values.data(), A.values.size());
+  ofs.close();
+}
+
+
+/// @brief Read a sparse matrix from a file in our binary sparse matrix format.
+/// @see write_sparse_matrix for the format description. Files in format version 1 get fingerprint 0.
+/// @throws std::runtime_error if the file cannot be opened or is truncated, std::domain_error if the header is invalid or the row pointers or column indices are out of range.
+void read_sparse_matrix(SparseMatrix* A, const std::string& filename) {
+  std::ifstream ifs(filename, std::ifstream::in | std::ifstream::binary);
+  if(! ifs.is_open()) {
+    throw std::runtime_error("Unable to open sparse matrix file '" + filename + "' for reading.\n");
+  }
+  ifs.seekg(0, std::ifstream::end);
+  const int64_t file_size = int64_t(ifs.tellg());
+  ifs.seekg(0, std::ifstream::beg);
+  int32_t header[4];
+  read_big_endian(ifs, header, 4);
+  if(header[0] != 43 || (header[1] != 1 && header[1] != 2)) {
+    throw std::domain_error("File '" + filename + "' is not a sparse matrix file in format version 1 or 2.\n");
+  }
+  int64_t nnz;
+  read_big_endian(ifs, &nnz, 1);
+  uint64_t fingerprint = 0;
+  if(header[1] >= 2) {
+    read_big_endian(ifs, &fingerprint, 1);
+  }
+  if(header[2] < 0 || header[3] < 0 || nnz < 0) {
+    throw std::domain_error("Sparse matrix file '" + filename + "' has invalid dimensions.\n");
+  }
+  // Check the size before allocating, a damaged header must not make us allocate huge arrays.
+  const int64_t header_size = int64_t(ifs.tellg());
+  if(file_size - header_size != (int64_t(header[2]) + 1) * int64_t(sizeof(int64_t)) + nnz * int64_t(sizeof(int32_t) + sizeof(float))) {
+    throw std::runtime_error("Sparse matrix file '" + filename + "' is truncated or has trailing data.\n");
+  }
+  A->num_rows = header[2];
+  A->num_cols = header[3];
+  A->fingerprint = fingerprint;
+  A->row_ptr.resize(size_t(A->num_rows) + 1);
+  A->col_idx.resize(nnz);
+  A->values.resize(nnz);
+  read_big_endian(ifs, A->row_ptr.data(), A->row_ptr.size());
+  read_big_endian(ifs, A->col_idx.data(), A->col_idx.size());
+  read_big_endian(ifs, A->values.data(), A->values.size());
+
+  // The products index with these without checks, so a damaged file must not get through.
+  if(A->row_ptr[0] != 0 || A->row_ptr[A->num_rows] != nnz) {
+    throw std::domain_error("Sparse matrix file '" + filename + "' has inconsistent row pointers.\n");
+  }
+  for(int32_t i=0; i<A->num_rows; i++) {
+    if(A->row_ptr[i+1] < A->row_ptr[i]) {
+      throw std::domain_error("Sparse matrix file '" + filename + "' has decreasing row pointers at row " + std::to_string(i) + ".\n");
+    }
+  }
+  for(int64_t k=0; k<nnz; k++) {
+    if(A->col_idx[k] < 0 || A->col_idx[k] >= A->num_cols) {
+      throw std::domain_error("Sparse matrix file '" + filename + "' has column index " + std::to_string(A->col_idx[k]) + " out of range for " + std::to_string(A->num_cols) + " columns.\n");
+    }
+  }
+}
@@ -1,12 +1,168 @@
-
 #pragma once
 
 #include "tinycolormap.hpp"
 
 #include <vector>
+#include <string>
+#include <limits>
 #include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cmath>
 
 // Functions for mapping numerical values to colors using a colormap function.
+//
+// Evaluating a tinycolormap colormap interpolates between its control points on every call. For mapping large
+// amounts of per-vertex data, we sample each colormap once into a lookup table (LUT) and then map values with a
+// single normalize-and-lookup pass into a preallocated RGB buffer.
+
+
+/// Number of entries in the colormap lookup tables.
+const size_t COLORMAP_LUT_SIZE = 4096;
+
+/// Number of colormap types in tinycolormap::ColormapType.
+const size_t _NUM_COLORMAP_TYPES = size_t(tinycolormap::ColormapType::Github) + 1;
+
+
+/// @brief Quantized lookup table for a colormap.
+/// @details Entry `i` holds the RGB color of the colormap at position `i / (size - 1)`.
+struct ColormapLUT {
+    tinycolormap::ColormapType cmap;  ///< The colormap this table was sampled from.
+    std::vector<uint8_t> rgb;         ///< The RGB bytes of all entries, 3 consecutive values per entry.
+
+    /// @brief Get the number of entries.
+    size_t size() const {
+        return this->rgb.size() / 3;
+    }
+};
+
+
+/// @brief Sample a colormap into a lookup table with `size` entries.
+/// @private
+ColormapLUT _build_colormap_lut(const tinycolormap::ColormapType cmap, const size_t size = COLORMAP_LUT_SIZE) {
+    ColormapLUT lut;
+    lut.cmap = cmap;
+    lut.rgb.resize(size * 3);
+    for(size_t i=0; i<size; i++) {
+        tinycolormap::Color color = tinycolormap::GetColor(double(i) / double(size - 1), cmap);
+        lut.rgb[i*3] = color.ri();
+        lut.rgb[i*3+1] = color.gi();
+        lut.rgb[i*3+2] = color.bi();
+    }
+    return lut;
+}
+
+
+/// @brief Build the lookup tables for all colormap types.
+/// @private
+std::vector<ColormapLUT> _build_all_colormap_luts() {
+    std::vector<ColormapLUT> luts;
+    for(size_t i=0; i<_NUM_COLORMAP_TYPES; i++) {
+        luts.push_back(_build_colormap_lut(tinycolormap::ColormapType(i)));
+    }
+    return luts;
+}
+
+
+/// @brief Get the shared lookup table for a colormap, with `COLORMAP_LUT_SIZE` entries.
+/// @details The tables for all colormaps are built on first use. This is thread-safe, and the returned reference stays valid for the lifetime of the program.
+const ColormapLUT& colormap_lut(const tinycolormap::ColormapType cmap = tinycolormap::ColormapType::Viridis) {
+    static const std::vector<ColormapLUT> luts = _build_all_colormap_luts();
+    return luts[size_t(cmap)];
+}
+
+
+/// @brief Compute minimum and maximum of `n` values in a single pass. NaN values are ignored.
+/// @details The loop is branch-free, so the compiler can vectorize it.
+/// @param min set to the minimum, or to +infinity if there are no non-NaN values.
+/// @param max set to the maximum, or to -infinity if there are no non-NaN values.
+template<class T>
+void data_minmax(const T* data, const size_t n, T* min, T* max) {
+    T mn = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+    T mx = std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();
+    for(size_t i=0; i<n; i++) {
+        const T v = data[i];
+        mn = (v < mn) ? v : mn;
+        mx = (v > mx) ? v : mx;
+    }
+    *min = mn;
+    *max = mx;
+}
+
+
+/// @brief Compute a robust value range: the given lower and upper percentiles of the data. NaN values are ignored.
+/// @param clip_percent percentage of values to clip at each end, in `[0, 50)`. E.g., 2.0 returns the 2nd and 98th percentile. With 0.0, this is the min and max.
+/// @throws std::invalid_argument if `clip_percent` is out of range.
+template<class T>
+void data_percentile_range(const T* data, const size_t n, const double clip_percent, T* lower, T* upper) {
+    if(clip_percent < 0.0 || clip_percent >= 50.0) {
+        throw std::invalid_argument("Parameter clip_percent must be in range [0, 50), but is " + std::to_string(clip_percent) + ".\n");
+    }
+    if(clip_percent == 0.0) {
+        data_minmax(data, n, lower, upper);
+        return;
+    }
+    std::vector<T> values;
+    values.reserve(n);
+    for(size_t i=0; i<n; i++) {
+        if(data[i] == data[i]) { // Not NaN.
+            values.push_back(data[i]);
+        }
+    }
+    if(values.empty()) {
+        data_minmax(data, 0, lower, upper);
+        return;
+    }
+    const size_t last = values.size() - 1;
+    const size_t lo_idx = size_t(std::floor(clip_percent / 100.0 * double(last)));
+    const size_t hi_idx = last - lo_idx;
+    std::nth_element(values.begin(), values.begin() + lo_idx, values.end());
+    *lower = values[lo_idx];
+    std::nth_element(values.begin() + lo_idx, values.begin() + hi_idx, values.end());
+    *upper = values[hi_idx];
+}
+
+
+/// @brief Map `n` values to RGB colors with a colormap lookup table, in a single pass into a preallocated buffer.
+/// @details Values are normalized to `[0, 1]` using `vmin` and `vmax`, and values outside that range are clamped. NaN values get the color of `vmin`.
+/// @param rgb output buffer of length at least `3 * n`. Three consecutive values describe the RGB data for one value.
+/// @param vmin the value mapped to the first colormap entry.
+/// @param vmax the value mapped to the last colormap entry. Must be larger than `vmin`.
+template<class T>
+void data_to_colors_lut(const T* data, const size_t n, uint8_t* rgb, const ColormapLUT& lut, const T vmin, const T vmax) {
+    const size_t last = lut.size() - 1;
+    const double scale = double(last) / (double(vmax) - double(vmin));
+    const double offset = double(vmin);
+    const uint8_t* table = lut.rgb.data();
+    for(size_t i=0; i<n; i++) {
+        double t = (double(data[i]) - offset) * scale + 0.5;
+        t = (t >= 0.0) ? t : 0.0;  // Also maps NaN to 0.
+        t = (t <= double(last)) ? t : double(last);
+        const size_t idx = size_t(t);
+        rgb[i*3] = table[idx*3];
+        rgb[i*3+1] = table[idx*3+1];
+        rgb[i*3+2] = table[idx*3+2];
+    }
+}
+
+
+/// @brief Map `n` values to RGB colors in a preallocated buffer, normalizing them to the range of the data.
+/// @param rgb output buffer of length at least `3 * n`.
+/// @param cmap the colormap to use.
+/// @param clip_percent percentage of values to clip at each end of the range before normalizing, for robustness against outliers. E.g., 2.0 maps the 2nd percentile to the first and the 98th percentile to the last colormap color. Defaults to 0.0, i.e., the full range from min to max.
+/// @throws std::invalid_argument if there are less than 2 values or the (clipped) range is empty.
+template<class T>
+void data_to_colors(const T* data, const size_t n, uint8_t* rgb, const tinycolormap::ColormapType cmap = tinycolormap::ColormapType::Viridis, const double clip_percent = 0.0) {
+    if(n < 2) {
+        throw std::invalid_argument("The 'data' to map to colors must contain at least 2 elements, but size is " + std::to_string(n) + ".");
+    }
+    T vmin, vmax;
+    data_percentile_range(data, n, clip_percent, &vmin, &vmax);
+    if(!(vmin < vmax)) {
+        throw std::invalid_argument("The 'data' to map to colors must contain at least 2 unique elements in the value range, but all " + std::to_string(n) + " elements are equal.");
+    }
+    data_to_colors_lut(data, n, rgb, colormap_lut(cmap), vmin, vmax);
+}
 
 
 /// Normalize values to range 0..1.
@@ -18,8 +174,8 @@ std::vector<T> normalize(const std::vector<T> data) {
     if(data.size() < 2) {
         throw std::invalid_argument("The 'data' vector to normalize must contain at least 2 elements, but size is " + std::to_string(data.size()) + ".");
     }
-    T min = *std::min_element(data.begin(), data.end());
-    T max = *std::max_element(data.begin(), data.end());
+    T min, max;
+    data_minmax(data.data(), data.size(), &min, &max);
     if(min == max) {
         throw std::invalid_argument("The 'data' vector to normalize must contain at least 2 unique elements, but all " + std::to_string(data.size()) + " elements are equal.");
     }
@@ -34,38 +190,12 @@ std::vector<T> normalize(const std::vector<T> data) {
 
 
 /// Map n data values to a vector of 3n unit_8 values, which represent the RGB channels of the respective colors.
-/// @details In the returned vector, three consecutive values describe the RGB data for one value. This must currently be called with double data, as the colormap function only works with double. See specializations below, which enable usage with float and int.
+/// @details In the returned vector, three consecutive values describe the RGB data for one value. The values are normalized to their range and mapped with the colormap lookup table, see `colormap_lut`.
+/// @param clip_percent percentage of values to clip at each end of the range, see the pointer version of `data_to_colors`. Defaults to 0.0.
 /// @throws std::invalid_argument if values are empty or max is equal to min.
 template<class T>
-std::vector<uint8_t> data_to_colors(const std::vector<T> data, const tinycolormap::ColormapType cmap = tinycolormap::ColormapType::Viridis) {
-    std::vector<T> dnorm = normalize(data);
-    std::vector<uint8_t> colors;
-    colors.reserve(data.size() * 3);
-    for(size_t i=0; i<dnorm.size(); i++) {
-        tinycolormap::Color color = tinycolormap::GetColor(dnorm[i], cmap);
-        colors.push_back(color.ri());
-        colors.push_back(color.gi());
-        colors.push_back(color.bi());
-    }
+std::vector<uint8_t> data_to_colors(const std::vector<T>& data, const tinycolormap::ColormapType cmap = tinycolormap::ColormapType::Viridis, const double clip_percent = 0.0) {
+    std::vector<uint8_t> colors(data.size() * 3);
+    data_to_colors(data.data(), data.size(), colors.data(), cmap, clip_percent);
     return(colors);
 }
-
-/// Template specialization for float, so users do not need to do the conversion themselves on each usage.
-template<>
-std::vector<uint8_t> data_to_colors(const std::vector<float> data, const tinycolormap::ColormapType cmap) {
-    return(data_to_colors(std::vector<double>(data.begin(), data.end()), cmap));
-}
-
-/// Template specialization for int, so users do not need to do the conversion themselves on each usage.
-template<>
-std::vector<uint8_t> data_to_colors(const std::vector<int> data, const tinycolormap::ColormapType cmap) {
-    return(data_to_colors(std::vector<double>(data.begin(), data.end()), cmap));
-}
-
-
-
-
-
-
-
-
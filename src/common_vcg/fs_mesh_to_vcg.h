@@ -8,33 +8,34 @@
 #include <vcg/space/point3.h>
 
 
-/// @brief Create a VCGLIB MyMesh instance from an fs::Mesh
-/// @param m pointer to an empty MyMesh instance
+/// @brief Create a VCGLIB mesh instance, like a MyMesh or GeodMesh, from an fs::Mesh
+/// @param m pointer to an empty VCGLIB mesh instance
 /// @param fs_surface the fs::Mesh instance to convert
-void vcgmesh_from_fs_surface(MyMesh* m, const fs::Mesh& fs_surface) {
+template<class MeshT>
+void vcgmesh_from_fs_surface(MeshT* m, const fs::Mesh& fs_surface) {
   int nv = fs_surface.num_vertices();
   int nf = fs_surface.num_faces();
 
   // Add vertices
-  vcg::tri::Allocator<MyMesh>::AddVertices(*m, nv);
+  vcg::tri::Allocator<MeshT>::AddVertices(*m, nv);
 
   //std::cout << " Creating MyMesh instance with " << nv << " vertices and " << nf << " faces.\n";
 
   // Create vertex pointers, used later when creating faces.
-  std::vector<MyMesh::VertexPointer> ivp;
+  std::vector<typename MeshT::VertexPointer> ivp;
   ivp.resize(nv);
 
   // Set vertex coordinates.
   for (int i=0; i < nv; i++) {
-    VertexIterator vi = m->vert.begin()+i;
+    typename MeshT::VertexIterator vi = m->vert.begin()+i;
     ivp[i]=&*vi;
-    (*vi).P() = CoordType(fs_surface.vm_at(i, 0), fs_surface.vm_at(i, 1), fs_surface.vm_at(i, 2));
+    (*vi).P() = typename MeshT::CoordType(fs_surface.vm_at(i, 0), fs_surface.vm_at(i, 1), fs_surface.vm_at(i, 2));
   }
 
   // Create faces
-  vcg::tri::Allocator<MyMesh>::AddFaces(*m, nf);
+  vcg::tri::Allocator<MeshT>::AddFaces(*m, nf);
   for (int i=0; i < nf; i++) {
-	  FaceIterator fi=m->face.begin()+i;
+	  typename MeshT::FaceIterator fi=m->face.begin()+i;
 	  for (int j = 0; j < 3; j++)  {
 		  (*fi).V(j)=ivp[fs_surface.fm_at(i, j)];
     }
@@ -42,13 +43,15 @@ void vcgmesh_from_fs_surface(MyMesh* m, const fs::Mesh& fs_surface) {
 }
 
 
-/// Create an fs::Mesh instance from a VCGLIB MyMesh
-void fs_surface_from_vcgmesh(fs::Mesh* surf, MyMesh& m) {
-  SimpleTempData<MyMesh::VertContainer,int> vert_indices(m.vert);
+/// Create an fs::Mesh instance from a VCGLIB mesh, like a MyMesh or GeodMesh
+template<class MeshT>
+void fs_surface_from_vcgmesh(fs::Mesh* surf, MeshT& m) {
+  SimpleTempData<typename MeshT::VertContainer,int> vert_indices(m.vert);
 
   std::vector<float> vertex_coords;
+  vertex_coords.reserve(size_t(m.vn) * 3);
 
-  VertexIterator vi = m.vert.begin();
+  typename MeshT::VertexIterator vi = m.vert.begin();
   for (int i=0; i < m.vn; i++) {
     vert_indices[vi] = i;
     vertex_coords.push_back((vi)->P().X());
@@ -58,8 +61,9 @@ void fs_surface_from_vcgmesh(fs::Mesh* surf, MyMesh& m) {
   }
 
   std::vector<int> faces; // Their vertex indices.
+  faces.reserve(size_t(m.fn) * 3);
 
-  FaceIterator fi = m.face.begin();
+  typename MeshT::FaceIterator fi = m.face.begin();
   for (int i=0; i < m.fn; i++) {
     faces.push_back(vert_indices[fi->V(0)]);
     faces.push_back(vert_indices[fi->V(1)]);
@@ -67,8 +71,8 @@ void fs_surface_from_vcgmesh(fs::Mesh* surf, MyMesh& m) {
     ++fi;
   }
 
-  surf->vertices = vertex_coords;
-  surf->faces = faces;
+  surf->vertices.swap(vertex_coords);
+  surf->faces.swap(faces);
 }
 
 
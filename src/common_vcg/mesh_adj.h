@@ -12,48 +12,30 @@
 #include <sstream>
 
 #include "cppgeod_settings.h"
+#include "fs_mesh_to_vcg.h"
+#include "mesh_csr.h"
 
 
 
-std::vector<std::vector<int>> mesh_adj(MyMesh& m, std::vector<int> query_vertices, int numstep=1, bool include_self=false) {
-  m.vert.EnableVFAdjacency();
-  m.face.EnableFFAdjacency();
-  m.face.EnableVFAdjacency();
-
-  tri::UpdateTopology<MyMesh>::FaceFace(m);
-  tri::UpdateTopology<MyMesh>::VertexFace(m);
-  FaceIterator fi;
-  VertexIterator vi;
-
-  // Create int vertex indices to return.
-  SimpleTempData<MyMesh::VertContainer,int> indices(m.vert);
-  vi = m.vert.begin();
-  for (int i=0; i < m.vn; i++) {
-    indices[vi] = i;
-    ++vi;
-  }
-
-  // Start neighborhood computation
-  std::vector<std::vector<int>> neighborhoods;
-  for(size_t i=0; i < query_vertices.size(); ++i) {
-    int qv = query_vertices[i];
-    vi = m.vert.begin()+qv;
-    MyVertex* pqv = &*vi;
-    std::vector<MyVertex*> neigh;
-    vcg::face::VVExtendedStarVF<MyFace>(pqv, numstep, neigh);
-
-    // Collect indices of vertices.
-    std::vector<int> neighidx;
-    if(include_self) {
-      neighidx.push_back(qv);
-    }
-    for(size_t j=0; j<neigh.size(); j++) {
-      neighidx.push_back(indices[neigh[j]]);
-    }
-    neighborhoods.push_back(neighidx);
-  }
+/// @brief Compute the k-ring edge neighborhoods of the query vertices.
+/// @details This goes through the CSR adjacency from `mesh_csr.h`, which scales to large meshes and runs in parallel.
+/// @param mesh the mesh
+/// @param query_vertices the query vertices. If empty, all vertices are used.
+/// @param numstep the k for the k-ring, i.e., the maximal edge distance.
+/// @param include_self whether to include the query vertex itself, as the first entry of its neighborhood.
+/// @return one neighborhood per query vertex, as vertex indices.
+std::vector<std::vector<int>> mesh_adj(const fs::Mesh& mesh, const std::vector<int> query_vertices, int numstep=1, bool include_self=false) {
+  MeshCSR csr = mesh_csr(mesh);
+  return mesh_kring(csr, query_vertices, numstep, include_self);
+}
+
 
-  return neighborhoods;
+/// @brief Compute the k-ring edge neighborhoods of the query vertices of a VCGLIB mesh.
+/// @see The overload for fs::Mesh, which this calls after converting the mesh.
+std::vector<std::vector<int>> mesh_adj(MyMesh& m, std::vector<int> query_vertices, int numstep=1, bool include_self=false) {
+  fs::Mesh surf;
+  fs_surface_from_vcgmesh(&surf, m);
+  return mesh_adj(surf, query_vertices, numstep, include_self);
 }
 
 
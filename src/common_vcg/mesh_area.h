@@ -4,10 +4,10 @@
 
 
 /// Compute total area of the mesh.
-double mesh_area_total(MyMesh& m) {
-    FaceIterator face;
+template<class MeshT>
+typename VcgMeshReturn<typename MeshT::VertContainer, double>::type mesh_area_total(MeshT& m) {
     double area = 0.0;
-    for(face=m.face.begin(); face != m.face.end(); face++) {
+    for(typename MeshT::FaceIterator face=m.face.begin(); face != m.face.end(); face++) {
       if(!(*face).IsD()) {
 	      area += DoubleArea(*face);
       }
@@ -17,12 +17,12 @@ double mesh_area_total(MyMesh& m) {
 
 
 /// Compute per-face area for the mesh.
-std::vector<double> mesh_area_per_face(MyMesh& m) {
-    FaceIterator face;
+template<class MeshT>
+typename VcgMeshReturn<typename MeshT::VertContainer, std::vector<double> >::type mesh_area_per_face(MeshT& m) {
     std::vector<double> faceareas;
     faceareas.resize(m.fn);
     int faceind = 0;
-    for(face=m.face.begin(); face != m.face.end(); face++) {
+    for(typename MeshT::FaceIterator face=m.face.begin(); face != m.face.end(); face++) {
       if(!(*face).IsD()) {
         faceareas[faceind] = DoubleArea(*face) / 2.0;
 	      faceind++;
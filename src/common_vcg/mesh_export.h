@@ -8,9 +8,11 @@
 #include <wrap/io_trimesh/import.h>
 
 
-void export_mesh_ply(MyMesh& m, const std::string& outfile) {
+/// Export a VCG mesh to a PLY file.
+/// @param binary whether to write the binary PLY format version instead of ASCII.
+void export_mesh_ply(MyMesh& m, const std::string& outfile, const bool binary = false) {
     //std::cout << "Exporting mesh in PLY format to file '" << outfile << "'.\n";
     int mask = 0;   // The mask defines which mesh features to write (e.g., vertex colors, normals, ...)
-    bool use_binary_format_version = false;
+    bool use_binary_format_version = binary;
     vcg::tri::io::ExporterPLY<MyMesh>::Save(m, outfile.c_str(), mask, use_binary_format_version);
 }
@@ -2,9 +2,13 @@
 
 #include "libfs.h"
 
+#include "cppgeod_settings.h"
 #include "typedef_vcg.h"
 #include "mesh_normals.h"
 #include "mesh_coords.h"
+#include "mesh_view.h"
+#include "mesh_geometry.h"
+#include "geod_engine.h"
 #include "write_data.h"
 
 
@@ -130,9 +134,10 @@ class Neighborhood {
 /// @brief Compute vertex neighborhoods: for a source vertex, compute centered coordinates of all given neighbors.
 /// @details The distances in the return value are geodesic distances.
 /// @param geod_neighbors: (n, m) 2D vector of `GeodNeighbor`, typically the neighborhoods (each consisting of `m` neighbors) for all `n` vertices of some mesh. Neighbors are encoded as vertex indices in the GeodNeighbor struct.
-/// @param mesh: the mesh, used to get the vertex coordinates from the vertex indices in geod_neighbors.
+/// @param mesh: the mesh, used to get the vertex coordinates from the vertex indices in geod_neighbors. A VCGLIB mesh, a `MeshView` or a `MeshGeometry`.
 /// @return vector of `n` Neighborhood instances
-std::vector<Neighborhood> neighborhoods_from_geod_neighbors(const std::vector<std::vector<GeodNeighbor> > geod_neighbors, MyMesh &mesh) {
+template<class MeshT>
+std::vector<Neighborhood> neighborhoods_from_geod_neighbors(const std::vector<std::vector<GeodNeighbor> > geod_neighbors, MeshT &mesh) {
   size_t num_neighborhoods = geod_neighbors.size();
   std::cout << std::string(APPTAG) << "Computing neighborhoods for " << num_neighborhoods << " vertices and their geodesic neighbors." << "\n";
   std::vector<Neighborhood> neighborhoods;
@@ -143,8 +148,8 @@ std::vector<Neighborhood> neighborhoods_from_geod_neighbors(const std::vector<st
   std::vector<float> source_vert_coords;
   std::vector<int> neigh_indices;
 
-  std::vector<std::vector<float>> m_vnormals = mesh_vnormals(mesh);
-  std::vector<std::vector<float>> m_vcoords = mesh_vertex_coords(mesh);
+  const std::vector<std::vector<float>>& m_vnormals = mesh_vnormals(mesh);  // References into the cache for a `MeshGeometry`.
+  const std::vector<std::vector<float>>& m_vcoords = mesh_vertex_coords(mesh);
 
   size_t central_vert_mesh_idx;
   size_t neigh_mesh_idx;
@@ -175,10 +180,11 @@ std::vector<Neighborhood> neighborhoods_from_geod_neighbors(const std::vector<st
 
 /// @brief Computes neighborhoods where the distance is the geodesic distance.
 /// @param edge_neighbors compute edge neighbors, see
-/// @param mesh VCGLIB mesh instance
+/// @param mesh the mesh, a VCGLIB mesh, a `MeshView` or a `MeshGeometry`.
 /// @param keep_verts vector with same length as edge_neighbors, whether to keep a certain vertex (neighborhood around this vertex). If left at default or empty vector is passed instead, all vertices will be kept (no filtering happens). Note that vertices ignored as centers of neighborhoods may still show up as part of a neighborhood of another source vertex.
 /// @details The distances in the return value are Euclidean distances.
-std::vector<Neighborhood> neighborhoods_from_edge_neighbors(const std::vector<std::vector<int> > edge_neighbors, MyMesh &mesh, std::vector<bool> keep_verts = std::vector<bool>()) {
+template<class MeshT>
+std::vector<Neighborhood> neighborhoods_from_edge_neighbors(const std::vector<std::vector<int> > edge_neighbors, MeshT &mesh, std::vector<bool> keep_verts = std::vector<bool>()) {
 
   size_t num_neighborhoods = edge_neighbors.size();
 
@@ -195,8 +201,8 @@ std::vector<Neighborhood> neighborhoods_from_edge_neighbors(const std::vector<st
   std::vector<float> source_vert_coords;
   std::vector<int> neigh_indices;
 
-  std::vector<std::vector<float>> m_vnormals = mesh_vnormals(mesh);
-  std::vector<std::vector<float>> m_vcoords = mesh_vertex_coords(mesh);
+  const std::vector<std::vector<float>>& m_vnormals = mesh_vnormals(mesh);  // References into the cache for a `MeshGeometry`.
+  const std::vector<std::vector<float>>& m_vcoords = mesh_vertex_coords(mesh);
 
   size_t central_vert_mesh_idx;
   for(size_t i = 0; i < num_neighborhoods; i++) {
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "libfs.h"
+#include "typedef_vcg.h"
+#include "mesh_geodesic.h"
+#include "sparse_matrix.h"
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
+// Smoothing of per-vertex data with Gaussian kernels based on geodesic distance along the mesh.
+//
+// Computing the geodesic neighborhoods is by far the most expensive part, so it is done only once for the largest
+// requested kernel. The kernels are stored as row-normalized sparse matrices, and smoothing a data vector is a single
+// sparse matrix-vector product. Kernels can be saved with `write_sparse_matrix` and re-used for all subjects that share
+// the mesh (e.g., fsaverage).
+
+
+/// @brief Convert the full width at half maximum (FWHM) of a Gaussian kernel to its standard deviation sigma.
+inline double fwhm_to_sigma(const double fwhm) {
+  return fwhm / (2.0 * std::sqrt(2.0 * std::log(2.0)));
+}
+
+
+/// @brief Compute a row-normalized Gaussian smoothing kernel from precomputed geodesic neighborhoods.
+/// @param neigh the geodesic neighborhoods of all vertices, see `geod_neighborhood`. They must reach at least `3 * sigma` and should include the vertex itself.
+/// @param fwhm the full width at half maximum of the Gaussian kernel, in mesh units (typically mm). Neighbors further away than 3 sigma are ignored.
+/// @return sparse matrix with one row per vertex, whose entries sum to 1.
+/// @throws std::domain_error if `fwhm` is not positive.
+SparseMatrix geod_gaussian_kernel(const std::vector<std::vector<GeodNeighbor>>& neigh, const float fwhm) {
+  if(fwhm <= 0.0) {
+    throw std::domain_error("The FWHM of the smoothing kernel must be positive.\n");
+  }
+  const double sigma = fwhm_to_sigma(fwhm);
+  const double cutoff = 3.0 * sigma;
+  const double denom = 2.0 * sigma * sigma;
+  const size_t nv = neigh.size();
+
+  SparseMatrix K;
+  K.num_rows = int32_t(nv);
+  K.num_cols = int32_t(nv);
+  std::vector<int64_t> counts(nv);
+  for(size_t i=0; i<nv; i++) {
+    int64_t c = 0;
+    for(size_t j=0; j<neigh[i].size(); j++) {
+      if(neigh[i][j].distance <= cutoff) {
+        c++;
+      }
+    }
+    counts[i] = c;
+  }
+  K.row_ptr.resize(nv + 1);
+  K.row_ptr[0] = 0;
+  for(size_t i=0; i<nv; i++) {
+    K.row_ptr[i+1] = K.row_ptr[i] + counts[i];
+  }
+  K.col_idx.resize(K.row_ptr[nv]);
+  K.values.resize(K.row_ptr[nv]);
+
+  const int64_t nv_signed = int64_t(nv);
+  # pragma omp parallel for schedule(static) shared(neigh, K)
+  for(int64_t i=0; i<nv_signed; i++) {
+    int64_t pos = K.row_ptr[i];
+    double row_sum = 0.0;
+    for(size_t j=0; j<neigh[i].size(); j++) {
+      const double d = neigh[i][j].distance;
+      if(d <= cutoff) {
+        const double w = std::exp(- d * d / denom);
+        K.col_idx[pos] = int32_t(neigh[i][j].index);
+        K.values[pos] = float(w);
+        row_sum += w;
+        pos++;
+      }
+    }
+    for(int64_t k=K.row_ptr[i]; k<pos; k++) {
+      K.values[k] = float(K.values[k] / row_sum);
+    }
+  }
+  return K;
+}
+
+
+/// @brief Compute row-normalized geodesic Gaussian smoothing kernels for several FWHM values.
+/// @details The geodesic neighborhoods are computed only once, up to 3 sigma of the largest FWHM, and shared by all kernels.
+/// @param m the mesh, a `MeshView` or a VCGLIB mesh.
+/// @param fwhms the full widths at half maximum of the requested kernels.
+/// @return one kernel per entry of `fwhms`, in the same order.
+template<class MeshT>
+std::vector<SparseMatrix> geod_gaussian_kernels(MeshT& m, const std::vector<float>& fwhms) {
+  std::vector<SparseMatrix> kernels;
+  if(fwhms.empty()) {
+    return kernels;
+  }
+  const float max_fwhm = *std::max_element(fwhms.begin(), fwhms.end());
+  const float max_dist = float(3.0 * fwhm_to_sigma(max_fwhm));
+  std::vector<std::vector<GeodNeighbor>> neigh = geod_neighborhood(m, max_dist, true);
+  for(size_t i=0; i<fwhms.size(); i++) {
+    kernels.push_back(geod_gaussian_kernel(neigh, fwhms[i]));
+  }
+  return kernels;
+}
@@ -104,3 +104,52 @@ typedef  MyMesh::VertContainer VertContainer;
 typedef  MyMesh::FaceContainer FaceContainer;
 /*typedef MyMesh::ConstVertexIterator ConstVertexIterator;
   typedef MyMesh::ConstFaceIterator   ConstFaceIterator;*/
+
+
+// The lean mesh type for geodesic workloads. It has exactly the components that `geodist`, `mesh_area_total`,
+// `mesh_area_per_face` and `mesh_edge_lengths` need, all of them static: coordinates, flags, the vertex mark and
+// quality used by the Dijkstra search, and the vertex-face adjacency. Without the colors, normals,
+// curvatures and texture coordinates of `MyMesh` and without the OCF bookkeeping, its elements are much smaller (see the
+// bench_vcgmesh app). Use `MyMesh` for everything else.
+class GeodFace;
+class GeodVertex;
+struct GeodUsedTypes: public UsedTypes<Use<GeodVertex>::AsVertexType,
+  Use<GeodFace>::AsFaceType
+  >{};
+
+class GeodVertex  : public Vertex< GeodUsedTypes,
+  vertex::Coord3f,
+  vertex::BitFlags,
+  vertex::Mark,
+  vertex::Qualityf,
+  vertex::VFAdj
+  >{};
+
+class GeodFace: public Face  <GeodUsedTypes,
+  face::VertexRef,
+  face::BitFlags,
+  face::VFAdj
+  > {};
+
+class GeodMesh : public vcg::tri::TriMesh< std::vector<GeodVertex>, std::vector<GeodFace> >{};
+
+
+/// @brief Provides `type` as `R` for VCGLIB mesh types only, i.e., types with a `VertContainer`.
+/// @details Used as the return type of the function templates on VCGLIB meshes like `MyMesh` and `GeodMesh`, so they do not compete with the `MeshView` functions of the same name.
+template<class VertContainer, class R>
+struct VcgMeshReturn {
+  typedef R type;
+};
+
+
+/// @brief Enable the optional components of a VCGLIB mesh that the geodesic functions need. Nothing to do for meshes with static components like `GeodMesh`.
+template<class MeshT>
+void enable_geodesic_components(MeshT&) {}
+
+
+/// @brief Enable the optional components of a `MyMesh` that the geodesic functions need.
+void enable_geodesic_components(MyMesh& m) {
+  m.vert.EnableVFAdjacency();
+  m.vert.EnableQuality();
+  m.face.EnableVFAdjacency();
+}
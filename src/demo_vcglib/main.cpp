@@ -76,7 +76,9 @@ int demo_vcglibbrain(const std::string& exec_mode, const std::string& subject) {
     query_vertices_geod.push_back(qv);
     std::cout << " Computing geodesic distance from query vertex " << qv << " to all others.\n";
     float max_dist = -1.0; // Negative value means no max distance.
-    std::vector<float> dists_to_vert = geodist(m, query_vertices_geod, max_dist);
+    GeodMesh gm;  // The search only needs the components of the lean mesh type.
+    vcgmesh_from_fs_surface(&gm, lh_white);
+    std::vector<float> dists_to_vert = geodist(gm, query_vertices_geod, max_dist);
 
     // Compute mean geodesic distance from each vertex to all others
     std::cout << " Computing mean geodesic distance from each vertex to all others.\n";
@@ -9,6 +9,8 @@
 #include "mesh_adj.h"
 #include "mesh_geodesic.h"
 #include "values_to_color.h"
+#include "mesh_mmap_io.h"
+#include "mesh_ply_export.h"
 
 
 #include <string>
@@ -16,60 +18,205 @@
 #include <vector>
 #include <algorithm>
 #include <iterator>
+#include <sstream>
+
+
+/// Read per-vertex data from a file in FreeSurfer curv or MGH format (determined by the file extension).
+std::vector<float> read_vertex_data(const std::string& data_file) {
+    if(fs::util::ends_with(data_file, ".mgh")) {
+        fs::Mgh mgh;
+        fs::read_mgh(&mgh, data_file);
+        return mgh.data.data_mri_float;
+    }
+    return read_curv_data_mmap(data_file);
+}
 
 
 /// Export a colored PLY brain mesh, can be viewed in Meshlab.
-void export_brain(const std::string& surf_file, const std::string& curv_file, const std::string& output_ply_file) {
+/// @param binary whether to write binary little endian PLY instead of ASCII PLY.
+void export_brain(const std::string& surf_file, const std::string& curv_file, const std::string& output_ply_file, const bool binary = false) {
     // Load mesh and data.
     fs::Mesh surface;
-    fs::read_mesh(&surface, surf_file);
-    std::vector<float> morph_data = fs::read_curv_data(curv_file);
+    read_mesh_mmap(&surface, surf_file);
+    std::vector<float> morph_data = read_vertex_data(curv_file);
 
     // Map data to colors
     std::vector<u_int8_t> colors = data_to_colors(morph_data);
-    surface.to_ply_file(output_ply_file, colors);
+    if(binary) {
+        write_ply_binary(output_ply_file, surface, colors);
+    } else {
+        surface.to_ply_file(output_ply_file, colors);
+    }
     std::cout << "Vertex-colored brain mesh written to file '" << output_ply_file << "'.\n";
 }
 
 
 /// Export a non-colored or plain brain mesh.
-void export_brain(const std::string& surf_file, const std::string& output_ply_file) {
+/// @param binary whether to write binary little endian PLY instead of ASCII PLY.
+void export_brain(const std::string& surf_file, const std::string& output_ply_file, const bool binary = false) {
     // Load mesh and data.
     fs::Mesh surface;
-    fs::read_mesh(&surface, surf_file);
+    read_mesh_mmap(&surface, surf_file);
 
-    // Map data to colors
-    surface.to_ply_file(output_ply_file);
+    if(binary) {
+        write_ply_binary(output_ply_file, surface);
+    } else {
+        surface.to_ply_file(output_ply_file);
+    }
     std::cout << "Plain brain mesh written to file '" << output_ply_file << "'.\n";
 }
 
+
+/// Parse a comma-separated list of measures, like 'thickness,area'.
+/// @throws std::runtime_error if the list contains no measure or an empty entry.
+std::vector<std::string> parse_measure_list(const std::string& arg) {
+    std::vector<std::string> measures;
+    std::stringstream ss(arg);
+    std::string measure;
+    while(std::getline(ss, measure, ',')) {
+        if(measure.empty()) {
+            throw std::runtime_error("Argument measure list '" + arg + "' contains an empty entry.\n");
+        }
+        measures.push_back(measure);
+    }
+    if(measures.empty()) {
+        throw std::runtime_error("Argument measure list must contain at least one measure.\n");
+    }
+    return measures;
+}
+
+
+/// Export colored binary PLY brain meshes for both hemispheres of many subjects and one or more measures, in parallel.
+/// @param subjects_file text file containing one subject identifier per line.
+/// @param subjects_dir directory containing the FreeSurfer recon-all output for the subjects.
+/// @param surface_name the surface to load from the surf/ subdir of each subject, without hemi part, e.g., 'white'.
+/// @param measures the per-vertex data to load from the surf/ subdir of each subject, without hemi part, e.g., 'thickness'. May end with '.mgh' for MGH files. One mesh is exported per measure.
+/// @param output_dir directory into which the PLY files are written, as '<subject>_<hemi>.<surface>_<measure>.ply'.
+/// @param clip_percent percentage of data values to clip at each end of the value range before mapping to colors, see `data_to_colors`. Defaults to 0.0, i.e., no clipping.
+/// @return the number of exports that failed, e.g., because of missing files.
+size_t export_brain_batch(const std::string& subjects_file, const std::string& subjects_dir, const std::string& surface_name, const std::vector<std::string>& measures, const std::string& output_dir, const double clip_percent = 0.0) {
+    const std::vector<std::string> subjects = fs::read_subjectsfile(subjects_file);
+    const std::vector<std::string> hemis = {"lh", "rh"};
+    std::vector<std::string> measure_names(measures);
+    for(size_t i=0; i<measure_names.size(); i++) {
+        if(fs::util::ends_with(measure_names[i], ".mgh")) {
+            measure_names[i] = measure_names[i].substr(0, measure_names[i].size() - 4);
+        }
+    }
+    // One job per subject, hemi and measure, so a few subjects with many measures also use all threads.
+    const int64_t num_jobs = int64_t(subjects.size() * hemis.size() * measures.size());
+    std::vector<std::string> errors(num_jobs);
+    std::cout << "Exporting " << num_jobs << " colored meshes for " << subjects.size() << " subjects, 2 hemispheres and " << measures.size() << " measures from '" << subjects_dir << "' to '" << output_dir << "'.\n";
+
+    # pragma omp parallel shared(subjects, hemis, measures, measure_names, errors)
+    {
+        // The color buffer is reused across the jobs of a thread, so it is only reallocated when a mesh is larger than all previous ones.
+        std::vector<uint8_t> colors;
+        # pragma omp for schedule(dynamic, 1)
+        for(int64_t job=0; job<num_jobs; job++) {
+            const std::string& subject = subjects[job / (hemis.size() * measures.size())];
+            const std::string& hemi = hemis[(job / measures.size()) % hemis.size()];
+            const std::string& measure = measures[job % measures.size()];
+            const std::string& measure_name = measure_names[job % measures.size()];
+            const std::string surf_file = fs::util::fullpath({subjects_dir, subject, "surf", hemi + "." + surface_name});
+            const std::string data_file = fs::util::fullpath({subjects_dir, subject, "surf", hemi + "." + measure});
+            const std::string output_ply_file = fs::util::fullpath({output_dir, subject + "_" + hemi + "." + surface_name + "_" + measure_name + ".ply"});
+            try {
+                fs::Mesh surface;
+                read_mesh_mmap(&surface, surf_file);
+                std::vector<float> morph_data = read_vertex_data(data_file);
+                if(morph_data.size() != surface.num_vertices()) {
+                    throw std::runtime_error("Data file '" + data_file + "' contains " + std::to_string(morph_data.size()) + " values, but the mesh has " + std::to_string(surface.num_vertices()) + " vertices.\n");
+                }
+                colors.resize(morph_data.size() * 3);
+                data_to_colors(morph_data.data(), morph_data.size(), colors.data(), tinycolormap::ColormapType::Viridis, clip_percent);
+                write_ply_binary(output_ply_file, surface, colors);
+            } catch(const std::exception& e) {
+                errors[job] = e.what();
+            }
+        }
+    }
+
+    size_t num_failed = 0;
+    for(int64_t job=0; job<num_jobs; job++) {
+        if(! errors[job].empty()) {
+            std::cerr << " * Failed to export subject '" << subjects[job / (hemis.size() * measures.size())] << "' hemi " << hemis[(job / measures.size()) % hemis.size()] << " measure '" << measures[job % measures.size()] << "': " << errors[job];
+            num_failed++;
+        }
+    }
+    std::cout << "Exported " << (num_jobs - num_failed) << " of " << num_jobs << " meshes.\n";
+    return num_failed;
+}
+
+
 /// Generate unit cube.
 /// @param mesh fslib mesh, an empty mesh instance to which to add cube vertices and faces.
 
 
 int main(int argc, char** argv) {
 
-    if(argc < 3 || argc > 4) {
+    // Handle the optional '--binary' flag, which can be given as the first argument in the single mesh modes.
+    bool binary = false;
+    std::vector<std::string> args(argv, argv + argc);
+    if(args.size() > 1 && args[1] == "--binary") {
+        binary = true;
+        args.erase(args.begin() + 1);
+    }
+    const size_t nargs = args.size();
+
+    if(nargs >= 2 && args[1] == "--batch") {
+        if(nargs != 7 && nargs != 8) {
+            std::cout << "Usage: " << args[0] << " --batch <subjects_file> <subjects_dir> <surface> <measures> <output_dir> [<clip_percent>]\n";
+            exit(1);
+        }
+        double clip_percent = 0.0;
+        if(nargs == 8) {
+            std::istringstream iss(args[7]);
+            if(!(iss >> clip_percent) || clip_percent < 0.0 || clip_percent >= 50.0) {
+                std::cerr << "Invalid <clip_percent> '" << args[7] << "': must be a number in range [0, 50).\n";
+                exit(1);
+            }
+        }
+        std::vector<std::string> measures;
+        try {
+            measures = parse_measure_list(args[5]);
+        } catch(const std::exception& e) {
+            std::cerr << e.what();
+            exit(1);
+        }
+        size_t num_failed = export_brain_batch(args[2], args[3], args[4], measures, args[6], clip_percent);
+        exit(num_failed == 0 ? 0 : 1);
+    }
+
+    if(nargs < 3 || nargs > 4) {
         std::cout << "== Export colored brain mesh ==.\n";
-        std::cout << "Usage: " << argv[0] << "[<surf_file> [<curv_file>] <output_ply_file>] | [--gen-cube <output_ply_file>]\n";
+        std::cout << "Usage: " << args[0] << " [--binary] [<surf_file> [<curv_file>] <output_ply_file>] | [--gen-cube <output_ply_file>]\n";
+        std::cout << "       " << args[0] << " --batch <subjects_file> <subjects_dir> <surface> <measures> <output_dir> [<clip_percent>]\n";
+        std::cout << "  --binary          : optional flag, write binary little endian PLY files instead of ASCII PLY. Binary files are smaller and much faster to write and read.\n";
         std::cout << "  <surf_file>       : path to a brain mesh file, typically in FreeSurfer surf format.\n";
         std::cout << "  <curv_file>       : optional, path to a file containing per-vertex data for the mesh, typically in FreeSurfer curv format. If omitted, no colors will be produced.\n";
         std::cout << "  <output_ply_file> : path to the output file in PLY format, will be created (or overwritten in case it exists).\n";
-        std::cout << "  Examples: " << argv[0] << " demo_data/subjects_dir/subject1/surf/lh.white demo_data/subjects_dir/subject1/surf/lh.thickness colored_brain.ply\n";
-        std::cout << "            " << argv[0] << " demo_data/subjects_dir/subject1/surf/lh.white plain_brain.ply\n";
-        std::cout << "            " << argv[0] << " --gen-cube cube_mesh.ply\n";
+        std::cout << "  --batch           : export colored binary PLY meshes for both hemispheres of all subjects in <subjects_file> in parallel, loading '<subjects_dir>/<subject>/surf/<hemi>.<surface>' and '<subjects_dir>/<subject>/surf/<hemi>.<measure>' for each measure in the comma-separated list <measures>, e.g., 'thickness,area'. The output files are named '<output_dir>/<subject>_<hemi>.<surface>_<measure>.ply'. The optional <clip_percent> clips that percentage of the data values at each end of the range before mapping them to colors, e.g., 2 maps the 2nd to 98th percentile to the full colormap. Defaults to 0.\n";
+        std::cout << "  Examples: " << args[0] << " demo_data/subjects_dir/subject1/surf/lh.white demo_data/subjects_dir/subject1/surf/lh.thickness colored_brain.ply\n";
+        std::cout << "            " << args[0] << " --binary demo_data/subjects_dir/subject1/surf/lh.white plain_brain.ply\n";
+        std::cout << "            " << args[0] << " --gen-cube cube_mesh.ply\n";
+        std::cout << "            " << args[0] << " --batch demo_data/subjects_dir/subjects_fsaverage3.txt demo_data/subjects_dir white thickness .\n";
         std::cout << "Hint: A great software to visualize colored PLY meshes is MeshLab. Run `meshlab mymesh.ply` to view if you have it installed.\n";
         exit(1);
-    } else if (argc == 3) {
-        if(std::string(argv[1]) == "--gen-cube") {
-            std::cout << "Generating simple cube mesh in PLY format and writing to '" << argv[2] << "'\n.";
+    } else if (nargs == 3) {
+        if(args[1] == "--gen-cube") {
+            std::cout << "Generating simple cube mesh in PLY format and writing to '" << args[2] << "'\n.";
             fs::Mesh surface = fs::Mesh::construct_cube();
-            surface.to_ply_file(argv[2]);
+            if(binary) {
+                write_ply_binary(args[2], surface);
+            } else {
+                surface.to_ply_file(args[2]);
+            }
         } else {
-            export_brain(argv[1], argv[2]);
+            export_brain(args[1], args[2], binary);
         }
-    } else { // argc = 4
-        export_brain(argv[1], argv[2], argv[3]);
+    } else { // nargs = 4
+        export_brain(args[1], args[2], args[3], binary);
     }
     exit(0);
 }
@@ -10,6 +10,10 @@
 #include "mesh_geodesic.h"
 #include "values_to_color.h"
 #include "io.h"
+#include "mesh_mmap_io.h"
+#include "mesh_view.h"
+#include "mesh_reorder.h"
+#include "geod_graph_file.h"
 
 
 #include <string>
@@ -18,28 +22,33 @@
 #include <algorithm>
 #include <iterator>
 #include <chrono>
-#include <unordered_map>
+#include <sstream>
 
 
 int main(int argc, char** argv) {
 
     std::cout << "=====[ geodcircles ]=====.\n";
 
-    if(argc < 2 || argc > 10) {
+    if(argc < 2 || argc > 13) {
         std::cout << "== Compute mean geodesic distances and circle stats for FreeSurfer brain meshes ==.\n";
-        std::cout << "Usage: " << argv[0] << " <subjects_file> [<subjects_dir> [<surface> [<do_circle_stats> [<keep_existing> [<circ_scale> [<cortex_label> [<hemi>] [<write_mgh>]]]]]]]]\n";
+        std::cout << "Usage: " << argv[0] << " <subjects_file> [<subjects_dir> [<surface> [<do_circle_stats> [<keep_existing> [<circ_scale> [<cortex_label> [<hemi>] [<write_mgh> [<reorder> [<radius_method> [<cache_dir>]]]]]]]]]]]\n";
         std::cout << "  <subjects_file> : text file containing one subject identifier per line.\n";
         std::cout << "  <subjects_dir>  : directory containing the FreeSurfer recon-all output for the subjects. Defaults to current working directory.\n";
-        std::cout << "  <surface>       : the surface file to load from the surf/ subdir of each subject, without hemi part. Defaults to 'pial'.\n";
+        std::cout << "  <surface>       : the surface file to load from the surf/ subdir of each subject, without hemi part. Defaults to 'pial'. Can be a comma-separated list of surfaces, e.g., 'white,pial', which are computed in turn for each subject and hemi.\n";
         std::cout << "  <do_circle_stat>: flag whether to compute geodesic circle stats as well, must be 0 (off), 1 (on) or 2 (on with mean dists). Defaults to 2. Valid aliases for 0 are 'false' and 'no'. Valid aliases for 1 are 'true' and 'yes'. Valid aliases for 2 are 'yes_with_meandists' and 'true_with_meandists'.\n";
         std::cout << "  <keep_existing> : flag whether to keep existing output files, must be 'no' (off: recompute and overwrite files. aliases: '0' and 'false' are also supported), or 'yes' (keep existing files, skip computation if exists). Aliases '1' / 'true', or '0' / 'false' are also supported. Defaults to 1.\n";
-        std::cout << "  <circ_scale>    : int, the fraction of the total surface that the circles for the geodesic circle stats should have (in percent). Ignored if do_circle_stats is 0. Defaults to 5.\n";
+        std::cout << "  <circ_scale>    : int, the fraction of the total surface that the circles for the geodesic circle stats should have (in percent). Ignored if do_circle_stats is 0. Defaults to 5. Can be a comma-separated list, e.g., '5,10,20', which computes the circle stats for all of them from a single geodesic search per vertex, and writes one set of output files per setting.\n";
         std::cout << "  <cortex_label>  : str, optional file name of a cortex label file, without the hemi prefix to load from the label/ subdir of each subject. If given, load label and ignore non-label vertices, typically the medial wall, during all computations. Defaults to the empty string, i.e., no cortex label file. E.g., 'cortex.label'. Can be set to 'none' to turn off.\n";
         std::cout << "  <hemi>          : str, which hemispheres to compute. One of 'lh', 'rh' or 'both'. Defaults to 'both'.\n";
         std::cout << "  <write_mgh>     : flag whether to write extra output files in MGH format (in addition to curv format), must be 'no' (off: only curv format) or 'yes' (on: write curv and MGH formats).  Aliases '1' / 'true', or '0' / 'false' are also supported. Defaults to 0.\n";
+        std::cout << "  <reorder>       : str, vertex reordering for better cache locality during the computation, one of 'none', 'rcm' (Reverse Cuthill-McKee) or 'morton' (Morton order of the coordinates). The results are mapped back to the original vertex order, so this only affects the computation time. Defaults to 'none'.\n";
+        std::cout << "  <radius_method> : str, how the geodesic circle radius with the requested area is found, 'spline' (interpolate the areas at 10 radii around the radius of a flat disk with cubic splines) or 'root' (root finding on the exact area function, faster and more accurate, but the results differ slightly from the ones of 'spline'). Ignored if do_circle_stats is 0. Defaults to 'spline'.\n";
+        std::cout << "  <cache_dir>     : str, optional existing directory for the geodesic neighborhood cache. The bounded neighborhoods of all vertices are read from it if a cache file for the mesh, cortex mask and a large enough radius exists, and computed and written to it otherwise. The cache files are named by a hash of the mesh content and take 8 bytes per neighbor. Ignored for the mean distances, which need full searches. Defaults to 'none', i.e., no cache.\n";
         std::cout << "NOTES:\n";
         std::cout << " * Sorry for the current command line parsing state: you will have to supply all arguments if you want to change the last one.\n";
         std::cout << " * We recommend to run this on simplified meshes to save computation time, e.g., by scaling the vertex count to that of fsaverage6. If you do that and use the cortex_label parameter, you will of course also need scaled cortex labels.\n";
+        std::cout << " * Meshes with the same faces as the previous mesh of the same hemi, like the surfaces of one subject or subjects resampled to fsaverage, reuse its vertex adjacency and only recompute the edge lengths and face areas.\n";
+        std::cout << " * Without <cortex_label> and <reorder>, the vertex adjacency, edge lengths, face areas and face adjacency are read from the graph sidecar '<surface file>.geodgraph' if it exists and matches the mesh, see the geodgraph app.\n";
         std::cout << " * The output files will be written to the surf/ subdir of each subject. They are in FreeSurfer curv format. See write_mgh above if you also want MGH format.\n";
         exit(1);
     }
@@ -52,12 +61,16 @@ int main(int argc, char** argv) {
     bool keep_existing_files = true;
     bool circle_stats_do_meandists = true;
     std::string cortex_label = "";
-    int circ_scale = 5; // The fraction of the total surface that the circles for the geodesic circle stats should have (in percent).
+    std::vector<int> circ_scales = {5}; // The fractions of the total surface that the circles for the geodesic circle stats should have (in percent).
     string arg_hemi = "both";
     bool write_output_also_in_mgh_format = false;
+    std::string reorder_method = "none";
+    std::string radius_method = "spline";
+    std::string cache_dir = "none";
 
     // These settings cannot be changed via command line arguments, they require a recompile.
-    float fill_value = 0.0f; // The default per-vertex data value used when mapping data from cortex-only submesh back to the full mesh. Only relevant if a valid 'cortex_label' is used. Note that while std::numeric_limits<float>::quiet_NaN() seems to be the best choice, this cannot be used because FreeSurfer tools (which are likely to be used on the output data later) cannot handle per-vertex data including NAN values.
+    const double radius_tolerance = 1e-6; // The relative tolerance of the geodesic circle area for radius method 'root'.
+    float fill_value = 0.0f; // The default per-vertex data value used for the medial wall vertices outside the cortex mask. Only relevant if a valid 'cortex_label' is used. Note that while std::numeric_limits<float>::quiet_NaN() seems to be the best choice, this cannot be used because FreeSurfer tools (which are likely to be used on the output data later) cannot handle per-vertex data including NAN values.
     std::string curv_outputfile_extension = ""; // Output file extension for the curv files when constructing output file names, including the dot if one is wanted. FreeSurfer does not use any, but one could use '.curv' to indicate the format and avoid confusion, as the format could also be MGH/MGZ instead of curv.
     std::string mgh_outputfile_extension = ".mgh";  // Output file extension for the optional MGH files when constructing output file names, including the dot if one is wanted.
 
@@ -94,8 +107,21 @@ int main(int argc, char** argv) {
             exit(1);
         }
     }
-    if(argc >= 7) { // circ_scale
-        circ_scale = std::atoi(argv[6]);
+    if(argc >= 7) { // circ_scale, a comma-separated list.
+        circ_scales.clear();
+        std::istringstream circ_scale_list(argv[6]);
+        std::string circ_scale;
+        while(std::getline(circ_scale_list, circ_scale, ',')) {
+            circ_scales.push_back(std::atoi(circ_scale.c_str()));
+            if(circ_scales.back() <= 0) {
+                std::cerr << "Invalid value '" << circ_scale << "' for parameter 'circ_scale'. Must be a positive integer or a comma-separated list of them.\n";
+                exit(1);
+            }
+        }
+        if(circ_scales.empty()) {
+            std::cerr << "Invalid value for parameter 'circ_scale'. Must not be empty.\n";
+            exit(1);
+        }
     }
     if(argc >= 8) { // cortex_label
         cortex_label = std::string(argv[7]);
@@ -103,7 +129,7 @@ int main(int argc, char** argv) {
     if(argc >= 9) {
         arg_hemi = std::string(argv[8]);
     }
-    if(argc == 10) { // whether to keep existing files / skip computation for those that are already done.
+    if(argc >= 10) { // whether to keep existing files / skip computation for those that are already done.
         if (std::string(argv[9]) == "0" || std::string(argv[9]) == "no" || std::string(argv[9]) == "false") {
             write_output_also_in_mgh_format = false;
         } else if (std::string(argv[9]) == "1" || std::string(argv[9]) == "yes" || std::string(argv[9]) == "true") {
@@ -113,6 +139,23 @@ int main(int argc, char** argv) {
             exit(1);
         }
     }
+    if(argc >= 11) {
+        reorder_method = std::string(argv[10]);
+        if(reorder_method != "none" && reorder_method != "rcm" && reorder_method != "morton") {
+            std::cerr << "Invalid value for parameter 'reorder'. Must be 'none', 'rcm' or 'morton'.\n";
+            exit(1);
+        }
+    }
+    if(argc >= 12) {
+        radius_method = std::string(argv[11]);
+        if(radius_method != "spline" && radius_method != "root") {
+            std::cerr << "Invalid value for parameter 'radius_method'. Must be 'spline' or 'root'.\n";
+            exit(1);
+        }
+    }
+    if(argc == 13) {
+        cache_dir = std::string(argv[12]);
+    }
 
     if (! fs::util::file_exists(subjects_file)) {
         std::cerr << "Subjects file '" << subjects_file << "' does not exist.\n";
@@ -128,12 +171,27 @@ int main(int argc, char** argv) {
 
     std::cout << "=Settings=\n";
     std::cout << "Using " << subjects.size() << " subjects listed in subjects file '" << subjects_file << "'.\n";
-    std::cout << "Using subject directory '" << subjects_dir << "' and surface '" << surface_name << "'.\n";
-    std::cout << (do_circle_stats? "Computing" : "Not computing")  << " geodesic circle stats" << (do_circle_stats? " with scale " + std::to_string(circ_scale) : "") << ".\n";
+    std::vector<std::string> surface_names;
+    const std::string surface_arg = surface_name;
+    std::istringstream surface_list(surface_arg);
+    while(std::getline(surface_list, surface_name, ',')) {
+        surface_names.push_back(surface_name);
+    }
+    if(surface_names.empty()) {
+        std::cerr << "Invalid value for parameter 'surface'. Must not be empty.\n";
+        exit(1);
+    }
+    std::cout << "Using subject directory '" << subjects_dir << "' and " << surface_names.size() << " surface(s) '" << surface_arg << "'.\n";
+    std::stringstream circ_scales_str;
+    for(size_t k=0; k<circ_scales.size(); k++) {
+        circ_scales_str << (k > 0 ? "," : "") << circ_scales[k];
+    }
+    std::cout << (do_circle_stats? "Computing" : "Not computing")  << " geodesic circle stats" << (do_circle_stats? " with scale " + circ_scales_str.str() : "") << ".\n";
     std::cout << (keep_existing_files? "Keeping" : "Not keeping (recomputing data for)")  << " existing output files.\n";
     if(do_circle_stats) {
         std::cout << (circle_stats_do_meandists? "Also computing" : "Not computing")  << " geodesic mean distances while computing circle stats.\n";
-        std::cout << "Using circ_scale " << circ_scale << "\n";
+        std::cout << "Using circ_scale " << circ_scales_str.str() << "\n";
+        std::cout << "Using radius method '" << radius_method << "' for the geodesic circles.\n";
     }
 
     bool use_cortex_label = cortex_label.size() > 0 && cortex_label != "none";
@@ -149,6 +207,12 @@ int main(int argc, char** argv) {
     } else {
         std::cout << "Writing all output files in FreeSurfer curv file format.\n";
     }
+    if(reorder_method != "none") {
+        std::cout << "Reordering mesh vertices with method '" << reorder_method << "' for the computation.\n";
+    }
+    if(cache_dir != "none") {
+        std::cout << "Using geodesic neighborhood cache directory '" << cache_dir << "'.\n";
+    }
 
     std::cout << "=Starting computation=\n";
 
@@ -172,20 +236,27 @@ int main(int argc, char** argv) {
     unsigned int num_skipped_hemis_so_far = 0; // This counts subject hemispheres for which no computation took place: the sum of failed subject hemis (e.g., due to missing surface files) and (if 'keep_existing_files' is true) subject hemis for which the output files already existed.
 
     bool circle_stats_do_meandists_this_hemi;
+    // Per hemi, the graph of the last mesh and its faces. Meshes with the same faces reuse the adjacency, see geod_graph_cached.
+    // The same holds for the RCM vertex order, which depends on the adjacency only.
+    std::vector<GeodGraphCache> graph_caches(hemis.size());
+    std::vector<std::vector<int32_t>> rcm_faces(hemis.size());
+    std::vector<VertexOrder> rcm_orders(hemis.size());
     for (size_t i=0; i<subjects.size(); i++) {
         subject = subjects[i];
         std::cout << " * Handling subject '" << subject << "', # " << (i+1) << " of " << subjects.size() << ".\n";
         std::chrono::time_point<std::chrono::steady_clock> subject_start_at = std::chrono::steady_clock::now();
-        for (size_t hemi_idx=0; hemi_idx<hemis.size(); hemi_idx++) {
+        for (size_t job_idx=0; job_idx<hemis.size() * surface_names.size(); job_idx++) {
             std::chrono::time_point<std::chrono::steady_clock> subject_hemi_start_at = std::chrono::steady_clock::now();
+            const size_t hemi_idx = job_idx / surface_names.size();
             hemi = hemis[hemi_idx];
+            surface_name = surface_names[job_idx % surface_names.size()];
 
             circle_stats_do_meandists_this_hemi = circle_stats_do_meandists;
 
             // Load FreeSurfer mesh from file.
             surf_file = fs::util::fullpath({subjects_dir, subject, "surf", hemi + "." + surface_name});
             try {
-                fs::read_mesh(&surface, surf_file);
+                read_mesh_mmap(&surface, surf_file);
             } catch(const std::exception& e) {
                 std::cerr << "   - Failed to load surface '" << surf_file << "' for subject " << subject << ", skipping hemi. Details: " << e.what();
                 failed_subjects.push_back(subject); // This may result in subjects ending up twice in the list, if both hemis fail. That is fine with us for now, and handled at the end when reporting.
@@ -195,16 +266,11 @@ int main(int argc, char** argv) {
 
             std::cout << "   - Handling hemi " << hemi << " for surface '" << surface_name << "' with " << surface.num_vertices() << " vertices and " << surface.num_faces() << " faces.\n";
 
-            // Create a VCGLIB mesh from the libfs Mesh.
-            MyMesh m;
-            vcgmesh_from_fs_surface(&m, surface);
-            MyMesh m_cortex;
-
             std::vector<bool> is_vertex_cortical = std::vector<bool>(surface.num_vertices(), true); // We assume all vertices are cortical by default.
 
             // Load cortex label if given.
-            std::pair<std::unordered_map<int32_t, int32_t>, fs::Mesh> res_pair;
             fs::Label label;
+            MeshMask mask;
             if(use_cortex_label) {
                 const std::string cortex_label_file = fs::util::fullpath({subjects_dir, subject, "label", hemi + "." + cortex_label});
                 try {
@@ -224,109 +290,70 @@ int main(int argc, char** argv) {
                     continue;
                 }
                 std::cout << "   - Loaded cortex label file '" << cortex_label_file << "', cortex spans " << label.vertex.size() << " of " << surface.num_vertices() << " vertices (" << int(label.vertex.size()/(float)surface.num_vertices()*100.0) << " percent).\n";
-
-                res_pair = surface.submesh_vertex(label.vertex);
-
-                vcgmesh_from_fs_surface(&m_cortex, res_pair.second);
-
-                std::cout << "Created VCG mesh with " << m_cortex.VN() << " vertices and " << m_cortex.FN() << " faces from cortex label.\n";
+                try {
+                    mask = mesh_mask(mesh_view(surface), label.vertex);
+                } catch(const std::exception& e) {
+                    std::cerr << "   - Invalid cortex label file '" << cortex_label_file << "' for subject " << subject << ", skipping hemi. Details: " << e.what();
+                    failed_subjects.push_back(subject); // This may result in subjects ending up twice in the list, if both hemis fail. That is fine with us for now, and handled at the end when reporting.
+                    num_skipped_hemis_so_far++;
+                    continue;
+                }
+                std::cout << "   - Created cortex mask with " << mask.num_vertices() << " vertices and " << mask.num_faces() << " faces from cortex label.\n";
             }
 
             std::string cortex_outfilepart = use_cortex_label ? "cortex" : "fullbr";    // cortex only or full brain mesh, including medial wall
-            std::string circscale_outfilepart = "_cs" + std::to_string(circ_scale); // The circ_scale setting, if circle stats are computed.
 
 
             const std::string mgd_filename_curv = fs::util::fullpath({subjects_dir, subject, "surf", hemi + ".meangeodist_" + surface_name + "_" + cortex_outfilepart + curv_outputfile_extension});
             const std::string mgd_filename_mgh = fs::util::fullpath({subjects_dir, subject, "surf", hemi + ".meangeodist_" + surface_name + "_" + cortex_outfilepart + mgh_outputfile_extension});
 
-            // Compute the geodesic mean distances and write result file.
+            // Decide which output files still need to be computed before building anything for the mesh, so hemis with
+            // existing output files are skipped right away.
+            std::vector<std::string> rad_filenames_curv, per_filenames_curv, rad_filenames_mgh, per_filenames_mgh;
+            std::vector<size_t> scales_todo; // Indices into circ_scales of the scales to compute.
             if(do_circle_stats) {
-                const std::string rad_filename_curv = fs::util::fullpath({subjects_dir, subject, "surf", hemi + ".geocircradius_" + surface_name + "_" + cortex_outfilepart + circscale_outfilepart + curv_outputfile_extension});
-                const std::string per_filename_curv = fs::util::fullpath({subjects_dir, subject, "surf", hemi + ".geocircperimeter_" + surface_name + "_" + cortex_outfilepart + circscale_outfilepart + curv_outputfile_extension});
-                const std::string rad_filename_mgh = fs::util::fullpath({subjects_dir, subject, "surf", hemi + ".geocircradius_" + surface_name + "_" + cortex_outfilepart + circscale_outfilepart + mgh_outputfile_extension});
-                const std::string per_filename_mgh = fs::util::fullpath({subjects_dir, subject, "surf", hemi + ".geocircperimeter_" + surface_name + "_" + cortex_outfilepart + circscale_outfilepart + mgh_outputfile_extension});
+                // One set of output files per circ_scale setting.
+                for(size_t k=0; k<circ_scales.size(); k++) {
+                    const std::string circscale_outfilepart = "_cs" + std::to_string(circ_scales[k]); // The circ_scale setting, if circle stats are computed.
+                    rad_filenames_curv.push_back(fs::util::fullpath({subjects_dir, subject, "surf", hemi + ".geocircradius_" + surface_name + "_" + cortex_outfilepart + circscale_outfilepart + curv_outputfile_extension}));
+                    per_filenames_curv.push_back(fs::util::fullpath({subjects_dir, subject, "surf", hemi + ".geocircperimeter_" + surface_name + "_" + cortex_outfilepart + circscale_outfilepart + curv_outputfile_extension}));
+                    rad_filenames_mgh.push_back(fs::util::fullpath({subjects_dir, subject, "surf", hemi + ".geocircradius_" + surface_name + "_" + cortex_outfilepart + circscale_outfilepart + mgh_outputfile_extension}));
+                    per_filenames_mgh.push_back(fs::util::fullpath({subjects_dir, subject, "surf", hemi + ".geocircperimeter_" + surface_name + "_" + cortex_outfilepart + circscale_outfilepart + mgh_outputfile_extension}));
+                }
                 // Note: there is another filename for the mean geodist, but that is only used if we do not compute circle stats. See variable 'mean_geodist_outfile' below.
 
+                for(size_t k=0; k<circ_scales.size(); k++) {
+                    const bool exists = file_exists(rad_filenames_curv[k]) && file_exists(per_filenames_curv[k]) &&
+                                        (! write_output_also_in_mgh_format || (file_exists(rad_filenames_mgh[k]) && file_exists(per_filenames_mgh[k])));
+                    if(! (keep_existing_files && exists)) {
+                        scales_todo.push_back(k);
+                    }
+                }
                 if(keep_existing_files) {
+                    const std::string format_msg = write_output_also_in_mgh_format ? "curv and MGH format output files exist" : "curv format output files exist";
                     if(circle_stats_do_meandists_this_hemi) {
-                        if(write_output_also_in_mgh_format) {
-                            if(file_exists(rad_filename_curv) && file_exists(per_filename_curv) && file_exists(mgd_filename_curv) &&
-                                            file_exists(rad_filename_mgh) && file_exists(per_filename_mgh) && file_exists(mgd_filename_mgh)) {
-                                std::cout << "     o Skipping computation for hemi " << hemi << ", curv and MGH format output files exist.\n";
-                                num_skipped_hemis_so_far++;
-                                continue;
-                            }
-                        } else {
-                            if(file_exists(rad_filename_curv) && file_exists(per_filename_curv) && file_exists(mgd_filename_curv)) {
-                                std::cout << "     o Skipping computation for hemi " << hemi << ", curv format output files exist.\n";
-                                num_skipped_hemis_so_far++;
-                                continue;
-                            }
+                        const bool meandist_exists = file_exists(mgd_filename_curv) && (! write_output_also_in_mgh_format || file_exists(mgd_filename_mgh));
+                        if(scales_todo.empty() && meandist_exists) {
+                            std::cout << "     o Skipping computation for hemi " << hemi << ", " << format_msg << ".\n";
+                            num_skipped_hemis_so_far++;
+                            continue;
                         }
                         // If people run this program several times with different circ_scale settings, we may not have
                         // computed the circle stats for the current setting yet, but as the mean dist is not affected by
                         // that setting, it may exist already and we can save a bit of time by not re-computing it.
-                        if(write_output_also_in_mgh_format) {
-                            if(file_exists(mgd_filename_curv) && file_exists(mgd_filename_mgh)) {
-                                std::cout << "     o Skipping only mean-dists computation for hemi " << hemi << ", curv and MGH format output files for that (but not for circle stats) exists.\n";
-                                circle_stats_do_meandists_this_hemi = false;
-                            }
-                        } else {
-                            if(file_exists(mgd_filename_curv)) {
-                                std::cout << "     o Skipping only mean-dists computation for hemi " << hemi << ", curv format output file for that (but not for circle stats) exists.\n";
-                                circle_stats_do_meandists_this_hemi = false;
-                            }
-                        }
-                    } else {
-                        if(write_output_also_in_mgh_format) {
-                            if(file_exists(rad_filename_curv) && file_exists(per_filename_curv) && file_exists(rad_filename_mgh) && file_exists(per_filename_mgh)) {
-                                std::cout << "     o Skipping computation for hemi " << hemi << ", curv and MGH format output files exist.\n";
-                                num_skipped_hemis_so_far++;
-                                continue;
-                            }
-                        } else {
-                            if(file_exists(rad_filename_curv) && file_exists(per_filename_curv)) {
-                                std::cout << "     o Skipping computation for hemi " << hemi << ", curv format output files exist.\n";
-                                num_skipped_hemis_so_far++;
-                                continue;
-                            }
+                        if(meandist_exists) {
+                            std::cout << "     o Skipping only mean-dists computation for hemi " << hemi << ", " << format_msg << " for that (but not for all circle stats).\n";
+                            circle_stats_do_meandists_this_hemi = false;
+                        } else if(scales_todo.empty()) {
+                            for(size_t k=0; k<circ_scales.size(); k++) { scales_todo.push_back(k); } // The mean dists are computed along with the circle stats.
                         }
+                    } else if(scales_todo.empty()) {
+                        std::cout << "     o Skipping computation for hemi " << hemi << ", " << format_msg << ".\n";
+                        num_skipped_hemis_so_far++;
+                        continue;
                     }
-                }
-
-                std::vector<int32_t> qv_cs; // The query vertices (empty vector means to use all of the mesh).
-                std::vector<std::vector<float>> circle_stats;
-                if  (use_cortex_label) {
-                    circle_stats = geodesic_circles(m_cortex, qv_cs, (float)circ_scale, circle_stats_do_meandists_this_hemi);
-                    circle_stats[0] = fs::Mesh::curv_data_for_orig_mesh(circle_stats[0], res_pair.first, surface.num_vertices(), fill_value);
-                    circle_stats[1] = fs::Mesh::curv_data_for_orig_mesh(circle_stats[1], res_pair.first, surface.num_vertices(), fill_value);
-                } else {
-                    circle_stats = geodesic_circles(m, qv_cs, (float)circ_scale, circle_stats_do_meandists_this_hemi);
-                }
-                const std::vector<float> radii = circle_stats[0];
-                const std::vector<float> perimeters = circle_stats[1];
-                fs::write_curv(rad_filename_curv, radii);
-                std::cout << "     o Geodesic circle radius results for hemi " << hemi << " written to file '" << rad_filename_curv << "' in curv format.\n";
-                if(write_output_also_in_mgh_format) {
-                    fs::write_mgh(fs::Mgh(radii), rad_filename_mgh);
-                    std::cout << "     o Geodesic circle radius results for hemi " << hemi << " written to file '" << rad_filename_mgh << "' in MGH format.\n";
-                }
-                fs::write_curv(per_filename_curv, perimeters);
-                std::cout << "     o Geodesic circle perimeter results for hemi " << hemi << " written to file '" << per_filename_curv << "' in curv format.\n";
-                if(write_output_also_in_mgh_format) {
-                    fs::write_mgh(fs::Mgh(radii), per_filename_mgh);
-                    std::cout << "     o Geodesic circle perimeter results for hemi " << hemi << " written to file '" << per_filename_mgh << "' in MGH format.\n";
-                }
-                if(circle_stats_do_meandists_this_hemi) {
-                    std::vector<float> mean_geodists_circ = circle_stats[2];
-                    if  (use_cortex_label) {
-                        mean_geodists_circ = fs::Mesh::curv_data_for_orig_mesh(mean_geodists_circ, res_pair.first, surface.num_vertices(), fill_value);
-                    }
-                    fs::write_curv(mgd_filename_curv, mean_geodists_circ);
-                    std::cout << "     o Geodesic mean distance results for hemi " << hemi << " written to file '" << mgd_filename_curv << "' in curv format.\n";
-                    if(write_output_also_in_mgh_format) {
-                        fs::write_mgh(fs::Mgh(mean_geodists_circ), mgd_filename_mgh);
-                        std::cout << "     o Geodesic mean distance results for hemi " << hemi << " written to file '" << mgd_filename_mgh << "' in MGH format.\n";
+                    if(scales_todo.size() < circ_scales.size()) {
+                        std::cout << "     o Skipping circle stats for " << (circ_scales.size() - scales_todo.size()) << " of " << circ_scales.size() << " circ_scale settings for hemi " << hemi << ", " << format_msg << ".\n";
                     }
                 }
             } else {
@@ -345,13 +372,91 @@ int main(int argc, char** argv) {
                         }
                     }
                 }
-                std::vector<float> mean_dists;
-                if  (use_cortex_label) {
-                    mean_dists = mean_geodist_p(m_cortex);
-                    mean_dists = fs::Mesh::curv_data_for_orig_mesh(mean_dists, res_pair.first, surface.num_vertices(), fill_value);
-                } else {
-                    mean_dists = mean_geodist(m);
+            }
+
+            // The geodesic computations work directly on the vertex and face arrays of the libfs Mesh, optionally after
+            // reordering its vertices. The results are mapped back to the original order. With a cortex label, the
+            // computations are restricted to the faces of the cortex by a mask, and the medial wall vertices get the fill value.
+            if(reorder_method == "rcm" && rcm_faces[hemi_idx] != surface.faces) {
+                rcm_orders[hemi_idx] = vertex_order(surface, reorder_method);
+                rcm_faces[hemi_idx] = surface.faces;
+            }
+            const VertexOrder order = (reorder_method == "rcm") ? rcm_orders[hemi_idx] : vertex_order(surface, reorder_method);
+            const fs::Mesh reordered = (reorder_method == "none") ? fs::Mesh() : reorder_mesh(surface, order);
+            const MeshView<> m = mesh_view((reorder_method == "none") ? surface : reordered);
+            if(use_cortex_label && reorder_method != "none") {
+                std::vector<int32_t> cortex_vertices(mask.vertices.size());
+                for(size_t i=0; i<cortex_vertices.size(); i++) {
+                    cortex_vertices[i] = order.old_to_new[mask.vertices[i]];
+                }
+                mask = mesh_mask(m, cortex_vertices);
+            }
+
+            // Without reordering and cortex label, the computation runs on the mesh as read from its file, so the graph,
+            // face areas and face adjacency come from the graph sidecar of the file if it matches the mesh.
+            GeodGraphSidecar sidecar;
+            const bool sidecar_hit = reorder_method == "none" && ! use_cortex_label && read_geod_graph_sidecar_for(surf_file, m, sidecar);
+            const size_t num_builds_before = graph_caches[hemi_idx].num_builds;
+            const GeodGraph& g = sidecar_hit ? sidecar.graph : geod_graph_cached(graph_caches[hemi_idx], use_cortex_label ? masked_view(m, mask) : m);
+            const MeshGeometry<> geom(use_cortex_label ? masked_view(m, mask) : m, sidecar_hit ? std::move(sidecar.face_areas) : std::vector<double>(), sidecar_hit ? std::move(sidecar.face_adj) : std::vector<int32_t>());  // Edge lengths and anything not from the sidecar are computed on first use.
+            if(sidecar_hit) {
+                std::cout << "     o Read the vertex adjacency, face areas and face adjacency from the graph sidecar '" << geod_graph_sidecar_filename(surf_file) << "'.\n";
+            } else if(graph_caches[hemi_idx].num_builds == num_builds_before) {
+                std::cout << "     o Reusing the vertex adjacency of the previous " << hemi << " mesh, which has the same faces.\n";
+            }
+
+            // Compute the geodesic mean distances and write result file.
+            if(do_circle_stats) {
+                // A single geodesic search per vertex serves the circle stats for all scales.
+                std::vector<float> scales;
+                for(size_t t=0; t<scales_todo.size(); t++) {
+                    scales.push_back((float)circ_scales[scales_todo[t]]);
+                }
+                // The neighborhood cache is keyed by the mesh as computed on, i.e., after reordering.
+                GeodNeighborhoods neighborhoods;
+                const bool use_cache = cache_dir != "none" && ! circle_stats_do_meandists_this_hemi;
+                if(use_cache) {
+                    bool hit;
+                    const float neigh_radius = geodesic_circles_neighborhood_radius(geom, scales, radius_method);
+                    neighborhoods = geod_neighborhoods_cached(cache_dir, geod_cache_key(m, use_cortex_label ? &mask : NULL), g, neigh_radius, &hit);
+                    std::cout << "     o " << (hit ? "Read" : "Computed and cached") << " the geodesic neighborhoods of radius " << neighborhoods.radius << " for radius " << neigh_radius << " with " << neighborhoods.index.size() << " neighbors in total.\n";
+                }
+                std::vector<int32_t> qv_cs; // The query vertices (empty vector means to use all of the mesh).
+                std::vector<std::vector<float>> circle_stats = geodesic_circles_scales(geom, g, qv_cs, scales, circle_stats_do_meandists_this_hemi, use_cortex_label ? &mask : NULL, radius_method, radius_tolerance, use_cache ? &neighborhoods : NULL);
+                for(size_t stat_idx=0; stat_idx<circle_stats.size(); stat_idx++) {
+                    if(use_cortex_label) {
+                        circle_stats[stat_idx] = mask_scatter(circle_stats[stat_idx], mask, fill_value);
+                    }
+                    circle_stats[stat_idx] = data_to_orig(circle_stats[stat_idx], order);
+                }
+                for(size_t t=0; t<scales_todo.size(); t++) {
+                    const size_t k = scales_todo[t];
+                    const std::vector<float>& radii = circle_stats[2 * t];
+                    const std::vector<float>& perimeters = circle_stats[2 * t + 1];
+                    fs::write_curv(rad_filenames_curv[k], radii);
+                    std::cout << "     o Geodesic circle radius results for hemi " << hemi << " written to file '" << rad_filenames_curv[k] << "' in curv format.\n";
+                    if(write_output_also_in_mgh_format) {
+                        fs::write_mgh(fs::Mgh(radii), rad_filenames_mgh[k]);
+                        std::cout << "     o Geodesic circle radius results for hemi " << hemi << " written to file '" << rad_filenames_mgh[k] << "' in MGH format.\n";
+                    }
+                    fs::write_curv(per_filenames_curv[k], perimeters);
+                    std::cout << "     o Geodesic circle perimeter results for hemi " << hemi << " written to file '" << per_filenames_curv[k] << "' in curv format.\n";
+                    if(write_output_also_in_mgh_format) {
+                        fs::write_mgh(fs::Mgh(perimeters), per_filenames_mgh[k]);
+                        std::cout << "     o Geodesic circle perimeter results for hemi " << hemi << " written to file '" << per_filenames_mgh[k] << "' in MGH format.\n";
+                    }
+                }
+                if(circle_stats_do_meandists_this_hemi) {
+                    const std::vector<float>& mean_geodists_circ = circle_stats[2 * scales_todo.size()];
+                    fs::write_curv(mgd_filename_curv, mean_geodists_circ);
+                    std::cout << "     o Geodesic mean distance results for hemi " << hemi << " written to file '" << mgd_filename_curv << "' in curv format.\n";
+                    if(write_output_also_in_mgh_format) {
+                        fs::write_mgh(fs::Mgh(mean_geodists_circ), mgd_filename_mgh);
+                        std::cout << "     o Geodesic mean distance results for hemi " << hemi << " written to file '" << mgd_filename_mgh << "' in MGH format.\n";
+                    }
                 }
+            } else {
+                const std::vector<float> mean_dists = data_to_orig(use_cortex_label ? mask_scatter(mean_geodist_p(g, &mask), mask, fill_value) : mean_geodist_p(g), order);
                 fs::write_curv(mgd_filename_curv, mean_dists);
                 std::cout << "     o Geodesic mean distance results for hemi " << hemi << " written to file '" << mgd_filename_curv << "' in curv format.\n";
                 if(write_output_also_in_mgh_format) {
@@ -376,6 +481,13 @@ int main(int argc, char** argv) {
 
     }
 
+    size_t num_graph_builds = 0, num_graph_reuses = 0;
+    for(size_t hemi_idx=0; hemi_idx<graph_caches.size(); hemi_idx++) {
+        num_graph_builds += graph_caches[hemi_idx].num_builds;
+        num_graph_reuses += graph_caches[hemi_idx].num_reuses;
+    }
+    std::cout << "Built the vertex adjacency for " << num_graph_builds << " meshes, reused it for " << num_graph_reuses << " meshes with the same faces.\n";
+
     // Report on failed subjects (e.g., failed due to missing files).
     if(failed_subjects.size() > 0) {
         // We need to make failed_subjects unique, as it may contain a subject twice if both of its hemispheres failed.
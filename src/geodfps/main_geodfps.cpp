@@ -0,0 +1,91 @@
+
+// The main for the geodfps program. The geodesic distances are computed directly on the mesh arrays, see geod_fps.h.
+// The program computes a geodesic farthest-point sampling of the mesh vertices: each new point is the vertex farthest
+// away (along the mesh) from all points picked before, so the points are spread evenly over the mesh.
+
+#include "libfs.h"
+#include "mesh_mmap_io.h"
+#include "mesh_view.h"
+#include "geod_engine.h"
+#include "geod_fps.h"
+#include "geod_graph_file.h"
+
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+
+
+int main(int argc, char** argv) {
+
+    std::cout << "=====[ geodfps ]=====.\n";
+
+    if(argc < 4 || argc > 6) {
+        std::cout << "== Compute a geodesic farthest-point sampling of the vertices of a mesh ==.\n";
+        std::cout << "Usage: " << argv[0] << " <mesh> <num_points> <output_file> [<first_vertex> [<min_radius>]]\n";
+        std::cout << "  <mesh>         : str, a mesh file in a format supported by libfs, e.g., FreeSurfer, PLY, OBJ, OFF.\n";
+        std::cout << "  <num_points>   : int >= 1, the number of points to pick.\n";
+        std::cout << "  <output_file>  : str, path of the output CSV file. Each line holds the step, the picked vertex, and the coverage radius after that step (the maximal geodesic distance of any vertex to its nearest picked point, -1 while some mesh parts are not reached yet).\n";
+        std::cout << "  <first_vertex> : int, the vertex to start with. Defaults to 0.\n";
+        std::cout << "  <min_radius>   : float, stop early once the coverage radius is at or below this value. Defaults to 0, i.e., always pick num_points points.\n";
+        std::cout << "NOTES:\n";
+        std::cout << " * Each point only updates the distances in the region around it which it covers, so picking thousands of points on a full resolution mesh is fast.\n";
+        std::cout << " * The mesh graph is read from the sidecar file '<mesh>.geodgraph' if it matches the mesh, see the geodgraph app.\n";
+        exit(1);
+    }
+
+    const std::string mesh_file = argv[1];
+    const std::string output_file = argv[3];
+    int64_t num_points;
+    int32_t first_vertex = 0;
+    float min_radius = 0.0;
+    std::istringstream iss_np(argv[2]);
+    if(!(iss_np >> num_points) || num_points < 1) {
+        throw std::runtime_error("Could not convert argument num_points to positive integer.\n");
+    }
+    if(argc >= 5) {
+        std::istringstream iss(argv[4]);
+        if(!(iss >> first_vertex)) {
+            throw std::runtime_error("Could not convert argument first_vertex to integer.\n");
+        }
+    }
+    if(argc >= 6) {
+        std::istringstream iss(argv[5]);
+        if(!(iss >> min_radius)) {
+            throw std::runtime_error("Could not convert argument min_radius to float.\n");
+        }
+    }
+
+    fs::Mesh surface;
+    read_mesh_mmap(&surface, mesh_file);
+    std::cout << "Read mesh '" << mesh_file << "' with " << surface.num_vertices() << " vertices and " << surface.num_faces() << " faces.\n";
+    bool sidecar_hit = false;
+    const GeodGraph g = geod_graph_from_sidecar(mesh_file, mesh_view(surface), &sidecar_hit);
+    if(sidecar_hit) {
+        std::cout << "Read the mesh graph from sidecar file '" << geod_graph_sidecar_filename(mesh_file) << "'.\n";
+    }
+
+    std::chrono::time_point<std::chrono::steady_clock> t_start = std::chrono::steady_clock::now();
+    const GeodFPS fps = geod_farthest_point_sampling(g, size_t(num_points), first_vertex, min_radius);
+    std::chrono::time_point<std::chrono::steady_clock> t_end = std::chrono::steady_clock::now();
+    const float final_radius = fps.radius.back();
+    std::cout << "Picked " << fps.points.size() << " points after " << std::chrono::duration<double, std::milli>(t_end - t_start).count() << " ms, final coverage radius " << (final_radius == GEOD_UNREACHED ? -1.0f : final_radius) << ".\n";
+
+    std::ofstream ofs(output_file);
+    if(! ofs.is_open()) {
+        throw std::runtime_error("Unable to open output file '" + output_file + "' for writing.\n");
+    }
+    ofs << "step,vertex,coverage_radius\n";
+    for(size_t i=0; i<fps.points.size(); i++) {
+        ofs << i << "," << fps.points[i] << "," << (fps.radius[i] == GEOD_UNREACHED ? -1.0f : fps.radius[i]) << "\n";
+    }
+    ofs.close();  // The stream would not be flushed on exit().
+    if(! ofs.good()) {
+        throw std::runtime_error("Failed to write output file '" + output_file + "'.\n");
+    }
+    std::cout << " * Sampled points written to CSV file '" << output_file << "'.\n";
+    exit(0);
+}
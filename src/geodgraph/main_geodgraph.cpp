@@ -0,0 +1,138 @@
+
+// The main for the geodgraph program, see geod_graph_file.h.
+// The program pre-generates the `.geodgraph` sidecar files of meshes, which hold their edge graph and face topology,
+// so the apps that load these meshes later skip building them.
+
+#include "libfs.h"
+#include "mesh_mmap_io.h"
+#include "mesh_view.h"
+#include "geod_graph_file.h"
+
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+
+/// @brief Write the graph sidecar of a mesh file, unless it already has a matching one and `keep_existing` is set.
+/// @return whether a sidecar was written.
+bool write_sidecar_for(const std::string& mesh_file, const bool keep_existing) {
+    fs::Mesh surface;
+    read_mesh_mmap(&surface, mesh_file);
+    const MeshView<> mv = mesh_view(surface);
+    const std::string sidecar_file = geod_graph_sidecar_filename(mesh_file);
+    GeodGraphSidecar sc;
+    if(keep_existing && read_geod_graph_sidecar(sidecar_file, mesh_content_hash(mv), sc)) {
+        std::cout << "   - Keeping sidecar file '" << sidecar_file << "', it matches the mesh.\n";
+        return false;
+    }
+    std::chrono::time_point<std::chrono::steady_clock> t_start = std::chrono::steady_clock::now();
+    sc = geod_graph_sidecar(mv);
+    write_geod_graph_sidecar(sidecar_file, sc);
+    std::chrono::time_point<std::chrono::steady_clock> t_end = std::chrono::steady_clock::now();
+    std::cout << "   - Wrote sidecar file '" << sidecar_file << "' for mesh with " << surface.num_vertices() << " vertices and " << surface.num_faces() << " faces after " << std::chrono::duration<double, std::milli>(t_end - t_start).count() << " ms.\n";
+    return true;
+}
+
+
+int main(int argc, char** argv) {
+
+    std::cout << "=====[ geodgraph ]=====.\n";
+
+    const std::string mode = argc >= 2 ? argv[1] : "";
+    if(!((mode == "subjects" && argc >= 5 && argc <= 7) || (mode == "mesh" && argc >= 3))) {
+        std::cout << "== Pre-generate the graph sidecar files of meshes, which let the apps skip building the mesh graph at startup ==.\n";
+        std::cout << "Usage: " << argv[0] << " subjects <subjects_file> <subjects_dir> <surfaces> [<hemi> [<keep_existing>]]\n";
+        std::cout << "       " << argv[0] << " mesh <mesh> [<mesh> ...]\n";
+        std::cout << "  <subjects_file> : str, path to a subjects file containing one subject identifier per line.\n";
+        std::cout << "  <subjects_dir>  : str, directory containing the FreeSurfer recon-all output for the subjects.\n";
+        std::cout << "  <surfaces>      : str, the surface files to handle, e.g., 'white', or a comma-separated list like 'white,pial,inflated'.\n";
+        std::cout << "  <hemi>          : str, one of 'lh', 'rh' or 'both'. Defaults to 'both'.\n";
+        std::cout << "  <keep_existing> : flag, whether to keep existing sidecar files which match their mesh. 'yes' or 'no'. Defaults to 'yes'. Sidecars which do not match their mesh are always replaced.\n";
+        std::cout << "  <mesh>          : str, a mesh file in a format supported by libfs, e.g., FreeSurfer, PLY, OBJ, OFF.\n";
+        std::cout << "NOTES:\n";
+        std::cout << " * The sidecar of mesh file '<mesh>' is '<mesh>.geodgraph'. It holds the vertex adjacency, edge lengths, face adjacency and face areas, and a hash of the mesh content.\n";
+        std::cout << " * The apps geodoracle, geodfps, geodvoronoi, geodserver and meshneigh_geod load the sidecar of a mesh if it matches the mesh, and build the graph otherwise. geodcircles loads the graph, face areas and face adjacency from it when run without cortex label and reordering.\n";
+        exit(1);
+    }
+
+    if(mode == "mesh") {
+        size_t num_written = 0;
+        for(int i=2; i<argc; i++) {
+            if(write_sidecar_for(argv[i], false)) {
+                num_written++;
+            }
+        }
+        std::cout << "Wrote " << num_written << " sidecar files.\n";
+        exit(0);
+    }
+
+    const std::string subjects_file = argv[2];
+    const std::string subjects_dir = argv[3];
+    std::vector<std::string> surface_names;
+    std::istringstream surface_list(argv[4]);
+    std::string surface_name;
+    while(std::getline(surface_list, surface_name, ',')) {
+        surface_names.push_back(surface_name);
+    }
+    if(surface_names.empty()) {
+        throw std::runtime_error("Argument surfaces must not be empty.\n");
+    }
+    std::vector<std::string> hemis = {"lh", "rh"};
+    if(argc >= 6) {
+        const std::string hemi = argv[5];
+        if(hemi == "lh" || hemi == "rh") {
+            hemis = {hemi};
+        } else if(hemi != "both") {
+            throw std::runtime_error("Invalid value for parameter 'hemi'. Must be 'lh', 'rh' or 'both'.\n");
+        }
+    }
+    bool keep_existing = true;
+    if(argc >= 7) {
+        const std::string keep = argv[6];
+        if(keep == "no") {
+            keep_existing = false;
+        } else if(keep != "yes") {
+            throw std::runtime_error("Invalid value for parameter 'keep_existing'. Must be 'yes' or 'no'.\n");
+        }
+    }
+
+    const std::vector<std::string> subjects = fs::read_subjectsfile(subjects_file);
+    std::cout << "Using " << subjects.size() << " subjects listed in subjects file '" << subjects_file << "', " << surface_names.size() << " surface(s) per hemi.\n";
+
+    size_t num_written = 0, num_kept = 0;
+    std::vector<std::string> failed_subjects;
+    for(size_t i=0; i<subjects.size(); i++) {
+        std::cout << " * Handling subject '" << subjects[i] << "', # " << (i+1) << " of " << subjects.size() << ".\n";
+        for(size_t h=0; h<hemis.size(); h++) {
+            for(size_t s=0; s<surface_names.size(); s++) {
+                const std::string surf_file = fs::util::fullpath({subjects_dir, subjects[i], "surf", hemis[h] + "." + surface_names[s]});
+                try {
+                    if(write_sidecar_for(surf_file, keep_existing)) {
+                        num_written++;
+                    } else {
+                        num_kept++;
+                    }
+                } catch(const std::exception& e) {
+                    std::cerr << "   - Failed to write the sidecar for surface '" << surf_file << "' of subject " << subjects[i] << ", skipping it. Details: " << e.what();
+                    failed_subjects.push_back(subjects[i]);
+                }
+            }
+        }
+    }
+
+    std::cout << "Wrote " << num_written << " sidecar files, kept " << num_kept << " matching ones.\n";
+    if(failed_subjects.size() > 0) {
+        failed_subjects.erase(std::unique(failed_subjects.begin(), failed_subjects.end()), failed_subjects.end());  // Failures of a subject are consecutive.
+        std::cout << "Writing sidecars failed for " << failed_subjects.size() << " of the " << subjects.size() << " subjects:\n";
+        for(size_t i=0; i<failed_subjects.size(); i++) {
+            std::cout << failed_subjects[i] << ' ';
+        }
+        std::cout << '\n';
+        exit(1);
+    }
+    exit(0);
+}
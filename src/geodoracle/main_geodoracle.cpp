@@ -0,0 +1,150 @@
+
+// The main for the geodoracle program. The geodesic distances are computed directly on the mesh arrays, see geod_oracle.h.
+// The program builds a landmark distance oracle for a mesh and stores it in a sidecar file, or answers vertex-pair
+// distance queries from such a file, which takes no search per pair unless exact distances are requested.
+
+#include "libfs.h"
+#include "mesh_mmap_io.h"
+#include "mesh_view.h"
+#include "geod_engine.h"
+#include "geod_oracle.h"
+#include "geod_graph_file.h"
+
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+
+
+/// @brief Read vertex pairs from a text file, two whitespace-separated vertex indices per pair (typically one pair per line).
+/// @throws std::runtime_error if the file cannot be read, contains something that is not a vertex index, or an odd number of indices.
+void read_vertex_pairs(const std::string& filename, std::vector<int32_t>& u, std::vector<int32_t>& v) {
+    std::ifstream ifs(filename);
+    if(! ifs.is_open()) {
+        throw std::runtime_error("Could not open vertex pair file '" + filename + "' for reading.\n");
+    }
+    std::vector<int32_t> indices;
+    std::string token;
+    while(ifs >> token) {
+        std::istringstream iss(token);
+        int32_t idx;
+        if(!(iss >> idx) || !iss.eof()) {
+            throw std::runtime_error("Could not convert entry '" + token + "' of vertex pair file '" + filename + "' to a vertex index.\n");
+        }
+        indices.push_back(idx);
+    }
+    if(indices.size() % 2 != 0) {
+        throw std::runtime_error("Vertex pair file '" + filename + "' contains an odd number of vertex indices.\n");
+    }
+    u.clear();
+    v.clear();
+    for(size_t i=0; i<indices.size(); i+=2) {
+        u.push_back(indices[i]);
+        v.push_back(indices[i+1]);
+    }
+}
+
+
+/// @brief Print a distance for the output, with -1 for `GEOD_UNREACHED`.
+float dist_out(const float d) {
+    return d == GEOD_UNREACHED ? -1.0f : d;
+}
+
+
+int main(int argc, char** argv) {
+
+    std::cout << "=====[ geodoracle ]=====.\n";
+
+    const std::string mode = argc >= 2 ? argv[1] : "";
+    if(!((mode == "build" && (argc == 5 || argc == 6)) || (mode == "query" && argc >= 6 && argc <= 8))) {
+        std::cout << "== Build a landmark geodesic distance oracle for a mesh, or answer vertex-pair distance queries with it ==.\n";
+        std::cout << "Usage: " << argv[0] << " build <mesh> <num_landmarks> <oracle_file> [<first_landmark>]\n";
+        std::cout << "       " << argv[0] << " query <mesh> <oracle_file> <pairs_file> <output_file> [<max_gap> [<method>]]\n";
+        std::cout << "  <mesh>           : str, a mesh file in a format supported by libfs, e.g., FreeSurfer, PLY, OBJ, OFF.\n";
+        std::cout << "  <num_landmarks>  : int, the number of landmarks, picked by geodesic farthest-point sampling. More landmarks give tighter bounds and larger files.\n";
+        std::cout << "  <oracle_file>    : str, the oracle sidecar file, e.g., '<mesh>.geodoracle'. It holds the quantized distances of all vertices to all landmarks, 2 bytes each.\n";
+        std::cout << "  <first_landmark> : int, the vertex to start the landmark sampling with. Defaults to 0.\n";
+        std::cout << "  <pairs_file>     : str, text file with two vertex indices per line, the pairs to query.\n";
+        std::cout << "  <output_file>    : str, output CSV file with the lower bound, upper bound and distance for each pair. Distances are -1 for pairs in different mesh components.\n";
+        std::cout << "  <max_gap>        : float, pairs whose bounds differ by more than this get their exact distance from a bounded search. Defaults to -1, i.e., never search, the distance is the mean of the bounds. Use 0 for exact distances.\n";
+        std::cout << "  <method>         : str, the search for the pairs to refine. 'grouped' for one bounded Dijkstra search per distinct first vertex, 'astar' for one A* search per pair, 'bidir' for one bidirectional A* search per pair. Defaults to 'grouped'. The point-to-point searches are faster unless many pairs share their first vertex.\n";
+        exit(1);
+    }
+
+    const std::string mesh_file = argv[2];
+    fs::Mesh surface;
+    read_mesh_mmap(&surface, mesh_file);
+    std::cout << "Read mesh '" << mesh_file << "' with " << surface.num_vertices() << " vertices and " << surface.num_faces() << " faces.\n";
+    bool sidecar_hit = false;
+    const GeodGraph g = geod_graph_from_sidecar(mesh_file, mesh_view(surface), &sidecar_hit);
+    if(sidecar_hit) {
+        std::cout << "Read the mesh graph from sidecar file '" << geod_graph_sidecar_filename(mesh_file) << "'.\n";
+    }
+
+    if(mode == "build") {
+        size_t num_landmarks;
+        int32_t first_landmark = 0;
+        const std::string oracle_file = argv[4];
+        std::istringstream iss_nl(argv[3]);
+        if(!(iss_nl >> num_landmarks) || num_landmarks < 1) {
+            throw std::runtime_error("Could not convert argument num_landmarks to positive integer.\n");
+        }
+        if(argc >= 6) {
+            std::istringstream iss(argv[5]);
+            if(!(iss >> first_landmark)) {
+                throw std::runtime_error("Could not convert argument first_landmark to integer.\n");
+            }
+        }
+        std::chrono::time_point<std::chrono::steady_clock> t_start = std::chrono::steady_clock::now();
+        const GeodOracle oracle = geod_oracle_build(g, num_landmarks, first_landmark);
+        std::chrono::time_point<std::chrono::steady_clock> t_end = std::chrono::steady_clock::now();
+        std::cout << "Built oracle with " << oracle.num_landmarks() << " landmarks after " << std::chrono::duration<double, std::milli>(t_end - t_start).count() << " ms, distance resolution " << oracle.scale << ".\n";
+        write_geod_oracle(oracle_file, oracle);
+        std::cout << " * Oracle written to file '" << oracle_file << "'.\n";
+        exit(0);
+    }
+
+    const std::string oracle_file = argv[3];
+    const std::string pairs_file = argv[4];
+    const std::string output_file = argv[5];
+    float max_gap = -1.0;
+    if(argc >= 7) {
+        std::istringstream iss(argv[6]);
+        if(!(iss >> max_gap)) {
+            throw std::runtime_error("Could not convert argument max_gap to float.\n");
+        }
+    }
+    const std::string method = argc >= 8 ? argv[7] : "grouped";
+    if(!(method == "grouped" || method == "astar" || method == "bidir")) {
+        throw std::runtime_error("Invalid value for parameter 'method'. Must be 'grouped', 'astar' or 'bidir'.\n");
+    }
+    const GeodOracle oracle = read_geod_oracle(oracle_file);
+    std::cout << "Read oracle file '" << oracle_file << "' with " << oracle.num_landmarks() << " landmarks.\n";
+    std::vector<int32_t> u, v;
+    read_vertex_pairs(pairs_file, u, v);
+    std::cout << "Read " << u.size() << " vertex pairs from file '" << pairs_file << "'.\n";
+
+    std::chrono::time_point<std::chrono::steady_clock> t_start = std::chrono::steady_clock::now();
+    const std::vector<GeodBounds> bounds = geod_oracle_bounds(oracle, u, v);
+    const std::vector<float> dist = (method == "grouped") ? geod_oracle_distances(oracle, g, u, v, max_gap) : geod_oracle_distances(oracle, g, mesh_view(surface), u, v, max_gap, method);
+    std::chrono::time_point<std::chrono::steady_clock> t_end = std::chrono::steady_clock::now();
+    std::cout << "Answered " << u.size() << " queries after " << std::chrono::duration<double, std::milli>(t_end - t_start).count() << " ms.\n";
+
+    std::ofstream ofs(output_file);
+    if(! ofs.is_open()) {
+        throw std::runtime_error("Unable to open output file '" + output_file + "' for writing.\n");
+    }
+    ofs << "source,target,lower,upper,dist\n";
+    for(size_t i=0; i<u.size(); i++) {
+        ofs << u[i] << "," << v[i] << "," << dist_out(bounds[i].lower) << "," << dist_out(bounds[i].upper) << "," << dist_out(dist[i]) << "\n";
+    }
+    ofs.close();  // The stream would not be flushed on exit().
+    if(! ofs.good()) {
+        throw std::runtime_error("Failed to write output file '" + output_file + "'.\n");
+    }
+    std::cout << " * Query results written to CSV file '" << output_file << "'.\n";
+    exit(0);
+}
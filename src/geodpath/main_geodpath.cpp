@@ -5,8 +5,14 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <utility>
 
 #include "libfs.h"
+#include "mesh_mmap_io.h"
+#include "mesh_view.h"
+#include "geod_engine.h"
+#include "geod_astar.h"
+#include "geod_tree.h"
 #include <geodesic_algorithm_dijkstra.h>
 #include <geodesic_algorithm_subdivision.h>
 #include <geodesic_algorithm_exact.h>
@@ -46,6 +52,104 @@ namespace geodesic {
 }
 
 
+/// @brief A graph-based third_party/geodesic algorithm, dijkstra or subdivision, which exports the shortest-path tree of its propagation, see `GeodTree`.
+/// @details The tree is read from the predecessors of the graph nodes, so each node is visited once. The parent of a
+/// vertex is the nearest mesh vertex before it on its path. For the dijkstra algorithm, that is the previous vertex on
+/// the edge path. The subdivision algorithm also has nodes on the edges, and the parent is the vertex the path bends
+/// around, or the source, with straight segments across the faces in between.
+template<class Algorithm>
+class GraphAlgorithmTree : public Algorithm {
+  public:
+    template<typename... Args>
+    explicit GraphAlgorithmTree(Args&&... args) : Algorithm(std::forward<Args>(args)...) {}
+
+    /// @brief Get the shortest-path tree of the last propagation.
+    GeodTree tree() {
+        typedef typename Algorithm::node_pointer node_pointer;
+        const size_t nv = this->m_mesh->vertices().size();
+        const size_t num_nodes = this->m_nodes.size();
+        // The nearest mesh vertex before each node on its path, or -1 for the sources, computed once per node: a node
+        // whose predecessor is no mesh vertex shares the value of its predecessor. The first nv nodes are the vertices.
+        std::vector<int32_t> vertex_before(num_nodes, -2);
+        std::vector<size_t> chain;
+        for (size_t n = 0; n < num_nodes; ++n) {
+            chain.clear();
+            size_t cur = n;
+            while (vertex_before[cur] == -2) {
+                const node_pointer prev = this->m_nodes[cur].previous();
+                if (prev == nullptr) {
+                    const geodesic::SurfacePoint& source = this->m_sources[this->m_nodes[cur].source_index()];
+                    const int32_t source_vertex = node_vertex(source);
+                    vertex_before[cur] = source_vertex != node_vertex(this->m_nodes[cur].surface_point()) ? source_vertex : -1;
+                } else if (node_vertex(prev->surface_point()) >= 0) {
+                    vertex_before[cur] = node_vertex(prev->surface_point());
+                } else {
+                    chain.push_back(cur);
+                    cur = size_t(prev - this->m_nodes.data());
+                }
+            }
+            for (size_t i = 0; i < chain.size(); ++i) {
+                vertex_before[chain[i]] = vertex_before[cur];
+            }
+        }
+        GeodTree tree;
+        tree.dist.assign(nv, GEOD_UNREACHED);
+        tree.parent.assign(nv, -1);
+        for (size_t v = 0; v < nv; ++v) {
+            const double dist = this->m_nodes[v].distance_from_source();
+            if (dist < geodesic::GEODESIC_INF && !(dist > this->m_propagation_distance_stopped)) {
+                tree.dist[v] = float(dist);
+                tree.parent[v] = vertex_before[v];
+            }
+        }
+        return tree;
+    }
+
+  private:
+    /// @brief Get the mesh vertex of a surface point, or -1 if it lies on an edge or face.
+    static int32_t node_vertex(const geodesic::SurfacePoint& point) {
+        return point.type() == geodesic::VERTEX ? int32_t(point.base_element()->id()) : -1;
+    }
+};
+
+
+/// @brief Get the shortest-path tree of the exact algorithm after its propagation, see `GeodTree`.
+/// @details The exact algorithm has no graph of predecessors, so the path of each vertex is traced back. The parent of
+/// a vertex is the vertex its path bends around, or the source, with a straight segment across the faces in between.
+/// @param num_untraced set to the number of vertices whose path the algorithm could not trace back, which happens on degenerate meshes. They are marked as not reached.
+/// @param num_pruned set to the number of vertices whose path runs through an untraced vertex. They are marked as not reached as well, see `geod_tree_prune`.
+GeodTree geodesic_tree(geodesic::GeodesicAlgorithmExact& algorithm, geodesic::Mesh& mesh, size_t& num_untraced, size_t& num_pruned) {
+    const size_t nv = mesh.vertices().size();
+    GeodTree tree;
+    tree.dist.assign(nv, GEOD_UNREACHED);
+    tree.parent.assign(nv, -1);
+    std::vector<geodesic::SurfacePoint> path;
+    num_untraced = 0;
+    for (size_t v = 0; v < nv; ++v) {
+        const geodesic::SurfacePoint point(&mesh.vertices()[v]);
+        double dist;
+        algorithm.best_source(point, dist);
+        if (!(dist < geodesic::GEODESIC_INF)) {
+            continue;
+        }
+        algorithm.trace_back(point, path);  // From the vertex to the source.
+        if (path.empty()) {
+            num_untraced++;
+            continue;
+        }
+        tree.dist[v] = float(dist);
+        for (size_t i = 1; i < path.size(); ++i) {
+            if (path[i].type() == geodesic::VERTEX && path[i].base_element()->id() != v) {
+                tree.parent[v] = int32_t(path[i].base_element()->id());
+                break;
+            }
+        }
+    }
+    num_pruned = geod_tree_prune(tree);
+    return tree;
+}
+
+
 int main(int argc, char** argv) {
     std::vector<double> points;
     std::vector<unsigned> faces;    
@@ -57,14 +161,20 @@ int main(int argc, char** argv) {
     size_t subdivision_level = 3; // Number of additional vertices per every edge in subdivision algorithm.
 
     
-    if(argc < 2 || argc > 6) {
+    std::string tree_file;
+
+    if(argc < 2 || argc > 7) {
         std::cout << "===" << argv[0] << " -- Compute geodesic path and distance on a mesh. ===\n";
-        std::cout << "Usage: " << argv[0] << " <mesh> [<source> [<target> [<algo> [<subd>]]]]\n";
+        std::cout << "Usage: " << argv[0] << " <mesh> [<source> [<target> [<algo> [<subd> [<tree_file>]]]]]\n";
         std::cout << "  <mesh>   : str, path to the input mesh file.\n";
         std::cout << "  <source> : int >= 0, the source vertex (0-based index). Defaults to 0.\n";
         std::cout << "  <target> : int >= 0, the target vertex (0-based index). Defaults to 100.\n";
-        std::cout << "  <algo>   : int >= 0, alogorithm to run. 0=all, 1=exact, 2=dijksta, 3=subdivision dijksta. Defaults to 2.\n";
-        std::cout << "  <subd>   : int >= 1, number of edge subdivisions for algo #3. Defaults to 3.\n";
+        std::cout << "  <algo>   : int >= 0, alogorithm to run. 0=all, 1=exact, 2=dijksta, 3=subdivision dijksta, 4=graph A*, 5=graph bidirectional A*. Defaults to 2.\n";
+        std::cout << "  <subd>   : int >= 1, number of edge subdivisions for algo #3. Defaults to 3. Ignored by the other algorithms.\n";
+        std::cout << "  <tree_file> : str, file to export the shortest-path tree from the source to all vertices to, i.e., the parent vertex and the distance of each vertex. Requires a single algorithm. Optional.\n";
+        std::cout << "NOTES:\n";
+        std::cout << " * Algorithms 1 to 3 propagate from the source until the target is covered, or over the whole mesh if a tree is exported. Algorithms 4 and 5 search along the mesh edges like algorithm 2, and give the same path length, but head for the target using the straight-line distance to it, so they settle a small fraction of the vertices.\n";
+        std::cout << " * The tree file holds an int32 magic number, the int32 number of vertices nv, nv int32 parents and nv float distances, in big endian byte order. Sources and unreached vertices have parent -1, unreached vertices distance -1. For algorithm 1 on degenerate meshes, vertices whose path cannot be traced back, and the vertices whose paths run through them, are marked as not reached. The path to any vertex follows the parents back to the source. For algorithms 1 and 3, the parent is the vertex the path bends around, with a straight segment across the faces in between. For algorithms 4 and 5, the tree is the one of algorithm 2.\n";
         exit(1);
     }
     if(argc >= 2) {
@@ -87,28 +197,32 @@ int main(int argc, char** argv) {
         if(!(iss >> algo)) {
             throw std::runtime_error("Could not convert argument 'algo' to integer.\n");
         }
-        if(algo >= 4) {
+        if(algo >= 6) {
             throw std::runtime_error("Argument 'algo' out of range.\n");
         }
         if(argc >= 6) {
+            std::istringstream iss( argv[5] );
+            if(!(iss >> subdivision_level)) {
+                throw std::runtime_error("Could not convert argument 'subdivision_level' to integer.\n");
+            }
+            if(subdivision_level < 1) {
+                throw std::runtime_error("Argument 'subdivision_level' out of range.\n");
+            }
             if(algo == 3 || algo == 0) {
-                std::istringstream iss( argv[5] );
-                if(!(iss >> subdivision_level)) {
-                    throw std::runtime_error("Could not convert argument 'subdivision_level' to integer.\n");
-                }
-                if(subdivision_level < 1) {
-                    throw std::runtime_error("Argument 'subdivision_level' out of range.\n");
-                }
                 std::cout << "Using " << std::to_string(subdivision_level) << " subdivisions for algorithm 'subdivision dijksta'.\n";
-            } else {
-                throw std::runtime_error("Argument 'subd' invalid unless algo is 0 or 3.");
             }
         }        
     }
+    if(argc >= 7) {
+        tree_file = argv[6];
+        if(algo == 0) {
+            throw std::runtime_error("Argument 'tree_file' requires a single algorithm, not algo 0.\n");
+        }
+    }
 
     std::cout << "Running algorithm " + std::to_string(algo) + " on mesh file '" + mesh_file + "'...\n";    
     fs::Mesh surface;
-    fs::read_mesh(&surface, mesh_file);
+    read_mesh_mmap(&surface, mesh_file);
 
     if(source >= surface.num_vertices()) {
         throw std::runtime_error("Source vertex index " + std::to_string(source) + " invalid for mesh with " + std::to_string(surface.num_vertices()) + " vertices (and 0-based indices).\n");
@@ -121,8 +235,8 @@ int main(int argc, char** argv) {
     mesh.initialize_mesh_data(surface.vertices, surface.faces, true);
 
     geodesic::GeodesicAlgorithmExact exact_algorithm(&mesh); // exact algorithm
-    geodesic::GeodesicAlgorithmDijkstra dijkstra_algorithm(&mesh); // simplest approximate algorithm: path only allowed on the edges of the mesh
-    geodesic::GeodesicAlgorithmSubdivision subdivision_algorithm(&mesh, subdivision_level); // with subdivision_level=0 this algorithm becomes Dijkstra, with subdivision_level->infinity it becomes exact
+    GraphAlgorithmTree<geodesic::GeodesicAlgorithmDijkstra> dijkstra_algorithm(&mesh); // simplest approximate algorithm: path only allowed on the edges of the mesh
+    GraphAlgorithmTree<geodesic::GeodesicAlgorithmSubdivision> subdivision_algorithm(&mesh, subdivision_level); // with subdivision_level=0 this algorithm becomes Dijkstra, with subdivision_level->infinity it becomes exact
 
     std::vector<geodesic::GeodesicAlgorithmBase*> all_algorithms;
     all_algorithms.push_back(&exact_algorithm);
@@ -139,15 +253,55 @@ int main(int argc, char** argv) {
         if((index + 1) == algo || algo == 0) {
             geodesic::GeodesicAlgorithmBase* algorithm = all_algorithms[index];        
 
-            algorithm->propagate(sources); // cover the whole mesh
+            algorithm->propagate(sources, geodesic::GEODESIC_INF, tree_file.empty() ? &targets : NULL); // stop once the target is covered, unless the tree covers the whole mesh
 
             std::vector<geodesic::SurfacePoint> path;
             for (size_t i = 0; i < targets.size(); ++i) {
                 algorithm->trace_back(targets[i], path);
+                if(path.empty()) {
+                    std::cout << "Results of algorithm " << algorithm->name() << ": the path from vertex " << std::to_string(source) << " to " << std::to_string(target) << " could not be traced back.\n";
+                    continue;
+                }
                 std::cout << "Results of algorithm " << algorithm->name() << " for path from vertex " << std::to_string(source) << " to " << std::to_string(target)
                  << " (" << std::to_string(path.size() - 1) << " segments, length " << path_length(path) <<"):" << std::endl;
                 std::cout << path_rep(path) << std::endl;
             }
+            if(! tree_file.empty()) {
+                size_t num_untraced = 0, num_pruned = 0;
+                const GeodTree tree = (index == 0) ? geodesic_tree(exact_algorithm, mesh, num_untraced, num_pruned) : (index == 1 ? dijkstra_algorithm.tree() : subdivision_algorithm.tree());
+                write_geod_tree(tree_file, tree);
+                std::cout << "Wrote shortest-path tree of algorithm " << algorithm->name() << " to file '" << tree_file << "'.\n";
+                if(num_untraced > 0) {
+                    std::cout << "The paths of " << num_untraced << " vertices could not be traced back, and the paths of " << num_pruned << " more vertices run through them. They are all marked as not reached.\n";
+                }
+            }
+        }
+    }
+
+    if(algo == 0 || algo >= 4) {
+        const MeshView<> mv = mesh_view(surface);
+        const GeodGraph g = geod_graph(mv);
+        const std::vector<std::string> methods = {"astar", "bidir"};
+        const std::vector<std::string> method_names = {"graph A*", "graph bidirectional A*"};
+        for (size_t index = 0; index < methods.size(); ++index) {
+            if((index + 4) == algo || algo == 0) {
+                const GeodPath graph_path = geod_shortest_path(g, mv, int32_t(source), int32_t(target), methods[index]);
+                if(graph_path.vertices.empty()) {
+                    std::cout << "Results of algorithm " << method_names[index] << ": vertex " << std::to_string(target) << " cannot be reached from vertex " << std::to_string(source) << ".\n";
+                } else {
+                    std::vector<geodesic::SurfacePoint> path;  // From the target to the source, like the ones of trace_back.
+                    for (size_t i = graph_path.vertices.size(); i-- > 0; ) {
+                        path.push_back(geodesic::SurfacePoint(&mesh.vertices()[graph_path.vertices[i]]));
+                    }
+                    std::cout << "Results of algorithm " << method_names[index] << " for path from vertex " << std::to_string(source) << " to " << std::to_string(target)
+                     << " (" << std::to_string(path.size() - 1) << " segments, length " << path_length(path) << ", settled " << graph_path.num_settled << " of " << surface.num_vertices() << " vertices):" << std::endl;
+                    std::cout << path_rep(path) << std::endl;
+                }
+                if(! tree_file.empty()) {
+                    write_geod_tree(tree_file, geod_tree(g, std::vector<int32_t>(1, int32_t(source)), -1.0f));
+                    std::cout << "Wrote shortest-path tree of algorithm dijkstra on the mesh graph to file '" << tree_file << "'.\n";
+                }
+            }
         }
     }
     return 0;
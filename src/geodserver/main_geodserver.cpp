@@ -0,0 +1,113 @@
+
+// The main for the geodserver program. The geodesic distances are computed directly on the mesh arrays, see geod_server.h.
+// The program loads meshes once and answers geodesic queries from other programs over a Unix domain socket, so the
+// startup cost of loading the mesh and building its graph is not paid per query. It can also query the latency
+// statistics of a running server and shut it down.
+
+#include "libfs.h"
+#include "mesh_mmap_io.h"
+#include "geod_server.h"
+#include "geod_graph_file.h"
+
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <csignal>
+
+
+#ifndef _WIN32
+
+/// @brief Send a request without arguments to a running server, and exit with an error if it fails.
+/// @return the response payload after the status.
+std::vector<char> simple_request(const std::string& socket_path, const uint32_t op) {
+    const int fd = geod_client_connect(socket_path);
+    GeodMessageWriter req;
+    req.put<uint32_t>(op);
+    req.put<uint32_t>(0);
+    const std::vector<char> resp = geod_client_call(fd, req.buf);
+    close(fd);
+    GeodMessageReader in(resp.data(), resp.size());
+    if(in.get<int32_t>() != 0) {
+        throw std::runtime_error("Server at socket '" + socket_path + "' reported an error.\n");
+    }
+    return std::vector<char>(resp.begin() + sizeof(int32_t), resp.end());
+}
+
+#endif
+
+
+int main(int argc, char** argv) {
+
+    std::cout << "=====[ geodserver ]=====.\n";
+
+    const std::string mode = argc >= 2 ? argv[1] : "";
+    if(!((mode == "serve" && argc >= 5) || ((mode == "stats" || mode == "shutdown") && argc == 3))) {
+        std::cout << "== Serve geodesic queries on meshes over a Unix domain socket ==.\n";
+        std::cout << "Usage: " << argv[0] << " serve <socket_path> <num_threads> <mesh> [<mesh> ...]\n";
+        std::cout << "       " << argv[0] << " stats <socket_path>\n";
+        std::cout << "       " << argv[0] << " shutdown <socket_path>\n";
+        std::cout << "  <socket_path> : str, path of the Unix domain socket file. An existing file is replaced when serving.\n";
+        std::cout << "  <num_threads> : int, the number of worker threads, i.e., the number of requests answered concurrently. Clients may stay connected between requests without holding a worker thread.\n";
+        std::cout << "  <mesh>        : str, a mesh file in a format supported by libfs, e.g., FreeSurfer, PLY, OBJ, OFF. Clients select meshes by their 0-based index in this list.\n";
+        std::cout << "NOTES:\n";
+        std::cout << " * Supported requests are distance fields, geodesic neighborhoods, k-rings and shortest paths. See src/common/geod_server.h for the binary protocol.\n";
+        std::cout << " * The 'stats' mode prints the latency histogram of each request type, the 'shutdown' mode stops the server.\n";
+        std::cout << " * The mesh graph is read from the sidecar file '<mesh>.geodgraph' if it matches the mesh, see the geodgraph app.\n";
+        exit(1);
+    }
+
+#ifdef _WIN32
+    throw std::runtime_error("The geodserver program needs Unix domain sockets, which are not supported on this platform.\n");
+#else
+    const std::string socket_path = argv[2];
+    if(mode == "stats") {
+        const char* op_names[GEOD_OP_COUNT] = { "info", "dist", "neigh", "kring", "path", "stats", "shutdown" };
+        const std::vector<char> resp = simple_request(socket_path, GEOD_OP_STATS);
+        GeodMessageReader in(resp.data(), resp.size());
+        const uint32_t num_ops = in.get<uint32_t>();
+        const uint32_t num_buckets = in.get<uint32_t>();
+        std::cout << "Request latency histograms, bucket b counts requests served in [2^b, 2^(b+1)) microseconds:\n";
+        for(uint32_t op=0; op<num_ops; op++) {
+            const std::vector<uint64_t> counts = in.get_vector<uint64_t>(num_buckets);
+            uint64_t total = 0;
+            std::stringstream buckets;
+            for(uint32_t b=0; b<num_buckets; b++) {
+                total += counts[b];
+                if(counts[b] > 0) {
+                    buckets << " " << (uint64_t(1) << b) << "us:" << counts[b];
+                }
+            }
+            std::cout << " * " << (op < GEOD_OP_COUNT ? op_names[op] : std::to_string(op)) << ": " << total << " requests." << buckets.str() << "\n";
+        }
+        exit(0);
+    }
+    if(mode == "shutdown") {
+        simple_request(socket_path, GEOD_OP_SHUTDOWN);
+        std::cout << "Server at socket '" << socket_path << "' is shutting down.\n";
+        exit(0);
+    }
+
+    size_t num_threads;
+    std::istringstream iss(argv[3]);
+    if(!(iss >> num_threads) || num_threads < 1) {
+        throw std::runtime_error("Could not convert argument num_threads to positive integer.\n");
+    }
+    GeodServer server;
+    for(int i=4; i<argc; i++) {
+        const std::string mesh_file = argv[i];
+        fs::Mesh surface;
+        read_mesh_mmap(&surface, mesh_file);
+        bool sidecar_hit = false;
+        server.add_mesh(mesh_file, surface, geod_graph_from_sidecar(mesh_file, mesh_view(surface), &sidecar_hit));
+        std::cout << "Mesh " << (i - 4) << ": '" << mesh_file << "' with " << surface.num_vertices() << " vertices and " << surface.num_faces() << " faces" << (sidecar_hit ? ", graph read from its sidecar file" : "") << ".\n";
+    }
+    signal(SIGPIPE, SIG_IGN);  // Clients closing their connection early must not kill the server.
+    std::cout << "Serving " << server.meshes.size() << " meshes on socket '" << socket_path << "' with " << num_threads << " worker threads.\n";
+    geod_server_run(server, socket_path, num_threads);
+    std::cout << "Server stopped.\n";
+    exit(0);
+#endif
+}
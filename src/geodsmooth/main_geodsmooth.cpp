@@ -0,0 +1,174 @@
+
+// The main for the geodsmooth program. This main file uses the VCGLIB algorithm.
+// The program smoothes per-vertex data (e.g., cortical thickness) with Gaussian kernels based on geodesic distance
+// along the mesh. The kernels are precomputed sparse matrices that get saved to disk and re-used on later runs, so the
+// expensive geodesic computations only need to be done once per mesh.
+
+#include "libfs.h"
+#include "typedef_vcg.h"
+#include "fs_mesh_to_vcg.h"
+#include "mesh_geodesic.h"
+#include "mesh_smooth.h"
+#include "sparse_matrix.h"
+#include "io.h"
+#include "mesh_mmap_io.h"
+#include "mesh_view.h"
+#include "geod_cache.h"
+
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+
+
+/// @brief Parse a comma-separated list of positive FWHM values, like '5,10,15'.
+/// @throws std::runtime_error if an entry cannot be parsed or is not positive.
+std::vector<float> parse_fwhm_list(const std::string& arg) {
+    std::vector<float> fwhms;
+    std::stringstream ss(arg);
+    std::string item;
+    while(std::getline(ss, item, ',')) {
+        std::istringstream iss(item);
+        float fwhm;
+        if(!(iss >> fwhm) || fwhm <= 0.0) {
+            throw std::runtime_error("Could not convert entry '" + item + "' of argument fwhm_list to a positive float.\n");
+        }
+        fwhms.push_back(fwhm);
+    }
+    if(fwhms.empty()) {
+        throw std::runtime_error("Argument fwhm_list must contain at least one value.\n");
+    }
+    return fwhms;
+}
+
+
+/// @brief Get a short string representation of a FWHM value for use in file names, e.g., '5' for 5.0 or '2.5' for 2.5.
+std::string fwhm_tag(const float fwhm) {
+    std::ostringstream oss;
+    oss << fwhm;
+    return oss.str();
+}
+
+
+/// @brief Get the fingerprint stored with a kernel: a hash of the mesh content and the FWHM, which determines the kernel radius.
+uint64_t kernel_fingerprint(const MeshView<>& mv, const float fwhm) {
+    return geod_hash_bytes(&fwhm, sizeof(float), mesh_content_hash(mv));
+}
+
+
+/// @brief Get the output file name for smoothed data: the FWHM is inserted before the '.mgh' extension for MGH files, and appended for curv files.
+std::string smoothed_data_filename(const std::string& data_file, const float fwhm) {
+    const std::string tag = ".fwhm" + fwhm_tag(fwhm);
+    if(fs::util::ends_with(data_file, ".mgh")) {
+        return data_file.substr(0, data_file.size() - 4) + tag + ".mgh";
+    }
+    return data_file + tag;
+}
+
+
+int main(int argc, char** argv) {
+
+    std::cout << "=====[ geodsmooth ]=====.\n";
+
+    if(argc < 5) {
+        std::cout << "== Smooth per-vertex data with geodesic Gaussian kernels ==.\n";
+        std::cout << "Usage: " << argv[0] << " <mesh> <fwhm_list> <kernel_prefix> <data_file> [<data_file> ...]\n";
+        std::cout << "  <mesh>          : str, a mesh file in a format supported by libfs, e.g., FreeSurfer, PLY, OBJ, OFF.\n";
+        std::cout << "  <fwhm_list>     : str, comma-separated list of full widths at half maximum of the Gaussian kernels, in mesh units (typically mm). E.g., '5,10,15'.\n";
+        std::cout << "  <kernel_prefix> : str, path prefix for the kernel files. The kernel for each FWHM is saved to '<kernel_prefix>.geodkernel_fwhm<fwhm>.gkern' and re-used if it exists and was computed for the same mesh and FWHM.\n";
+        std::cout << "  <data_file>     : str, per-vertex data file(s) for the mesh, in FreeSurfer curv or MGH format. The smoothed data is written next to the input, with '.fwhm<fwhm>' added to the file name.\n";
+        std::cout << "NOTES:\n";
+        std::cout << " * Computing the kernels is expensive for large FWHM values and meshes, but it is only done once: all data files for the mesh (e.g., all subjects registered to fsaverage) can share them.\n";
+        std::cout << " * Vertices more than 3 sigma away from a vertex are ignored for its kernel.\n";
+        exit(1);
+    }
+
+    const std::string mesh_file = argv[1];
+    const std::vector<float> fwhms = parse_fwhm_list(argv[2]);
+    const std::string kernel_prefix = argv[3];
+    std::vector<std::string> data_files;
+    for(int i=4; i<argc; i++) {
+        data_files.push_back(argv[i]);
+    }
+
+    fs::Mesh surface;
+    read_mesh_mmap(&surface, mesh_file);
+    const int32_t nv = int32_t(surface.num_vertices());
+    std::cout << "Read mesh '" << mesh_file << "' with " << nv << " vertices and " << surface.num_faces() << " faces.\n";
+
+    // Load existing kernels, and determine which ones still need to be computed.
+    const MeshView<> mv = mesh_view(surface);
+    std::vector<SparseMatrix> kernels(fwhms.size());
+    std::vector<std::string> kernel_files(fwhms.size());
+    std::vector<float> missing_fwhms;
+    std::vector<size_t> missing_idx;
+    for(size_t i=0; i<fwhms.size(); i++) {
+        kernel_files[i] = kernel_prefix + ".geodkernel_fwhm" + fwhm_tag(fwhms[i]) + ".gkern";
+        bool loaded = false;
+        if(file_exists(kernel_files[i])) {
+            try {
+                read_sparse_matrix(&kernels[i], kernel_files[i]);
+            } catch(const std::exception& e) {
+                std::cout << " * Existing kernel file '" << kernel_files[i] << "' could not be read, recomputing: " << e.what();
+                kernels[i] = SparseMatrix();
+            }
+            if(kernels[i].num_rows == nv && kernels[i].num_cols == nv && kernels[i].fingerprint == kernel_fingerprint(mv, fwhms[i])) {
+                std::cout << " * Re-using existing kernel file '" << kernel_files[i] << "' for FWHM " << fwhms[i] << ".\n";
+                loaded = true;
+            } else if(kernels[i].num_rows > 0) {
+                std::cout << " * Existing kernel file '" << kernel_files[i] << "' was computed for a different mesh or FWHM, recomputing.\n";
+            }
+        }
+        if(! loaded) {
+            missing_fwhms.push_back(fwhms[i]);
+            missing_idx.push_back(i);
+        }
+    }
+
+    if(! missing_fwhms.empty()) {
+        std::cout << "Computing " << missing_fwhms.size() << " geodesic smoothing kernel(s)...\n";
+        std::chrono::time_point<std::chrono::steady_clock> t_start = std::chrono::steady_clock::now();
+        std::vector<SparseMatrix> computed = geod_gaussian_kernels(mv, missing_fwhms);
+        for(size_t j=0; j<computed.size(); j++) {
+            const size_t i = missing_idx[j];
+            kernels[i] = computed[j];
+            kernels[i].fingerprint = kernel_fingerprint(mv, fwhms[i]);
+            write_sparse_matrix(kernel_files[i], kernels[i]);
+            std::cout << " * Kernel for FWHM " << fwhms[i] << " has " << kernels[i].nnz() << " entries, written to '" << kernel_files[i] << "'.\n";
+        }
+        std::chrono::time_point<std::chrono::steady_clock> t_end = std::chrono::steady_clock::now();
+        std::cout << "Kernel computation done after " << secduration(std::chrono::duration<double>(t_end - t_start).count()) << ".\n";
+    }
+
+    // Read all data files, then smooth them in one pass over each kernel.
+    std::vector<std::vector<float>> data(data_files.size());
+    for(size_t i=0; i<data_files.size(); i++) {
+        if(fs::util::ends_with(data_files[i], ".mgh")) {
+            fs::Mgh mgh;
+            fs::read_mgh(&mgh, data_files[i]);
+            data[i] = mgh.data.data_mri_float;
+        } else {
+            data[i] = read_curv_data_mmap(data_files[i]);
+        }
+        if(data[i].size() != size_t(nv)) {
+            throw std::runtime_error("Data file '" + data_files[i] + "' contains " + std::to_string(data[i].size()) + " float values, but the mesh has " + std::to_string(nv) + " vertices.\n");
+        }
+    }
+
+    for(size_t k=0; k<kernels.size(); k++) {
+        std::vector<std::vector<float>> smoothed = spmv_batch(kernels[k], data);
+        for(size_t i=0; i<data_files.size(); i++) {
+            const std::string out_file = smoothed_data_filename(data_files[i], fwhms[k]);
+            if(fs::util::ends_with(out_file, ".mgh")) {
+                fs::write_mgh(fs::Mgh(smoothed[i]), out_file);
+            } else {
+                fs::write_curv(out_file, smoothed[i]);
+            }
+            std::cout << " * Smoothed data with FWHM " << fwhms[k] << " written to '" << out_file << "'.\n";
+        }
+    }
+    std::cout << "Done.\n";
+    exit(0);
+}
@@ -0,0 +1,173 @@
+
+// The main for the geodvoronoi program. The geodesic distances are computed directly on the mesh arrays, see geod_voronoi.h.
+// The program computes a geodesic Voronoi parcellation of a mesh: each vertex is assigned to its nearest seed (along the
+// mesh), with a single multi-source search from all seeds. The seeds can be given as a vertex list, a label or an annot.
+
+#include "libfs.h"
+#include "mesh_mmap_io.h"
+#include "mesh_view.h"
+#include "geod_engine.h"
+#include "geod_voronoi.h"
+#include "geod_graph_file.h"
+#include "annot_export.h"
+
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <unordered_map>
+
+
+/// @brief Read seed vertex indices from a text file, separated by whitespace (typically one per line).
+/// @throws std::runtime_error if the file cannot be read or contains something that is not a vertex index.
+std::vector<int32_t> read_seed_list(const std::string& filename) {
+    std::ifstream ifs(filename);
+    if(! ifs.is_open()) {
+        throw std::runtime_error("Could not open seed file '" + filename + "' for reading.\n");
+    }
+    std::vector<int32_t> seeds;
+    std::string token;
+    while(ifs >> token) {
+        std::istringstream iss(token);
+        int32_t seed;
+        if(!(iss >> seed) || !iss.eof()) {
+            throw std::runtime_error("Could not convert entry '" + token + "' of seed file '" + filename + "' to a vertex index.\n");
+        }
+        seeds.push_back(seed);
+    }
+    return seeds;
+}
+
+
+int main(int argc, char** argv) {
+
+    std::cout << "=====[ geodvoronoi ]=====.\n";
+
+    if(argc < 4 || argc > 6) {
+        std::cout << "== Compute a geodesic Voronoi parcellation of a mesh from seed vertices ==.\n";
+        std::cout << "Usage: " << argv[0] << " <mesh> <seeds> <output_prefix> [<max_dist> [<num_partitions>]]\n";
+        std::cout << "  <mesh>           : str, a mesh file in a format supported by libfs, e.g., FreeSurfer, PLY, OBJ, OFF.\n";
+        std::cout << "  <seeds>          : str, the seeds. Either a FreeSurfer label file (extension '.label', each label vertex is a seed), a FreeSurfer annot file (extension '.annot', the vertices of each region except 'unknown' are the seeds of that region), or a text file with one seed vertex index per line.\n";
+        std::cout << "  <output_prefix>  : str, path prefix for the output files: '<output_prefix>.annot' assigns each vertex to the region of its nearest seed, '<output_prefix>.geoddist' (curv format) holds the geodesic distance to it.\n";
+        std::cout << "  <max_dist>       : float, vertices farther away from all seeds are not assigned ('unknown' region, distance -1). Defaults to -1, i.e., no limit.\n";
+        std::cout << "  <num_partitions> : int, split the seeds into this many parts which are searched in parallel. Only pays off with a max_dist. Defaults to 1.\n";
+        std::cout << "NOTES:\n";
+        std::cout << " * All seeds are handled in a single multi-source search, so the computation time hardly depends on the number of seeds.\n";
+        std::cout << " * For label and vertex list input, each seed becomes a region named 'seed_<vertex>'. For annot input, the regions and colors of the annot are kept.\n";
+        std::cout << " * The mesh graph is read from the sidecar file '<mesh>.geodgraph' if it matches the mesh, see the geodgraph app.\n";
+        exit(1);
+    }
+
+    const std::string mesh_file = argv[1];
+    const std::string seeds_file = argv[2];
+    const std::string output_prefix = argv[3];
+    float max_dist = -1.0;
+    size_t num_partitions = 1;
+    if(argc >= 5) {
+        std::istringstream iss(argv[4]);
+        if(!(iss >> max_dist)) {
+            throw std::runtime_error("Could not convert argument max_dist to float.\n");
+        }
+    }
+    if(argc >= 6) {
+        std::istringstream iss(argv[5]);
+        if(!(iss >> num_partitions) || num_partitions < 1) {
+            throw std::runtime_error("Could not convert argument num_partitions to positive integer.\n");
+        }
+    }
+
+    fs::Mesh surface;
+    read_mesh_mmap(&surface, mesh_file);
+    const size_t nv = surface.num_vertices();
+    std::cout << "Read mesh '" << mesh_file << "' with " << nv << " vertices and " << surface.num_faces() << " faces.\n";
+    bool sidecar_hit = false;
+    const GeodGraph g = geod_graph_from_sidecar(mesh_file, mesh_view(surface), &sidecar_hit);
+    if(sidecar_hit) {
+        std::cout << "Read the mesh graph from sidecar file '" << geod_graph_sidecar_filename(mesh_file) << "'.\n";
+    }
+
+    // Collect the seeds, and for each seed the index of its region in the output colortable.
+    std::vector<int32_t> seeds;
+    std::vector<int32_t> seed_region;
+    fs::Annot out_annot;
+    int32_t unknown_label = 0;
+    const bool annot_input = fs::util::ends_with(seeds_file, ".annot");
+    if(annot_input) {
+        fs::Annot in_annot;
+        fs::read_annot(&in_annot, seeds_file);
+        if(in_annot.num_vertices() != nv) {
+            throw std::runtime_error("Annot file '" + seeds_file + "' has " + std::to_string(in_annot.num_vertices()) + " vertices, but the mesh has " + std::to_string(nv) + ".\n");
+        }
+        const int32_t unknown_idx = in_annot.colortable.get_region_idx(std::string("unknown"));
+        if(unknown_idx >= 0) {
+            unknown_label = in_annot.colortable.label[unknown_idx];
+        }
+        std::unordered_map<int32_t, int32_t> region_by_label;
+        for(size_t i=0; i<in_annot.colortable.num_entries(); i++) {
+            region_by_label[in_annot.colortable.label[i]] = int32_t(i);
+        }
+        for(size_t v=0; v<nv; v++) {
+            std::unordered_map<int32_t, int32_t>::const_iterator it = region_by_label.find(in_annot.vertex_labels[v]);
+            if(it != region_by_label.end() && it->second != unknown_idx) {
+                seeds.push_back(int32_t(v));
+                seed_region.push_back(it->second);
+            }
+        }
+        out_annot.colortable = in_annot.colortable;
+        out_annot.vertex_indices = in_annot.vertex_indices;
+    } else {
+        if(fs::util::ends_with(seeds_file, ".label")) {
+            fs::Label label;
+            fs::read_label(&label, seeds_file);
+            seeds = label.vertex;
+        } else {
+            seeds = read_seed_list(seeds_file);
+        }
+        for(size_t i=0; i<seeds.size(); i++) {
+            seed_region.push_back(int32_t(i));
+        }
+    }
+    if(seeds.empty()) {
+        throw std::runtime_error("Found no seed vertices in seed file '" + seeds_file + "'.\n");
+    }
+    std::cout << "Using " << seeds.size() << " seed vertices from file '" << seeds_file << "'" << (max_dist > 0.0 ? ", max_dist " + std::to_string(max_dist) : std::string("")) << ", " << num_partitions << " partition(s).\n";
+
+    std::chrono::time_point<std::chrono::steady_clock> t_start = std::chrono::steady_clock::now();
+    const GeodVoronoi vor = geod_voronoi(g, seeds, max_dist, num_partitions);
+    std::chrono::time_point<std::chrono::steady_clock> t_end = std::chrono::steady_clock::now();
+
+    size_t num_unassigned = 0;
+    std::vector<float> dist(nv);
+    std::vector<int32_t> vertex_region(nv);
+    for(size_t v=0; v<nv; v++) {
+        const bool reached = vor.seed[v] >= 0;
+        num_unassigned += reached ? 0 : 1;
+        dist[v] = reached ? vor.dist[v] : -1.0f;
+        vertex_region[v] = reached ? seed_region[vor.seed[v]] : -1;
+    }
+    std::cout << "Parcellation done after " << std::chrono::duration<double, std::milli>(t_end - t_start).count() << " ms, " << num_unassigned << " of " << nv << " vertices were not reached by any seed.\n";
+
+    if(annot_input) {
+        out_annot.vertex_labels.resize(nv);
+        for(size_t v=0; v<nv; v++) {
+            out_annot.vertex_labels[v] = vertex_region[v] >= 0 ? out_annot.colortable.label[vertex_region[v]] : unknown_label;
+        }
+    } else {
+        std::vector<std::string> region_names(seeds.size());
+        for(size_t i=0; i<seeds.size(); i++) {
+            region_names[i] = "seed_" + std::to_string(seeds[i]);
+        }
+        out_annot = annot_from_regions(vertex_region, region_names);
+    }
+
+    const std::string annot_file = output_prefix + ".annot";
+    const std::string dist_file = output_prefix + ".geoddist";
+    write_annot(annot_file, out_annot);
+    std::cout << " * Parcellation written to annot file '" << annot_file << "'.\n";
+    fs::write_curv(dist_file, dist);
+    std::cout << " * Distances to the nearest seed written to curv file '" << dist_file << "'.\n";
+    exit(0);
+}
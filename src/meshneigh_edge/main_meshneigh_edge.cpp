@@ -1,5 +1,5 @@
 
-// The main for the meshneigh_edge program. This main file uses the VCGLIB algorithm.
+// The main for the meshneigh_edge program. The neighborhoods are computed directly on the mesh arrays.
 // The program computes neighborhoods of vertices on meshes and saves them to files.
 // The neighborhood is defined by edge distance in the mesh (aka graph distance).
 
@@ -17,6 +17,9 @@
 #include "mesh_neighborhood.h"
 #include "write_data.h"
 #include "write_data_npy.h"
+#include "mesh_mmap_io.h"
+#include "mesh_view.h"
+#include "mesh_reorder.h"
 
 
 #include <string>
@@ -43,7 +46,8 @@
 /// @param input_ctx_file str, path to cortex label file for mesh to identify cortex versus medial wall vertices and remove the latter.
 /// @param neigh_write_size int, number of vertices to export per neighborhood, even if more are part of it. used to force CSV rows to a fixed length over several meshes for machine learning input.
 /// @param write_numpy bool, whether to export in Numpy format (flattened).
-void mesh_neigh_edge(const std::string& input_mesh_file, const size_t k = 1, const std::string& output_dist_file="edge_distances", const bool include_self=true, const bool write_json=false, const bool write_csv=false, const bool write_vvbin=true, const bool with_neigh=false, const std::string& input_pvd_file="", const std::string& input_ctx_file="", const size_t neigh_write_size = 0, const bool write_numpy=true) {
+/// @param reorder str, the vertex reordering method used during the computation, see `vertex_order`. The neighborhoods are mapped back to the original vertex order and are identical to the ones computed without reordering.
+void mesh_neigh_edge(const std::string& input_mesh_file, const size_t k = 1, const std::string& output_dist_file="edge_distances", const bool include_self=true, const bool write_json=false, const bool write_csv=false, const bool write_vvbin=true, const bool with_neigh=false, const std::string& input_pvd_file="", const std::string& input_ctx_file="", const size_t neigh_write_size = 0, const bool write_numpy=true, const std::string& reorder="none") {
 
     debug_print(CPP_GEOD_DEBUG_LVL_VERBOSE, "Reading mesh '" + input_mesh_file + "' to compute graph " + std::to_string(k) + "-ring edge neighborhoods...");
     if(include_self) {
@@ -53,20 +57,26 @@ void mesh_neigh_edge(const std::string& input_mesh_file, const size_t k = 1, con
     }
 
     fs::Mesh surface;
-    fs::read_surf(&surface, input_mesh_file);
+    read_mesh_mmap(&surface, input_mesh_file);
 
-    // Create a VCGLIB mesh from the libfs Mesh.
-    debug_print(CPP_GEOD_DEBUG_LVL_VERBOSE, "Creating VCG mesh from brain surface with " + std::to_string(surface.num_vertices()) + " vertices and " + std::to_string(surface.num_faces()) + " faces.");
-    MyMesh m;
-    vcgmesh_from_fs_surface(&m, surface);
+    // The neighborhood computations work directly on the vertex and face arrays of the libfs Mesh.
+    debug_print(CPP_GEOD_DEBUG_LVL_VERBOSE, "Loaded brain surface with " + std::to_string(surface.num_vertices()) + " vertices and " + std::to_string(surface.num_faces()) + " faces.");
+    const MeshView<> mv = mesh_view(surface);
+    const int nv = int(surface.num_vertices());
 
     // Compute adjacency list representation of mesh
     debug_print(CPP_GEOD_DEBUG_LVL_INFO, "Computing neighborhoods...");
-    std::vector<int> query_vertices(surface.num_vertices());
-    for(int i=0; i<m.vn; i++) {
-        query_vertices[i] = i;
+    std::vector<int> query_vertices; // Empty means all vertices.
+    std::vector<std::vector<int32_t>> neigh;
+    if(reorder == "none") {
+        neigh = mesh_adj(surface, query_vertices, k, include_self);
+    } else {
+        // The permuted adjacency keeps the neighbor order of the original one, so the k-ring order is the same after mapping back.
+        debug_print(CPP_GEOD_DEBUG_LVL_INFO, "Reordering mesh vertices with method '" + reorder + "' for the computation.");
+        const VertexOrder order = vertex_order(surface, reorder);
+        const MeshCSR csr = mesh_csr_permute(mesh_csr(surface), order);
+        neigh = index_lists_to_orig(mesh_kring(csr, query_vertices, k, include_self), order);
     }
-    std::vector<std::vector<int32_t>> neigh = mesh_adj(m, query_vertices, k, include_self);
 
     std::vector<Neighborhood> nh;
 
@@ -74,17 +84,17 @@ void mesh_neigh_edge(const std::string& input_mesh_file, const size_t k = 1, con
 
     const std::string output_neigh_file = output_dist_file + "_neigh";
     if(with_neigh) {
-        std::vector<bool> is_cortex = std::vector<bool>(m.vn, true); // filter nothing by default.
+        std::vector<bool> is_cortex = std::vector<bool>(nv, true); // filter nothing by default.
         if(! input_ctx_file.empty()) {
             debug_print(CPP_GEOD_DEBUG_LVL_INFO, "Reading cortex label file '" + input_ctx_file + "' and filtering Neighborhoods to keep only those in cortex.");
             fs::Label lab;
             fs::read_label(&lab, input_ctx_file);
-            is_cortex = lab.vert_in_label(m.vn);
-            assert((int)is_cortex.size() == m.vn);
-            debug_print(CPP_GEOD_DEBUG_LVL_INFO, "Read cortex label file '" + input_ctx_file + "'. Keeping " + std::to_string(lab.num_entries()) + " of " + std::to_string(m.vn) + " vertices. Filtered out " + std::to_string(m.vn - lab.num_entries()) + " vertices.");
+            is_cortex = lab.vert_in_label(nv);
+            assert((int)is_cortex.size() == nv);
+            debug_print(CPP_GEOD_DEBUG_LVL_INFO, "Read cortex label file '" + input_ctx_file + "'. Keeping " + std::to_string(lab.num_entries()) + " of " + std::to_string(nv) + " vertices. Filtered out " + std::to_string(nv - lab.num_entries()) + " vertices.");
         }
 
-        nh = neighborhoods_from_edge_neighbors(neigh, m, is_cortex);
+        nh = neighborhoods_from_edge_neighbors(neigh, mv, is_cortex);
     }
 
 
@@ -161,8 +171,9 @@ int main(int argc, char** argv) {
     std::string input_pvd_file = "";
     std::string input_ctx_file = "";
     size_t neigh_write_size = 0;
+    std::string reorder = "none";
 
-    if(argc < 2 || argc > 12) {
+    if(argc < 2 || argc > 13) {
         std::cout << "===" << argv[0] << " -- Compute edge neighborhoods for mesh vertices. ===\n";
         std::cout << "Usage: " << argv[0] << " <input_mesh> [<k> [<output_file] [<include_self> [<json>] [<csv>] [<vv>]]]]>\n";
         std::cout << "  <input_mesh>       : str, a mesh file in a format supported by libfs, e.g., FreeSurfer, PLY, OBJ, OFF.\n";
@@ -176,6 +187,7 @@ int main(int argc, char** argv) {
         std::cout << "  <input_pvd>        : str, a per-vertex value file in a format supported by libfs, e.g., FreeSurfer curv or MGH format. Optional, only used for CSV/vv export.\n";
         std::cout << "  <input_ctx>        : str, a file containing label for the cortex versus non-cortex, e.g., typically 'surf/?h.cortex.label'. Optional, used to filter exported vertices.\n";
         std::cout << "  <neigh_write_size> : int, number of verts to export in CSV per neighborhood. Set to 0 for auto-determin from data (of a single mesh).\n";
+        std::cout << "  <reorder>          : str, vertex reordering for better cache locality during the computation, one of 'none', 'rcm' or 'morton'. The output is in the original vertex order. Default: 'none'.\n";
         exit(1);
     }
     input_mesh_file = argv[1];
@@ -264,13 +276,19 @@ int main(int argc, char** argv) {
             throw std::runtime_error("Could not convert argument neigh_write_size to positive integer or zero.\n");
         }
     }
+    if(argc >= 13) {
+        reorder = argv[12];
+        if(reorder != "none" && reorder != "rcm" && reorder != "morton") {
+            throw std::runtime_error("Argument 'reorder' must be 'none', 'rcm' or 'morton'.\n");
+        }
+    }
 
 
 
-    std::cout << std::string(APPTAG) << "base settings: k=" << k << "" << ", include_self=" << include_self << ", neigh_write_size=" << neigh_write_size << "\n";
+    std::cout << std::string(APPTAG) << "base settings: k=" << k << "" << ", include_self=" << include_self << ", neigh_write_size=" << neigh_write_size << ", reorder=" << reorder << "\n";
     std::cout << std::string(APPTAG) << "input settings: input_mesh_file=" << input_mesh_file << ", input_pvd_file=" << input_pvd_file << ", input_ctx_file=" << input_ctx_file << "\n";
     std::cout << std::string(APPTAG) << "output settings: json=" << json << ", csv=" << csv << ", vvbin=" << vvbin << ", with_neigh=" << with_neigh << ", output_dist_file=" << output_dist_file << "\n";
 
-    mesh_neigh_edge(input_mesh_file, k, output_dist_file, include_self, json, csv, vvbin, with_neigh, input_pvd_file, input_ctx_file, neigh_write_size);
+    mesh_neigh_edge(input_mesh_file, k, output_dist_file, include_self, json, csv, vvbin, with_neigh, input_pvd_file, input_ctx_file, neigh_write_size, true, reorder);
     exit(0);
 }
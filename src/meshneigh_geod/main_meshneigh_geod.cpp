@@ -1,5 +1,5 @@
 
-// The main for the meshneigh_geod program. This main file uses the VCGLIB algorithm.
+// The main for the meshneigh_geod program. The geodesic distances are computed directly on the mesh arrays, see geod_engine.h.
 // The program computes neighborhoods of vertices on meshes and saves them to files.
 // The neighborhood is defined by geodesic distance along the mesh.
 
@@ -11,6 +11,11 @@
 #include "mesh_geodesic.h"
 #include "mesh_neighborhood.h"
 #include "write_data.h"
+#include "mesh_mmap_io.h"
+#include "mesh_view.h"
+#include "mesh_reorder.h"
+#include "geod_cache.h"
+#include "geod_graph_file.h"
 
 
 #include <string>
@@ -19,11 +24,17 @@
 #include <algorithm>
 #include <iterator>
 #include <chrono>
+#include <fstream>
+#include <sstream>
+#include <utility>
 
 
 /// Compute geodesic neighborhood up to max dist for the mesh.
 /// @param max_dist float, the distance defining the geodesic neighborhood circle.
-void mesh_neigh_geod(const std::string& input_mesh_file, const float max_dist = 5.0, const std::string& output_dist_file="geod_distances", bool include_self = true, const bool write_json=false, const bool write_csv=false, const bool write_vvbin=true, const bool with_neigh=false) {
+/// @param reorder the vertex reordering method used during the computation, see `vertex_order`. The neighborhoods are mapped back to the original vertex order.
+/// @param cache optional graph cache, meshes with the same faces as the previous one reuse its vertex adjacency. See `geod_graph_cached`.
+/// @param cache_dir the geodesic neighborhood cache directory, or 'none'. See `geod_cache.h`.
+void mesh_neigh_geod(const std::string& input_mesh_file, const float max_dist = 5.0, const std::string& output_dist_file="geod_distances", bool include_self = true, const bool write_json=false, const bool write_csv=false, const bool write_vvbin=true, const bool with_neigh=false, const std::string& reorder="none", GeodGraphCache* cache=NULL, const std::string& cache_dir="none") {
 
     std::cout << "Reading mesh '" + input_mesh_file + "' to compute geodesic distance up to " + std::to_string(max_dist) + " along mesh...\n";
     if(include_self) {
@@ -33,25 +44,64 @@ void mesh_neigh_geod(const std::string& input_mesh_file, const float max_dist =
     }
 
     fs::Mesh surface;
-    fs::read_surf(&surface, input_mesh_file);
+    read_mesh_mmap(&surface, input_mesh_file);
 
-    // Create a VCGLIB mesh from the libfs Mesh.
-    std::cout << "Creating VCG mesh from brain surface with " << surface.num_vertices() << " vertices and " << surface.num_faces() << " faces.\n";
-    MyMesh m;
-    vcgmesh_from_fs_surface(&m, surface);
+    // The geodesic computations work directly on the vertex and face arrays of the libfs Mesh.
+    const MeshView<> mv = mesh_view(surface);
 
-    // Compute adjacency list representation of mesh
-    std::cout << "Computing neighborhoods...\n";
-    std::vector<int> query_vertices(surface.num_vertices());
-    for(int i=0; i<m.vn; i++) {
-        query_vertices[i] = i;
+    // The cache serves any radius up to the cached one. The neighborhoods are cached with the vertex itself, and in the
+    // original vertex order, so the reordering does not matter for it.
+    const bool use_cache = cache_dir != "none";
+    GeodCacheKey key;
+    GeodNeighborhoods cached;
+    bool hit = false;
+    if(use_cache) {
+        key = geod_cache_key(mv);
+        hit = read_geod_neighborhoods(geod_cache_filename(cache_dir, key), key, max_dist, cached) && cached.num_vertices() == mv.num_vertices();
+    }
+
+    std::vector<std::vector<GeodNeighbor>> neigh;
+    if(hit) {
+        std::cout << "Filtering cached neighborhoods of radius " << cached.radius << " from file '" << geod_cache_filename(cache_dir, key) << "'.\n";
+        neigh = geod_neighborhoods_filter(cached, max_dist, include_self);
+    } else {
+        std::cout << "Computing neighborhoods for mesh with " << surface.num_vertices() << " vertices and " << surface.num_faces() << " faces...\n";
+        GeodGraphCache local_cache;
+        if(! cache) {
+            cache = &local_cache;
+        }
+        const size_t num_builds_before = cache->num_builds;
+        const bool compute_with_self = include_self || use_cache;
+        GeodGraphSidecar sc;
+        const bool from_sidecar = reorder == "none" && read_geod_graph_sidecar(geod_graph_sidecar_filename(input_mesh_file), mesh_content_hash(mv), sc) && sc.graph.num_vertices() == mv.num_vertices();
+        if(from_sidecar) {
+            std::cout << " * Read the mesh graph from sidecar file '" << geod_graph_sidecar_filename(input_mesh_file) << "'.\n";
+            neigh = geod_neighborhood(sc.graph, max_dist, compute_with_self);
+        } else if(reorder == "none") {
+            neigh = geod_neighborhood(geod_graph_cached(*cache, mv), max_dist, compute_with_self);
+        } else {
+            std::cout << " * Reordering mesh vertices with method '" << reorder << "' for the computation.\n";
+            const VertexOrder order = vertex_order(surface, reorder);
+            const fs::Mesh reordered = reorder_mesh(surface, order);
+            neigh = geod_neighborhood_to_orig(geod_neighborhood(geod_graph_cached(*cache, mesh_view(reordered)), max_dist, compute_with_self), order);
+        }
+        if(! from_sidecar && cache->num_builds == num_builds_before) {
+            std::cout << " * Reused the vertex adjacency of the previous mesh, which has the same faces.\n";
+        }
+        if(use_cache) {
+            const GeodNeighborhoods nh = geod_neighborhoods_from_lists(neigh, max_dist);
+            write_geod_neighborhoods(geod_cache_filename(cache_dir, key), key, nh);
+            std::cout << "Neighborhoods written to cache file '" << geod_cache_filename(cache_dir, key) << "'.\n";
+            if(! include_self) {
+                neigh = geod_neighborhoods_filter(nh, max_dist, include_self);
+            }
+        }
     }
-    std::vector<std::vector<GeodNeighbor>> neigh = geod_neighborhood(m, max_dist, include_self);
 
     std::vector<Neighborhood> nh;
     const std::string output_neigh_file = output_dist_file + "_neigh";
     if (with_neigh) {
-        nh = neighborhoods_from_geod_neighbors(neigh, m);
+        nh = neighborhoods_from_geod_neighbors(neigh, mv);
     }
 
     // Write it to a JSON file if requested.
@@ -101,6 +151,30 @@ void mesh_neigh_geod(const std::string& input_mesh_file, const float max_dist =
     }
 }
 
+/// @brief Read the mesh and output file pairs of a batch list file, one whitespace-separated pair per line.
+/// @throws std::runtime_error if the file cannot be read, or a line does not hold exactly two entries.
+std::vector<std::pair<std::string, std::string>> read_batch_list(const std::string& list_file) {
+    std::ifstream ifs(list_file);
+    if(! ifs.is_open()) {
+        throw std::runtime_error("Could not open batch list file '" + list_file + "' for reading.\n");
+    }
+    std::vector<std::pair<std::string, std::string>> jobs;
+    std::string line;
+    while(std::getline(ifs, line)) {
+        std::istringstream iss(line);
+        std::string mesh_file, output_file, extra;
+        if(!(iss >> mesh_file)) {
+            continue;  // Empty line.
+        }
+        if(!(iss >> output_file) || (iss >> extra)) {
+            throw std::runtime_error("Line '" + line + "' of batch list file '" + list_file + "' must hold a mesh file and an output file.\n");
+        }
+        jobs.push_back(std::make_pair(mesh_file, output_file));
+    }
+    return jobs;
+}
+
+
 int main(int argc, char** argv) {
     std::string input_mesh_file;
     std::string output_dist_file = "geod_distances";
@@ -110,11 +184,13 @@ int main(int argc, char** argv) {
     bool csv = false;
     bool vvbin = true;
     bool with_neigh = false;
+    std::string reorder = "none";
+    std::string cache_dir = "none";
 
-    if(argc < 2 || argc > 9) {
+    if(argc < 2 || argc > 11) {
         std::cout << "===" << argv[0] << " -- Compute geodesic neighborhoods for mesh vertices. ===\n";
         std::cout << "Usage: " << argv[0] << " <input_mesh> [<max_dist> [<output_file> [<include_self> [json]]]]>\n";
-        std::cout << "   <input_mesh>    : str, a mesh file in a format supported by libfs, e.g., FreeSurfer, PLY, OBJ, OFF.\n";
+        std::cout << "   <input_mesh>    : str, a mesh file in a format supported by libfs, e.g., FreeSurfer, PLY, OBJ, OFF. Or '@' followed by a batch list file with a mesh file and its output file per line, in which case <output_file> is ignored.\n";
         std::cout << "   <max_dist>      : float, the maximal distance to travel along the mesh when defining neighbors. Defaults to 5.0.\n";
         std::cout << "   <output_file>   : str, file name for the output file (suffix gets added, will be overwritten if existing). Default: geod_distances.\n";
         std::cout << "   <include_self>  : bool, whether to include vertex itself in neighborhood, must be 'true' or 'false'. Default: 'true'.\n";
@@ -122,6 +198,11 @@ int main(int argc, char** argv) {
         std::cout << "   <csv>           : bool, whether to write CSV text output, must be 'true' or 'false'. Default: 'false'.\n";
         std::cout << "   <vv>            : bool, whether to write custom binary VV output, must be 'true' or 'false'. Default: 'true'.\n";
         std::cout << "   <with_neigh>    : bool, whether to also write unified Neighborhood format files, must be 'true' or 'false'. Default: 'false'.\n";
+        std::cout << "   <reorder>       : str, vertex reordering for better cache locality during the computation, one of 'none', 'rcm' or 'morton'. The output is in the original vertex order. Default: 'none'.\n";
+        std::cout << "   <cache_dir>     : str, existing directory for the geodesic neighborhood cache, or 'none'. Neighborhoods are filtered from a cache file for the same mesh content with a radius of at least <max_dist> if one exists, and computed and written to the cache otherwise. Default: 'none'.\n";
+        std::cout << "NOTES:\n";
+        std::cout << " * In batch mode, meshes with the same faces as the previous one, like the white and pial surfaces of a subject or subjects resampled to fsaverage, reuse its vertex adjacency and only recompute the edge lengths.\n";
+        std::cout << " * Without reordering, the mesh graph is read from the sidecar file '<input_mesh>.geodgraph' if it matches the mesh, see the geodgraph app.\n";
         exit(1);
     }
     input_mesh_file = argv[1];
@@ -187,13 +268,32 @@ int main(int argc, char** argv) {
             throw std::runtime_error("Argument 'with_neigh' must be 'true' or 'false'.\n");
         }
     }
+    if(argc >= 10) {
+        reorder = argv[9];
+        if(reorder != "none" && reorder != "rcm" && reorder != "morton") {
+            throw std::runtime_error("Argument 'reorder' must be 'none', 'rcm' or 'morton'.\n");
+        }
+    }
+    if(argc >= 11) {
+        cache_dir = argv[10];
+    }
 
     std::cout << "meshneigh_geod: base settings: input_mesh_file=" << input_mesh_file << ", max_dist=" << max_dist << ", output_dist_file=" << output_dist_file << ", include_self=" << include_self << "\n";
-    std::cout << "meshneigh_geod: output settings: json=" << json << ", csv=" << csv << ", vvbin=" << vvbin << "with_neigh=" << with_neigh << "\n";
+    std::cout << "meshneigh_geod: output settings: json=" << json << ", csv=" << csv << ", vvbin=" << vvbin << "with_neigh=" << with_neigh << ", reorder=" << reorder << ", cache_dir=" << cache_dir << "\n";
 
     if((!json) && (!csv) && (!vvbin)) {
         throw std::runtime_error("At least one of the arguments json, csv, and vv must be 'true'.\n");
     }
-    mesh_neigh_geod(input_mesh_file, max_dist, output_dist_file, include_self, json, csv, vvbin);
+    if(input_mesh_file.size() > 1 && input_mesh_file[0] == '@') {
+        const std::vector<std::pair<std::string, std::string>> jobs = read_batch_list(input_mesh_file.substr(1));
+        std::cout << "meshneigh_geod: batch mode with " << jobs.size() << " meshes.\n";
+        GeodGraphCache cache;
+        for(size_t i=0; i<jobs.size(); i++) {
+            mesh_neigh_geod(jobs[i].first, max_dist, jobs[i].second, include_self, json, csv, vvbin, with_neigh, reorder, &cache, cache_dir);
+        }
+        std::cout << "meshneigh_geod: built the vertex adjacency for " << cache.num_builds << " meshes, reused it for " << cache.num_reuses << " meshes with the same faces.\n";
+    } else {
+        mesh_neigh_geod(input_mesh_file, max_dist, output_dist_file, include_self, json, csv, vvbin, with_neigh, reorder, NULL, cache_dir);
+    }
     exit(0);
 }
@@ -6,12 +6,38 @@
 #include <algorithm>
 #include <iterator>
 #include <numeric>
+#include <fstream>
+#include <unordered_map>
 
 // The files including the functions we want to test.
 #include "fs_mesh_to_vcg.h"
 #include "mesh_edges.h"
+#include "mesh_area.h"
 #include "mesh_coords.h"
 #include "mesh_normals.h"
+#include "mesh_csr.h"
+#include "mesh_smooth.h"
+#include "mesh_mmap_io.h"
+#include "fs_mmap_io.h"
+#include "mesh_ply_export.h"
+#include "values_to_color.h"
+#include "mesh_view.h"
+#include "geod_engine.h"
+#include "geod_circles.h"
+#include "mesh_geometry.h"
+#include "mesh_neighborhood.h"
+#include "mesh_reorder.h"
+#include "geod_voronoi.h"
+#include "annot_export.h"
+#include "geod_fps.h"
+#include "geod_oracle.h"
+#include "geod_server.h"
+#include "geod_cache.h"
+#include "geod_graph_file.h"
+#include "geod_delta.h"
+#include "geod_astar.h"
+#include "geod_tree.h"
+#include <thread>
 
 
 TEST_CASE( "Reading the demo cube mesh file with read_mesh works" ) {
@@ -128,3 +154,1602 @@ TEST_CASE( "We can compute the vertex normals of a VCGLIB mesh" ) {
     }
 }
 
+
+
+TEST_CASE( "We can compute the CSR vertex adjacency and k-rings of a mesh" ) {
+
+    fs::Mesh surface = fs::Mesh::construct_pyramid();
+    MeshCSR csr = mesh_csr(surface);
+
+    SECTION("The number of vertices and edges is correct" ) {
+        REQUIRE( csr.num_vertices() == 5);
+        REQUIRE( csr.num_edges() == 9);
+        REQUIRE( csr.degree(4) == 4); // The apex is connected to all base vertices.
+    }
+
+    SECTION("The adjacency matches the libfs adjacency list" ) {
+        fs::Mesh cube = fs::Mesh::construct_cube();
+        std::vector<std::vector<size_t>> adjl_libfs = cube.as_adjlist();
+        std::vector<std::vector<size_t>> adjl_csr = mesh_csr(cube).to_adjlist();
+        REQUIRE( adjl_csr.size() == adjl_libfs.size());
+        for(size_t i = 0; i < adjl_libfs.size(); i++) {
+            std::sort(adjl_libfs[i].begin(), adjl_libfs[i].end());
+            REQUIRE( adjl_csr[i] == adjl_libfs[i]);
+        }
+    }
+
+    SECTION("The k-rings are correct" ) {
+        std::vector<int32_t> query = { 1, 4 };
+        std::vector<std::vector<int32_t>> ring1 = mesh_kring(csr, query, 1, false);
+        REQUIRE( ring1.size() == 2);
+        REQUIRE( ring1[0] == std::vector<int32_t>({ 0, 2, 4 }));
+        REQUIRE( ring1[1].size() == 4);
+        std::vector<std::vector<int32_t>> ring2 = mesh_kring(csr, query, 2, true);
+        REQUIRE( ring2[0].size() == 5); // All vertices are within 2 edges, plus self.
+        REQUIRE( ring2[0][0] == 1);
+        MeshCSR ext = mesh_csr_extend(csr, 2);
+        REQUIRE( ext.degree(1) == 4);
+    }
+}
+
+
+TEST_CASE( "We can compute and apply geodesic Gaussian smoothing kernels" ) {
+
+    fs::Mesh surface;
+    fs::read_mesh(&surface, "demo_data/meshes/cube.ply");
+    MyMesh m;
+    vcgmesh_from_fs_surface(&m, surface);
+    std::vector<float> fwhms = { 0.5, 5.0 };
+    std::vector<SparseMatrix> kernels = geod_gaussian_kernels(m, fwhms);
+    REQUIRE( kernels.size() == 2);
+
+    SECTION("The kernel rows are normalized and larger kernels have more entries" ) {
+        for(size_t k = 0; k < kernels.size(); k++) {
+            REQUIRE( kernels[k].num_rows == 8);
+            for(int32_t i = 0; i < kernels[k].num_rows; i++) {
+                float row_sum = 0.0;
+                for(int64_t j = kernels[k].row_ptr[i]; j < kernels[k].row_ptr[i+1]; j++) {
+                    row_sum += kernels[k].values[j];
+                }
+                REQUIRE( row_sum == Approx(1.0));
+            }
+        }
+        REQUIRE( kernels[0].nnz() == 8); // Only the vertex itself, the cube edges are longer than 3 sigma.
+        REQUIRE( kernels[1].nnz() > kernels[0].nnz());
+    }
+
+    SECTION("Smoothing preserves constant data and the batch product matches single products" ) {
+        std::vector<float> constant(8, 3.0);
+        std::vector<float> ramp = { 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0 };
+        std::vector<std::vector<float>> smoothed = spmv_batch(kernels[1], { constant, ramp });
+        for(size_t i = 0; i < 8; i++) {
+            REQUIRE( smoothed[0][i] == Approx(3.0));
+        }
+        REQUIRE( smoothed[1] == spmv(kernels[1], ramp));
+    }
+
+    SECTION("Kernels can be written to and read from a file" ) {
+        const std::string kernel_file = "test_kernel.gkern";
+        kernels[1].fingerprint = 12345678901234ULL;
+        write_sparse_matrix(kernel_file, kernels[1]);
+        SparseMatrix K;
+        read_sparse_matrix(&K, kernel_file);
+        REQUIRE( K.num_rows == kernels[1].num_rows);
+        REQUIRE( K.num_cols == kernels[1].num_cols);
+        REQUIRE( K.fingerprint == kernels[1].fingerprint);
+        REQUIRE( K.row_ptr == kernels[1].row_ptr);
+        REQUIRE( K.col_idx == kernels[1].col_idx);
+        REQUIRE( K.values == kernels[1].values);
+
+        // Damaged files are rejected instead of being used for out of range accesses.
+        SparseMatrix bad_col = kernels[1];
+        bad_col.col_idx[0] = bad_col.num_cols;
+        write_sparse_matrix(kernel_file, bad_col);
+        REQUIRE_THROWS_AS(read_sparse_matrix(&K, kernel_file), std::domain_error);
+        SparseMatrix bad_rows = kernels[1];
+        bad_rows.row_ptr[1] = int64_t(bad_rows.nnz());
+        write_sparse_matrix(kernel_file, bad_rows);
+        REQUIRE_THROWS_AS(read_sparse_matrix(&K, kernel_file), std::domain_error);
+        std::remove(kernel_file.c_str());
+    }
+}
+
+
+TEST_CASE( "The memory-mapped surf and curv readers return the same data as libfs" ) {
+
+    SECTION("Reading a surf file" ) {
+        const std::string surf_file = "demo_data/subjects_dir/fsaverage3/surf/lh.white";
+        fs::Mesh expected, surface;
+        fs::read_surf(&expected, surf_file);
+        read_surf_mmap(&surface, surf_file);
+        REQUIRE( surface.num_vertices() == 642);
+        REQUIRE( surface.num_faces() == 1280);
+        REQUIRE( surface.vertices == expected.vertices);
+        REQUIRE( surface.faces == expected.faces);
+    }
+
+    SECTION("Reading a curv file" ) {
+        const std::string curv_file = "demo_data/subjects_dir/fsaverage3/surf/lh.thickness";
+        REQUIRE( read_curv_data_mmap(curv_file) == fs::read_curv_data(curv_file));
+    }
+
+    SECTION("Reading a file of the wrong type throws" ) {
+        fs::Mesh surface;
+        REQUIRE_THROWS( read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.thickness"));
+    }
+}
+
+
+/// Write the cube mesh to a binary PLY file with the given byte order. If with_colors is set, add uchar vertex color properties.
+void write_binary_ply_cube(const std::string& filename, const bool big_endian, const bool with_colors) {
+    fs::Mesh cube = fs::Mesh::construct_cube();
+    std::ofstream ofs(filename, std::ofstream::out | std::ofstream::binary);
+    ofs << "ply\nformat " << (big_endian ? "binary_big_endian" : "binary_little_endian") << " 1.0\ncomment test\n";
+    ofs << "element vertex " << cube.num_vertices() << "\nproperty float x\nproperty float y\nproperty float z\n";
+    if(with_colors) {
+        ofs << "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+    }
+    ofs << "element face " << cube.num_faces() << "\nproperty list uchar int vertex_indices\nend_header\n";
+    const bool swap = big_endian != host_is_bigendian();
+    for(size_t i = 0; i < cube.num_vertices(); i++) {
+        float xyz[3] = { cube.vertices[i*3], cube.vertices[i*3+1], cube.vertices[i*3+2] };
+        if(swap) bswap_inplace(xyz, 3);
+        ofs.write(reinterpret_cast<const char*>(xyz), 12);
+        if(with_colors) {
+            const unsigned char rgb[3] = { 255, 0, 0 };
+            ofs.write(reinterpret_cast<const char*>(rgb), 3);
+        }
+    }
+    for(size_t i = 0; i < cube.num_faces(); i++) {
+        const unsigned char cnt = 3;
+        int32_t f[3] = { cube.faces[i*3], cube.faces[i*3+1], cube.faces[i*3+2] };
+        if(swap) bswap_inplace(f, 3);
+        ofs.write(reinterpret_cast<const char*>(&cnt), 1);
+        ofs.write(reinterpret_cast<const char*>(f), 12);
+    }
+}
+
+
+TEST_CASE( "The memory-mapped PLY, OBJ and OFF readers return the same meshes as libfs" ) {
+
+    fs::Mesh cube = fs::Mesh::construct_cube();
+
+    SECTION("Reading ASCII PLY, OBJ and OFF files" ) {
+        std::vector<std::string> files = { "test_cube.ply", "test_cube.obj", "test_cube.off" };
+        cube.to_ply_file(files[0]);
+        cube.to_obj_file(files[1]);
+        cube.to_off_file(files[2]);
+        for(size_t i = 0; i < files.size(); i++) {
+            fs::Mesh expected, surface;
+            fs::read_mesh(&expected, files[i]);
+            read_mesh_mmap(&surface, files[i]);
+            std::remove(files[i].c_str());
+            REQUIRE( surface.vertices == expected.vertices);
+            REQUIRE( surface.faces == expected.faces);
+        }
+    }
+
+    SECTION("Reading binary PLY files in both byte orders" ) {
+        const std::string ply_file = "test_cube_bin.ply";
+        for(int variant = 0; variant < 4; variant++) {
+            write_binary_ply_cube(ply_file, variant % 2 == 1, variant >= 2);
+            fs::Mesh surface;
+            read_ply_mmap(&surface, ply_file);
+            std::remove(ply_file.c_str());
+            REQUIRE( surface.vertices == cube.vertices);
+            REQUIRE( surface.faces == cube.faces);
+        }
+    }
+}
+
+
+TEST_CASE( "We can write binary PLY files with and without vertex colors" ) {
+
+    fs::Mesh cube = fs::Mesh::construct_cube();
+    const std::string ply_file = "test_cube_export.ply";
+
+    SECTION("Without colors, the file round-trips and has the expected size" ) {
+        write_ply_binary(ply_file, cube);
+        fs::Mesh surface;
+        read_ply_mmap(&surface, ply_file);
+        std::string contents;
+        {
+            MappedFile mf(ply_file);
+            contents.assign(mf.data(), mf.size());
+        }
+        std::remove(ply_file.c_str());
+        REQUIRE( surface.vertices == cube.vertices);
+        REQUIRE( surface.faces == cube.faces);
+        const size_t header_size = contents.find("end_header\n") + 11;
+        REQUIRE( contents.size() == header_size + 8 * 12 + 12 * 13);
+    }
+
+    SECTION("With colors, the file round-trips" ) {
+        std::vector<uint8_t> colors(cube.num_vertices() * 3, 128);
+        write_ply_binary(ply_file, cube, colors);
+        fs::Mesh surface;
+        read_ply_mmap(&surface, ply_file);
+        std::remove(ply_file.c_str());
+        REQUIRE( surface.vertices == cube.vertices);
+        REQUIRE( surface.faces == cube.faces);
+    }
+
+    SECTION("Invalid color vectors are rejected" ) {
+        std::vector<uint8_t> colors(5, 128);
+        REQUIRE_THROWS( write_ply_binary(ply_file, cube, colors));
+    }
+}
+
+TEST_CASE( "We can map data to colors with the colormap lookup tables" ) {
+
+    SECTION("The lookup tables contain the colormap colors" ) {
+        const ColormapLUT& lut = colormap_lut(tinycolormap::ColormapType::Viridis);
+        REQUIRE( lut.size() == COLORMAP_LUT_SIZE);
+        REQUIRE( lut.cmap == tinycolormap::ColormapType::Viridis);
+        tinycolormap::Color first = tinycolormap::GetColor(0.0, tinycolormap::ColormapType::Viridis);
+        tinycolormap::Color last = tinycolormap::GetColor(1.0, tinycolormap::ColormapType::Viridis);
+        REQUIRE( lut.rgb[0] == first.ri());
+        REQUIRE( lut.rgb[2] == first.bi());
+        REQUIRE( lut.rgb[(lut.size() - 1) * 3 + 1] == last.gi());
+        REQUIRE( colormap_lut(tinycolormap::ColormapType::Github).cmap == tinycolormap::ColormapType::Github);
+    }
+
+    SECTION("The mapped colors match the colormap within quantization error" ) {
+        std::vector<float> data = { 2.0f, 0.5f, 3.0f, 1.0f, 2.75f };
+        std::vector<uint8_t> colors = data_to_colors(data, tinycolormap::ColormapType::Jet);
+        REQUIRE( colors.size() == data.size() * 3);
+        for(size_t i=0; i<data.size(); i++) {
+            tinycolormap::Color c = tinycolormap::GetColor((data[i] - 0.5) / 2.5, tinycolormap::ColormapType::Jet);
+            REQUIRE( std::abs(int(colors[i*3]) - int(c.ri())) <= 1);
+            REQUIRE( std::abs(int(colors[i*3+1]) - int(c.gi())) <= 1);
+            REQUIRE( std::abs(int(colors[i*3+2]) - int(c.bi())) <= 1);
+        }
+        std::vector<int> idata = { 0, 4, 2 };
+        REQUIRE( data_to_colors(idata).size() == 9);
+    }
+
+    SECTION("Percentile clipping limits the range and clamps outliers" ) {
+        std::vector<float> data(101);
+        std::iota(data.begin(), data.end(), 0.0f);
+        data[100] = 1000000.0f;
+        float lower, upper;
+        data_percentile_range(data.data(), data.size(), 2.0, &lower, &upper);
+        REQUIRE( lower == Approx(2.0f));
+        REQUIRE( upper == Approx(98.0f));
+        data_minmax(data.data(), data.size(), &lower, &upper);
+        REQUIRE( lower == Approx(0.0f));
+        REQUIRE( upper == Approx(1000000.0f));
+
+        std::vector<uint8_t> colors(data.size() * 3);
+        data_to_colors(data.data(), data.size(), colors.data(), tinycolormap::ColormapType::Viridis, 2.0);
+        const ColormapLUT& lut = colormap_lut();
+        REQUIRE( std::equal(colors.begin(), colors.begin() + 3, lut.rgb.begin()));  // Clamped to first color.
+        REQUIRE( std::equal(colors.end() - 3, colors.end(), lut.rgb.end() - 3));  // Outlier clamped to last color.
+    }
+
+    SECTION("Invalid data and parameters are rejected" ) {
+        std::vector<float> constant(5, 1.0f);
+        REQUIRE_THROWS( data_to_colors(constant));
+        std::vector<float> single(1, 1.0f);
+        REQUIRE_THROWS( data_to_colors(single));
+        std::vector<float> data = { 0.0f, 1.0f };
+        REQUIRE_THROWS( data_to_colors(data, tinycolormap::ColormapType::Viridis, 50.0));
+    }
+}
+
+
+TEST_CASE( "The mesh view functions match the VCGLIB mesh functions" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    const MeshView<> mv = mesh_view(surface);
+    MyMesh m;
+    vcgmesh_from_fs_surface(&m, surface);
+
+    SECTION("The view gives access to the mesh arrays" ) {
+        REQUIRE( mv.num_vertices() == surface.num_vertices());
+        REQUIRE( mv.num_faces() == surface.num_faces());
+        REQUIRE( mv.vm_at(5, 2) == surface.vm_at(5, 2));
+        REQUIRE( mv.fm_at(7, 1) == surface.fm_at(7, 1));
+        REQUIRE( mv.vertex_coords(3) == surface.vertex_coords(3));
+    }
+
+    SECTION("Areas, edge lengths, normals and coordinates match" ) {
+        REQUIRE( mesh_area_total(mv) == mesh_area_total(m));
+        REQUIRE( mesh_area_per_face(mv) == mesh_area_per_face(m));
+        std::vector<double> el_view = mesh_edge_lengths(mv);
+        std::vector<double> el_vcg = mesh_edge_lengths(m);
+        REQUIRE( el_view.size() == el_vcg.size());
+        REQUIRE( *std::max_element(el_view.begin(), el_view.end()) == Approx(*std::max_element(el_vcg.begin(), el_vcg.end())));
+        REQUIRE( std::accumulate(el_view.begin(), el_view.end(), 0.0) == Approx(std::accumulate(el_vcg.begin(), el_vcg.end(), 0.0)));
+        REQUIRE( mesh_vertex_coords(mv) == mesh_vertex_coords(m));
+        for(int angle_weighted = 0; angle_weighted < 2; angle_weighted++) {
+            std::vector<std::vector<float>> n_view = mesh_vnormals(mv, angle_weighted == 1);
+            std::vector<std::vector<float>> n_vcg = mesh_vnormals(m, angle_weighted == 1);
+            REQUIRE( n_view.size() == n_vcg.size());
+            for(size_t i = 0; i < n_view.size(); i++) {
+                for(size_t j = 0; j < 3; j++) {
+                    REQUIRE( n_view[i][j] == Approx(n_vcg[i][j]).margin(1e-5));
+                }
+            }
+        }
+    }
+
+    SECTION("Geodesic distances are identical to the VCGLIB ones" ) {
+        std::vector<int> sources = { 0, 100 };
+        REQUIRE( geodist(mv, sources, -1.0) == geodist(m, sources, -1.0));
+        MyMesh m2; // The VCGLIB geodist keeps old distances of unreached vertices, so it needs a fresh mesh for a bounded search.
+        vcgmesh_from_fs_surface(&m2, surface);
+        std::vector<int> source = { 17 };
+        REQUIRE( geodist(mv, source, 20.0) == geodist(m2, source, 20.0));
+    }
+
+    SECTION("Geodesic neighborhoods contain the vertices within the distance, sorted by index" ) {
+        const float max_dist = 15.0;
+        std::vector<std::vector<GeodNeighbor>> neigh = geod_neighborhood(mv, max_dist, true);
+        REQUIRE( neigh.size() == mv.num_vertices());
+        std::vector<int> source = { 42 };
+        std::vector<float> dists = geodist(m, source, max_dist);
+        std::vector<GeodNeighbor> expected;
+        for(size_t j = 0; j < dists.size(); j++) {
+            if(j == 42 || dists[j] > 0.0) {
+                expected.push_back(GeodNeighbor(j, dists[j]));
+            }
+        }
+        REQUIRE( neigh[42].size() == expected.size());
+        for(size_t j = 0; j < expected.size(); j++) {
+            REQUIRE( neigh[42][j].index == expected[j].index);
+            REQUIRE( neigh[42][j].distance == expected[j].distance);
+        }
+    }
+}
+
+
+TEST_CASE( "Reordering mesh vertices does not change the results mapped back to the original order" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    const std::vector<std::string> methods = { "rcm", "morton" };
+
+    SECTION("The orders are permutations and reduce the index distance of mesh neighbors" ) {
+        const MeshCSR csr = mesh_csr(surface);
+        size_t span_orig = 0;
+        for(size_t v = 0; v < csr.num_vertices(); v++) {
+            for(const int32_t* n = csr.neighbors_begin(v); n != csr.neighbors_end(v); ++n) {
+                span_orig = std::max(span_orig, size_t(std::abs(*n - int32_t(v))));
+            }
+        }
+        for(size_t i = 0; i < methods.size(); i++) {
+            const VertexOrder order = vertex_order(surface, methods[i]);
+            REQUIRE( order.size() == surface.num_vertices());
+            for(size_t v = 0; v < order.size(); v++) {
+                REQUIRE( order.old_to_new[order.new_to_old[v]] == int32_t(v));
+            }
+            const fs::Mesh reordered = reorder_mesh(surface, order);
+            REQUIRE( reordered.num_faces() == surface.num_faces());
+            REQUIRE( mesh_area_total(mesh_view(reordered)) == Approx(mesh_area_total(mesh_view(surface))));
+            const MeshCSR rcsr = mesh_csr(reordered);
+            size_t span = 0;
+            for(size_t v = 0; v < rcsr.num_vertices(); v++) {
+                for(const int32_t* n = rcsr.neighbors_begin(v); n != rcsr.neighbors_end(v); ++n) {
+                    span = std::max(span, size_t(std::abs(*n - int32_t(v))));
+                }
+            }
+            if(methods[i] == "rcm") {
+                REQUIRE( span < span_orig);  // RCM minimizes the bandwidth, Morton order only the mean distance.
+            }
+        }
+        REQUIRE_THROWS( vertex_order(surface, "invalid"));
+        REQUIRE_THROWS( vertex_order_from_permutation(std::vector<int32_t>({ 0, 0, 1 })));
+    }
+
+    SECTION("Geodesic neighborhoods and k-rings are identical after mapping back" ) {
+        const std::vector<std::vector<GeodNeighbor>> neigh = geod_neighborhood(mesh_view(surface), 15.0, true);
+        const std::vector<std::vector<int32_t>> rings = mesh_kring(mesh_csr(surface), std::vector<int32_t>(), 3, true);
+        for(size_t i = 0; i < methods.size(); i++) {
+            const VertexOrder order = vertex_order(surface, methods[i]);
+            const fs::Mesh reordered = reorder_mesh(surface, order);
+            const std::vector<std::vector<GeodNeighbor>> neigh_re = geod_neighborhood_to_orig(geod_neighborhood(mesh_view(reordered), 15.0, true), order);
+            REQUIRE( neigh_re.size() == neigh.size());
+            for(size_t v = 0; v < neigh.size(); v++) {
+                REQUIRE( neigh_re[v].size() == neigh[v].size());
+                for(size_t j = 0; j < neigh[v].size(); j++) {
+                    REQUIRE( neigh_re[v][j].index == neigh[v][j].index);
+                    REQUIRE( neigh_re[v][j].distance == neigh[v][j].distance);
+                }
+            }
+            const MeshCSR csr_re = mesh_csr_permute(mesh_csr(surface), order);
+            REQUIRE( index_lists_to_orig(mesh_kring(csr_re, std::vector<int32_t>(), 3, true), order) == rings);
+        }
+    }
+
+    SECTION("Per-vertex data is mapped back to the original order" ) {
+        const std::vector<float> mgd = mean_geodist_p(mesh_view(surface));
+        const VertexOrder order = vertex_order(surface, "rcm");
+        const std::vector<float> mgd_re = data_to_orig(mean_geodist_p(mesh_view(reorder_mesh(surface, order))), order);
+        REQUIRE( mgd_re.size() == mgd.size());
+        for(size_t v = 0; v < mgd.size(); v++) {
+            REQUIRE( mgd_re[v] == Approx(mgd[v]).epsilon(1e-6));
+        }
+    }
+}
+
+
+TEST_CASE( "We can compute geodesic Voronoi parcellations and write them as annot files" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    const MeshView<> mv = mesh_view(surface);
+    const GeodGraph g = geod_graph(mv);
+    const std::vector<int32_t> seeds = { 5, 100, 250, 400, 600 };
+
+    SECTION("Each vertex is assigned to its nearest seed" ) {
+        std::vector<std::vector<float>> seed_dists;
+        for(size_t i = 0; i < seeds.size(); i++) {
+            seed_dists.push_back(geodist(g, std::vector<int32_t>({ seeds[i] }), -1.0));
+        }
+        const GeodVoronoi vor = geod_voronoi(g, seeds);
+        REQUIRE( vor.num_vertices() == mv.num_vertices());
+        for(size_t v = 0; v < mv.num_vertices(); v++) {
+            REQUIRE( vor.seed[v] >= 0);
+            float min_dist = GEOD_UNREACHED;
+            for(size_t i = 0; i < seeds.size(); i++) {
+                const float d = (seeds[i] == int32_t(v)) ? 0.0f : seed_dists[i][v];
+                min_dist = std::min(min_dist, d);
+            }
+            REQUIRE( vor.dist[v] == min_dist);
+            REQUIRE( (seeds[vor.seed[v]] == int32_t(v) || seed_dists[vor.seed[v]][v] == min_dist));
+        }
+        for(size_t i = 0; i < seeds.size(); i++) {
+            REQUIRE( vor.seed[seeds[i]] == int32_t(i));
+        }
+    }
+
+    SECTION("Bounded and partitioned searches give the same parcellation" ) {
+        const GeodVoronoi vor = geod_voronoi(g, seeds, 30.0);
+        size_t num_unreached = 0;
+        for(size_t v = 0; v < vor.num_vertices(); v++) {
+            if(vor.seed[v] < 0) {
+                num_unreached++;
+                REQUIRE( vor.dist[v] == GEOD_UNREACHED);
+            } else {
+                REQUIRE( vor.dist[v] < 30.0);
+            }
+        }
+        REQUIRE( num_unreached > 0);
+        for(size_t num_parts = 2; num_parts <= 6; num_parts += 2) {
+            const GeodVoronoi vor_p = geod_voronoi(g, seeds, 30.0, num_parts);
+            REQUIRE( vor_p.seed == vor.seed);
+            REQUIRE( vor_p.dist == vor.dist);
+        }
+        REQUIRE_THROWS( geod_voronoi(g, std::vector<int32_t>({ -1 })));
+        REQUIRE_THROWS( geod_voronoi(g, seeds, -1.0, 0));
+    }
+
+    SECTION("Annot files written from region indices can be read with libfs" ) {
+        const GeodVoronoi vor = geod_voronoi(g, seeds, 30.0);
+        std::vector<std::string> names = { "a", "b", "c", "d", "e" };
+        const fs::Annot annot = annot_from_regions(vor.seed, names);
+        const std::string annot_file = "test_voronoi_tmp.annot";
+        write_annot(annot_file, annot);
+        fs::Annot annot2;
+        fs::read_annot(&annot2, annot_file);
+        std::remove(annot_file.c_str());
+        REQUIRE( annot2.vertex_labels == annot.vertex_labels);
+        REQUIRE( annot2.colortable.name == annot.colortable.name);
+        REQUIRE( annot2.colortable.label == annot.colortable.label);
+        REQUIRE( annot2.colortable.name[0] == "unknown");
+        REQUIRE( annot2.region_vertices("c").size() > 0);
+        std::vector<int32_t> labels = annot.colortable.label;
+        std::sort(labels.begin(), labels.end());
+        REQUIRE( std::unique(labels.begin(), labels.end()) == labels.end());
+        REQUIRE_THROWS( annot_from_regions(std::vector<int32_t>({ 7 }), names));
+    }
+}
+
+
+TEST_CASE( "Incremental geodesic farthest-point sampling equals sampling with full distance recomputation" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    const GeodGraph g = geod_graph(mesh_view(surface));
+    const size_t nv = g.num_vertices();
+    const size_t num_points = 40;
+
+    SECTION("Points, coverage radii and distances match the brute force sampling" ) {
+        const GeodFPS fps = geod_farthest_point_sampling(g, num_points, 17);
+        REQUIRE( fps.points.size() == num_points);
+        REQUIRE( fps.radius.size() == num_points);
+        std::vector<float> field(nv, GEOD_UNREACHED);
+        int32_t p = 17;
+        for(size_t i = 0; i < num_points; i++) {
+            REQUIRE( fps.points[i] == p);
+            const std::vector<float> d = geodist(g, std::vector<int32_t>({ p }), -1.0);
+            field[p] = 0.0f;
+            float max_field = -1.0f;
+            int32_t farthest = -1;
+            for(size_t v = 0; v < nv; v++) {
+                if(int32_t(v) != p) {
+                    field[v] = std::min(field[v], d[v]);
+                }
+                if(field[v] > max_field) {
+                    max_field = field[v];
+                    farthest = int32_t(v);
+                }
+            }
+            REQUIRE( fps.radius[i] == max_field);
+            p = farthest;
+        }
+        REQUIRE( fps.dist == field);
+        for(size_t i = 1; i < num_points; i++) {
+            REQUIRE( fps.radius[i] <= fps.radius[i-1]);
+        }
+    }
+
+    SECTION("Sampling stops at the minimal radius and at the number of vertices" ) {
+        const GeodFPS fps = geod_farthest_point_sampling(g, num_points, 0);
+        const float min_radius = fps.radius[9];
+        const GeodFPS fps_r = geod_farthest_point_sampling(g, num_points, 0, min_radius);
+        REQUIRE( fps_r.points.size() <= 10);
+        REQUIRE( fps_r.radius.back() <= min_radius);
+        REQUIRE( std::equal(fps_r.points.begin(), fps_r.points.end(), fps.points.begin()));
+        const GeodFPS fps_all = geod_farthest_point_sampling(g, nv + 10, 0);
+        REQUIRE( fps_all.points.size() == nv);
+        REQUIRE( fps_all.radius.back() == 0.0f);
+        std::vector<int32_t> sorted_points = fps_all.points;
+        std::sort(sorted_points.begin(), sorted_points.end());
+        REQUIRE( std::unique(sorted_points.begin(), sorted_points.end()) == sorted_points.end());
+        REQUIRE_THROWS( geod_farthest_point_sampling(g, 5, int32_t(nv)));
+    }
+}
+
+
+TEST_CASE( "The landmark distance oracle bounds and refines geodesic distances" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    const GeodGraph g = geod_graph(mesh_view(surface));
+    const int32_t nv = int32_t(g.num_vertices());
+    const GeodOracle oracle = geod_oracle_build(g, 16);
+    REQUIRE( oracle.num_landmarks() == 16);
+    REQUIRE( oracle.qdist.size() == size_t(nv) * 16);
+
+    std::vector<int32_t> u, v;
+    for(int32_t i = 0; i < 300; i++) {
+        u.push_back((i * 7919) % nv);
+        v.push_back((i * 104729 + 13) % nv);
+    }
+    u.push_back(5);
+    v.push_back(5);
+
+    SECTION("The bounds contain the exact distances, and refinement gives them" ) {
+        const std::vector<GeodBounds> bounds = geod_oracle_bounds(oracle, u, v);
+        const std::vector<float> exact = geod_oracle_distances(oracle, g, u, v, 0.0);
+        const std::vector<float> approx = geod_oracle_distances(oracle, g, u, v, -1.0);
+        const std::vector<float> exact_astar = geod_oracle_distances(oracle, g, mesh_view(surface), u, v, 0.0, "astar");
+        const std::vector<float> exact_bidir = geod_oracle_distances(oracle, g, mesh_view(surface), u, v, 0.0, "bidir");
+        for(size_t i = 0; i < u.size(); i++) {
+            const std::vector<float> d = geodist(g, std::vector<int32_t>({ u[i] }), -1.0);
+            const float d_uv = (u[i] == v[i]) ? 0.0f : d[v[i]];
+            REQUIRE( exact[i] == d_uv);
+            REQUIRE( exact_astar[i] == d_uv);
+            REQUIRE( exact_bidir[i] == Approx(d_uv).epsilon(1e-5));
+            REQUIRE( bounds[i].lower <= d_uv * 1.0001f);
+            REQUIRE( bounds[i].upper >= d_uv * 0.9999f);
+            REQUIRE( approx[i] >= bounds[i].lower);
+            REQUIRE( approx[i] <= bounds[i].upper);
+        }
+        const GeodBounds b = geod_oracle_bounds(oracle, oracle.landmarks[0], 100);
+        REQUIRE( b.upper - b.lower <= 4.0f * oracle.scale);
+        REQUIRE_THROWS( geod_oracle_bounds(oracle, 0, nv));
+    }
+
+    SECTION("Oracles can be written to and read from sidecar files" ) {
+        const std::string oracle_file = "test_oracle_tmp.geodoracle";
+        write_geod_oracle(oracle_file, oracle);
+        const GeodOracle oracle2 = read_geod_oracle(oracle_file);
+        std::remove(oracle_file.c_str());
+        REQUIRE( oracle2.num_vertices == oracle.num_vertices);
+        REQUIRE( oracle2.num_edges == oracle.num_edges);
+        REQUIRE( oracle2.scale == oracle.scale);
+        REQUIRE( oracle2.landmarks == oracle.landmarks);
+        REQUIRE( oracle2.qdist == oracle.qdist);
+
+        fs::Mesh other;
+        read_surf_mmap(&other, "demo_data/subjects_dir/fsaverage6/surf/lh.pial");
+        REQUIRE_THROWS( geod_oracle_distances(oracle2, geod_graph(mesh_view(other)), u, v, 0.0));
+        REQUIRE_THROWS( read_geod_oracle("demo_data/subjects_dir/fsaverage3/surf/lh.white"));
+    }
+}
+
+
+TEST_CASE( "The geodesic query server answers requests like the engine" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    const GeodGraph g = geod_graph(mesh_view(surface));
+    GeodServer server;
+    server.add_mesh("lh.white", surface);
+    GeodServerSession session;
+
+    SECTION("Distance, neighborhood, k-ring and path requests" ) {
+        GeodMessageWriter req;
+        req.put<uint32_t>(GEOD_OP_DIST);
+        req.put<uint32_t>(0);
+        req.put<float>(-1.0f);
+        req.put<uint32_t>(1);
+        req.put<int32_t>(10);
+        std::vector<char> resp = geod_server_handle(server, session, req.buf.data(), req.buf.size());
+        GeodMessageReader in(resp.data(), resp.size());
+        REQUIRE( in.get<int32_t>() == 0);
+        const std::vector<float> dist = in.get_vector<float>(in.get<uint32_t>());
+        std::vector<float> expected = geodist(g, std::vector<int32_t>({ 10 }), -1.0);
+        expected[10] = 0.0f;
+        REQUIRE( dist == expected);
+
+        GeodMessageWriter req_n;
+        req_n.put<uint32_t>(GEOD_OP_NEIGH);
+        req_n.put<uint32_t>(0);
+        req_n.put<int32_t>(10);
+        req_n.put<float>(15.0f);
+        resp = geod_server_handle(server, session, req_n.buf.data(), req_n.buf.size());
+        GeodMessageReader in_n(resp.data(), resp.size());
+        REQUIRE( in_n.get<int32_t>() == 0);
+        const uint32_t nn = in_n.get<uint32_t>();
+        const std::vector<int32_t> neigh = in_n.get_vector<int32_t>(nn);
+        const std::vector<float> neigh_dist = in_n.get_vector<float>(nn);
+        size_t num_within = 0;
+        for(size_t v = 0; v < expected.size(); v++) {
+            num_within += expected[v] < 15.0f ? 1 : 0;
+        }
+        REQUIRE( neigh.size() == num_within);
+        REQUIRE( std::is_sorted(neigh.begin(), neigh.end()));
+        for(size_t i = 0; i < nn; i++) {
+            REQUIRE( neigh_dist[i] == expected[neigh[i]]);
+        }
+
+        GeodMessageWriter req_k;
+        req_k.put<uint32_t>(GEOD_OP_KRING);
+        req_k.put<uint32_t>(0);
+        req_k.put<int32_t>(10);
+        req_k.put<uint32_t>(2);
+        for(int rep = 0; rep < 2; rep++) {  // The second request reuses the k-ring work array.
+            resp = geod_server_handle(server, session, req_k.buf.data(), req_k.buf.size());
+            GeodMessageReader in_k(resp.data(), resp.size());
+            REQUIRE( in_k.get<int32_t>() == 0);
+            const std::vector<int32_t> kring = in_k.get_vector<int32_t>(in_k.get<uint32_t>());
+            REQUIRE( kring == mesh_kring(g.csr, std::vector<int32_t>({ 10 }), 2)[0]);
+        }
+
+        GeodMessageWriter req_p;
+        req_p.put<uint32_t>(GEOD_OP_PATH);
+        req_p.put<uint32_t>(0);
+        req_p.put<int32_t>(10);
+        req_p.put<int32_t>(500);
+        resp = geod_server_handle(server, session, req_p.buf.data(), req_p.buf.size());
+        GeodMessageReader in_p(resp.data(), resp.size());
+        REQUIRE( in_p.get<int32_t>() == 0);
+        const float length = in_p.get<float>();
+        const std::vector<int32_t> path = in_p.get_vector<int32_t>(in_p.get<uint32_t>());
+        REQUIRE( length == expected[500]);
+        REQUIRE( path.front() == 10);
+        REQUIRE( path.back() == 500);
+        float path_length = 0.0f;
+        for(size_t i = 1; i < path.size(); i++) {
+            const int32_t* nb = g.csr.neighbors_begin(path[i-1]);
+            const int32_t* it = std::find(nb, g.csr.neighbors_end(path[i-1]), path[i]);
+            REQUIRE( it != g.csr.neighbors_end(path[i-1]));
+            path_length += g.weights[g.csr.offsets[path[i-1]] + (it - nb)];
+        }
+        REQUIRE( path_length == length);
+    }
+
+    SECTION("Path requests cross zero-length edges between duplicate vertices" ) {
+        fs::Mesh dup;
+        dup.vertices = { 0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,  0.0f, 5.0f, 0.0f,  1.0f, 0.0f, 0.0f,  2.0f, 0.0f, 0.0f };  // Vertex 3 duplicates vertex 1.
+        dup.faces = { 0, 1, 2,  1, 3, 2,  3, 4, 2 };
+        server.add_mesh("dup", dup);
+        GeodMessageWriter req_p;
+        req_p.put<uint32_t>(GEOD_OP_PATH);
+        req_p.put<uint32_t>(1);
+        req_p.put<int32_t>(0);
+        req_p.put<int32_t>(4);
+        std::vector<char> resp = geod_server_handle(server, session, req_p.buf.data(), req_p.buf.size());
+        GeodMessageReader in_p(resp.data(), resp.size());
+        REQUIRE( in_p.get<int32_t>() == 0);
+        REQUIRE( in_p.get<float>() == 2.0f);
+        REQUIRE( in_p.get_vector<int32_t>(in_p.get<uint32_t>()) == std::vector<int32_t>({ 0, 1, 3, 4 }));
+    }
+
+    SECTION("Invalid requests get error responses" ) {
+        GeodMessageWriter req;
+        req.put<uint32_t>(GEOD_OP_NEIGH);
+        req.put<uint32_t>(3);
+        req.put<int32_t>(10);
+        req.put<float>(15.0f);
+        std::vector<char> resp = geod_server_handle(server, session, req.buf.data(), req.buf.size());
+        REQUIRE( GeodMessageReader(resp.data(), resp.size()).get<int32_t>() == 1);
+        GeodMessageWriter req_t;
+        req_t.put<uint32_t>(GEOD_OP_DIST);
+        req_t.put<uint32_t>(0);
+        req_t.put<float>(-1.0f);
+        req_t.put<uint32_t>(1000000);
+        resp = geod_server_handle(server, session, req_t.buf.data(), req_t.buf.size());
+        REQUIRE( GeodMessageReader(resp.data(), resp.size()).get<int32_t>() == 1);
+    }
+
+    SECTION("Requests over the socket, with latency statistics" ) {
+        const std::string socket_path = "test_geodserver_tmp.sock";
+        std::thread server_thread(geod_server_run, std::ref(server), socket_path, 2);
+        int fd = -1;
+        for(int attempt = 0; attempt < 100 && fd < 0; attempt++) {
+            try {
+                fd = geod_client_connect(socket_path);
+            } catch(const std::runtime_error&) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+        }
+        REQUIRE( fd >= 0);
+        GeodMessageWriter req;
+        req.put<uint32_t>(GEOD_OP_INFO);
+        req.put<uint32_t>(0);
+        std::vector<char> resp = geod_client_call(fd, req.buf);
+        GeodMessageReader in(resp.data(), resp.size());
+        REQUIRE( in.get<int32_t>() == 0);
+        REQUIRE( in.get<uint32_t>() == 1);
+        REQUIRE( in.get<uint32_t>() == uint32_t(surface.num_vertices()));
+        REQUIRE( in.get<uint32_t>() == uint32_t(surface.num_faces()));
+        const std::vector<char> name = in.get_vector<char>(in.get<uint32_t>());
+        REQUIRE( std::string(name.begin(), name.end()) == "lh.white");
+
+        GeodMessageWriter req_s;
+        req_s.put<uint32_t>(GEOD_OP_STATS);
+        req_s.put<uint32_t>(0);
+        resp = geod_client_call(fd, req_s.buf);
+        GeodMessageReader in_s(resp.data(), resp.size());
+        REQUIRE( in_s.get<int32_t>() == 0);
+        REQUIRE( in_s.get<uint32_t>() == uint32_t(GEOD_OP_COUNT));
+        REQUIRE( in_s.get<uint32_t>() == uint32_t(GEOD_LATENCY_BUCKETS));
+        const std::vector<uint64_t> counts = in_s.get_vector<uint64_t>(GEOD_OP_COUNT * GEOD_LATENCY_BUCKETS);
+        REQUIRE( std::accumulate(counts.begin(), counts.begin() + GEOD_LATENCY_BUCKETS, uint64_t(0)) == 1);  // The INFO request.
+
+        GeodMessageWriter req_q;
+        req_q.put<uint32_t>(GEOD_OP_SHUTDOWN);
+        req_q.put<uint32_t>(0);
+        resp = geod_client_call(fd, req_q.buf);
+        REQUIRE( GeodMessageReader(resp.data(), resp.size()).get<int32_t>() == 0);
+        close(fd);
+        server_thread.join();
+        REQUIRE_THROWS( geod_client_connect(socket_path));
+    }
+
+    SECTION("Clients which stay connected do not hold a worker thread" ) {
+        const std::string socket_path = "test_geodserver_idle_tmp.sock";
+        std::thread server_thread(geod_server_run, std::ref(server), socket_path, 1);
+        int fd_a = -1;
+        for(int attempt = 0; attempt < 100 && fd_a < 0; attempt++) {
+            try {
+                fd_a = geod_client_connect(socket_path);
+            } catch(const std::runtime_error&) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+        }
+        REQUIRE( fd_a >= 0);
+        GeodMessageWriter req;
+        req.put<uint32_t>(GEOD_OP_INFO);
+        req.put<uint32_t>(0);
+        std::vector<char> resp = geod_client_call(fd_a, req.buf);
+        REQUIRE( GeodMessageReader(resp.data(), resp.size()).get<int32_t>() == 0);
+
+        // The first client stays connected, with a single worker thread the other clients are still served.
+        const int fd_b = geod_client_connect(socket_path);
+        GeodMessageWriter req_s;
+        req_s.put<uint32_t>(GEOD_OP_STATS);
+        req_s.put<uint32_t>(0);
+        resp = geod_client_call(fd_b, req_s.buf);
+        REQUIRE( GeodMessageReader(resp.data(), resp.size()).get<int32_t>() == 0);
+        resp = geod_client_call(fd_a, req.buf);
+        REQUIRE( GeodMessageReader(resp.data(), resp.size()).get<int32_t>() == 0);
+        close(fd_b);
+
+        const int fd_c = geod_client_connect(socket_path);
+        GeodMessageWriter req_q;
+        req_q.put<uint32_t>(GEOD_OP_SHUTDOWN);
+        req_q.put<uint32_t>(0);
+        resp = geod_client_call(fd_c, req_q.buf);
+        REQUIRE( GeodMessageReader(resp.data(), resp.size()).get<int32_t>() == 0);
+        close(fd_c);
+        server_thread.join();
+        close(fd_a);
+    }
+}
+
+
+TEST_CASE( "Geodesic computations on a vertex mask equal the ones on the submesh of the included vertices" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    const MeshView<> m = mesh_view(surface);
+    std::vector<int32_t> label_vertices;  // Leave out a part of the mesh, like the medial wall. Unsorted on purpose.
+    for(size_t v = surface.num_vertices(); v-- > 0;) {
+        if(surface.vm_at(v, 1) < 10.0f) {
+            label_vertices.push_back(int32_t(v));
+        }
+    }
+    REQUIRE( label_vertices.size() > 100);
+    REQUIRE( label_vertices.size() < surface.num_vertices());
+    const MeshMask mask = mesh_mask(m, label_vertices);
+    std::vector<int32_t> sorted_label = label_vertices;
+    std::sort(sorted_label.begin(), sorted_label.end());
+    const std::pair<std::unordered_map<int32_t, int32_t>, fs::Mesh> sub = surface.submesh_vertex(sorted_label);
+
+    SECTION("The mask holds the included vertices in ascending order and the faces of the submesh" ) {
+        REQUIRE( mask.vertices == sorted_label);
+        REQUIRE( mask.num_faces() == sub.second.num_faces());
+        for(size_t f = 0; f < mask.num_faces(); f++) {
+            for(size_t j = 0; j < 3; j++) {
+                REQUIRE( sub.first.at(sub.second.fm_at(f, j)) == mask.faces[f * 3 + j]);
+            }
+        }
+        const std::vector<float> dist = geodist(masked_view(m, mask), std::vector<int32_t>(1, mask.vertices[0]), -1.0f);
+        for(size_t v = 0; v < dist.size(); v++) {
+            if(! mask.included[v]) {
+                REQUIRE( dist[v] == 0.0f);  // Masked vertices are never reached.
+            }
+        }
+        REQUIRE_THROWS( mesh_mask(m, std::vector<int32_t>(1, int32_t(surface.num_vertices()))));
+        REQUIRE_THROWS( mask_scatter(std::vector<float>(3, 1.0f), mask, 0.0f));
+    }
+
+    SECTION("Mean geodesic distances and geodesic circles equal the submesh results" ) {
+        const float fill_value = -1.0f;
+        const std::vector<float> mgd = mask_scatter(mean_geodist_p(m, mask), mask, fill_value);
+        const std::vector<float> mgd_sub = fs::Mesh::curv_data_for_orig_mesh(mean_geodist_p(mesh_view(sub.second)), sub.first, surface.num_vertices(), fill_value);
+        REQUIRE( mgd == mgd_sub);
+
+        const std::vector<std::vector<float>> circ = geodesic_circles(m, mask, std::vector<int>(), 5.0, true);
+        const std::vector<std::vector<float>> circ_sub = geodesic_circles(mesh_view(sub.second), std::vector<int>(), 5.0, true);
+        REQUIRE( circ.size() == 3);
+        for(size_t i = 0; i < circ.size(); i++) {
+            REQUIRE( mask_scatter(circ[i], mask, fill_value) == fs::Mesh::curv_data_for_orig_mesh(circ_sub[i], sub.first, surface.num_vertices(), fill_value));
+        }
+        int masked_vertex = 0;
+        while(mask.included[masked_vertex]) {
+            masked_vertex++;
+        }
+        REQUIRE_THROWS( geodesic_circles(m, mask, std::vector<int>(1, masked_vertex), 5.0, false));
+    }
+}
+
+
+TEST_CASE( "Meshes with the same faces reuse the vertex adjacency of the geodesic graph" ) {
+
+    fs::Mesh white, pial;
+    read_surf_mmap(&white, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    read_surf_mmap(&pial, "demo_data/subjects_dir/fsaverage3/surf/lh.pial");
+    REQUIRE( white.faces == pial.faces);
+
+    SECTION("The cached graph equals the graph built from scratch, and only meshes with other faces rebuild the adjacency" ) {
+        GeodGraphCache cache;
+        const GeodGraph g_white = geod_graph(mesh_view(white));
+        const GeodGraph g_pial = geod_graph(mesh_view(pial));
+        const GeodGraph& gc_white = geod_graph_cached(cache, mesh_view(white));
+        REQUIRE( gc_white.csr.offsets == g_white.csr.offsets);
+        REQUIRE( gc_white.csr.adj == g_white.csr.adj);
+        REQUIRE( gc_white.weights == g_white.weights);
+        const GeodGraph& gc_pial = geod_graph_cached(cache, mesh_view(pial));
+        REQUIRE( gc_pial.csr.adj == g_pial.csr.adj);
+        REQUIRE( gc_pial.weights == g_pial.weights);
+        REQUIRE( cache.num_builds == 1);
+        REQUIRE( cache.num_reuses == 1);
+
+        std::vector<int32_t> half(white.num_vertices() / 2);
+        std::iota(half.begin(), half.end(), 0);
+        const MeshMask mask = mesh_mask(mesh_view(pial), half);
+        const GeodGraph& gc_masked = geod_graph_cached(cache, masked_view(mesh_view(pial), mask));
+        REQUIRE( gc_masked.weights == geod_graph(masked_view(mesh_view(pial), mask)).weights);
+        REQUIRE( cache.num_builds == 2);
+        REQUIRE( mesh_edge_lengths(gc_masked) == mesh_edge_lengths(masked_view(mesh_view(pial), mask)));
+    }
+
+    SECTION("Geodesic circles and neighborhoods on a cached graph equal the ones on the mesh" ) {
+        GeodGraphCache cache;
+        geod_graph_cached(cache, mesh_view(white));
+        const GeodGraph& g = geod_graph_cached(cache, mesh_view(pial));
+        const std::vector<std::vector<float>> circ = geodesic_circles(mesh_view(pial), g, std::vector<int>(), 5.0, false);
+        REQUIRE( circ == geodesic_circles(mesh_view(pial), std::vector<int>(), 5.0, false));
+        const std::vector<std::vector<GeodNeighbor>> neigh = geod_neighborhood(g, 15.0, true);
+        const std::vector<std::vector<GeodNeighbor>> neigh_mesh = geod_neighborhood(mesh_view(pial), 15.0, true);
+        REQUIRE( neigh.size() == neigh_mesh.size());
+        for(size_t v = 0; v < neigh.size(); v++) {
+            REQUIRE( neigh[v].size() == neigh_mesh[v].size());
+            for(size_t j = 0; j < neigh[v].size(); j++) {
+                REQUIRE( neigh[v][j].index == neigh_mesh[v][j].index);
+                REQUIRE( neigh[v][j].distance == neigh_mesh[v][j].distance);
+            }
+        }
+        REQUIRE_THROWS( geod_graph_set_coords(cache.graph, mesh_view(fs::Mesh::construct_cube())));
+    }
+}
+
+
+TEST_CASE( "The lean GeodMesh type gives the same geodesic and area results as MyMesh" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    MyMesh m;
+    vcgmesh_from_fs_surface(&m, surface);
+    GeodMesh gm;
+    vcgmesh_from_fs_surface(&gm, surface);
+
+    SECTION("The conversion round trip, areas and edge lengths are identical" ) {
+        fs::Mesh surface2;
+        fs_surface_from_vcgmesh(&surface2, gm);
+        REQUIRE( surface2.vertices == surface.vertices);
+        REQUIRE( surface2.faces == surface.faces);
+        REQUIRE( mesh_area_total(gm) == mesh_area_total(m));
+        REQUIRE( mesh_area_per_face(gm) == mesh_area_per_face(m));
+        REQUIRE( mesh_edge_lengths(gm) == mesh_edge_lengths(m));
+    }
+
+    SECTION("Geodesic distances are identical" ) {
+        const std::vector<int> sources = { 0, 100, 500 };
+        for(size_t i = 0; i < sources.size(); i++) {
+            REQUIRE( geodist(gm, std::vector<int>(1, sources[i]), -1.0f) == geodist(m, std::vector<int>(1, sources[i]), -1.0f));
+        }
+    }
+}
+
+
+TEST_CASE( "The local face sweep gives the same geodesic circle stats as the per-radius loop over all faces" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    const MeshView<float, int32_t> m = mesh_view(surface);
+
+    SECTION("The vertex-face incidence lists the faces of each vertex in ascending order" ) {
+        const MeshCSR vf = mesh_vertex_faces(m);
+        REQUIRE( vf.num_vertices() == surface.num_vertices());
+        REQUIRE( vf.adj.size() == surface.num_faces() * 3);
+        std::vector<std::vector<int32_t>> expected(surface.num_vertices());
+        for(size_t f = 0; f < surface.num_faces(); f++) {
+            for(int j = 0; j < 3; j++) {
+                expected[surface.fm_at(f, j)].push_back(int32_t(f));
+            }
+        }
+        for(size_t v = 0; v < surface.num_vertices(); v++) {
+            REQUIRE( vf.neighbors(v) == expected[v]);
+        }
+    }
+
+    SECTION("Area and perimeter agree for all radii" ) {
+        const GeodGraph g = geod_graph(m);
+        const std::vector<double> per_face_area = mesh_area_per_face(m);
+        const MeshCSR vf = mesh_vertex_faces(m);
+        const std::vector<double> radii = linspace<double>(5.0, 25.0, 10);
+        GeodWorkspace ws(g.num_vertices());
+        const std::vector<int32_t> sources = { 0, 100, 500 };
+        for(size_t s = 0; s < sources.size(); s++) {
+            geod_dijkstra(g, &sources[s], 1, 40.0f, ws);
+            std::vector<float> dist(m.num_vertices(), std::numeric_limits<float>::max());
+            std::vector<int32_t> local_faces;
+            for(size_t j = 0; j < ws.reached.size(); j++) {
+                dist[ws.reached[j]] = ws.dist[ws.reached[j]];
+                local_faces.insert(local_faces.end(), vf.neighbors_begin(ws.reached[j]), vf.neighbors_end(ws.reached[j]));
+            }
+            std::sort(local_faces.begin(), local_faces.end());
+            local_faces.erase(std::unique(local_faces.begin(), local_faces.end()), local_faces.end());
+            REQUIRE( local_faces.size() < m.num_faces());
+            const std::vector<std::vector<double>> stats = _compute_geodesic_circle_stats(m, dist, radii, per_face_area, local_faces);
+
+            for(size_t r = 0; r < radii.size(); r++) {
+                double area = 0.0, perimeter = 0.0;
+                for(size_t f = 0; f < m.num_faces(); f++) {
+                    int num_in = 0;
+                    for(int j = 0; j < 3; j++) {
+                        num_in += dist[m.fm_at(f, j)] < radii[r] ? 1 : 0;
+                    }
+                    if(num_in == 3) {
+                        area += per_face_area[f];
+                    } else if(num_in > 0) {
+                        _add_partial_face_circle_stats(m, dist, int(f), radii[r], per_face_area[f], area, perimeter);
+                    }
+                }
+                REQUIRE( area > 0.0);
+                REQUIRE( stats[0][r] == Approx(area).epsilon(1e-9));
+                REQUIRE( stats[1][r] == Approx(perimeter).epsilon(1e-9));
+            }
+        }
+    }
+}
+
+
+TEST_CASE( "The lazily computed mesh geometry equals the geometry functions and is shared by all users" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    const MeshView<float, int32_t> m = mesh_view(surface);
+    const MeshGeometry<float, int32_t> geom(m);
+
+    SECTION("All quantities equal the ones of the view functions, and are computed once" ) {
+        std::vector<const void*> addresses(5, NULL);
+        std::vector<int> num_mismatches(5, 0);
+        # pragma omp parallel for
+        for(int i = 0; i < 16; i++) {
+            const void* a[5] = { &geom.face_areas(), &geom.face_adjacency(), &geom.edge_lengths(), &geom.vnormals(), &geom.vertex_coords() };
+            # pragma omp critical
+            {
+                for(int j = 0; j < 5; j++) {
+                    if(addresses[j] == NULL) {
+                        addresses[j] = a[j];
+                    }
+                    num_mismatches[j] += (addresses[j] != a[j]) ? 1 : 0;
+                }
+            }
+        }
+        REQUIRE( num_mismatches == std::vector<int>(5, 0));
+        REQUIRE( mesh_area_per_face(geom) == mesh_area_per_face(m));
+        REQUIRE( mesh_face_adjacency(geom) == mesh_face_adjacency(m));
+        REQUIRE( mesh_area_total(geom) == mesh_area_total(m));
+        REQUIRE( mesh_edge_lengths(geom) == mesh_edge_lengths(m));
+        REQUIRE( mesh_vnormals(geom) == mesh_vnormals(m));
+        REQUIRE( mesh_vertex_coords(geom) == mesh_vertex_coords(m));
+        const std::vector<int32_t>& edges = geom.edges();
+        REQUIRE( edges.size() == geom.edge_lengths().size() * 2);
+        REQUIRE( edges[0] < edges[1]);
+        REQUIRE( geom.edge_lengths()[0] == Approx(dist_euclid(surface.vertex_coords(edges[0]), surface.vertex_coords(edges[1]))));
+    }
+
+    SECTION("Geodesic circles and neighborhoods computed from the geometry equal the ones from the mesh" ) {
+        const GeodGraph g = geod_graph(m);
+        REQUIRE( geodesic_circles(geom, g, std::vector<int>(), 5.0, false) == geodesic_circles(m, std::vector<int>(), 5.0, false));
+        const std::vector<std::vector<GeodNeighbor>> neigh = geod_neighborhood(g, 10.0, false);
+        const std::vector<Neighborhood> nh = neighborhoods_from_geod_neighbors(neigh, geom);
+        const std::vector<Neighborhood> nh_mesh = neighborhoods_from_geod_neighbors(neigh, m);
+        REQUIRE( nh.size() == nh_mesh.size());
+        for(size_t i = 0; i < nh.size(); i++) {
+            REQUIRE( nh[i].coords == nh_mesh[i].coords);
+            REQUIRE( nh[i].normals == nh_mesh[i].normals);
+        }
+
+        std::vector<int32_t> half(surface.num_vertices() / 2);
+        std::iota(half.begin(), half.end(), 0);
+        const MeshMask mask = mesh_mask(m, half);
+        REQUIRE_THROWS( geodesic_circles(geom, geod_graph(masked_view(m, mask)), std::vector<int>(), 5.0, false, &mask));
+    }
+}
+
+
+TEST_CASE( "The root finding radius method gives geodesic circles with the requested area" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    const MeshView<float, int32_t> m = mesh_view(surface);
+    const float scale = 5.0;
+    const double target_area = scale * mesh_area_total(m) / 100.0;
+
+    const std::vector<std::vector<float>> circ = geodesic_circles(m, std::vector<int>(), scale, false, "root", 1e-7);
+    const std::vector<std::vector<float>> circ_spline = geodesic_circles(m, std::vector<int>(), scale, false);
+    REQUIRE( circ.size() == 2);
+    REQUIRE( circ[0].size() == surface.num_vertices());
+
+    SECTION("The area of the circle at the radius found equals the requested area, and the perimeter is the one at that radius" ) {
+        const GeodGraph g = geod_graph(m);
+        const std::vector<double> per_face_area = mesh_area_per_face(m);
+        std::vector<int32_t> all_faces(m.num_faces());
+        std::iota(all_faces.begin(), all_faces.end(), 0);
+        GeodWorkspace ws(g.num_vertices());
+        for(int32_t v = 0; v < int32_t(surface.num_vertices()); v += 37) {
+            geod_dijkstra(g, &v, 1, -1.0f, ws);
+            std::vector<float> dist(ws.dist.begin(), ws.dist.end());
+            for(size_t j = 0; j < dist.size(); j++) {
+                if(dist[j] == 0.0f && int32_t(j) != v) {
+                    dist[j] = std::numeric_limits<float>::max();
+                }
+            }
+            const std::vector<std::vector<double>> stats = _compute_geodesic_circle_stats(m, dist, std::vector<double>(1, double(circ[0][v])), per_face_area, all_faces);
+            REQUIRE( stats[0][0] == Approx(target_area).epsilon(1e-5));
+            REQUIRE( circ[1][v] == Approx(stats[1][0]).epsilon(1e-4));
+        }
+    }
+
+    SECTION("The results are close to the ones of the spline method, and the mean distances do not change them" ) {
+        std::vector<double> rel_diff(circ[0].size());
+        for(size_t v = 0; v < rel_diff.size(); v++) {
+            rel_diff[v] = std::fabs(circ[0][v] - circ_spline[0][v]) / circ[0][v];
+        }
+        std::sort(rel_diff.begin(), rel_diff.end());
+        REQUIRE( rel_diff[rel_diff.size() / 2] < 0.01);
+
+        const std::vector<std::vector<float>> circ_md = geodesic_circles(m, std::vector<int>(), scale, true, "root", 1e-7);
+        REQUIRE( circ_md.size() == 3);
+        for(size_t v = 0; v < circ[0].size(); v++) {
+            REQUIRE( circ_md[0][v] == Approx(circ[0][v]).epsilon(1e-5));
+        }
+        REQUIRE_THROWS( geodesic_circles(m, std::vector<int>(1, 0), scale, false, "newton"));
+    }
+}
+
+TEST_CASE( "Geodesic circles for several scales from one search equal the ones computed per scale" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    const MeshView<float, int32_t> m = mesh_view(surface);
+    const MeshGeometry<float, int32_t> geom(m);
+    const GeodGraph g = geod_graph(m);
+    std::vector<float> scales;
+    scales.push_back(5.0);
+    scales.push_back(10.0);
+    scales.push_back(2.0);
+
+    SECTION("The spline and root radii and perimeters of each scale, and the mean distances, equal the single scale ones" ) {
+        const std::vector<std::string> methods = { "spline", "root" };
+        for(size_t mi = 0; mi < methods.size(); mi++) {
+            const std::vector<std::vector<float>> circ = geodesic_circles_scales(geom, g, std::vector<int>(), scales, true, NULL, methods[mi]);
+            REQUIRE( circ.size() == 2 * scales.size() + 1);
+            for(size_t k = 0; k < scales.size(); k++) {
+                const std::vector<std::vector<float>> circ_k = geodesic_circles(geom, g, std::vector<int>(), scales[k], true, NULL, methods[mi]);
+                REQUIRE( circ[2 * k].size() == surface.num_vertices());
+                for(size_t v = 0; v < circ_k[0].size(); v++) {
+                    REQUIRE( circ[2 * k][v] == Approx(circ_k[0][v]).epsilon(1e-5));
+                    REQUIRE( circ[2 * k + 1][v] == Approx(circ_k[1][v]).epsilon(1e-5));
+                    REQUIRE( circ[2 * scales.size()][v] == circ_k[2][v]);
+                }
+            }
+        }
+    }
+
+    SECTION("An empty list of scales is rejected" ) {
+        REQUIRE_THROWS( geodesic_circles_scales(geom, g, std::vector<int>(), std::vector<float>()));
+    }
+}
+
+TEST_CASE( "The frontier-driven search stops early with the distances and circles of an unbounded search" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    const MeshView<float, int32_t> m = mesh_view(surface);
+    const GeodGraph g = geod_graph(m);
+    GeodWorkspace ws(g.num_vertices()), ws_full(g.num_vertices());
+
+    SECTION("All faces crossing the radius get the final vertex distances, and the search is a prefix of the unbounded one" ) {
+        const float radius = 30.0f;
+        for(int32_t v = 0; v < int32_t(surface.num_vertices()); v += 13) {
+            geod_dijkstra(g, &v, 1, -1.0f, ws_full);
+            const size_t num_beyond = geod_dijkstra_faces(g, &v, 1, radius, ws);
+            REQUIRE( ws.reached.size() < ws_full.reached.size());
+            REQUIRE( std::equal(ws.reached.begin(), ws.reached.end(), ws_full.reached.begin()));
+            REQUIRE( num_beyond > 0);
+            for(size_t f = 0; f < m.num_faces(); f++) {
+                const int32_t* fv = m.face(f);
+                if(std::min(ws_full.dist[fv[0]], std::min(ws_full.dist[fv[1]], ws_full.dist[fv[2]])) < radius) {
+                    REQUIRE( ws.dist[fv[0]] == ws_full.dist[fv[0]]);
+                    REQUIRE( ws.dist[fv[1]] == ws_full.dist[fv[1]]);
+                    REQUIRE( ws.dist[fv[2]] == ws_full.dist[fv[2]]);
+                }
+            }
+            for(size_t j = 0; j < ws.reached.size(); j++) {
+                REQUIRE( ws.dist[ws.reached[j]] >= ws_full.dist[ws.reached[j]]);
+            }
+        }
+    }
+
+    SECTION("The spline radii and perimeters are bit-identical to the ones from unbounded searches" ) {
+        const float scale = 5.0;
+        const std::vector<std::vector<float>> circ = geodesic_circles(m, std::vector<int>(), scale, false);
+        const std::vector<double> per_face_area = mesh_area_per_face(m);
+        const double target_area = scale * mesh_area_total(m) / 100.0;
+        const MeshCSR vertex_faces = mesh_vertex_faces(m);
+        std::vector<int32_t> face_mark(m.num_faces(), -1), faces;
+        for(int32_t v = 0; v < int32_t(surface.num_vertices()); v += 7) {
+            geod_dijkstra(g, &v, 1, -1.0f, ws_full);
+            std::vector<float> dist(ws_full.dist.begin(), ws_full.dist.end());
+            for(size_t j = 0; j < dist.size(); j++) {
+                if(int32_t(j) != v && dist[j] <= 0.000000001) {
+                    dist[j] = std::numeric_limits<float>::max();
+                }
+            }
+            _collect_vertex_faces(vertex_faces, ws_full.reached, face_mark, v, faces);
+            double r, p;
+            _geodesic_circle_radius_spline(m, dist, per_face_area, faces, target_area, std::sqrt(target_area / M_PI), r, p);
+            REQUIRE( circ[0][v] == float(r));
+            REQUIRE( circ[1][v] == float(p));
+        }
+    }
+}
+
+TEST_CASE( "The neighborhood cache serves smaller radii exactly and feeds the geodesic circles" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    const MeshView<float, int32_t> m = mesh_view(surface);
+    const GeodGraph g = geod_graph(m);
+    const GeodCacheKey key = geod_cache_key(m);
+    const std::string cache_dir = ".";
+    const std::string cache_file = geod_cache_filename(cache_dir, key);
+    std::remove(cache_file.c_str());
+
+    SECTION("The cache key depends on the mesh content and the mask only" ) {
+        fs::Mesh moved = surface;
+        moved.vertices[0] += 1.0f;
+        std::vector<int32_t> half(surface.num_vertices() / 2);
+        std::iota(half.begin(), half.end(), 0);
+        const MeshMask mask = mesh_mask(m, half);
+        REQUIRE( geod_cache_key(mesh_view(surface)).mesh_hash == key.mesh_hash);
+        REQUIRE( geod_cache_key(mesh_view(moved)).mesh_hash != key.mesh_hash);
+        REQUIRE( geod_cache_key(m, &mask).mask_hash != key.mask_hash);
+        REQUIRE( geod_cache_filename(cache_dir, geod_cache_key(m, &mask)) != cache_file);
+    }
+
+    SECTION("Cached neighborhoods filtered to a smaller radius equal the computed ones" ) {
+        bool hit = true;
+        const GeodNeighborhoods nh = geod_neighborhoods_cached(cache_dir, key, g, 30.0f, &hit);
+        REQUIRE( ! hit);
+        GeodNeighborhoods nh_read;
+        REQUIRE( ! read_geod_neighborhoods(cache_file, key, 30.5f, nh_read));
+        geod_neighborhoods_cached(cache_dir, key, g, 20.0f, &hit);
+        REQUIRE( hit);
+        REQUIRE( read_geod_neighborhoods(cache_file, key, 30.0f, nh_read));
+        REQUIRE( nh_read.offsets == nh.offsets);
+        REQUIRE( nh_read.index == nh.index);
+        REQUIRE( nh_read.dist == nh.dist);
+        GeodCacheKey other_key = key;
+        other_key.backend = "other";
+        REQUIRE( ! read_geod_neighborhoods(cache_file, other_key, 10.0f, nh_read));
+
+        for(int s = 0; s < 2; s++) {
+            const bool include_self = (s == 0);
+            const std::vector<std::vector<GeodNeighbor>> expected = geod_neighborhood(g, 20.0f, include_self);
+            const std::vector<std::vector<GeodNeighbor>> filtered = geod_neighborhoods_filter(nh_read, 20.0f, include_self);
+            REQUIRE( filtered.size() == expected.size());
+            for(size_t v = 0; v < expected.size(); v++) {
+                REQUIRE( filtered[v].size() == expected[v].size());
+                for(size_t j = 0; j < expected[v].size(); j++) {
+                    REQUIRE( filtered[v][j].index == expected[v][j].index);
+                    REQUIRE( filtered[v][j].distance == expected[v][j].distance);
+                }
+            }
+        }
+        REQUIRE_THROWS( geod_neighborhoods_filter(nh_read, 31.0f, true));
+
+        GeodNeighborhoods corrupt = nh_read;  // Damaged files count as misses instead of being used.
+        corrupt.index[5] = int32_t(g.num_vertices());
+        write_geod_neighborhoods(cache_file, key, corrupt);
+        REQUIRE( ! read_geod_neighborhoods(cache_file, key, 10.0f, nh_read));
+        corrupt = nh;
+        std::swap(corrupt.offsets[3], corrupt.offsets[4]);
+        write_geod_neighborhoods(cache_file, key, corrupt);
+        REQUIRE( ! read_geod_neighborhoods(cache_file, key, 10.0f, nh_read));
+        REQUIRE( geod_tmp_filename(cache_file) != cache_file + ".tmp");
+    }
+
+    SECTION("Geodesic circles from the neighborhoods are bit-identical to the ones from searches" ) {
+        const MeshGeometry<float, int32_t> geom(m);
+        const std::vector<float> scales(1, 5.0f);
+        const std::vector<std::string> methods = { "spline", "root" };
+        for(size_t mi = 0; mi < methods.size(); mi++) {
+            const GeodNeighborhoods nh = geod_neighborhoods_cached(cache_dir, key, g, geodesic_circles_neighborhood_radius(geom, scales, methods[mi]));
+            const std::vector<std::vector<float>> circ = geodesic_circles_scales(geom, g, std::vector<int>(), scales, false, NULL, methods[mi]);
+            const std::vector<std::vector<float>> circ_nh = geodesic_circles_scales(geom, g, std::vector<int>(), scales, false, NULL, methods[mi], 1e-6, &nh);
+            REQUIRE( circ_nh == circ);
+        }
+        GeodNeighborhoods too_small;
+        too_small.offsets.assign(3, 0);
+        REQUIRE_THROWS( geodesic_circles_scales(geom, g, std::vector<int>(), scales, false, NULL, "spline", 1e-6, &too_small));
+    }
+    std::remove(cache_file.c_str());
+}
+
+
+TEST_CASE( "The graph sidecar file round-trips the mesh graph and is only used for the mesh it was built for" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    const MeshView<float, int32_t> m = mesh_view(surface);
+    const std::string mesh_file = "test_sidecar_lh.white";  // Only its sidecar file name is used.
+    const std::string sidecar_file = geod_graph_sidecar_filename(mesh_file);
+    std::remove(sidecar_file.c_str());
+
+    SECTION("The face adjacency of a closed mesh is symmetric and pairs faces sharing an edge" ) {
+        const std::vector<int32_t> face_adj = mesh_face_adjacency(m);
+        REQUIRE( face_adj.size() == surface.num_faces() * 3);
+        for(size_t f = 0; f < surface.num_faces(); f++) {
+            for(size_t k = 0; k < 3; k++) {
+                const int32_t other = face_adj[f*3 + k];
+                REQUIRE( other >= 0);
+                REQUIRE( size_t(other) != f);
+                const int32_t a = surface.faces[f*3 + k], b = surface.faces[f*3 + (k + 1) % 3];
+                const int32_t* ov = surface.faces.data() + other * 3;
+                REQUIRE( std::count(ov, ov + 3, a) == 1);
+                REQUIRE( std::count(ov, ov + 3, b) == 1);
+                REQUIRE( std::count(face_adj.begin() + other * 3, face_adj.begin() + other * 3 + 3, int32_t(f)) == 1);
+            }
+        }
+        const std::vector<int32_t> single_face = { 0, 1, 2 };
+        REQUIRE( mesh_face_adjacency_from_faces(single_face.data(), 1, 3) == std::vector<int32_t>(3, -1));
+    }
+
+    SECTION("A sidecar written for the mesh is read back exactly and gives the graph of the mesh" ) {
+        const GeodGraphSidecar sc = geod_graph_sidecar(m);
+        const GeodGraph g = geod_graph(m);
+        bool hit = true;
+        geod_graph_from_sidecar(mesh_file, m, &hit);
+        REQUIRE( ! hit);
+        write_geod_graph_sidecar(sidecar_file, sc);
+
+        GeodGraphSidecar sc_read;
+        REQUIRE( read_geod_graph_sidecar(sidecar_file, mesh_content_hash(m), sc_read));
+        REQUIRE( sc_read.mesh_hash == sc.mesh_hash);
+        REQUIRE( sc_read.graph.csr.offsets == g.csr.offsets);
+        REQUIRE( sc_read.graph.csr.adj == g.csr.adj);
+        REQUIRE( sc_read.graph.weights == g.weights);
+        REQUIRE( sc_read.face_adj == mesh_face_adjacency(m));
+        REQUIRE( sc_read.face_areas == mesh_area_per_face(m));
+
+        const GeodGraph g_read = geod_graph_from_sidecar(mesh_file, m, &hit);
+        REQUIRE( hit);
+        REQUIRE( geodist(g_read, std::vector<int32_t>(1, 0), -1.0f) == geodist(g, std::vector<int32_t>(1, 0), -1.0f));
+    }
+
+    SECTION("A geometry with the face areas and face adjacency of the sidecar gives the same geodesic circles" ) {
+        write_geod_graph_sidecar(sidecar_file, geod_graph_sidecar(m));
+        GeodGraphSidecar sc_read;
+        REQUIRE( read_geod_graph_sidecar_for(mesh_file, m, sc_read));
+        const MeshGeometry<float, int32_t> geom(m);
+        const MeshGeometry<float, int32_t> geom_sc(m, sc_read.face_areas, sc_read.face_adj);
+        REQUIRE( geom_sc.face_areas() == geom.face_areas());
+        REQUIRE( geom_sc.area_total() == geom.area_total());
+        REQUIRE( geom_sc.face_adjacency() == geom.face_adjacency());
+        const std::vector<float> scales(1, 5.0f);
+        REQUIRE( geodesic_circles_scales(geom_sc, sc_read.graph, std::vector<int>(), scales, false, NULL, "root") == geodesic_circles_scales(geom, geod_graph(m), std::vector<int>(), scales, false, NULL, "root"));
+        REQUIRE_THROWS( MeshGeometry<float, int32_t>(m, std::vector<double>(3, 1.0), std::vector<int32_t>()));
+        REQUIRE_THROWS( MeshGeometry<float, int32_t>(m, std::vector<double>(), std::vector<int32_t>(3, -1)));
+    }
+
+    SECTION("A sidecar of another mesh or a damaged sidecar is not used" ) {
+        write_geod_graph_sidecar(sidecar_file, geod_graph_sidecar(m));
+        fs::Mesh moved = surface;
+        moved.vertices[0] += 1.0f;
+        bool hit = true;
+        const GeodGraph g_moved = geod_graph_from_sidecar(mesh_file, mesh_view(moved), &hit);
+        REQUIRE( ! hit);
+        REQUIRE( g_moved.weights == geod_graph(mesh_view(moved)).weights);
+
+        std::ifstream ifs(sidecar_file, std::ifstream::binary);
+        std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        ifs.close();
+        std::ofstream ofs(sidecar_file, std::ofstream::binary);
+        ofs.write(content.data(), std::streamsize(content.size() - 8));
+        ofs.close();
+        GeodGraphSidecar sc_read;
+        REQUIRE( ! read_geod_graph_sidecar(sidecar_file, mesh_content_hash(m), sc_read));
+        geod_graph_from_sidecar(mesh_file, m, &hit);
+        REQUIRE( ! hit);
+    }
+    std::remove(sidecar_file.c_str());
+}
+
+
+TEST_CASE( "Delta-stepping gives the distances of Dijkstra's algorithm for any bucket width" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    const GeodGraph g = geod_graph(mesh_view(surface));
+    const std::vector<int32_t> sources = { 0, 17, 17, 500 };
+    const std::vector<float> max_dists = { -1.0f, 25.0f, 4.0f, -1.0f };  // The workspace is reused between small and large searches.
+    const std::vector<float> deltas = { -1.0f, 0.3f, 2.0f, 1000.0f };
+
+    SECTION("Full and bounded searches from several sources" ) {
+        GeodWorkspace ws_dijkstra, ws_delta;
+        for(size_t i = 0; i < max_dists.size(); i++) {
+            geod_dijkstra(g, sources.data(), sources.size(), max_dists[i], ws_dijkstra);
+            std::vector<int32_t> reached = ws_dijkstra.reached;
+            std::sort(reached.begin(), reached.end());
+            for(size_t j = 0; j < deltas.size(); j++) {
+                geod_delta_stepping(g, sources.data(), sources.size(), max_dists[i], deltas[j], ws_delta);
+                REQUIRE( ws_delta.dist == ws_dijkstra.dist);
+                REQUIRE( ws_delta.reached == reached);
+            }
+        }
+        REQUIRE( geodist_delta(g, std::vector<int32_t>(1, 3), -1.0f) == geodist(g, std::vector<int32_t>(1, 3), -1.0f));
+        REQUIRE( geod_delta_default(g) > 0.0f);
+    }
+
+    SECTION("The search backends are interchangeable" ) {
+        GeodWorkspace ws_dijkstra, ws_delta;
+        geod_search(g, sources.data(), 1, -1.0f, ws_dijkstra, "dijkstra");
+        geod_search(g, sources.data(), 1, -1.0f, ws_delta, "delta");
+        REQUIRE( ws_delta.dist == ws_dijkstra.dist);
+        REQUIRE_THROWS( geod_search(g, sources.data(), 1, -1.0f, ws_delta, "bfs"));
+        REQUIRE( geod_search_backend(geod_num_threads()) == "dijkstra");
+        const int32_t invalid_source = int32_t(g.num_vertices());
+        REQUIRE_THROWS( geod_delta_stepping(g, &invalid_source, 1, -1.0f, -1.0f, ws_delta));
+        geod_search(g, sources.data(), 1, 10.0f, ws_dijkstra, "dijkstra");
+        geod_search(g, sources.data(), 1, 10.0f, ws_delta, "delta");
+        REQUIRE( ws_delta.dist == ws_dijkstra.dist);
+    }
+}
+
+
+TEST_CASE( "A* and bidirectional A* give the shortest path lengths of Dijkstra's algorithm while settling fewer vertices" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    const MeshView<> mv = mesh_view(surface);
+    const GeodGraph g = geod_graph(mv);
+    const int32_t nv = int32_t(g.num_vertices());
+
+    SECTION("Paths between many vertex pairs" ) {
+        GeodPathWorkspace ws;
+        GeodWorkspace ws_dijkstra;
+        size_t settled_dijkstra = 0, settled_astar = 0, settled_bidir = 0;
+        for(int32_t i = 0; i < 200; i++) {
+            const int32_t source = (i * 7919) % nv, target = (i * 104729 + 13) % nv;
+            geod_dijkstra(g, &source, 1, -1.0f, ws_dijkstra);
+            const float d = ws_dijkstra.dist[target];
+            const GeodPath p_dijkstra = geod_shortest_path(g, mv, source, target, "dijkstra", &ws);
+            const GeodPath p_astar = geod_shortest_path(g, mv, source, target, "astar", &ws);
+            const GeodPath p_bidir = geod_shortest_path(g, mv, source, target, "bidir", &ws);
+            REQUIRE( p_dijkstra.length == d);
+            REQUIRE( p_astar.length == d);
+            REQUIRE( p_bidir.length == Approx(d).epsilon(1e-5));
+            const std::vector<GeodPath> paths = { p_dijkstra, p_astar, p_bidir };
+            for(size_t k = 0; k < paths.size(); k++) {
+                REQUIRE( paths[k].vertices.front() == source);
+                REQUIRE( paths[k].vertices.back() == target);
+                float length = 0.0f;
+                for(size_t j = 1; j < paths[k].vertices.size(); j++) {
+                    length += _geod_edge_weight(g, paths[k].vertices[j-1], paths[k].vertices[j]);  // Throws unless consecutive vertices are adjacent.
+                }
+                REQUIRE( length == Approx(d).epsilon(1e-5));
+            }
+            settled_dijkstra += p_dijkstra.num_settled;
+            settled_astar += p_astar.num_settled;
+            settled_bidir += p_bidir.num_settled;
+        }
+        REQUIRE( settled_astar < settled_dijkstra / 2);
+        REQUIRE( settled_bidir < settled_dijkstra / 2);
+
+        const GeodPath same = geod_shortest_path(g, mv, 5, 5, "bidir", &ws);
+        REQUIRE( same.length == 0.0f);
+        REQUIRE( same.vertices == std::vector<int32_t>({ 5 }));
+    }
+
+    SECTION("Batch pair distances and invalid queries" ) {
+        const std::vector<int32_t> u = { 0, 17, 500 }, v = { 600, 3, 500 };
+        const std::vector<float> d_astar = geod_pair_distances(g, mv, u, v, "astar");
+        const std::vector<float> d_dijkstra = geod_pair_distances(g, mv, u, v, "dijkstra");
+        REQUIRE( d_astar == d_dijkstra);
+        REQUIRE( d_astar[2] == 0.0f);
+        REQUIRE_THROWS( geod_shortest_path(g, mv, 0, nv, "astar"));
+        REQUIRE_THROWS( geod_shortest_path(g, mv, 0, 1, "bfs"));
+        REQUIRE_THROWS( geod_pair_distances(g, mv, u, std::vector<int32_t>({ 1 }), "astar"));
+        const fs::Mesh cube = fs::Mesh::construct_cube();
+        REQUIRE_THROWS_AS( geod_pair_distances(g, mesh_view(cube), u, v, "astar"), std::invalid_argument);
+    }
+}
+
+
+TEST_CASE( "Shortest-path trees give the paths to all vertices from one search" ) {
+
+    fs::Mesh surface;
+    read_surf_mmap(&surface, "demo_data/subjects_dir/fsaverage3/surf/lh.white");
+    const MeshView<> mv = mesh_view(surface);
+    const GeodGraph g = geod_graph(mv);
+    const int32_t nv = int32_t(g.num_vertices());
+    const std::vector<int32_t> sources = { 17 };
+    std::vector<int32_t> all_vertices(nv);
+    std::iota(all_vertices.begin(), all_vertices.end(), 0);
+
+    SECTION("The engine and VCGLIB trees have the geodist distances, and each vertex extends the path to its parent" ) {
+        MyMesh m;
+        vcgmesh_from_fs_surface(&m, surface);
+        const std::vector<GeodTree> trees = { geod_tree(g, sources, -1.0f), geod_tree(m, std::vector<int>(1, 17), -1.0f) };
+        const std::vector<float> d = geodist(g, sources, -1.0f);
+        for(size_t t = 0; t < trees.size(); t++) {
+            REQUIRE( trees[t].dist == d);
+            REQUIRE( trees[t].parent[17] == -1);
+            for(int32_t v = 0; v < nv; v++) {
+                if(v != 17) {
+                    const int32_t p = trees[t].parent[v];
+                    REQUIRE( p >= 0);
+                    REQUIRE( trees[t].dist[p] + _geod_edge_weight(g, p, v) == trees[t].dist[v]);
+                }
+            }
+        }
+    }
+
+    SECTION("Bulk path reconstruction gives the paths of the point-to-point searches" ) {
+        const GeodTree tree = geod_tree(g, sources, -1.0f);
+        const GeodTreePaths paths = geod_tree_paths(tree, all_vertices);
+        REQUIRE( paths.num_paths() == size_t(nv));
+        for(int32_t v = 0; v < nv; v++) {
+            const std::vector<int32_t> path = paths.path(v);
+            REQUIRE( path.front() == 17);
+            REQUIRE( path.back() == v);
+            float length = 0.0f;
+            for(size_t j = 1; j < path.size(); j++) {
+                length += _geod_edge_weight(g, path[j-1], path[j]);
+            }
+            REQUIRE( length == tree.dist[v]);
+            REQUIRE( length == geod_shortest_path(g, mv, 17, v, "astar").length);
+        }
+        REQUIRE_THROWS( geod_tree_paths(tree, std::vector<int32_t>(1, nv)));
+        GeodTree cyclic = tree;
+        cyclic.parent[17] = cyclic.parent[0];
+        cyclic.parent[cyclic.parent[0]] = 17;
+        REQUIRE_THROWS( geod_tree_paths(cyclic, std::vector<int32_t>(1, 0)));
+        GeodTree orphan = tree;
+        orphan.parent[0] = -1;  // A reached vertex without parent which is not a source.
+        REQUIRE_THROWS_AS( geod_tree_paths(orphan, std::vector<int32_t>(1, 0)), std::domain_error);
+    }
+
+    SECTION("Bounded trees cover a region, and trees can be written to and read from files" ) {
+        const GeodTree tree = geod_tree(g, sources, 20.0f);
+        const GeodTreePaths paths = geod_tree_paths(tree, all_vertices);
+        size_t num_reached = 0;
+        for(int32_t v = 0; v < nv; v++) {
+            REQUIRE( tree.reached(v) == (tree.dist[v] < 20.0f));
+            REQUIRE( paths.path(v).empty() == ! tree.reached(v));
+            num_reached += tree.reached(v) ? 1 : 0;
+        }
+        REQUIRE( num_reached > 1);
+        REQUIRE( num_reached < size_t(nv));
+
+        const std::string tree_file = "test_tree_tmp.geodtree";
+        write_geod_tree(tree_file, tree);
+        const GeodTree tree2 = read_geod_tree(tree_file);
+        std::remove(tree_file.c_str());
+        REQUIRE( tree2.dist == tree.dist);
+        REQUIRE( tree2.parent == tree.parent);
+        REQUIRE_THROWS( read_geod_tree("demo_data/subjects_dir/fsaverage3/surf/lh.white"));
+    }
+
+    SECTION("A tree with untraced vertices is pruned to the vertices whose paths lead to a source, and read back" ) {
+        GeodTree tree = geod_tree(g, sources, -1.0f);
+        REQUIRE( geod_tree_prune(tree) == 0);
+        // Mark a vertex as not reached, like one whose path the exact algorithm of geodpath could not trace back.
+        int32_t untraced = -1;
+        for(int32_t v = 0; v < nv && untraced < 0; v++) {
+            if(tree.parent[v] >= 0 && tree.parent[tree.parent[v]] >= 0) {
+                untraced = tree.parent[v];
+            }
+        }
+        REQUIRE( untraced >= 0);
+        tree.dist[untraced] = GEOD_UNREACHED;
+        tree.parent[untraced] = -1;
+        const GeodTree unpruned = tree;
+        const std::string tree_file = "test_tree_pruned_tmp.geodtree";
+        write_geod_tree(tree_file, unpruned);
+        REQUIRE_THROWS_AS( read_geod_tree(tree_file), std::domain_error);
+
+        const size_t num_pruned = geod_tree_prune(tree);
+        REQUIRE( num_pruned > 0);
+        size_t num_below = 0;  // The vertices whose path in the unpruned tree runs through the untraced vertex.
+        for(int32_t v = 0; v < nv; v++) {
+            bool below = false;
+            for(int32_t p = unpruned.parent[v]; p != -1; p = unpruned.parent[p]) {
+                below = below || p == untraced;
+            }
+            num_below += below ? 1 : 0;
+            REQUIRE( tree.reached(v) == (unpruned.reached(v) && ! below));
+        }
+        REQUIRE( num_pruned == num_below);
+        write_geod_tree(tree_file, tree);
+        const GeodTree tree2 = read_geod_tree(tree_file);
+        std::remove(tree_file.c_str());
+        REQUIRE( tree2.parent == tree.parent);
+        const GeodTreePaths paths = geod_tree_paths(tree2, all_vertices);
+        for(int32_t v = 0; v < nv; v++) {
+            REQUIRE( paths.path(v).empty() == ! tree.reached(v));
+        }
+
+        GeodTree cyclic = geod_tree(g, sources, -1.0f);
+        const int32_t a = cyclic.parent[0];
+        cyclic.parent[a] = 0;  // Vertices 0 and a form a cycle, cut off from the source.
+        REQUIRE( geod_tree_prune(cyclic) >= 2);
+        REQUIRE( ! cyclic.reached(0));
+        REQUIRE( cyclic.reached(17));
+        geod_tree_paths(cyclic, all_vertices);
+    }
+}
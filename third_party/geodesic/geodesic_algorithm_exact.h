@@ -1183,6 +1183,13 @@ GeodesicAlgorithmExact::trace_back(
                0) // while this point is not in the direct visibility of some source (if we are
                   // inside the FACE, we obviously hit the source)
         {
+            if (path.size() > m_mesh->edges().size()) // a path crosses each edge at most once, so the
+                                                      // trace back cycles on a degenerate mesh
+            {
+                path.clear();
+                return;
+            }
+
             SurfacePoint& q = path.back();
 
             possible_traceback_edges(q, possible_edges);